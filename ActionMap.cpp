@@ -0,0 +1,530 @@
+#include "ActionMap.h"
+#include "KeyNames.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline char FoldCase(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+static BOOL EqualNames(const char *a, const char *b)
+{
+    while (*a && FoldCase(*a) == FoldCase(*b))
+    {
+        ++a;
+        ++b;
+    }
+    return FoldCase(*a) == FoldCase(*b);
+}
+
+static DWORD HashName(const char *name)
+{
+    DWORD hash = 2166136261u; // FNV-1a
+    while (*name)
+    {
+        hash ^= (BYTE)FoldCase(*name++);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void CopyName(char *dest, const char *name)
+{
+    strncpy(dest, name, ACTION_NAME_LENGTH - 1);
+    dest[ACTION_NAME_LENGTH - 1] = '\0';
+}
+
+// Scratch bits of an action while a frame is evaluated
+#define ACTION_HELD 1    // A binding is down at the end of the frame
+#define ACTION_TOUCHED 2 // A button went down during the frame, even if it was released again
+
+// Key and mouse button states keep INPUT_KS_PRESSED in the frame of the release
+static inline BYTE ButtonBits(BYTE state)
+{
+    if ((state & INPUT_KS_PRESSED) == 0)
+        return 0;
+    return (state & INPUT_KS_RELEASED) ? ACTION_TOUCHED : ACTION_HELD;
+}
+
+static inline float GetAxis(const InputJoystick &joystick, DWORD axis)
+{
+    if (axis < 3)
+        return joystick.GetPosition()[axis];
+    if (axis < 6)
+        return joystick.GetRotation()[axis - 3];
+    return joystick.GetSliders()[axis - 6];
+}
+
+//
+// InputActionTable
+//
+
+InputActionTable::InputActionTable(int actionCount, int bindingCount)
+    : m_ActionCount(actionCount), m_BindingCount(bindingCount), m_JoystickMask(0)
+{
+    memset(m_SourceStart, 0, sizeof(m_SourceStart));
+    m_Bindings = new InputBinding[bindingCount > 0 ? bindingCount : 1];
+    m_States = new BYTE[actionCount];
+    m_Down = new BYTE[actionCount];
+    m_Values = new float[actionCount];
+    m_Names = new char[actionCount][ACTION_NAME_LENGTH];
+    memset(m_Slots, -1, sizeof(m_Slots));
+    Clear();
+}
+
+InputActionTable::~InputActionTable()
+{
+    delete[] m_Bindings;
+    delete[] m_States;
+    delete[] m_Down;
+    delete[] m_Values;
+    delete[] m_Names;
+}
+
+void InputActionTable::Clear()
+{
+    memset(m_States, 0, m_ActionCount);
+    memset(m_Values, 0, m_ActionCount * sizeof(float));
+}
+
+int InputActionTable::Evaluate(const InputKeyboard &keyboard, const InputMouse &mouse, InputJoystick *joysticks, int joystickCount)
+{
+    memset(m_Down, 0, m_ActionCount);
+    memset(m_Values, 0, m_ActionCount * sizeof(float));
+
+    const InputBinding *binding = m_Bindings;
+    const InputBinding *end = m_Bindings + m_SourceStart[INPUT_BIND_KEY + 1];
+    const BYTE *keys = keyboard.GetState();
+    for (; binding < end; ++binding)
+    {
+        BYTE bits = ButtonBits(keys[binding->Code]);
+        if (bits)
+        {
+            m_Down[binding->Action] |= bits;
+            if (fabsf(binding->Scale) > fabsf(m_Values[binding->Action]))
+                m_Values[binding->Action] = binding->Scale;
+        }
+    }
+
+    end = m_Bindings + m_SourceStart[INPUT_BIND_MOUSE_BUTTON + 1];
+    const BYTE *buttons = mouse.GetState().rgbButtons;
+    for (; binding < end; ++binding)
+    {
+        BYTE bits = ButtonBits(buttons[binding->Code]);
+        if (bits)
+        {
+            m_Down[binding->Action] |= bits;
+            if (fabsf(binding->Scale) > fabsf(m_Values[binding->Action]))
+                m_Values[binding->Action] = binding->Scale;
+        }
+    }
+
+    // Each bound joystick is polled once, before its bindings are read
+    if (m_JoystickMask)
+    {
+        for (int i = 0; i < joystickCount && i < 32; i++)
+        {
+            if (m_JoystickMask & (1u << i))
+                joysticks[i].Poll();
+        }
+    }
+
+    end = m_Bindings + m_SourceStart[INPUT_BIND_JOYSTICK_BUTTON + 1];
+    for (; binding < end; ++binding)
+    {
+        if (binding->Device >= joystickCount)
+            continue;
+        if (KeyMaskTest(joysticks[binding->Device].GetButtonMask(), binding->Code))
+        {
+            m_Down[binding->Action] |= ACTION_HELD;
+            if (fabsf(binding->Scale) > fabsf(m_Values[binding->Action]))
+                m_Values[binding->Action] = binding->Scale;
+        }
+    }
+
+    end = m_Bindings + m_SourceStart[INPUT_BIND_JOYSTICK_AXIS + 1];
+    for (; binding < end; ++binding)
+    {
+        if (binding->Device >= joystickCount)
+            continue;
+        float value = GetAxis(joysticks[binding->Device], binding->Code) * binding->Scale;
+        if (value >= binding->Threshold)
+            m_Down[binding->Action] |= ACTION_HELD;
+        if (fabsf(value) > fabsf(m_Values[binding->Action]))
+            m_Values[binding->Action] = value;
+    }
+
+    // A tap within the frame reports both edges without holding the action
+    for (int i = 0; i < m_ActionCount; i++)
+    {
+        int was = m_States[i] & INPUT_ACTION_DOWN;
+        int held = m_Down[i] & ACTION_HELD;
+        int pressed = (m_Down[i] != 0) & !was;
+        int released = (was | pressed) & !held;
+        m_States[i] = (BYTE)(held | (pressed << 1) | (released << 2));
+    }
+    return m_BindingCount;
+}
+
+void InputActionTable::Adopt(const InputActionTable &previous)
+{
+    for (int i = 0; i < m_ActionCount; i++)
+    {
+        int handle = previous.Find(m_Names[i]);
+        if (handle >= 0)
+        {
+            m_States[i] = previous.m_States[handle] & INPUT_ACTION_DOWN;
+            m_Values[i] = previous.m_Values[handle];
+        }
+    }
+}
+
+int InputActionTable::Find(const char *name) const
+{
+    if (!name || name[0] == '\0')
+        return -1;
+
+    DWORD slot = HashName(name) & (ACTION_HASH_SIZE - 1);
+    while (m_Slots[slot] >= 0)
+    {
+        if (EqualNames(m_Names[m_Slots[slot]], name))
+            return m_Slots[slot];
+        slot = (slot + 1) & (ACTION_HASH_SIZE - 1);
+    }
+    return -1;
+}
+
+const char *InputActionTable::GetName(int handle) const
+{
+    return (handle >= 0 && handle < m_ActionCount) ? m_Names[handle] : NULL;
+}
+
+//
+// InputActionMap
+//
+
+InputActionMap::InputActionMap()
+{
+    Clear();
+}
+
+void InputActionMap::Clear()
+{
+    m_ActionCount = 0;
+    m_BindingCount = 0;
+}
+
+int InputActionMap::FindAction(const char *name) const
+{
+    if (!name)
+        return -1;
+    for (int i = 0; i < m_ActionCount; i++)
+    {
+        if (EqualNames(m_Names[i], name))
+            return i;
+    }
+    return -1;
+}
+
+int InputActionMap::AddAction(const char *name)
+{
+    if (!name || name[0] == '\0')
+        return -1;
+
+    int handle = FindAction(name);
+    if (handle >= 0)
+        return handle;
+    if (m_ActionCount >= ACTION_MAX_ACTIONS)
+        return -1;
+
+    CopyName(m_Names[m_ActionCount], name);
+    return m_ActionCount++;
+}
+
+BOOL InputActionMap::Bind(int action, INPUT_BINDING_SOURCE source, DWORD device, DWORD code, float scale, float threshold)
+{
+    if (action < 0 || action >= m_ActionCount || m_BindingCount >= ACTION_MAX_BINDINGS)
+        return FALSE;
+
+    switch (source)
+    {
+    case INPUT_BIND_KEY:
+        if (code >= KEYBOARD_BUFFER_SIZE)
+            return FALSE;
+        break;
+    case INPUT_BIND_MOUSE_BUTTON:
+        if (code >= 4)
+            return FALSE;
+        break;
+    case INPUT_BIND_JOYSTICK_BUTTON:
+        if (device >= 32 || code >= JOYSTICK_BUTTON_COUNT)
+            return FALSE;
+        break;
+    case INPUT_BIND_JOYSTICK_AXIS:
+        if (device >= 32 || code >= INPUT_AXIS_COUNT)
+            return FALSE;
+        break;
+    default:
+        return FALSE;
+    }
+
+    InputBinding &binding = m_Bindings[m_BindingCount++];
+    binding.Action = (WORD)action;
+    binding.Source = (BYTE)source;
+    binding.Device = (BYTE)device;
+    binding.Code = (WORD)code;
+    binding.Reserved = 0;
+    binding.Scale = scale;
+    binding.Threshold = threshold;
+    return TRUE;
+}
+
+InputActionTable *InputActionMap::Compile() const
+{
+    if (m_ActionCount == 0)
+        return NULL;
+
+    InputActionTable *table = new InputActionTable(m_ActionCount, m_BindingCount);
+    for (int i = 0; i < m_ActionCount; i++)
+    {
+        memcpy(table->m_Names[i], m_Names[i], ACTION_NAME_LENGTH);
+        DWORD slot = HashName(m_Names[i]) & (ACTION_HASH_SIZE - 1);
+        while (table->m_Slots[slot] >= 0)
+            slot = (slot + 1) & (ACTION_HASH_SIZE - 1);
+        table->m_Slots[slot] = (short)i;
+    }
+
+    // Grouped by source, keeping the file order within a source; keys and
+    // buttons are further ordered by code so the reads walk the state forward
+    int count = 0;
+    for (int source = 0; source < INPUT_BIND_SOURCE_COUNT; source++)
+    {
+        table->m_SourceStart[source] = count;
+        int first = count;
+        for (int i = 0; i < m_BindingCount; i++)
+        {
+            const InputBinding &binding = m_Bindings[i];
+            if (binding.Source != source)
+                continue;
+
+            int j = count++;
+            while (j > first && source != INPUT_BIND_JOYSTICK_AXIS &&
+                   (table->m_Bindings[j - 1].Device > binding.Device ||
+                    (table->m_Bindings[j - 1].Device == binding.Device && table->m_Bindings[j - 1].Code > binding.Code)))
+            {
+                table->m_Bindings[j] = table->m_Bindings[j - 1];
+                --j;
+            }
+            table->m_Bindings[j] = binding;
+            if (source >= INPUT_BIND_JOYSTICK_BUTTON)
+                table->m_JoystickMask |= 1u << binding.Device;
+        }
+    }
+    table->m_SourceStart[INPUT_BIND_SOURCE_COUNT] = count;
+    return table;
+}
+
+BOOL InputActionMap::Load(const char *path, const KeyNameTable *names, int *errorLine)
+{
+    if (errorLine)
+        *errorLine = 0;
+    if (!path)
+        return FALSE;
+
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return FALSE;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < 0)
+    {
+        fclose(file);
+        return FALSE;
+    }
+
+    char *text = new char[size + 1];
+    size_t read = fread(text, 1, (size_t)size, file);
+    fclose(file);
+    text[read] = '\0';
+
+    BOOL result = Parse(text, names, errorLine);
+    delete[] text;
+    return result;
+}
+
+BOOL InputActionMap::Parse(const char *text, const KeyNameTable *names, int *errorLine)
+{
+    if (errorLine)
+        *errorLine = 0;
+    if (!text)
+        return FALSE;
+
+    int actionCount = m_ActionCount;
+    int bindingCount = m_BindingCount;
+    char line[256];
+    int number = 0;
+    while (*text)
+    {
+        const char *next = strchr(text, '\n');
+        size_t length = next ? (size_t)(next - text) : strlen(text);
+        if (length >= sizeof(line))
+            length = sizeof(line) - 1;
+        memcpy(line, text, length);
+        line[length] = '\0';
+        ++number;
+
+        if (!ParseLine(line, names))
+        {
+            m_ActionCount = actionCount;
+            m_BindingCount = bindingCount;
+            if (errorLine)
+                *errorLine = number;
+            return FALSE;
+        }
+        if (!next)
+            break;
+        text = next + 1;
+    }
+    return TRUE;
+}
+
+// Splits the next token off the line; quoted tokens may contain spaces
+static char *NextToken(char **cursor)
+{
+    char *p = *cursor;
+    while (*p == ' ' || *p == '\t' || *p == '\r')
+        ++p;
+    if (*p == '\0' || *p == '#')
+        return NULL;
+
+    char *token;
+    if (*p == '"')
+    {
+        token = ++p;
+        while (*p && *p != '"')
+            ++p;
+    }
+    else
+    {
+        token = p;
+        while (*p && *p != ' ' && *p != '\t' && *p != '\r' && *p != '#')
+            ++p;
+    }
+
+    if (*p == '#')
+    {
+        *p = '\0';
+        *cursor = p; // The comment ends the line
+        return token;
+    }
+    if (*p)
+        *p++ = '\0';
+    *cursor = p;
+    return token;
+}
+
+static BOOL ParseNumber(const char *token, DWORD *value)
+{
+    char *end = NULL;
+    unsigned long n = strtoul(token, &end, 0);
+    if (!end || end == token || *end != '\0')
+        return FALSE;
+    *value = (DWORD)n;
+    return TRUE;
+}
+
+static BOOL ParseFloat(const char *token, float *value)
+{
+    char *end = NULL;
+    double n = strtod(token, &end);
+    if (!end || end == token || *end != '\0')
+        return FALSE;
+    *value = (float)n;
+    return TRUE;
+}
+
+static BOOL ParseAxis(const char *token, DWORD *axis)
+{
+    static const char *const axes[INPUT_AXIS_COUNT] = {"x", "y", "z", "rx", "ry", "rz", "slider0", "slider1"};
+    for (DWORD i = 0; i < INPUT_AXIS_COUNT; i++)
+    {
+        if (EqualNames(token, axes[i]))
+        {
+            *axis = i;
+            return TRUE;
+        }
+    }
+    return ParseNumber(token, axis);
+}
+
+BOOL InputActionMap::ParseLine(char *line, const KeyNameTable *names)
+{
+    char *cursor = line;
+    char *action = NextToken(&cursor);
+    if (!action)
+        return TRUE; // Blank or comment
+
+    char *kind = NextToken(&cursor);
+    if (!kind)
+        return FALSE;
+
+    INPUT_BINDING_SOURCE source;
+    DWORD device = 0;
+    DWORD code = 0;
+    char *token = NextToken(&cursor);
+    if (!token)
+        return FALSE;
+
+    if (EqualNames(kind, "key"))
+    {
+        source = INPUT_BIND_KEY;
+        if (!ParseNumber(token, &code))
+        {
+            code = names ? names->GetKey(token) : KEYNAME_KEY_COUNT;
+            if (code >= KEYNAME_KEY_COUNT)
+                return FALSE;
+        }
+    }
+    else if (EqualNames(kind, "mouse"))
+    {
+        source = INPUT_BIND_MOUSE_BUTTON;
+        if (!ParseNumber(token, &code))
+            return FALSE;
+    }
+    else if (EqualNames(kind, "button") || EqualNames(kind, "axis"))
+    {
+        BOOL axis = EqualNames(kind, "axis");
+        source = axis ? INPUT_BIND_JOYSTICK_AXIS : INPUT_BIND_JOYSTICK_BUTTON;
+        if (!ParseNumber(token, &device))
+            return FALSE;
+        token = NextToken(&cursor);
+        if (!token || !(axis ? ParseAxis(token, &code) : ParseNumber(token, &code)))
+            return FALSE;
+    }
+    else
+    {
+        return FALSE;
+    }
+
+    float scale = 1.0f;
+    float threshold = ACTION_DEFAULT_THRESHOLD;
+    token = NextToken(&cursor);
+    if (token && !ParseFloat(token, &scale))
+        return FALSE;
+    if (token && source == INPUT_BIND_JOYSTICK_AXIS)
+    {
+        token = NextToken(&cursor);
+        if (token && !ParseFloat(token, &threshold))
+            return FALSE;
+    }
+    if (NextToken(&cursor))
+        return FALSE;
+
+    return Bind(AddAction(action), source, device, code, scale, threshold);
+}
@@ -0,0 +1,129 @@
+#ifndef ACTIONMAP_H
+#define ACTIONMAP_H
+
+#include "InputDevices.h"
+
+class KeyNameTable;
+
+#define ACTION_MAX_ACTIONS 256
+#define ACTION_MAX_BINDINGS 1024
+#define ACTION_NAME_LENGTH 32
+#define ACTION_HASH_SIZE 512          // Power of two, at least twice ACTION_MAX_ACTIONS
+#define ACTION_DEFAULT_THRESHOLD 0.5f // Scaled axis value from which an axis binding holds its action down
+
+enum INPUT_BINDING_SOURCE
+{
+    INPUT_BIND_KEY = 0,             // Code is a scancode
+    INPUT_BIND_MOUSE_BUTTON = 1,    // Code is a mouse button (0-3)
+    INPUT_BIND_JOYSTICK_BUTTON = 2, // Code is a button (0-127) of joystick Device
+    INPUT_BIND_JOYSTICK_AXIS = 3,   // Code is an INPUT_AXIS of joystick Device
+    INPUT_BIND_SOURCE_COUNT = 4
+};
+
+// Action state bits
+enum INPUT_ACTION_STATE
+{
+    INPUT_ACTION_IDLE = 0,
+    INPUT_ACTION_DOWN = 1,
+    INPUT_ACTION_PRESSED = 2, // Went down this frame
+    INPUT_ACTION_RELEASED = 4 // Went up this frame; both edges without DOWN for a tap within the frame
+};
+
+struct InputBinding
+{
+    WORD Action;
+    BYTE Source; // INPUT_BINDING_SOURCE
+    BYTE Device; // Joystick index
+    WORD Code;
+    WORD Reserved;
+    float Scale;     // Value of the action while a button is held, multiplier of an axis
+    float Threshold; // Scaled axis value from which the action is down
+};
+
+// Compiled action map: bindings sorted by source in one flat array and the
+// state of every action in contiguous arrays indexed by handle. Evaluated once
+// per frame from the device states; the bindings never change once compiled.
+class InputActionTable
+{
+    friend class InputActionMap;
+
+public:
+    ~InputActionTable();
+
+    // Reads the bindings of the frame and updates every action. Joysticks with
+    // bindings are polled once here, so later queries of the frame reuse the poll.
+    // Returns the number of bindings evaluated.
+    int Evaluate(const InputKeyboard &keyboard, const InputMouse &mouse, InputJoystick *joysticks, int joystickCount);
+    // Carries the held actions of a table being replaced over to this one, by name,
+    // so swapping tables does not produce spurious presses or releases
+    void Adopt(const InputActionTable &previous);
+    void Clear();
+
+    int GetActionCount() const { return m_ActionCount; }
+    int GetBindingCount() const { return m_BindingCount; }
+    // Handles are indices, in the order the actions were defined; -1 for an unknown name
+    int Find(const char *name) const;
+    const char *GetName(int handle) const;
+
+    const BYTE *GetStates() const { return m_States; } // INPUT_ACTION_STATE bits per action
+    const float *GetValues() const { return m_Values; } // Largest scaled value of the bindings per action
+    BYTE GetState(int handle) const { return (handle >= 0 && handle < m_ActionCount) ? m_States[handle] : (BYTE)INPUT_ACTION_IDLE; }
+    float GetValue(int handle) const { return (handle >= 0 && handle < m_ActionCount) ? m_Values[handle] : 0.0f; }
+
+private:
+    InputActionTable(int actionCount, int bindingCount);
+    InputActionTable(const InputActionTable &);
+    InputActionTable &operator=(const InputActionTable &);
+
+    int m_ActionCount;
+    int m_BindingCount;
+    int m_SourceStart[INPUT_BIND_SOURCE_COUNT + 1]; // First binding of each source
+    DWORD m_JoystickMask;                           // Joysticks with bindings
+    InputBinding *m_Bindings;
+    BYTE *m_States;
+    BYTE *m_Down; // Scratch for the frame being evaluated
+    float *m_Values;
+    char (*m_Names)[ACTION_NAME_LENGTH];
+    short m_Slots[ACTION_HASH_SIZE]; // Action per hash slot, -1 when empty
+};
+
+// Editable list of actions and their bindings, compiled into an InputActionTable.
+//
+// Text format, one binding per line, '#' starts a comment:
+//   action  key     <scancode|"key name">            [scale]
+//   action  mouse   <button>                          [scale]
+//   action  button  <joystick> <button>               [scale]
+//   action  axis    <joystick> <x|y|z|rx|ry|rz|slider0|slider1> [scale] [threshold]
+// Actions get their handles in the order they first appear.
+class InputActionMap
+{
+public:
+    InputActionMap();
+    void Clear();
+
+    // Returns the handle of the action, creating it if needed; -1 when full
+    int AddAction(const char *name);
+    BOOL Bind(int action, INPUT_BINDING_SOURCE source, DWORD device, DWORD code, float scale = 1.0f, float threshold = ACTION_DEFAULT_THRESHOLD);
+
+    // Appends the bindings of a file. Key names are resolved through names when given.
+    // On failure the map is left as it was and errorLine receives the offending line.
+    BOOL Load(const char *path, const KeyNameTable *names = NULL, int *errorLine = NULL);
+    BOOL Parse(const char *text, const KeyNameTable *names = NULL, int *errorLine = NULL);
+
+    int GetActionCount() const { return m_ActionCount; }
+    int GetBindingCount() const { return m_BindingCount; }
+    int FindAction(const char *name) const;
+
+    // Returns a new table owned by the caller, NULL if the map is empty
+    InputActionTable *Compile() const;
+
+private:
+    BOOL ParseLine(char *line, const KeyNameTable *names);
+
+    int m_ActionCount;
+    int m_BindingCount;
+    char m_Names[ACTION_MAX_ACTIONS][ACTION_NAME_LENGTH];
+    InputBinding m_Bindings[ACTION_MAX_BINDINGS];
+};
+
+#endif // ACTIONMAP_H
@@ -0,0 +1,119 @@
+#ifndef AXISKERNEL_H
+#define AXISKERNEL_H
+
+#include "InputBackend.h"
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AXISKERNEL_SSE2 1
+#endif
+
+// The eight axes in DIJOYSTATE2 order: lX, lY, lZ, lRx, lRy, lRz, rglSlider[0], rglSlider[1]
+#define AXIS_KERNEL_AXES 8
+
+// Per-axis mapping of the raw value to [-1, 1]: value * Scale + Offset.
+// Both are 0 for an absent axis or an empty range, which reads as centered.
+struct InputAxisScale
+{
+    float Scale[AXIS_KERNEL_AXES];
+    float Offset[AXIS_KERNEL_AXES];
+};
+
+inline void InputAxisScaleSet(InputAxisScale &scale, int axis, BOOL present, LONG minValue, LONG maxValue)
+{
+    if (!present || maxValue == minValue)
+    {
+        scale.Scale[axis] = 0.0f;
+        scale.Offset[axis] = 0.0f;
+        return;
+    }
+    double factor = 2.0 / ((double)maxValue - (double)minValue);
+    scale.Scale[axis] = (float)factor;
+    scale.Offset[axis] = (float)(-(double)minValue * factor - 1.0);
+}
+
+// Normalizes the eight axes, applies the radial deadzone to X/Y and Rx/Ry and the
+// axial one to Z, Rz and the sliders, then the gain of each axis, and clamps to [-1, 1].
+// raw points to the first axis of a DIJOYSTATE2; gains and out are in the same order.
+inline void InputNormalizeAxes(const LONG *raw, const InputAxisScale &scale, float deadzone, const float *gains, float *out)
+{
+#if defined(AXISKERNEL_SSE2)
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minusOne = _mm_set1_ps(-1.0f);
+    __m128 low = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)raw));
+    __m128 high = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(raw + 4)));
+    low = _mm_add_ps(_mm_mul_ps(low, _mm_loadu_ps(scale.Scale)), _mm_loadu_ps(scale.Offset));
+    high = _mm_add_ps(_mm_mul_ps(high, _mm_loadu_ps(scale.Scale + 4)), _mm_loadu_ps(scale.Offset + 4));
+    low = _mm_max_ps(_mm_min_ps(low, one), minusOne);
+    high = _mm_max_ps(_mm_min_ps(high, one), minusOne);
+
+    // Regroup as the stick pairs (X, Y, Rx, Ry) and the single axes (Z, Rz, S0, S1)
+    __m128 rotation = _mm_shuffle_ps(low, high, _MM_SHUFFLE(0, 0, 3, 3));
+    __m128 pairs = _mm_shuffle_ps(low, rotation, _MM_SHUFFLE(2, 0, 1, 0));
+    __m128 singles = _mm_shuffle_ps(_mm_shuffle_ps(low, high, _MM_SHUFFLE(1, 1, 2, 2)), high, _MM_SHUFFLE(3, 2, 2, 0));
+
+    const __m128 zone = _mm_set1_ps(deadzone);
+    if (deadzone < 1.0f)
+    {
+        // Pair magnitude in both lanes of the pair; beyond the deadzone it is
+        // remapped from [deadzone, 1] to [0, 1]. The mask also drops the 0/0 of a centered stick.
+        __m128 squares = _mm_mul_ps(pairs, pairs);
+        __m128 magnitude = _mm_sqrt_ps(_mm_add_ps(squares, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(2, 3, 0, 1))));
+        __m128 outside = _mm_cmpgt_ps(magnitude, zone);
+        __m128 factor = _mm_div_ps(_mm_sub_ps(magnitude, zone), _mm_mul_ps(_mm_sub_ps(one, zone), magnitude));
+        pairs = _mm_mul_ps(pairs, _mm_and_ps(outside, factor));
+    }
+    else
+    {
+        pairs = _mm_setzero_ps();
+    }
+    singles = _mm_and_ps(singles, _mm_cmpge_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), singles), zone));
+
+    // Back to DIJOYSTATE2 order for the gains
+    low = _mm_shuffle_ps(pairs, _mm_shuffle_ps(singles, pairs, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0));
+    high = _mm_shuffle_ps(_mm_shuffle_ps(pairs, singles, _MM_SHUFFLE(1, 1, 3, 3)), singles, _MM_SHUFFLE(3, 2, 2, 0));
+    _mm_storeu_ps(out, _mm_max_ps(_mm_min_ps(_mm_mul_ps(low, _mm_loadu_ps(gains)), one), minusOne));
+    _mm_storeu_ps(out + 4, _mm_max_ps(_mm_min_ps(_mm_mul_ps(high, _mm_loadu_ps(gains + 4)), one), minusOne));
+#else
+    float axes[AXIS_KERNEL_AXES];
+    for (int i = 0; i < AXIS_KERNEL_AXES; i++)
+    {
+        float value = (float)raw[i] * scale.Scale[i] + scale.Offset[i];
+        axes[i] = (value > 1.0f) ? 1.0f : ((value < -1.0f) ? -1.0f : value);
+    }
+
+    static const int pairAxes[2][2] = {{0, 1}, {3, 4}};
+    for (int p = 0; p < 2; p++)
+    {
+        float &a = axes[pairAxes[p][0]];
+        float &b = axes[pairAxes[p][1]];
+        float magnitude = sqrtf(a * a + b * b);
+        float factor = (deadzone < 1.0f && magnitude > deadzone) ? (magnitude - deadzone) / ((1.0f - deadzone) * magnitude) : 0.0f;
+        a *= factor;
+        b *= factor;
+    }
+    static const int singleAxes[4] = {2, 5, 6, 7};
+    for (int s = 0; s < 4; s++)
+    {
+        if (fabsf(axes[singleAxes[s]]) < deadzone)
+            axes[singleAxes[s]] = 0.0f;
+    }
+
+    for (int i = 0; i < AXIS_KERNEL_AXES; i++)
+    {
+        float value = axes[i] * gains[i];
+        out[i] = (value > 1.0f) ? 1.0f : ((value < -1.0f) ? -1.0f : value);
+    }
+#endif
+}
+
+// Same with one gain for every axis
+inline void InputNormalizeAxes(const LONG *raw, const InputAxisScale &scale, float deadzone, float gain, float *out)
+{
+    const float gains[AXIS_KERNEL_AXES] = {gain, gain, gain, gain, gain, gain, gain, gain};
+    InputNormalizeAxes(raw, scale, deadzone, gains, out);
+}
+
+#endif // AXISKERNEL_H
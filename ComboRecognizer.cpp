@@ -0,0 +1,518 @@
+#include "ComboRecognizer.h"
+
+#include <string.h>
+
+static inline InputTime Elapsed(InputTime from, InputTime to)
+{
+    return (to > from) ? to - from : 0;
+}
+
+//
+// InputComboRecognizer
+//
+
+InputComboRecognizer::InputComboRecognizer()
+    : m_PatternCount(0), m_StateCount(0), m_ClassCount(0), m_Next(NULL), m_OutputStart(NULL),
+      m_Outputs(NULL), m_Sequences(NULL), m_JoystickMask(0), m_MaxGap(0)
+{
+    memset(m_Classes, 0, sizeof(m_Classes));
+    memset(m_Matched, 0, sizeof(m_Matched));
+    m_MatchCount = 0;
+    Reset();
+}
+
+InputComboRecognizer::~InputComboRecognizer()
+{
+    delete[] m_Next;
+    delete[] m_OutputStart;
+    delete[] m_Outputs;
+    delete[] m_Sequences;
+}
+
+void InputComboRecognizer::Reset()
+{
+    m_State = 0;
+    m_Fed = 0;
+    m_Position = 0;
+    memset(m_History, 0, sizeof(m_History));
+}
+
+void InputComboRecognizer::ClearMatches()
+{
+    if (m_MatchCount > 0)
+        memset(m_Matched, 0, sizeof(m_Matched));
+    m_MatchCount = 0;
+}
+
+BOOL InputComboRecognizer::Accepts(const InputComboSequence &sequence) const
+{
+    // Press i of the sequence is the (Length - 1 - i)-th latest press
+    const int mask = COMBO_MAX_STEPS - 1;
+    int first = m_Position - (sequence.Length - 1);
+    for (int i = 1; i < sequence.Length; i++)
+    {
+        if (sequence.MaxGap[i] == 0)
+            continue;
+        InputTime from = m_History[(first + i - sequence.Anchor[i]) & mask];
+        if (Elapsed(from, m_History[(first + i) & mask]) > sequence.MaxGap[i])
+            return FALSE;
+    }
+    if (sequence.MaxDuration != 0 && Elapsed(m_History[first & mask], m_History[m_Position & mask]) > sequence.MaxDuration)
+        return FALSE;
+    return TRUE;
+}
+
+void InputComboRecognizer::Feed(DWORD symbol, InputTime time)
+{
+    if (symbol >= COMBO_SYMBOL_COUNT || m_StateCount == 0)
+        return;
+
+    // Nothing spans a pause longer than every window
+    if (m_MaxGap != 0 && m_Fed > 0 && Elapsed(m_History[m_Position], time) > m_MaxGap)
+    {
+        m_State = 0;
+        m_Fed = 0;
+    }
+
+    m_Position = (m_Position + 1) & (COMBO_MAX_STEPS - 1);
+    m_History[m_Position] = time;
+    if (m_Fed < COMBO_MAX_STEPS)
+        ++m_Fed;
+
+    m_State = m_Next[m_State * m_ClassCount + m_Classes[symbol]];
+    int end = m_OutputStart[m_State + 1];
+    if (m_OutputStart[m_State] == end)
+        return;
+
+    BOOL matched = FALSE;
+    for (int i = m_OutputStart[m_State]; i < end; i++)
+    {
+        const InputComboSequence &sequence = m_Sequences[m_Outputs[i]];
+        if ((DWORD)sequence.Length > m_Fed || !Accepts(sequence))
+            continue;
+
+        matched = TRUE;
+        m_Matched[sequence.Pattern] = TRUE;
+        if (m_MatchCount < COMBO_MAX_MATCHES)
+        {
+            InputComboMatch &match = m_Matches[m_MatchCount++];
+            match.Pattern = sequence.Pattern;
+            match.Start = m_History[(m_Position - (sequence.Length - 1)) & (COMBO_MAX_STEPS - 1)];
+            match.End = time;
+        }
+    }
+
+    // The presses of a match are not reused by the next one
+    if (matched)
+    {
+        m_State = 0;
+        m_Fed = 0;
+    }
+}
+
+int InputComboRecognizer::Process(const InputKeyboard &keyboard, const InputMouse &mouse, InputJoystick *joysticks, int joystickCount)
+{
+    ClearMatches();
+
+    int count = 0;
+    for (int i = 0; i < mouse.GetEventCount(); i++)
+    {
+        const DIDEVICEOBJECTDATA &data = mouse.GetEvent(i);
+        if (data.dwOfs >= DIMOFS_BUTTON0 && data.dwOfs <= DIMOFS_BUTTON3 && (data.dwData & 0x80) != 0)
+        {
+            m_Presses[count].Symbol = InputComboMouseButton(data.dwOfs - DIMOFS_BUTTON0);
+            m_Presses[count].Time = mouse.GetEventTime(i);
+            ++count;
+        }
+    }
+
+    // Game controllers have no buffer: presses are the button edges of the frame
+    for (int j = 0; j < joystickCount && j < 32 && m_JoystickMask != 0; j++)
+    {
+        if ((m_JoystickMask & (1u << j)) == 0)
+            continue;
+        joysticks[j].Poll();
+        const DWORD *pressed = joysticks[j].GetPressedMask();
+        for (int w = 0; w < JOYSTICK_BUTTON_WORDS; w++)
+        {
+            for (DWORD word = pressed[w]; word != 0; word &= word - 1)
+            {
+                // Kept sorted: joystick times are not earlier than the mouse events of the frame, as a rule
+                Press press;
+                press.Symbol = InputComboJoystickButton(j, w * 32 + KeyMaskLowestBit(word));
+                press.Time = joysticks[j].GetTime();
+                int k = count++;
+                while (k > 0 && m_Presses[k - 1].Time > press.Time)
+                {
+                    m_Presses[k] = m_Presses[k - 1];
+                    --k;
+                }
+                m_Presses[k] = press;
+            }
+        }
+    }
+
+    // Merged with the key presses, which are already in order
+    const InputEventRing &keys = keyboard.GetHardwareEvents();
+    DWORD keyCount = keys.GetCount();
+    DWORD k = 0;
+    int o = 0;
+    int fed = 0;
+    while (k < keyCount || o < count)
+    {
+        if (k < keyCount && (o >= count || keys.Get(k).Time <= m_Presses[o].Time))
+        {
+            const InputEvent &event = keys.Get(k++);
+            if ((event.Data.dwData & 0x80) == 0)
+                continue;
+            Feed(InputComboKey(event.Data.dwOfs), event.Time);
+        }
+        else
+        {
+            Feed(m_Presses[o].Symbol, m_Presses[o].Time);
+            ++o;
+        }
+        ++fed;
+    }
+    return fed;
+}
+
+//
+// InputComboSet
+//
+
+InputComboSet::InputComboSet()
+{
+    Clear();
+}
+
+void InputComboSet::Clear()
+{
+    m_PatternCount = 0;
+    m_StepCount = 0;
+    m_Open = FALSE;
+    m_Failed = FALSE;
+}
+
+void InputComboSet::BeginPattern(DWORD maxDuration)
+{
+    if (m_Open)
+        EndPattern();
+    m_Open = TRUE;
+    m_Failed = m_PatternCount >= COMBO_MAX_PATTERNS;
+    if (m_Failed)
+        return;
+
+    Pattern &pattern = m_Patterns[m_PatternCount];
+    pattern.MaxDuration = maxDuration;
+    pattern.FirstStep = m_StepCount;
+    pattern.StepCount = 0;
+    pattern.Presses = 0;
+}
+
+BOOL InputComboSet::AddPress(DWORD symbol, DWORD maxGap)
+{
+    return AddChord(&symbol, 1, maxGap, 0);
+}
+
+BOOL InputComboSet::AddChord(const DWORD *symbols, int count, DWORD maxGap, DWORD window)
+{
+    if (!m_Open || m_Failed)
+        return FALSE;
+
+    Pattern &pattern = m_Patterns[m_PatternCount];
+    BOOL valid = symbols && count > 0 && count <= COMBO_MAX_CHORD &&
+                 pattern.Presses + count <= COMBO_MAX_STEPS && m_StepCount < COMBO_MAX_SEQUENCES;
+    for (int i = 0; valid && i < count; i++)
+        valid = symbols[i] < COMBO_SYMBOL_COUNT;
+    if (!valid)
+    {
+        m_Failed = TRUE;
+        return FALSE;
+    }
+
+    Step &step = m_Steps[m_StepCount++];
+    memcpy(step.Symbols, symbols, count * sizeof(DWORD));
+    step.Count = count;
+    step.MaxGap = maxGap;
+    step.Window = window;
+    pattern.StepCount++;
+    pattern.Presses += count;
+    return TRUE;
+}
+
+int InputComboSet::EndPattern()
+{
+    if (!m_Open)
+        return -1;
+    m_Open = FALSE;
+
+    if (m_PatternCount >= COMBO_MAX_PATTERNS)
+        return -1;
+
+    Pattern &pattern = m_Patterns[m_PatternCount];
+    if (m_Failed || pattern.Presses == 0)
+    {
+        m_StepCount = pattern.FirstStep;
+        return -1;
+    }
+    return m_PatternCount++;
+}
+
+int InputComboSet::AddSequence(const DWORD *symbols, int count, DWORD maxGap, DWORD maxDuration)
+{
+    BeginPattern(maxDuration);
+    for (int i = 0; i < count; i++)
+        AddPress(symbols ? symbols[i] : COMBO_SYMBOL_COUNT, maxGap);
+    return EndPattern();
+}
+
+int InputComboSet::AddChordPattern(const DWORD *symbols, int count, DWORD window)
+{
+    BeginPattern();
+    AddChord(symbols, count, 0, window);
+    return EndPattern();
+}
+
+// Scratch state of Compile
+struct ComboBuilder
+{
+    InputComboSequence *Sequences;
+    int SequenceCount;
+    DWORD Symbols[COMBO_MAX_SEQUENCES][COMBO_MAX_STEPS];
+    BOOL Overflow;
+};
+
+// Emits every order of the chords of a pattern, from step index on
+static void ExpandSteps(ComboBuilder &builder, InputComboSequence &current, DWORD *symbols,
+                        const DWORD *const *stepSymbols, const int *stepCounts, const DWORD *gaps, const DWORD *windows,
+                        int stepCount, int step, int length)
+{
+    if (step == stepCount)
+    {
+        if (builder.SequenceCount >= COMBO_MAX_SEQUENCES)
+        {
+            builder.Overflow = TRUE;
+            return;
+        }
+        current.Length = length;
+        builder.Sequences[builder.SequenceCount] = current;
+        memcpy(builder.Symbols[builder.SequenceCount], symbols, length * sizeof(DWORD));
+        ++builder.SequenceCount;
+        return;
+    }
+
+    int count = stepCounts[step];
+    int order[COMBO_MAX_CHORD];
+    for (int i = 0; i < count; i++)
+        order[i] = i;
+
+    // Permutations in lexicographic order
+    for (;;)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            symbols[length + i] = stepSymbols[step][order[i]];
+            current.Anchor[length + i] = (BYTE)((i == 0) ? (length > 0 ? 1 : 0) : i);
+            DWORD window = (i == 0) ? (length > 0 ? gaps[step] : 0) : windows[step];
+            current.MaxGap[length + i] = (InputTime)window * 1000;
+        }
+        ExpandSteps(builder, current, symbols, stepSymbols, stepCounts, gaps, windows, stepCount, step + 1, length + count);
+        if (builder.Overflow)
+            return;
+
+        int i = count - 2;
+        while (i >= 0 && order[i] >= order[i + 1])
+            --i;
+        if (i < 0)
+            break;
+        int j = count - 1;
+        while (order[j] <= order[i])
+            --j;
+        int t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+        for (int a = i + 1, b = count - 1; a < b; a++, b--)
+        {
+            t = order[a];
+            order[a] = order[b];
+            order[b] = t;
+        }
+    }
+}
+
+InputComboRecognizer *InputComboSet::Compile() const
+{
+    if (m_PatternCount == 0)
+        return NULL;
+
+    ComboBuilder *builder = new ComboBuilder;
+    builder->Sequences = new InputComboSequence[COMBO_MAX_SEQUENCES];
+    builder->SequenceCount = 0;
+    builder->Overflow = FALSE;
+
+    InputComboRecognizer *recognizer = new InputComboRecognizer;
+    recognizer->m_PatternCount = m_PatternCount;
+
+    // Chords are expanded into one sequence per order
+    for (int p = 0; p < m_PatternCount && !builder->Overflow; p++)
+    {
+        const Pattern &pattern = m_Patterns[p];
+        const DWORD *stepSymbols[COMBO_MAX_STEPS];
+        int stepCounts[COMBO_MAX_STEPS];
+        DWORD gaps[COMBO_MAX_STEPS];
+        DWORD windows[COMBO_MAX_STEPS];
+        for (int s = 0; s < pattern.StepCount; s++)
+        {
+            const Step &step = m_Steps[pattern.FirstStep + s];
+            stepSymbols[s] = step.Symbols;
+            stepCounts[s] = step.Count;
+            gaps[s] = step.MaxGap;
+            windows[s] = step.Window;
+        }
+
+        InputComboSequence current;
+        memset(&current, 0, sizeof(current));
+        current.Pattern = p;
+        current.MaxDuration = (InputTime)pattern.MaxDuration * 1000;
+        DWORD symbols[COMBO_MAX_STEPS];
+        ExpandSteps(*builder, current, symbols, stepSymbols, stepCounts, gaps, windows, pattern.StepCount, 0, 0);
+    }
+
+    // Dense classes for the symbols in use, class 0 for all others
+    int classCount = 1;
+    int totalLength = 0;
+    InputTime maxGap = 0;
+    BOOL unlimited = FALSE;
+    for (int i = 0; i < builder->SequenceCount && !builder->Overflow; i++)
+    {
+        const InputComboSequence &sequence = builder->Sequences[i];
+        totalLength += sequence.Length;
+        for (int s = 0; s < sequence.Length; s++)
+        {
+            DWORD symbol = builder->Symbols[i][s];
+            if (recognizer->m_Classes[symbol] == 0)
+            {
+                if (classCount >= COMBO_MAX_CLASSES)
+                {
+                    builder->Overflow = TRUE;
+                    break;
+                }
+                recognizer->m_Classes[symbol] = (BYTE)classCount++;
+            }
+            if (symbol >= COMBO_SYMBOL_JOYSTICK)
+                recognizer->m_JoystickMask |= 1u << ((symbol - COMBO_SYMBOL_JOYSTICK) / JOYSTICK_BUTTON_COUNT);
+            if (s > 0)
+            {
+                if (sequence.MaxGap[s] == 0)
+                    unlimited = TRUE;
+                else if (sequence.MaxGap[s] > maxGap)
+                    maxGap = sequence.MaxGap[s];
+            }
+        }
+    }
+
+    int stateLimit = totalLength + 1;
+    if (builder->Overflow || stateLimit > COMBO_MAX_STATES)
+    {
+        delete[] builder->Sequences;
+        delete builder;
+        delete recognizer;
+        return NULL;
+    }
+
+    // Trie of the sequences; 0 marks a missing child since nothing returns to the root
+    WORD *trie = new WORD[stateLimit * classCount];
+    memset(trie, 0, stateLimit * classCount * sizeof(WORD));
+    int *terminal = new int[stateLimit]; // First sequence ending in each state, -1 if none
+    int *nextTerminal = new int[builder->SequenceCount];
+    for (int s = 0; s < stateLimit; s++)
+        terminal[s] = -1;
+
+    int stateCount = 1;
+    for (int i = builder->SequenceCount - 1; i >= 0; i--)
+    {
+        int state = 0;
+        for (int s = 0; s < builder->Sequences[i].Length; s++)
+        {
+            int c = recognizer->m_Classes[builder->Symbols[i][s]];
+            WORD &child = trie[state * classCount + c];
+            if (child == 0)
+                child = (WORD)stateCount++;
+            state = child;
+        }
+        nextTerminal[i] = terminal[state];
+        terminal[state] = i;
+    }
+
+    // Breadth-first: failure links, the complete transition table, and the
+    // accepted sequences of each state followed by those of its failure state
+    WORD *next = new WORD[stateCount * classCount];
+    int *fail = new int[stateCount];
+    int *queue = new int[stateCount];
+    int *outputCount = new int[stateCount];
+    int head = 0, tail = 0;
+    fail[0] = 0;
+    queue[tail++] = 0;
+    while (head < tail)
+    {
+        int state = queue[head++];
+        int own = 0;
+        for (int i = terminal[state]; i >= 0; i = nextTerminal[i])
+            ++own;
+        outputCount[state] = own + ((state != 0) ? outputCount[fail[state]] : 0);
+
+        for (int c = 0; c < classCount; c++)
+        {
+            int child = trie[state * classCount + c];
+            if (child != 0)
+            {
+                fail[child] = (state == 0) ? 0 : next[fail[state] * classCount + c];
+                next[state * classCount + c] = (WORD)child;
+                queue[tail++] = child;
+            }
+            else
+            {
+                next[state * classCount + c] = (state == 0) ? 0 : next[fail[state] * classCount + c];
+            }
+        }
+    }
+
+    int *outputStart = new int[stateCount + 1];
+    outputStart[0] = 0;
+    for (int s = 0; s < stateCount; s++)
+        outputStart[s + 1] = outputStart[s] + outputCount[s];
+    WORD *outputs = new WORD[outputStart[stateCount] > 0 ? outputStart[stateCount] : 1];
+    for (int q = 0; q < stateCount; q++)
+    {
+        int state = queue[q];
+        int o = outputStart[state];
+        for (int i = terminal[state]; i >= 0; i = nextTerminal[i])
+            outputs[o++] = (WORD)i;
+        if (state != 0)
+        {
+            int f = fail[state];
+            for (int i = outputStart[f]; i < outputStart[f + 1]; i++)
+                outputs[o++] = outputs[i];
+        }
+    }
+
+    recognizer->m_StateCount = stateCount;
+    recognizer->m_ClassCount = classCount;
+    recognizer->m_Next = next;
+    recognizer->m_OutputStart = outputStart;
+    recognizer->m_Outputs = outputs;
+    recognizer->m_Sequences = new InputComboSequence[builder->SequenceCount];
+    memcpy(recognizer->m_Sequences, builder->Sequences, builder->SequenceCount * sizeof(InputComboSequence));
+    recognizer->m_MaxGap = unlimited ? 0 : maxGap;
+
+    delete[] trie;
+    delete[] terminal;
+    delete[] nextTerminal;
+    delete[] fail;
+    delete[] queue;
+    delete[] outputCount;
+    delete[] builder->Sequences;
+    delete builder;
+    return recognizer;
+}
@@ -0,0 +1,155 @@
+#ifndef COMBORECOGNIZER_H
+#define COMBORECOGNIZER_H
+
+#include "InputDevices.h"
+
+#define COMBO_MAX_PATTERNS 128
+#define COMBO_MAX_STEPS 16       // Presses per pattern, chords counted in full; power of two
+#define COMBO_MAX_CHORD 4        // Presses per chord; chords are expanded into every order
+#define COMBO_MAX_SEQUENCES 1024 // Patterns after chord expansion
+#define COMBO_MAX_STATES 4096
+#define COMBO_MAX_CLASSES 256    // Distinct symbols used by the patterns, plus one for the others
+#define COMBO_MAX_MATCHES 32     // Matches kept per frame
+
+// Press symbols: scancodes, then mouse buttons, then JOYSTICK_BUTTON_COUNT buttons per joystick
+#define COMBO_SYMBOL_MOUSE 256
+#define COMBO_SYMBOL_JOYSTICK 260
+#define COMBO_SYMBOL_COUNT (COMBO_SYMBOL_JOYSTICK + 32 * JOYSTICK_BUTTON_COUNT)
+
+inline DWORD InputComboKey(DWORD key) { return key & 0xFF; }
+inline DWORD InputComboMouseButton(DWORD button) { return COMBO_SYMBOL_MOUSE + (button & 3); }
+inline DWORD InputComboJoystickButton(DWORD joystick, DWORD button) { return COMBO_SYMBOL_JOYSTICK + (joystick & 31) * JOYSTICK_BUTTON_COUNT + (button & (JOYSTICK_BUTTON_COUNT - 1)); }
+
+struct InputComboMatch
+{
+    int Pattern;     // Handle given by InputComboSet::EndPattern
+    InputTime Start; // Time of the first press
+    InputTime End;   // Time of the press that completed the pattern
+};
+
+// A pattern after chord expansion: press i must follow press i - Anchor[i]
+// within MaxGap[i] microseconds (no limit when 0)
+struct InputComboSequence
+{
+    int Pattern;
+    int Length;
+    InputTime MaxDuration; // 0 when unlimited
+    BYTE Anchor[COMBO_MAX_STEPS];
+    InputTime MaxGap[COMBO_MAX_STEPS];
+};
+
+// Compiled patterns: one deterministic automaton (Aho-Corasick) over the press
+// symbols, so each press costs a table lookup whatever the number of patterns.
+// The timing windows are only checked for the patterns the automaton accepts.
+// Presses must be consecutive: any other press in between breaks a pattern.
+// A match consumes the presses it is made of.
+class InputComboRecognizer
+{
+    friend class InputComboSet;
+
+public:
+    ~InputComboRecognizer();
+
+    // Feeds the presses of the frame in time order: keyboard hardware events,
+    // buffered mouse buttons and the joystick button edges. Joysticks with buttons
+    // in a pattern are polled here. Clears the matches of the previous frame and
+    // returns the number of presses fed.
+    int Process(const InputKeyboard &keyboard, const InputMouse &mouse, InputJoystick *joysticks, int joystickCount);
+    // Feeds a single press; matches accumulate until the next Process or ClearMatches
+    void Feed(DWORD symbol, InputTime time);
+    void ClearMatches();
+    void Reset(); // Forgets the presses fed so far
+
+    int GetPatternCount() const { return m_PatternCount; }
+    int GetStateCount() const { return m_StateCount; }
+    int GetMatchCount() const { return m_MatchCount; }
+    const InputComboMatch *GetMatch(int i) const { return (i >= 0 && i < m_MatchCount) ? &m_Matches[i] : NULL; }
+    BOOL IsMatched(int pattern) const { return (pattern >= 0 && pattern < m_PatternCount) ? m_Matched[pattern] : FALSE; }
+
+private:
+    struct Press
+    {
+        DWORD Symbol;
+        InputTime Time;
+    };
+
+    InputComboRecognizer();
+    InputComboRecognizer(const InputComboRecognizer &);
+    InputComboRecognizer &operator=(const InputComboRecognizer &);
+
+    BOOL Accepts(const InputComboSequence &sequence) const;
+
+    int m_PatternCount;
+    int m_StateCount;
+    int m_ClassCount;
+    BYTE m_Classes[COMBO_SYMBOL_COUNT]; // Symbol to class, 0 for symbols in no pattern
+    WORD *m_Next;                       // m_StateCount x m_ClassCount transitions
+    int *m_OutputStart;                 // Per state, into m_Outputs; m_StateCount + 1 entries
+    WORD *m_Outputs;                    // Sequences accepted in each state, its suffixes included
+    InputComboSequence *m_Sequences;
+    DWORD m_JoystickMask; // Joysticks with buttons in a pattern
+    InputTime m_MaxGap;   // Longest window of any step, 0 when one is unlimited
+
+    // Run time
+    int m_State;
+    DWORD m_Fed; // Presses fed since the last reset, saturated at COMBO_MAX_STEPS
+    InputTime m_History[COMBO_MAX_STEPS]; // Times of the latest presses, ring indexed by m_Position
+    int m_Position;
+    Press m_Presses[MOUSE_BUFFER_SIZE + 32 * JOYSTICK_BUTTON_COUNT]; // Mouse and joystick presses of the frame, sorted by time
+    InputComboMatch m_Matches[COMBO_MAX_MATCHES];
+    int m_MatchCount;
+    BOOL m_Matched[COMBO_MAX_PATTERNS];
+};
+
+// Patterns being registered, compiled into an InputComboRecognizer.
+// Windows are in milliseconds; 0 means unlimited.
+class InputComboSet
+{
+public:
+    InputComboSet();
+    void Clear();
+
+    // maxDuration bounds the time from the first to the last press
+    void BeginPattern(DWORD maxDuration = 0);
+    // One press, within maxGap of the previous step
+    BOOL AddPress(DWORD symbol, DWORD maxGap);
+    // Presses in any order, the first within maxGap of the previous step and all within window of the first
+    BOOL AddChord(const DWORD *symbols, int count, DWORD maxGap, DWORD window);
+    // Returns the pattern handle, -1 if the pattern was empty or did not fit
+    int EndPattern();
+
+    // Shortcuts for a single sequence or a single chord
+    int AddSequence(const DWORD *symbols, int count, DWORD maxGap, DWORD maxDuration = 0);
+    int AddChordPattern(const DWORD *symbols, int count, DWORD window);
+
+    int GetPatternCount() const { return m_PatternCount; }
+
+    // Returns a new recognizer owned by the caller, NULL if there is no pattern or the automaton is too large
+    InputComboRecognizer *Compile() const;
+
+private:
+    struct Step
+    {
+        DWORD Symbols[COMBO_MAX_CHORD];
+        int Count;
+        DWORD MaxGap;
+        DWORD Window;
+    };
+
+    struct Pattern
+    {
+        DWORD MaxDuration;
+        int FirstStep;
+        int StepCount;
+        int Presses;
+    };
+
+    int m_PatternCount;
+    int m_StepCount;
+    BOOL m_Open;
+    BOOL m_Failed; // A step of the open pattern did not fit
+    Pattern m_Patterns[COMBO_MAX_PATTERNS];
+    Step m_Steps[COMBO_MAX_SEQUENCES];
+};
+
+#endif // COMBORECOGNIZER_H
@@ -0,0 +1,347 @@
+#include "DI8Backend.h"
+
+#include "InputThread.h"
+
+DI8InputDevice::DI8InputDevice(LPDIRECTINPUTDEVICE8 device) : m_Device(device), m_Ranges(NULL) {}
+
+DI8InputDevice::~DI8InputDevice()
+{
+    if (m_Device)
+    {
+        m_Device->Release();
+        m_Device = NULL;
+    }
+}
+
+HRESULT DI8InputDevice::Acquire()
+{
+    return m_Device->Acquire();
+}
+
+HRESULT DI8InputDevice::Unacquire()
+{
+    return m_Device->Unacquire();
+}
+
+HRESULT DI8InputDevice::Poll()
+{
+    return m_Device->Poll();
+}
+
+HRESULT DI8InputDevice::SetCooperativeLevel(HWND hWnd, DWORD flags)
+{
+    return m_Device->SetCooperativeLevel(hWnd, flags);
+}
+
+HRESULT DI8InputDevice::GetDeviceData(DIDEVICEOBJECTDATA *data, DWORD *count, DWORD flags)
+{
+    return m_Device->GetDeviceData(sizeof(DIDEVICEOBJECTDATA), data, count, flags);
+}
+
+HRESULT DI8InputDevice::GetDeviceState(DWORD size, void *state)
+{
+    return m_Device->GetDeviceState(size, state);
+}
+
+HRESULT DI8InputDevice::SetEventNotification(InputSignal *signal)
+{
+    return m_Device->SetEventNotification(signal ? (HANDLE)signal->GetNativeHandle() : NULL);
+}
+
+HRESULT DI8InputDevice::GetCapabilities(InputDeviceCaps *caps)
+{
+    if (!caps)
+        return DIERR_INVALIDPARAM;
+
+    DIDEVCAPS devcaps;
+    memset(&devcaps, 0, sizeof(DIDEVCAPS));
+    devcaps.dwSize = sizeof(DIDEVCAPS);
+    HRESULT hr = m_Device->GetCapabilities(&devcaps);
+    if (FAILED(hr))
+        return hr;
+
+    caps->Axes = devcaps.dwAxes;
+    caps->Buttons = devcaps.dwButtons;
+    caps->POVs = devcaps.dwPOVs;
+    return hr;
+}
+
+// EnumAxesCallback: Enumerate device axes and query their properties
+BOOL CALLBACK DI8InputDevice::EnumAxesCallback(LPCDIDEVICEOBJECTINSTANCE lpddoi, LPVOID pvRef)
+{
+    DI8InputDevice *device = (DI8InputDevice *)pvRef;
+
+    if (!device || !device->m_Device || !device->m_Ranges)
+        return DIENUM_STOP;
+
+    // Set up the property range structure
+    DIPROPRANGE range;
+    memset(&range, 0, sizeof(DIPROPRANGE));
+    range.diph.dwSize = sizeof(DIPROPRANGE);
+    range.diph.dwHeaderSize = sizeof(DIPROPHEADER);
+    range.diph.dwHow = DIPH_BYID;
+    range.diph.dwObj = lpddoi->dwType & ~DIDFT_COLLECTION;
+
+    HRESULT hr = device->m_Device->GetProperty(DIPROP_RANGE, &range.diph);
+    if (FAILED(hr) || range.lMax == range.lMin)
+    {
+        // Fall back to a symmetric range to keep normalization stable
+        range.lMin = -1000;
+        range.lMax = 1000;
+        if (FAILED(device->m_Device->SetProperty(DIPROP_RANGE, &range.diph)))
+            return DIENUM_CONTINUE;
+    }
+
+    // Determine which axis this is and store its range
+    GUID guidType = lpddoi->guidType;
+    int axis = -1;
+
+    if (guidType == GUID_XAxis)
+        axis = INPUT_AXIS_X;
+    else if (guidType == GUID_YAxis)
+        axis = INPUT_AXIS_Y;
+    else if (guidType == GUID_ZAxis)
+        axis = INPUT_AXIS_Z;
+    else if (guidType == GUID_RxAxis)
+        axis = INPUT_AXIS_RX;
+    else if (guidType == GUID_RyAxis)
+        axis = INPUT_AXIS_RY;
+    else if (guidType == GUID_RzAxis)
+        axis = INPUT_AXIS_RZ;
+    else if (guidType == GUID_Slider)
+    {
+        // Sliders are numbered sequentially
+        if (!device->m_Ranges[INPUT_AXIS_SLIDER0].Present)
+            axis = INPUT_AXIS_SLIDER0;
+        else if (!device->m_Ranges[INPUT_AXIS_SLIDER1].Present)
+            axis = INPUT_AXIS_SLIDER1;
+    }
+
+    if (axis >= 0)
+    {
+        device->m_Ranges[axis].Present = TRUE;
+        device->m_Ranges[axis].Min = range.lMin;
+        device->m_Ranges[axis].Max = range.lMax;
+    }
+
+    return DIENUM_CONTINUE;
+}
+
+HRESULT DI8InputDevice::GetAxisRanges(InputAxisRange ranges[INPUT_AXIS_COUNT])
+{
+    for (int i = 0; i < INPUT_AXIS_COUNT; i++)
+    {
+        ranges[i].Present = FALSE;
+        ranges[i].Min = -1000;
+        ranges[i].Max = 1000;
+    }
+
+    m_Ranges = ranges;
+    HRESULT hr = m_Device->EnumObjects(EnumAxesCallback, (LPVOID)this, DIDFT_AXIS);
+    m_Ranges = NULL;
+    return hr;
+}
+
+void *DI8InputDevice::GetNativeInterface()
+{
+    return m_Device;
+}
+
+void DI8InputDevice::Release()
+{
+    delete this;
+}
+
+DI8InputBackend::DI8InputBackend() : m_DirectInput(NULL)
+{
+    ::QueryPerformanceFrequency(&m_Frequency);
+}
+
+DI8InputBackend::~DI8InputBackend()
+{
+    Shutdown();
+}
+
+HRESULT DI8InputBackend::Initialize(HWND hWnd)
+{
+    if (m_DirectInput)
+        return DI_OK;
+
+    // Register with the DirectInput subsystem and get a pointer
+    // to a IDirectInput interface we can use.
+    // Create a DInput object
+    HRESULT hr = DirectInput8Create(::GetModuleHandle(TEXT("CK2.dll")), DIRECTINPUT_VERSION, IID_IDirectInput8, (void **)&m_DirectInput, NULL);
+    if (FAILED(hr))
+        m_DirectInput = NULL;
+    else if (!m_DirectInput)
+        hr = DIERR_GENERIC;
+    return hr;
+}
+
+void DI8InputBackend::Shutdown()
+{
+    if (m_DirectInput)
+    {
+        m_DirectInput->Release();
+        m_DirectInput = NULL;
+    }
+}
+
+HRESULT DI8InputBackend::CreateKeyboard(DWORD bufferSize, InputDevice **device)
+{
+    if (!device)
+        return DIERR_INVALIDPARAM;
+    *device = NULL;
+    if (!m_DirectInput)
+        return DIERR_NOTINITIALIZED;
+
+    // Obtain an interface to the system keyboard device.
+    LPDIRECTINPUTDEVICE8 keyboard = NULL;
+    HRESULT hr = m_DirectInput->CreateDevice(GUID_SysKeyboard, &keyboard, NULL);
+    if (FAILED(hr) || !keyboard)
+        return FAILED(hr) ? hr : DIERR_GENERIC;
+
+    // Set the data format to "keyboard format".
+    // This tells DirectInput that we will be passing an array
+    // of 256 bytes to IDirectInputDevice::GetDeviceState.
+    keyboard->SetDataFormat(&c_dfDIKeyboard);
+
+    // Set the buffer size to let DirectInput uses buffered I/O.
+    DIPROPDWORD dipdw;
+    dipdw.diph.dwSize = sizeof(DIPROPDWORD);
+    dipdw.diph.dwHeaderSize = sizeof(DIPROPHEADER);
+    dipdw.diph.dwObj = 0;
+    dipdw.diph.dwHow = DIPH_DEVICE;
+    dipdw.dwData = bufferSize;
+    keyboard->SetProperty(DIPROP_BUFFERSIZE, &dipdw.diph);
+
+    *device = new DI8InputDevice(keyboard);
+    return hr;
+}
+
+HRESULT DI8InputBackend::CreateMouse(DWORD bufferSize, InputDevice **device)
+{
+    if (!device)
+        return DIERR_INVALIDPARAM;
+    *device = NULL;
+    if (!m_DirectInput)
+        return DIERR_NOTINITIALIZED;
+
+    // Obtain an interface to the system mouse device.
+    LPDIRECTINPUTDEVICE8 mouse = NULL;
+    HRESULT hr = m_DirectInput->CreateDevice(GUID_SysMouse, &mouse, NULL);
+    if (FAILED(hr) || !mouse)
+        return FAILED(hr) ? hr : DIERR_GENERIC;
+
+    if (FAILED(mouse->SetDataFormat(&c_dfDIMouse)))
+        ::OutputDebugString(TEXT("Input Manager =  Failed : SetDataFormat (Mouse)"));
+
+    DIPROPDWORD dipdw;
+    dipdw.diph.dwSize = sizeof(DIPROPDWORD);
+    dipdw.diph.dwHeaderSize = sizeof(DIPROPHEADER);
+    dipdw.diph.dwObj = 0;
+    dipdw.diph.dwHow = DIPH_DEVICE;
+    dipdw.dwData = DIPROPAXISMODE_REL;
+    if (FAILED(mouse->SetProperty(DIPROP_AXISMODE, &dipdw.diph)))
+        ::OutputDebugString(TEXT("Input Manager =  Failed : SetProperty (Mouse) Relative Coord"));
+
+    dipdw.diph.dwSize = sizeof(DIPROPDWORD);
+    dipdw.diph.dwHeaderSize = sizeof(DIPROPHEADER);
+    dipdw.diph.dwObj = 0;
+    dipdw.diph.dwHow = DIPH_DEVICE;
+    dipdw.dwData = bufferSize;
+    if (FAILED(mouse->SetProperty(DIPROP_BUFFERSIZE, &dipdw.diph)))
+        ::OutputDebugString(TEXT("Input Manager =  Failed : SetProperty (Mouse) Buffered Data"));
+
+    *device = new DI8InputDevice(mouse);
+    return hr;
+}
+
+BOOL CALLBACK DI8InputBackend::JoystickEnum(const DIDEVICEINSTANCE *pdidInstance, void *pContext)
+{
+    EnumContext *ctx = (EnumContext *)pContext;
+
+    InputDeviceInfo info;
+    memset(&info, 0, sizeof(InputDeviceInfo));
+    info.InstanceGUID = pdidInstance->guidInstance;
+
+    // Store the device product name (convert from TCHAR to char if needed)
+#ifdef UNICODE
+    WideCharToMultiByte(CP_UTF8, 0, pdidInstance->tszProductName, -1,
+                        info.ProductName, MAX_PATH, NULL, NULL);
+#else
+    strncpy(info.ProductName, pdidInstance->tszProductName, MAX_PATH - 1);
+    info.ProductName[MAX_PATH - 1] = '\0';
+#endif
+
+    return ctx->Callback(&info, ctx->Context);
+}
+
+HRESULT DI8InputBackend::EnumJoysticks(InputDeviceEnumCallback callback, void *context)
+{
+    if (!callback)
+        return DIERR_INVALIDPARAM;
+    if (!m_DirectInput)
+        return DIERR_NOTINITIALIZED;
+
+    // Enumerate DirectInput devices (joysticks, gamepads, wheels, flight sticks, etc.)
+    EnumContext ctx;
+    ctx.Callback = callback;
+    ctx.Context = context;
+    return m_DirectInput->EnumDevices(DI8DEVCLASS_GAMECTRL, JoystickEnum, &ctx, DIEDFL_ATTACHEDONLY);
+}
+
+HRESULT DI8InputBackend::CreateJoystick(const GUID &instance, InputDevice **device)
+{
+    if (!device)
+        return DIERR_INVALIDPARAM;
+    *device = NULL;
+    if (!m_DirectInput)
+        return DIERR_NOTINITIALIZED;
+
+    LPDIRECTINPUTDEVICE8 joystick = NULL;
+    HRESULT hr = m_DirectInput->CreateDevice(instance, &joystick, NULL);
+    if (FAILED(hr) || !joystick)
+        return FAILED(hr) ? hr : DIERR_GENERIC;
+
+    joystick->SetDataFormat(&c_dfDIJoystick2);
+
+    *device = new DI8InputDevice(joystick);
+    return hr;
+}
+
+DWORD DI8InputBackend::GetTickCount()
+{
+    return ::GetTickCount();
+}
+
+InputTime DI8InputBackend::GetTime()
+{
+    LARGE_INTEGER counter;
+    ::QueryPerformanceCounter(&counter);
+
+    // Split the division so the multiplication cannot overflow
+    InputTime frequency = (InputTime)m_Frequency.QuadPart;
+    InputTime ticks = (InputTime)counter.QuadPart;
+    return (ticks / frequency) * 1000000 + (ticks % frequency) * 1000000 / frequency;
+}
+
+BOOL DI8InputBackend::GetCursorPos(LONG *x, LONG *y)
+{
+    POINT pt;
+    if (!::GetCursorPos(&pt))
+        return FALSE;
+    if (x) *x = pt.x;
+    if (y) *y = pt.y;
+    return TRUE;
+}
+
+BOOL DI8InputBackend::SetCursorPos(LONG x, LONG y)
+{
+    return ::SetCursorPos((int)x, (int)y);
+}
+
+void DI8InputBackend::Release()
+{
+    delete this;
+}
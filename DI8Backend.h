@@ -0,0 +1,62 @@
+#ifndef DI8BACKEND_H
+#define DI8BACKEND_H
+
+#include "InputBackend.h"
+
+class DI8InputDevice : public InputDevice
+{
+public:
+    explicit DI8InputDevice(LPDIRECTINPUTDEVICE8 device);
+    virtual ~DI8InputDevice();
+
+    virtual HRESULT Acquire();
+    virtual HRESULT Unacquire();
+    virtual HRESULT Poll();
+    virtual HRESULT SetCooperativeLevel(HWND hWnd, DWORD flags);
+    virtual HRESULT GetDeviceData(DIDEVICEOBJECTDATA *data, DWORD *count, DWORD flags);
+    virtual HRESULT GetDeviceState(DWORD size, void *state);
+    virtual HRESULT SetEventNotification(InputSignal *signal);
+    virtual HRESULT GetCapabilities(InputDeviceCaps *caps);
+    virtual HRESULT GetAxisRanges(InputAxisRange ranges[INPUT_AXIS_COUNT]);
+    virtual void *GetNativeInterface();
+    virtual void Release();
+
+private:
+    static BOOL CALLBACK EnumAxesCallback(LPCDIDEVICEOBJECTINSTANCE lpddoi, LPVOID pvRef);
+
+    LPDIRECTINPUTDEVICE8 m_Device;
+    InputAxisRange *m_Ranges; // Target of the axis enumeration in progress
+};
+
+class DI8InputBackend : public InputBackend
+{
+public:
+    DI8InputBackend();
+    virtual ~DI8InputBackend();
+
+    virtual HRESULT Initialize(HWND hWnd);
+    virtual void Shutdown();
+    virtual HRESULT CreateKeyboard(DWORD bufferSize, InputDevice **device);
+    virtual HRESULT CreateMouse(DWORD bufferSize, InputDevice **device);
+    virtual HRESULT EnumJoysticks(InputDeviceEnumCallback callback, void *context);
+    virtual HRESULT CreateJoystick(const GUID &instance, InputDevice **device);
+    virtual DWORD GetTickCount();
+    virtual InputTime GetTime();
+    virtual BOOL GetCursorPos(LONG *x, LONG *y);
+    virtual BOOL SetCursorPos(LONG x, LONG y);
+    virtual void Release();
+
+private:
+    struct EnumContext
+    {
+        InputDeviceEnumCallback Callback;
+        void *Context;
+    };
+
+    static BOOL CALLBACK JoystickEnum(const DIDEVICEINSTANCE *pdidInstance, void *pContext);
+
+    LPDIRECTINPUT8 m_DirectInput;
+    LARGE_INTEGER m_Frequency; // QueryPerformanceCounter ticks per second
+};
+
+#endif // DI8BACKEND_H
@@ -1,96 +1,324 @@
 #include "DX8InputManager.h"
 
+#include <stdio.h>
+
 #include "CKAll.h"
 
+#include "DI8Backend.h"
+
 void DX8InputManager::EnableKeyboardRepetition(CKBOOL iEnable)
 {
-    m_EnableKeyboardRepetition = iEnable;
+    m_Keyboard.EnableRepetition(iEnable);
 }
 
 CKBOOL DX8InputManager::IsKeyboardRepetitionEnabled()
 {
-    return m_EnableKeyboardRepetition;
+    return m_Keyboard.IsRepetitionEnabled();
 }
 
 CKBOOL DX8InputManager::IsKeyDown(CKDWORD iKey, CKDWORD *oStamp)
 {
+    NoteRead(CK_LATENCY_KEYBOARD);
     if (iKey >= KEYBOARD_BUFFER_SIZE)
         return FALSE;
-    if ((m_KeyboardState[iKey] & KS_PRESSED) == 0)
+    if ((m_Keyboard.m_State[iKey] & KS_PRESSED) == 0)
         return FALSE;
     if (oStamp)
-        *oStamp = m_KeyboardStamps[iKey];
+        *oStamp = m_Keyboard.m_Stamps[iKey];
     return TRUE;
 }
 
 CKBOOL DX8InputManager::IsKeyUp(CKDWORD iKey)
 {
-    return iKey < KEYBOARD_BUFFER_SIZE && m_KeyboardState[iKey] == KS_IDLE;
+    NoteRead(CK_LATENCY_KEYBOARD);
+    return iKey < KEYBOARD_BUFFER_SIZE && m_Keyboard.m_State[iKey] == KS_IDLE;
 }
 
 CKBOOL DX8InputManager::IsKeyToggled(CKDWORD iKey, CKDWORD *oStamp)
 {
+    NoteRead(CK_LATENCY_KEYBOARD);
     if (iKey >= KEYBOARD_BUFFER_SIZE)
         return FALSE;
-    if ((m_KeyboardState[iKey] & KS_RELEASED) == 0)
+    if ((m_Keyboard.m_State[iKey] & KS_RELEASED) == 0)
         return FALSE;
     if (oStamp)
-        *oStamp = m_KeyboardStamps[iKey];
+        *oStamp = m_Keyboard.m_Stamps[iKey];
     return TRUE;
 }
 
+static int ScanCodeToName(DWORD key, char *name)
+{
+    return VxScanCodeToName(key, name);
+}
+
 int DX8InputManager::GetKeyName(CKDWORD iKey, char *oKeyName)
 {
-    return VxScanCodeToName(iKey, oKeyName);
+    UpdateKeyNames();
+    return m_KeyNames.GetName(iKey, oKeyName);
 }
 
 CKDWORD DX8InputManager::GetKeyFromName(CKSTRING iKeyName)
 {
-    char keyName[32];
-    CKDWORD iKey;
-    for (iKey = 0; iKey < KEYBOARD_BUFFER_SIZE; iKey++)
-        if (GetKeyName(iKey, keyName) != 0 && stricmp(keyName, iKeyName) == 0)
-            break;
-    return iKey;
+    UpdateKeyNames();
+    return m_KeyNames.GetKey(iKeyName);
+}
+
+void DX8InputManager::UpdateKeyNames()
+{
+    HKL layout = ::GetKeyboardLayout(0);
+    if (!m_KeyNames.IsBuilt() || layout != m_KeyboardLayout)
+    {
+        m_KeyboardLayout = layout;
+        m_KeyNames.Build(ScanCodeToName);
+    }
 }
 
 unsigned char *DX8InputManager::GetKeyboardState()
 {
-    return m_KeyboardState;
+    NoteRead(CK_LATENCY_KEYBOARD);
+    return m_Keyboard.GetWritableState();
+}
+
+const CKDWORD *DX8InputManager::GetKeyboardDownMask()
+{
+    NoteRead(CK_LATENCY_KEYBOARD);
+    return (const CKDWORD *)m_Keyboard.GetDownMask();
+}
+
+const CKDWORD *DX8InputManager::GetKeyboardPressedMask()
+{
+    NoteRead(CK_LATENCY_KEYBOARD);
+    return (const CKDWORD *)m_Keyboard.GetPressedMask();
+}
+
+const CKDWORD *DX8InputManager::GetKeyboardReleasedMask()
+{
+    NoteRead(CK_LATENCY_KEYBOARD);
+    return (const CKDWORD *)m_Keyboard.GetReleasedMask();
 }
 
 CKBOOL DX8InputManager::IsKeyboardAttached()
 {
-    return m_Keyboard != NULL;
+    return m_Keyboard.IsAttached();
 }
 
 int DX8InputManager::GetNumberOfKeyInBuffer()
 {
-    return m_NumberOfKeyInBuffer;
+    NoteRead(CK_LATENCY_KEYBOARD);
+    return m_Keyboard.GetEventCount();
 }
 
 int DX8InputManager::GetKeyFromBuffer(int i, CKDWORD &oKey, CKDWORD *oTimeStamp)
 {
-    if (i >= m_NumberOfKeyInBuffer)
+    NoteRead(CK_LATENCY_KEYBOARD);
+    const InputEvent *event = m_Keyboard.GetEvent(i);
+    if (!event)
         return 0;
-    oKey = m_KeyInBuffer[i].dwOfs;
+    oKey = event->Data.dwOfs;
     if (oTimeStamp)
-        *oTimeStamp = m_KeyInBuffer[i].dwTimeStamp;
-    return (m_KeyInBuffer[i].dwData & 0x80) ? KS_PRESSED : KS_RELEASED;
+        *oTimeStamp = event->Data.dwTimeStamp;
+    return (event->Data.dwData & 0x80) ? KS_PRESSED : KS_RELEASED;
+}
+
+int DX8InputManager::GetKeyRepeatCount(int i)
+{
+    // Hardware events come first in the buffer and never repeat
+    if (i < (int)m_Keyboard.GetHardwareEvents().GetCount())
+        return 0;
+    const InputEvent *event = m_Keyboard.GetEvent(i);
+    return event ? (int)event->Data.uAppData : 0;
+}
+
+InputTime DX8InputManager::GetInputTime()
+{
+    return m_Backend->GetTime();
+}
+
+InputTime DX8InputManager::GetKeyPressTime(CKDWORD iKey)
+{
+    return m_Keyboard.GetPressTime(iKey);
+}
+
+InputTime DX8InputManager::GetKeyReleaseTime(CKDWORD iKey)
+{
+    return m_Keyboard.GetReleaseTime(iKey);
+}
+
+InputTime DX8InputManager::GetKeyTimeFromBuffer(int i)
+{
+    const InputEvent *event = m_Keyboard.GetEvent(i);
+    return event ? event->Time : 0;
+}
+
+InputTime DX8InputManager::GetMouseTime()
+{
+    return m_Mouse.GetTime();
+}
+
+InputTime DX8InputManager::GetMouseButtonTime(CK_MOUSEBUTTON iButton)
+{
+    return m_Mouse.GetButtonTime(iButton);
+}
+
+InputTime DX8InputManager::GetJoystickTime(int iJoystick)
+{
+    if (iJoystick < 0 || iJoystick >= m_JoystickCount)
+        return 0;
+    m_Joysticks[iJoystick].Poll();
+    return m_Joysticks[iJoystick].GetTime();
+}
+
+void DX8InputManager::EnableLatencyStats(CKBOOL iEnable)
+{
+    if (iEnable && !m_Latency)
+    {
+        m_Latency = new LatencyHistogram[CK_LATENCY_SOURCE_COUNT * CK_LATENCY_STAGE_COUNT];
+        m_Keyboard.SetIngestLatency(&m_Latency[CK_LATENCY_KEYBOARD * CK_LATENCY_STAGE_COUNT + CK_LATENCY_INGEST]);
+        m_Mouse.SetIngestLatency(&m_Latency[CK_LATENCY_MOUSE * CK_LATENCY_STAGE_COUNT + CK_LATENCY_INGEST]);
+    }
+    else if (!iEnable && m_Latency)
+    {
+        m_Keyboard.SetIngestLatency(NULL);
+        m_Mouse.SetIngestLatency(NULL);
+        delete[] m_Latency;
+        m_Latency = NULL;
+        m_LatencyPending = 0;
+    }
+}
+
+CKBOOL DX8InputManager::IsLatencyStatsEnabled()
+{
+    return m_Latency != NULL;
+}
+
+void DX8InputManager::ResetLatencyStats()
+{
+    if (!m_Latency)
+        return;
+    for (int i = 0; i < CK_LATENCY_SOURCE_COUNT * CK_LATENCY_STAGE_COUNT; i++)
+        m_Latency[i].Clear();
+}
+
+const LatencyHistogram *DX8InputManager::GetLatencyHistogram(CK_INPUT_LATENCY_SOURCE source, CK_INPUT_LATENCY_STAGE stage)
+{
+    if (!m_Latency || source < 0 || source >= CK_LATENCY_SOURCE_COUNT || stage < 0 || stage >= CK_LATENCY_STAGE_COUNT)
+        return NULL;
+    return &m_Latency[source * CK_LATENCY_STAGE_COUNT + stage];
+}
+
+CKDWORD DX8InputManager::GetLatencyPercentile(CK_INPUT_LATENCY_SOURCE source, CK_INPUT_LATENCY_STAGE stage, float fraction)
+{
+    const LatencyHistogram *histogram = GetLatencyHistogram(source, stage);
+    return histogram ? histogram->GetPercentile(fraction) : 0;
+}
+
+void DX8InputManager::RecordReadLatency(int source)
+{
+    m_LatencyPending &= ~(1u << source);
+    if (!m_Latency)
+        return;
+
+    InputTime now = m_Backend->GetTime();
+    if (source == CK_LATENCY_KEYBOARD)
+    {
+        LatencyHistogram &histogram = m_Latency[CK_LATENCY_KEYBOARD * CK_LATENCY_STAGE_COUNT + CK_LATENCY_CONSUME];
+        const InputEventRing &events = m_Keyboard.GetHardwareEvents();
+        for (DWORD i = 0; i < events.GetCount(); i++)
+            histogram.Add(events.Get(i).Time, now);
+    }
+    else if (source == CK_LATENCY_MOUSE)
+    {
+        if (m_Mouse.IsAttached())
+            m_Latency[CK_LATENCY_MOUSE * CK_LATENCY_STAGE_COUNT + CK_LATENCY_CONSUME].Add(m_Mouse.GetTime(), now);
+    }
+    else if (source - CK_LATENCY_JOYSTICK < m_JoystickCount)
+    {
+        const CKJoystick &joystick = m_Joysticks[source - CK_LATENCY_JOYSTICK];
+        if (joystick.IsAttached())
+            m_Latency[CK_LATENCY_JOYSTICK * CK_LATENCY_STAGE_COUNT + CK_LATENCY_CONSUME].Add(joystick.GetTime(), now);
+    }
+}
+
+void DX8InputManager::EnableFrameStats(CKBOOL iEnable)
+{
+    if (iEnable && !m_FrameStats)
+        m_FrameStats = new InputFrameStats;
+    else if (!iEnable && m_FrameStats)
+    {
+        delete m_FrameStats;
+        m_FrameStats = NULL;
+    }
+
+    m_Keyboard.SetFrameStats(m_FrameStats);
+    m_Mouse.SetFrameStats(m_FrameStats);
+    for (int i = 0; i < m_JoystickCount; i++)
+        m_Joysticks[i].SetFrameStats(m_FrameStats);
+}
+
+CKBOOL DX8InputManager::IsFrameStatsEnabled()
+{
+    return m_FrameStats != NULL;
+}
+
+void DX8InputManager::ResetFrameStats()
+{
+    if (m_FrameStats)
+        m_FrameStats->Clear();
+}
+
+const InputFrameStats *DX8InputManager::GetFrameStats()
+{
+    return m_FrameStats;
+}
+
+CKBOOL DX8InputManager::GetFrameStageCost(INPUT_STAGE stage, int age, InputStageCost *oCost)
+{
+    if (!m_FrameStats || !oCost || stage < 0 || stage >= INPUT_STAGE_COUNT)
+        return FALSE;
+    const InputFrameCost *frame = m_FrameStats->GetFrame(age);
+    if (!frame)
+        return FALSE;
+    *oCost = frame->Stages[stage];
+    return TRUE;
+}
+
+void DX8InputManager::SetFrameStatsDumpInterval(int frames)
+{
+    m_FrameStatsDumpInterval = (frames > 0) ? frames : 0;
+}
+
+void DX8InputManager::DumpFrameStats()
+{
+    char buffer[1024];
+    if (m_FrameStats->Format(buffer, sizeof(buffer), m_FrameStatsDumpInterval) > 0)
+        ::OutputDebugStringA(buffer);
+}
+
+CKDWORD DX8InputManager::GetKeyboardOverflowCount()
+{
+    return m_Keyboard.GetOverflowCount();
+}
+
+CKDWORD DX8InputManager::GetKeyboardDroppedEventCount()
+{
+    return m_Keyboard.GetDroppedCount();
 }
 
 CKBOOL DX8InputManager::IsMouseButtonDown(CK_MOUSEBUTTON iButton)
 {
+    NoteRead(CK_LATENCY_MOUSE);
     return m_Mouse.m_State.rgbButtons[iButton] & KS_PRESSED;
 }
 
 CKBOOL DX8InputManager::IsMouseClicked(CK_MOUSEBUTTON iButton)
 {
+    NoteRead(CK_LATENCY_MOUSE);
     return (m_Mouse.m_State.rgbButtons[iButton] & KS_PRESSED) != 0 && (m_Mouse.m_LastButtons[iButton] & KS_PRESSED) == 0;
 }
 
 CKBOOL DX8InputManager::IsMouseToggled(CK_MOUSEBUTTON iButton)
 {
+    NoteRead(CK_LATENCY_MOUSE);
     // Check if button was released (bit 1 set)
     // (state >> 1) & KS_PRESSED is equivalent to (state & KS_RELEASED)
     return (m_Mouse.m_State.rgbButtons[iButton] >> 1) & KS_PRESSED;
@@ -98,39 +326,239 @@ CKBOOL DX8InputManager::IsMouseToggled(CK_MOUSEBUTTON iButton)
 
 void DX8InputManager::GetMouseButtonsState(CKBYTE *oStates)
 {
+    NoteRead(CK_LATENCY_MOUSE);
     *(CKDWORD *)oStates = *(CKDWORD *)(m_Mouse.m_State.rgbButtons);
 }
 
 void DX8InputManager::GetMousePosition(Vx2DVector &oPosition, CKBOOL iAbsolute)
 {
+    NoteRead(CK_LATENCY_MOUSE);
     if (iAbsolute)
     {
-        oPosition = m_Mouse.m_Position;
+        oPosition.Set(m_Mouse.m_Position[0], m_Mouse.m_Position[1]);
     }
     else
     {
-        CKRenderContext *rc = m_Context->GetPlayerRenderContext();
-        if (rc)
-        {
-            VxRect rect;
-            rc->GetWindowRect(rect, TRUE);
-            oPosition.Set(m_Mouse.m_Position.x - rect.left, m_Mouse.m_Position.y - rect.top);
-        }
-        else
-        {
-            oPosition = m_Mouse.m_Position;
-        }
+        if (!m_GeometryContext)
+            UpdateWindowGeometry();
+        oPosition.Set(m_Mouse.m_Position[0] - m_WindowOrigin[0], m_Mouse.m_Position[1] - m_WindowOrigin[1]);
+    }
+}
+
+void DX8InputManager::GetMouseCoordinates(CKMouseCoordinates *oCoordinates)
+{
+    if (!oCoordinates)
+        return;
+
+    NoteRead(CK_LATENCY_MOUSE);
+    if (!m_GeometryContext)
+        UpdateWindowGeometry();
+    oCoordinates->Screen.Set(m_Mouse.m_Position[0], m_Mouse.m_Position[1]);
+    oCoordinates->Window.Set(m_Mouse.m_Position[0] - m_WindowOrigin[0], m_Mouse.m_Position[1] - m_WindowOrigin[1]);
+    GetMouseClientPosition(oCoordinates->Client, FALSE);
+    oCoordinates->Scaled.Set(oCoordinates->Client.x / m_DpiScale, oCoordinates->Client.y / m_DpiScale);
+    oCoordinates->DpiScale = m_DpiScale;
+}
+
+void DX8InputManager::GetMouseClientPosition(Vx2DVector &oPosition, CKBOOL iScaled)
+{
+    NoteRead(CK_LATENCY_MOUSE);
+    if (!m_GeometryContext)
+        UpdateWindowGeometry();
+    if (!m_GeometryContext)
+    {
+        oPosition.Set(m_Mouse.m_Position[0], m_Mouse.m_Position[1]);
+        return;
+    }
+
+    // Same rounding and clamping as ScreenToClient on the integer cursor position
+    LONG point[2] = {(LONG)m_Mouse.m_Position[0] - m_ClientOrigin[0], (LONG)m_Mouse.m_Position[1] - m_ClientOrigin[1]};
+    for (int i = 0; i < 2; i++)
+    {
+        if (point[i] >= m_ClientSize[i])
+            point[i] = m_ClientSize[i] - 1;
+        if (point[i] < 0)
+            point[i] = 0;
+    }
+    if (iScaled)
+        oPosition.Set((float)point[0] / m_DpiScale, (float)point[1] / m_DpiScale);
+    else
+        oPosition.Set((float)point[0], (float)point[1]);
+}
+
+void DX8InputManager::InvalidateWindowGeometry()
+{
+    m_GeometryContext = NULL;
+}
+
+void DX8InputManager::UpdateWindowGeometry()
+{
+    CKRenderContext *rc = m_Context->GetPlayerRenderContext();
+    if (!rc)
+    {
+        m_GeometryContext = NULL;
+        m_WindowOrigin[0] = m_WindowOrigin[1] = 0.0f;
+        m_DpiScale = 1.0f;
+        return;
+    }
+
+    HWND hWnd = (HWND)rc->GetWindowHandle();
+    POINT origin;
+    origin.x = 0;
+    origin.y = 0;
+    ::ClientToScreen(hWnd, &origin);
+    int width = rc->GetWidth();
+    int height = rc->GetHeight();
+    if (rc == m_GeometryContext && origin.x == m_ClientOrigin[0] && origin.y == m_ClientOrigin[1] &&
+        width == m_ClientSize[0] && height == m_ClientSize[1])
+        return;
+
+    VxRect rect;
+    rc->GetWindowRect(rect, TRUE);
+    int dpi = 96;
+    HDC dc = ::GetDC(hWnd);
+    if (dc)
+    {
+        dpi = ::GetDeviceCaps(dc, LOGPIXELSX);
+        ::ReleaseDC(hWnd, dc);
     }
+
+    m_GeometryContext = rc;
+    m_ClientOrigin[0] = origin.x;
+    m_ClientOrigin[1] = origin.y;
+    m_ClientSize[0] = width;
+    m_ClientSize[1] = height;
+    m_WindowOrigin[0] = rect.left;
+    m_WindowOrigin[1] = rect.top;
+    m_DpiScale = (dpi > 0) ? dpi / 96.0f : 1.0f;
 }
 
 void DX8InputManager::GetMouseRelativePosition(VxVector &oPosition)
 {
+    NoteRead(CK_LATENCY_MOUSE);
     oPosition.Set((float)m_Mouse.m_State.lX, (float)m_Mouse.m_State.lY, (float)m_Mouse.m_State.lZ);
 }
 
 CKBOOL DX8InputManager::IsMouseAttached()
 {
-    return m_Mouse.m_Device != NULL;
+    return m_Mouse.IsAttached();
+}
+
+void DX8InputManager::EnableMouseBufferedOnly(CKBOOL iEnable)
+{
+    m_Mouse.SetBufferedOnly(iEnable);
+}
+
+CKBOOL DX8InputManager::IsMouseBufferedOnly()
+{
+    return m_Mouse.IsBufferedOnly();
+}
+
+void DX8InputManager::SetMouseCursorSource(INPUT_CURSOR_SOURCE source, CKDWORD resyncFrames)
+{
+    m_Mouse.SetCursorSource(source, resyncFrames);
+}
+
+INPUT_CURSOR_SOURCE DX8InputManager::GetMouseCursorSource()
+{
+    return m_Mouse.GetCursorSource();
+}
+
+void DX8InputManager::FeedMouseCursorPosition(const Vx2DVector &position)
+{
+    InputInjection args;
+    args.Values[0] = position.x;
+    args.Values[1] = position.y;
+    if (!RecordInjection(INJECT_MOUSE_CURSOR_FEED, &args, sizeof(args)))
+        return;
+
+    m_Mouse.SetCursorPosition(position.x, position.y);
+}
+
+CKBOOL DX8InputManager::EnableMouseMotionHistory(CKDWORD pollingRate, CKDWORD minFrameRate)
+{
+    CKDWORD bufferSize = MOUSE_BUFFER_SIZE;
+    if (pollingRate == 0)
+    {
+        m_Mouse.SetMotionHistory(NULL);
+        delete m_MotionHistory;
+        m_MotionHistory = NULL;
+    }
+    else
+    {
+        InputMotionHistory *history = m_MotionHistory ? m_MotionHistory : new InputMotionHistory;
+        if (!history->Configure(pollingRate, minFrameRate))
+        {
+            if (history != m_MotionHistory)
+                delete history;
+            return FALSE;
+        }
+        m_MotionHistory = history;
+        m_Mouse.SetMotionHistory(history);
+
+        // A mouse drain reads at most MOUSE_MAX_READS chunks
+        bufferSize = history->GetDeviceBufferSize();
+        if (bufferSize < MOUSE_BUFFER_SIZE)
+            bufferSize = MOUSE_BUFFER_SIZE;
+        if (bufferSize > MOUSE_BUFFER_SIZE * MOUSE_MAX_READS)
+            bufferSize = MOUSE_BUFFER_SIZE * MOUSE_MAX_READS;
+    }
+
+    if (bufferSize != m_MouseBufferSize)
+    {
+        m_MouseBufferSize = bufferSize;
+        ReopenMouse();
+    }
+    return TRUE;
+}
+
+CKBOOL DX8InputManager::IsMouseMotionHistoryEnabled()
+{
+    return m_MotionHistory != NULL;
+}
+
+void DX8InputManager::SetMouseMotionCoalescing(INPUT_MOTION_COALESCING mode, int samples)
+{
+    if (m_MotionHistory)
+        m_MotionHistory->SetCoalescing(mode, samples);
+}
+
+const InputMotionHistory *DX8InputManager::GetMouseMotionHistory()
+{
+    return m_MotionHistory;
+}
+
+int DX8InputManager::GetMouseMotionPath(InputMotionSample *oSamples, int max)
+{
+    if (!m_MotionHistory)
+        return 0;
+    NoteRead(CK_LATENCY_MOUSE);
+    return m_MotionHistory->GetSamples(oSamples, max);
+}
+
+void DX8InputManager::SetMouseFilter(InputMotionFilter *filter)
+{
+    if (filter != m_MouseFilter)
+        delete m_MouseFilter;
+    m_MouseFilter = filter;
+    if (m_MouseFilter)
+        m_MouseFilter->Reset();
+    m_FilteredMotion[0] = (float)m_Mouse.m_State.lX;
+    m_FilteredMotion[1] = (float)m_Mouse.m_State.lY;
+}
+
+InputMotionFilter *DX8InputManager::GetMouseFilter()
+{
+    return m_MouseFilter;
+}
+
+void DX8InputManager::GetMouseFilteredMotion(VxVector &oMotion)
+{
+    NoteRead(CK_LATENCY_MOUSE);
+    if (m_MouseFilter)
+        oMotion.Set(m_FilteredMotion[0], m_FilteredMotion[1], (float)m_Mouse.m_State.lZ);
+    else
+        oMotion.Set((float)m_Mouse.m_State.lX, (float)m_Mouse.m_State.lY, (float)m_Mouse.m_State.lZ);
 }
 
 CKBOOL DX8InputManager::IsJoystickAttached(int iJoystick)
@@ -147,7 +575,8 @@ void DX8InputManager::GetJoystickPosition(int iJoystick, VxVector *oPosition)
     {
         CKJoystick *joystick = &m_Joysticks[iJoystick];
         joystick->Poll();
-        *oPosition = joystick->m_Position;
+        NoteRead(CK_LATENCY_JOYSTICK + iJoystick);
+        oPosition->Set(joystick->m_Position[0], joystick->m_Position[1], joystick->m_Position[2]);
     }
 }
 
@@ -160,7 +589,8 @@ void DX8InputManager::GetJoystickRotation(int iJoystick, VxVector *oRotation)
     {
         CKJoystick *joystick = &m_Joysticks[iJoystick];
         joystick->Poll();
-        *oRotation = joystick->m_Rotation;
+        NoteRead(CK_LATENCY_JOYSTICK + iJoystick);
+        oRotation->Set(joystick->m_Rotation[0], joystick->m_Rotation[1], joystick->m_Rotation[2]);
     }
 }
 
@@ -173,7 +603,8 @@ void DX8InputManager::GetJoystickSliders(int iJoystick, Vx2DVector *oPosition)
     {
         CKJoystick *joystick = &m_Joysticks[iJoystick];
         joystick->Poll();
-        *oPosition = joystick->m_Sliders;
+        NoteRead(CK_LATENCY_JOYSTICK + iJoystick);
+        oPosition->Set(joystick->m_Sliders[0], joystick->m_Sliders[1]);
     }
 }
 
@@ -186,6 +617,7 @@ void DX8InputManager::GetJoystickPointOfViewAngle(int iJoystick, float *oAngle)
     {
         CKJoystick *joystick = &m_Joysticks[iJoystick];
         joystick->Poll();
+        NoteRead(CK_LATENCY_JOYSTICK + iJoystick);
         *oAngle = (joystick->m_PointOfViewAngle == -1)
                       ? -1.0f
                       : (float)(joystick->m_PointOfViewAngle * PI * 0.000055555556);
@@ -199,62 +631,192 @@ CKDWORD DX8InputManager::GetJoystickButtonsState(int iJoystick)
 
     CKJoystick *joystick = &m_Joysticks[iJoystick];
     joystick->Poll();
-    return joystick->m_Buttons;
+    NoteRead(CK_LATENCY_JOYSTICK + iJoystick);
+    return joystick->GetButtons();
 }
 
 CKBOOL DX8InputManager::IsJoystickButtonDown(int iJoystick, int iButton)
+{
+    if (iJoystick < 0 || iJoystick >= m_JoystickCount || iButton < 0 || iButton >= JOYSTICK_BUTTON_COUNT)
+        return FALSE;
+
+    CKJoystick *joystick = &m_Joysticks[iJoystick];
+    joystick->Poll();
+    NoteRead(CK_LATENCY_JOYSTICK + iJoystick);
+    return KeyMaskTest(joystick->GetButtonMask(), iButton);
+}
+
+CKBOOL DX8InputManager::GetJoystickButtonsMask(int iJoystick, CKDWORD *oDown, CKDWORD *oPressed, CKDWORD *oReleased)
 {
     if (iJoystick < 0 || iJoystick >= m_JoystickCount)
         return FALSE;
 
     CKJoystick *joystick = &m_Joysticks[iJoystick];
     joystick->Poll();
-    return (joystick->m_Buttons & (1 << iButton)) != 0;
+    NoteRead(CK_LATENCY_JOYSTICK + iJoystick);
+    if (oDown)
+        memcpy(oDown, joystick->GetButtonMask(), JOYSTICK_BUTTON_WORDS * sizeof(CKDWORD));
+    if (oPressed)
+        memcpy(oPressed, joystick->GetPressedMask(), JOYSTICK_BUTTON_WORDS * sizeof(CKDWORD));
+    if (oReleased)
+        memcpy(oReleased, joystick->GetReleasedMask(), JOYSTICK_BUTTON_WORDS * sizeof(CKDWORD));
+    return TRUE;
 }
 
-void DX8InputManager::Pause(CKBOOL pause)
+CKBOOL DX8InputManager::IsJoystickButtonPressed(int iJoystick, int iButton)
 {
-    if (pause && !m_Paused)
-    {
-        ::OutputDebugString(TEXT("InputManager Paused"));
-        ClearBuffers();
-        m_Paused = pause;
-        m_WasPaused = TRUE; // Set flag to prevent redundant clears in PreProcess
-        return;
-    }
-    else if (m_Paused)
-    {
-        ::OutputDebugString(TEXT("InputManager Un-Paused"));
-    }
+    if (iJoystick < 0 || iJoystick >= m_JoystickCount || iButton < 0 || iButton >= JOYSTICK_BUTTON_COUNT)
+        return FALSE;
 
-    m_Paused = pause;
+    CKJoystick *joystick = &m_Joysticks[iJoystick];
+    joystick->Poll();
+    NoteRead(CK_LATENCY_JOYSTICK + iJoystick);
+    return KeyMaskTest(joystick->GetPressedMask(), iButton);
 }
 
-void DX8InputManager::ShowCursor(CKBOOL iShow)
+CKBOOL DX8InputManager::IsJoystickButtonReleased(int iJoystick, int iButton)
 {
-    m_ShowCursor = iShow;
-    EnsureCursorVisible(iShow);
+    if (iJoystick < 0 || iJoystick >= m_JoystickCount || iButton < 0 || iButton >= JOYSTICK_BUTTON_COUNT)
+        return FALSE;
+
+    CKJoystick *joystick = &m_Joysticks[iJoystick];
+    joystick->Poll();
+    NoteRead(CK_LATENCY_JOYSTICK + iJoystick);
+    return KeyMaskTest(joystick->GetReleasedMask(), iButton);
 }
 
-void DX8InputManager::EnsureCursorVisible(CKBOOL iShow)
+int DX8InputManager::GetKeysState(const CKDWORD *iKeys, int count, CKBYTE *oStates, CKDWORD *oStamps)
 {
-    if (iShow)
+    if (!iKeys || count <= 0)
+        return 0;
+
+    NoteRead(CK_LATENCY_KEYBOARD);
+    int down = 0;
+    for (int i = 0; i < count; i++)
     {
-        int dc = VxShowCursor(TRUE);
-        if (dc > 0)
-            dc = VxShowCursor(FALSE);
-        if (dc < 0)
-            while (VxShowCursor(TRUE) < 0)
-                continue;
+        CKDWORD key = iKeys[i];
+        CKBYTE state = (key < KEYBOARD_BUFFER_SIZE) ? m_Keyboard.m_State[key] : (CKBYTE)KS_IDLE;
+        if (state & KS_PRESSED)
+            ++down;
+        if (oStates)
+            oStates[i] = state;
+        if (oStamps)
+            oStamps[i] = (state != KS_IDLE) ? (CKDWORD)m_Keyboard.m_Stamps[key] : 0;
     }
+    return down;
+}
+
+void DX8InputManager::GetMouseState(CKInputMouseState *oState)
+{
+    if (!oState)
+        return;
+
+    NoteRead(CK_LATENCY_MOUSE);
+    const DIMOUSESTATE &state = m_Mouse.m_State;
+    oState->Position.Set(m_Mouse.m_Position[0], m_Mouse.m_Position[1]);
+    oState->Motion.Set((float)state.lX, (float)state.lY, (float)state.lZ);
+    if (m_MouseFilter)
+        oState->FilteredMotion.Set(m_FilteredMotion[0], m_FilteredMotion[1], (float)state.lZ);
     else
+        oState->FilteredMotion = oState->Motion;
+    oState->Clicked = 0;
+    for (int i = 0; i < 4; i++)
     {
-        int dc = VxShowCursor(FALSE);
-        if (dc < -1)
-            dc = VxShowCursor(TRUE);
-        if (dc >= 0)
-            while (VxShowCursor(FALSE) >= 0)
-                continue;
+        oState->Buttons[i] = state.rgbButtons[i];
+        if ((state.rgbButtons[i] & KS_PRESSED) != 0 && (m_Mouse.m_LastButtons[i] & KS_PRESSED) == 0)
+            oState->Clicked |= 1 << i;
+    }
+    oState->WheelPosition = m_Mouse.m_WheelPosition;
+    oState->Attached = m_Mouse.IsAttached();
+    oState->Time = m_Mouse.GetTime();
+}
+
+CKBOOL DX8InputManager::GetJoystickState(int iJoystick, CKInputJoystickState *oState)
+{
+    if (!oState)
+        return FALSE;
+    if (iJoystick < 0 || iJoystick >= m_JoystickCount)
+    {
+        memset(oState, 0, sizeof(CKInputJoystickState));
+        oState->PointOfViewAngle = -1.0f;
+        return FALSE;
+    }
+
+    CKJoystick *joystick = &m_Joysticks[iJoystick];
+    joystick->Poll();
+    NoteRead(CK_LATENCY_JOYSTICK + iJoystick);
+    oState->Position.Set(joystick->m_Position[0], joystick->m_Position[1], joystick->m_Position[2]);
+    oState->Rotation.Set(joystick->m_Rotation[0], joystick->m_Rotation[1], joystick->m_Rotation[2]);
+    oState->Sliders.Set(joystick->m_Sliders[0], joystick->m_Sliders[1]);
+    oState->PointOfViewAngle = (joystick->m_PointOfViewAngle == -1)
+                                   ? -1.0f
+                                   : (float)(joystick->m_PointOfViewAngle * PI * 0.000055555556);
+    oState->Buttons = joystick->GetButtons();
+    memcpy(oState->ButtonMask, joystick->GetButtonMask(), sizeof(oState->ButtonMask));
+    memcpy(oState->Pressed, joystick->GetPressedMask(), sizeof(oState->Pressed));
+    memcpy(oState->Released, joystick->GetReleasedMask(), sizeof(oState->Released));
+    oState->Attached = joystick->IsAttached();
+    oState->Time = joystick->GetTime();
+    return TRUE;
+}
+
+int DX8InputManager::GetJoystickStates(CKInputJoystickState *oStates, int count)
+{
+    if (!oStates || count <= 0)
+        return 0;
+
+    int filled = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (DX8InputManager::GetJoystickState(i, &oStates[i]))
+            ++filled;
+    }
+    return filled;
+}
+
+void DX8InputManager::Pause(CKBOOL pause)
+{
+    if (pause && !m_Paused)
+    {
+        ::OutputDebugString(TEXT("InputManager Paused"));
+        ClearBuffers();
+        m_Paused = pause;
+        m_WasPaused = TRUE; // Set flag to prevent redundant clears in PreProcess
+        return;
+    }
+    else if (m_Paused)
+    {
+        ::OutputDebugString(TEXT("InputManager Un-Paused"));
+    }
+
+    m_Paused = pause;
+}
+
+void DX8InputManager::ShowCursor(CKBOOL iShow)
+{
+    m_ShowCursor = iShow;
+    EnsureCursorVisible(iShow);
+}
+
+void DX8InputManager::EnsureCursorVisible(CKBOOL iShow)
+{
+    if (iShow)
+    {
+        int dc = VxShowCursor(TRUE);
+        if (dc > 0)
+            dc = VxShowCursor(FALSE);
+        if (dc < 0)
+            while (VxShowCursor(TRUE) < 0)
+                continue;
+    }
+    else
+    {
+        int dc = VxShowCursor(FALSE);
+        if (dc < -1)
+            dc = VxShowCursor(TRUE);
+        if (dc >= 0)
+            while (VxShowCursor(FALSE) >= 0)
+                continue;
     }
 }
 
@@ -281,10 +843,10 @@ int DX8InputManager::GetJoystickCount()
 
 IDirectInputDevice8 *DX8InputManager::GetJoystickDxInterface(int iJoystick)
 {
-    if (iJoystick < 0 || iJoystick >= m_JoystickCount)
+    if (iJoystick < 0 || iJoystick >= m_JoystickCount || !m_Joysticks[iJoystick].m_Device)
         return NULL;
     else
-        return m_Joysticks[iJoystick].m_Device;
+        return (IDirectInputDevice8 *)m_Joysticks[iJoystick].m_Device->GetNativeInterface();
 }
 
 int DX8InputManager::GetMaxJoysticks()
@@ -364,13 +926,12 @@ CKBOOL DX8InputManager::GetJoystickCapabilities(int iJoystick, CKDWORD *caps)
     if (joystick.m_AxisCaps.hasSlider1)
         *caps |= CK_JOYSTICK_HAS_SLIDER1;
 
-    // Query DirectInput device for POV capability
+    // Query the device for POV capability
     if (joystick.m_Device)
     {
-        DIDEVCAPS devcaps;
-        memset(&devcaps, 0, sizeof(DIDEVCAPS));
-        devcaps.dwSize = sizeof(DIDEVCAPS);
-        if (SUCCEEDED(joystick.m_Device->GetCapabilities(&devcaps)) && devcaps.dwPOVs > 0)
+        InputDeviceCaps devcaps;
+        memset(&devcaps, 0, sizeof(InputDeviceCaps));
+        if (SUCCEEDED(joystick.m_Device->GetCapabilities(&devcaps)) && devcaps.POVs > 0)
         {
             *caps |= CK_JOYSTICK_HAS_POV;
         }
@@ -553,6 +1114,7 @@ CKBOOL DX8InputManager::SetJoystickAxisRange(int iJoystick, CK_JOYSTICK_AXIS axi
         ::OutputDebugString(TEXT("DX8InputManager::SetJoystickAxisRange: Invalid axis"));
         return FALSE;
     }
+    joystick.UpdateAxisScale();
 
     return TRUE;
 }
@@ -578,264 +1140,932 @@ CKBOOL DX8InputManager::ResetJoystickAxisRanges(int iJoystick)
     // Re-query actual device ranges if DirectInput device exists
     if (joystick.m_Device)
     {
-        joystick.GetInfo(); // Re-enumerate axes to get device defaults
+        joystick.GetInfo(); // Re-enumerate axes to get device defaults
+    }
+    else
+    {
+        joystick.UpdateAxisScale();
+    }
+
+    return TRUE;
+}
+
+CKBOOL DX8InputManager::SetJoystickResponseCurve(int iJoystick, CK_JOYSTICK_AXIS axis, const float *iX, const float *iY, int iCount, CKBOOL iSymmetric)
+{
+    if (iJoystick < 0 || iJoystick >= m_JoystickCount)
+    {
+        ::OutputDebugString(TEXT("DX8InputManager::SetJoystickResponseCurve: Invalid joystick index"));
+        return FALSE;
+    }
+
+    if (!m_Joysticks[iJoystick].SetResponseCurve((int)axis, iX, iY, iCount, iSymmetric))
+    {
+        ::OutputDebugString(TEXT("DX8InputManager::SetJoystickResponseCurve: Invalid axis or control points"));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void DX8InputManager::ClearJoystickResponseCurve(int iJoystick, CK_JOYSTICK_AXIS axis)
+{
+    if (iJoystick < 0 || iJoystick >= m_JoystickCount)
+    {
+        ::OutputDebugString(TEXT("DX8InputManager::ClearJoystickResponseCurve: Invalid joystick index"));
+        return;
+    }
+    m_Joysticks[iJoystick].ClearResponseCurve((int)axis);
+}
+
+CKBOOL DX8InputManager::HasJoystickResponseCurve(int iJoystick, CK_JOYSTICK_AXIS axis)
+{
+    return 0 <= iJoystick && iJoystick < m_JoystickCount && m_Joysticks[iJoystick].HasResponseCurve((int)axis);
+}
+
+CKDWORD DX8InputManager::GetKeyboardRepeatDelay()
+{
+    return m_Keyboard.m_RepeatDelay;
+}
+
+void DX8InputManager::SetKeyboardRepeatDelay(CKDWORD delay)
+{
+    m_Keyboard.m_RepeatDelay = delay;
+}
+
+CKDWORD DX8InputManager::GetKeyboardRepeatInterval()
+{
+    return m_Keyboard.m_RepeatInterval;
+}
+
+void DX8InputManager::SetKeyboardRepeatInterval(CKDWORD interval)
+{
+    m_Keyboard.m_RepeatInterval = interval;
+}
+
+int DX8InputManager::GetMouseWheelDelta()
+{
+    NoteRead(CK_LATENCY_MOUSE);
+    return m_Mouse.m_State.lZ;
+}
+
+int DX8InputManager::GetMouseWheelPosition()
+{
+    return m_Mouse.m_WheelPosition;
+}
+
+// State setting calls stored in the input journal
+enum INPUT_INJECTION
+{
+    INJECT_KEY_DOWN = 1,
+    INJECT_KEY_UP,
+    INJECT_MULTIPLE_KEYS,
+    INJECT_MOUSE_BUTTON_DOWN,
+    INJECT_MOUSE_BUTTON_UP,
+    INJECT_MOUSE_POSITION,
+    INJECT_MOUSE_WHEEL,
+    INJECT_MOUSE_WHEEL_POSITION,
+    INJECT_JOYSTICK_BUTTON_DOWN,
+    INJECT_JOYSTICK_BUTTON_UP,
+    INJECT_JOYSTICK_POSITION,
+    INJECT_JOYSTICK_ROTATION,
+    INJECT_JOYSTICK_SLIDERS,
+    INJECT_JOYSTICK_POV,
+    INJECT_KEYBOARD_STATE,
+    INJECT_MOUSE_STATE,
+    INJECT_JOYSTICK_STATE,
+    INJECT_CLEAR_KEYBOARD,
+    INJECT_CLEAR_MOUSE,
+    INJECT_CLEAR_JOYSTICK,
+    INJECT_MOUSE_CURSOR_FEED
+};
+
+// Arguments of a journaled call; unused fields are zero
+struct InputInjection
+{
+    int Index;       // Key, mouse button or joystick
+    int Value;       // Joystick button, wheel, key count or flags
+    float Values[8]; // Vectors, in argument order
+    CKDWORD Buttons;
+    CKDWORD Pov;
+
+    InputInjection(int index = 0, int value = 0) : Index(index), Value(value), Buttons(0), Pov(0)
+    {
+        for (int i = 0; i < 8; i++)
+            Values[i] = 0.0f;
+    }
+};
+
+CKBOOL DX8InputManager::RecordInjection(CKDWORD call, const void *args, CKDWORD size, const void *body, CKDWORD bodySize)
+{
+    // The journal supplies the injections of a replay
+    if (m_Replay && !m_ReplayingInjection)
+        return FALSE;
+    if (m_Recorder)
+        m_Recorder->WriteInjection(call, args, size, body, bodySize);
+    return TRUE;
+}
+
+void DX8InputManager::ReplayInjection(DWORD call, const void *data, DWORD size, void *context)
+{
+    DX8InputManager *im = (DX8InputManager *)context;
+    if (size < sizeof(InputInjection))
+        return;
+
+    InputInjection args;
+    memcpy(&args, data, sizeof(args));
+    const CKBYTE *body = (const CKBYTE *)data + sizeof(args);
+    DWORD bodySize = size - sizeof(args);
+    const float *v = args.Values;
+
+    CKBOOL replaying = im->m_ReplayingInjection;
+    im->m_ReplayingInjection = TRUE;
+    switch (call)
+    {
+    case INJECT_KEY_DOWN:
+        im->SetKeyDown(args.Index);
+        break;
+    case INJECT_KEY_UP:
+        im->SetKeyUp(args.Index);
+        break;
+    case INJECT_MULTIPLE_KEYS:
+    {
+        // The payload may be unaligned; more keys than scancodes can only be repeats
+        CKDWORD keys[KEYBOARD_BUFFER_SIZE];
+        int count = (args.Index < KEYBOARD_BUFFER_SIZE) ? args.Index : KEYBOARD_BUFFER_SIZE;
+        if (count < 0 || bodySize < count * sizeof(CKDWORD))
+            break;
+        memcpy(keys, body, count * sizeof(CKDWORD));
+        im->SetMultipleKeys(keys, count, args.Value);
+        break;
+    }
+    case INJECT_MOUSE_BUTTON_DOWN:
+        im->SetMouseButtonDown((CK_MOUSEBUTTON)args.Index);
+        break;
+    case INJECT_MOUSE_BUTTON_UP:
+        im->SetMouseButtonUp((CK_MOUSEBUTTON)args.Index);
+        break;
+    case INJECT_MOUSE_POSITION:
+        im->SetMousePosition(Vx2DVector(v[0], v[1]));
+        break;
+    case INJECT_MOUSE_CURSOR_FEED:
+        im->FeedMouseCursorPosition(Vx2DVector(v[0], v[1]));
+        break;
+    case INJECT_MOUSE_WHEEL:
+        im->SetMouseWheel(args.Value);
+        break;
+    case INJECT_MOUSE_WHEEL_POSITION:
+        im->SetMouseWheelPosition(args.Value);
+        break;
+    case INJECT_JOYSTICK_BUTTON_DOWN:
+        im->SetJoystickButtonDown(args.Index, args.Value);
+        break;
+    case INJECT_JOYSTICK_BUTTON_UP:
+        im->SetJoystickButtonUp(args.Index, args.Value);
+        break;
+    case INJECT_JOYSTICK_POSITION:
+        im->SetJoystickPosition(args.Index, VxVector(v[0], v[1], v[2]));
+        break;
+    case INJECT_JOYSTICK_ROTATION:
+        im->SetJoystickRotation(args.Index, VxVector(v[0], v[1], v[2]));
+        break;
+    case INJECT_JOYSTICK_SLIDERS:
+        im->SetJoystickSliders(args.Index, Vx2DVector(v[0], v[1]));
+        break;
+    case INJECT_JOYSTICK_POV:
+        im->SetJoystickPOV(args.Index, v[0]);
+        break;
+    case INJECT_KEYBOARD_STATE:
+    {
+        // Key states, followed by the stamps when Value is set
+        CKBYTE states[KEYBOARD_BUFFER_SIZE];
+        int stamps[KEYBOARD_BUFFER_SIZE];
+        if (bodySize < sizeof(states) + (args.Value ? sizeof(stamps) : 0))
+            break;
+        memcpy(states, body, sizeof(states));
+        if (args.Value)
+            memcpy(stamps, body + sizeof(states), sizeof(stamps));
+        im->SetKeyboardState(states, args.Value ? stamps : NULL);
+        break;
+    }
+    case INJECT_MOUSE_STATE:
+    {
+        CKBYTE buttons[4];
+        memcpy(buttons, &args.Buttons, sizeof(buttons));
+        im->SetMouseState(Vx2DVector(v[0], v[1]), args.Value ? buttons : NULL, VxVector(v[2], v[3], v[4]));
+        break;
+    }
+    case INJECT_JOYSTICK_STATE:
+        im->SetJoystickState(args.Index, VxVector(v[0], v[1], v[2]), VxVector(v[3], v[4], v[5]), Vx2DVector(v[6], v[7]), args.Buttons, args.Pov);
+        break;
+    case INJECT_CLEAR_KEYBOARD:
+        im->ClearKeyboardState();
+        break;
+    case INJECT_CLEAR_MOUSE:
+        im->ClearMouseState();
+        break;
+    case INJECT_CLEAR_JOYSTICK:
+        im->ClearJoystickState(args.Index);
+        break;
+    default:
+        break;
+    }
+    im->m_ReplayingInjection = replaying;
+}
+
+void DX8InputManager::SetKeyDown(CKDWORD iKey)
+{
+    InputInjection args(iKey);
+    if (!RecordInjection(INJECT_KEY_DOWN, &args, sizeof(args)))
+        return;
+
+    m_Keyboard.SetKey(iKey, TRUE, m_Backend->GetTickCount(), m_Backend->GetTime());
+}
+
+void DX8InputManager::SetKeyUp(CKDWORD iKey)
+{
+    InputInjection args(iKey);
+    if (!RecordInjection(INJECT_KEY_UP, &args, sizeof(args)))
+        return;
+
+    m_Keyboard.SetKey(iKey, FALSE, m_Backend->GetTickCount(), m_Backend->GetTime());
+}
+
+void DX8InputManager::SetMultipleKeys(const CKDWORD *keys, int count, CKBOOL pressed)
+{
+    if (!keys || count <= 0)
+        return;
+
+    InputInjection args(count, pressed);
+    if (!RecordInjection(INJECT_MULTIPLE_KEYS, &args, sizeof(args), keys, count * sizeof(CKDWORD)))
+        return;
+
+    // All keys of one call share the same stamp
+    DWORD stamp = m_Backend->GetTickCount();
+    InputTime time = m_Backend->GetTime();
+    for (int i = 0; i < count; i++)
+        m_Keyboard.SetKey(keys[i], pressed, stamp, time);
+}
+
+void DX8InputManager::SetMouseButtonDown(CK_MOUSEBUTTON iButton)
+{
+    InputInjection args(iButton);
+    if (!RecordInjection(INJECT_MOUSE_BUTTON_DOWN, &args, sizeof(args)))
+        return;
+
+    if (iButton < 4)
+    {
+        m_Mouse.m_State.rgbButtons[iButton] |= KS_PRESSED;
+        m_Mouse.m_ButtonTimes[iButton] = m_Backend->GetTime();
+    }
+}
+
+void DX8InputManager::SetMouseButtonUp(CK_MOUSEBUTTON iButton)
+{
+    InputInjection args(iButton);
+    if (!RecordInjection(INJECT_MOUSE_BUTTON_UP, &args, sizeof(args)))
+        return;
+
+    if (iButton < 4)
+    {
+        m_Mouse.m_State.rgbButtons[iButton] |= KS_RELEASED;
+        m_Mouse.m_ButtonTimes[iButton] = m_Backend->GetTime();
+    }
+}
+
+void DX8InputManager::SetMousePosition(const Vx2DVector &position)
+{
+    InputInjection args;
+    args.Values[0] = position.x;
+    args.Values[1] = position.y;
+    if (!RecordInjection(INJECT_MOUSE_POSITION, &args, sizeof(args)))
+        return;
+
+    m_Mouse.m_Position[0] = position.x;
+    m_Mouse.m_Position[1] = position.y;
+    if (m_Backend)
+    {
+        m_Mouse.m_Time = m_Backend->GetTime();
+        m_Backend->SetCursorPos((LONG)position.x, (LONG)position.y);
+    }
+}
+
+void DX8InputManager::SetMouseWheel(int wheelDelta)
+{
+    InputInjection args(0, wheelDelta);
+    if (!RecordInjection(INJECT_MOUSE_WHEEL, &args, sizeof(args)))
+        return;
+
+    m_Mouse.m_State.lZ = wheelDelta;
+    m_Mouse.m_WheelPosition += wheelDelta;
+}
+
+void DX8InputManager::SetMouseWheelPosition(int position)
+{
+    InputInjection args(0, position);
+    if (!RecordInjection(INJECT_MOUSE_WHEEL_POSITION, &args, sizeof(args)))
+        return;
+
+    int delta = position - m_Mouse.m_WheelPosition;
+    m_Mouse.m_State.lZ = delta;
+    m_Mouse.m_WheelPosition = position;
+}
+
+void DX8InputManager::SetJoystickButtonDown(int iJoystick, int iButton)
+{
+    InputInjection args(iJoystick, iButton);
+    if (!RecordInjection(INJECT_JOYSTICK_BUTTON_DOWN, &args, sizeof(args)))
+        return;
+
+    if (iJoystick >= 0 && iJoystick < m_JoystickCount && iButton >= 0 && iButton < JOYSTICK_BUTTON_COUNT)
+    {
+        DWORD buttons[JOYSTICK_BUTTON_WORDS];
+        memcpy(buttons, m_Joysticks[iJoystick].m_ButtonMask, sizeof(buttons));
+        KeyMaskSet(buttons, iButton);
+        m_Joysticks[iJoystick].SetButtons(buttons);
+        m_Joysticks[iJoystick].m_Polled = TRUE;
+        m_Joysticks[iJoystick].m_Time = m_Backend->GetTime();
+    }
+}
+
+void DX8InputManager::SetJoystickButtonUp(int iJoystick, int iButton)
+{
+    InputInjection args(iJoystick, iButton);
+    if (!RecordInjection(INJECT_JOYSTICK_BUTTON_UP, &args, sizeof(args)))
+        return;
+
+    if (iJoystick >= 0 && iJoystick < m_JoystickCount && iButton >= 0 && iButton < JOYSTICK_BUTTON_COUNT)
+    {
+        DWORD buttons[JOYSTICK_BUTTON_WORDS];
+        memcpy(buttons, m_Joysticks[iJoystick].m_ButtonMask, sizeof(buttons));
+        KeyMaskReset(buttons, iButton);
+        m_Joysticks[iJoystick].SetButtons(buttons);
+        m_Joysticks[iJoystick].m_Polled = TRUE;
+        m_Joysticks[iJoystick].m_Time = m_Backend->GetTime();
+    }
+}
+
+void DX8InputManager::SetJoystickPosition(int iJoystick, const VxVector &position)
+{
+    InputInjection args(iJoystick);
+    args.Values[0] = position.x;
+    args.Values[1] = position.y;
+    args.Values[2] = position.z;
+    if (!RecordInjection(INJECT_JOYSTICK_POSITION, &args, sizeof(args)))
+        return;
+
+    if (iJoystick >= 0 && iJoystick < m_JoystickCount)
+    {
+        m_Joysticks[iJoystick].m_Position[0] = position.x;
+        m_Joysticks[iJoystick].m_Position[1] = position.y;
+        m_Joysticks[iJoystick].m_Position[2] = position.z;
+        m_Joysticks[iJoystick].m_Polled = TRUE;
+        m_Joysticks[iJoystick].m_Time = m_Backend->GetTime();
+    }
+}
+
+void DX8InputManager::SetJoystickRotation(int iJoystick, const VxVector &rotation)
+{
+    InputInjection args(iJoystick);
+    args.Values[0] = rotation.x;
+    args.Values[1] = rotation.y;
+    args.Values[2] = rotation.z;
+    if (!RecordInjection(INJECT_JOYSTICK_ROTATION, &args, sizeof(args)))
+        return;
+
+    if (iJoystick >= 0 && iJoystick < m_JoystickCount)
+    {
+        m_Joysticks[iJoystick].m_Rotation[0] = rotation.x;
+        m_Joysticks[iJoystick].m_Rotation[1] = rotation.y;
+        m_Joysticks[iJoystick].m_Rotation[2] = rotation.z;
+        m_Joysticks[iJoystick].m_Polled = TRUE;
+        m_Joysticks[iJoystick].m_Time = m_Backend->GetTime();
+    }
+}
+
+void DX8InputManager::SetJoystickSliders(int iJoystick, const Vx2DVector &sliders)
+{
+    InputInjection args(iJoystick);
+    args.Values[0] = sliders.x;
+    args.Values[1] = sliders.y;
+    if (!RecordInjection(INJECT_JOYSTICK_SLIDERS, &args, sizeof(args)))
+        return;
+
+    if (iJoystick >= 0 && iJoystick < m_JoystickCount)
+    {
+        m_Joysticks[iJoystick].m_Sliders[0] = sliders.x;
+        m_Joysticks[iJoystick].m_Sliders[1] = sliders.y;
+        m_Joysticks[iJoystick].m_Polled = TRUE;
+        m_Joysticks[iJoystick].m_Time = m_Backend->GetTime();
+    }
+}
+
+void DX8InputManager::SetJoystickPOV(int iJoystick, float angle)
+{
+    InputInjection args(iJoystick);
+    args.Values[0] = angle;
+    if (!RecordInjection(INJECT_JOYSTICK_POV, &args, sizeof(args)))
+        return;
+
+    if (iJoystick >= 0 && iJoystick < m_JoystickCount)
+    {
+        // Convert angle from radians to the format expected by DirectInput (degrees * 100)
+        // -1.0f is a special value indicating POV is not pressed/centered
+        if (angle < 0.0f)
+        {
+            m_Joysticks[iJoystick].m_PointOfViewAngle = -1;
+        }
+        else
+        {
+            // Convert radians to degrees * 100 (DirectInput format)
+            float degrees = angle * 180.0f / PI;
+            m_Joysticks[iJoystick].m_PointOfViewAngle = (CKDWORD)(degrees * 100.0f);
+        }
+        m_Joysticks[iJoystick].m_Polled = TRUE;
+        m_Joysticks[iJoystick].m_Time = m_Backend->GetTime();
+    }
+}
+
+void DX8InputManager::SetKeyboardState(const CKBYTE *states, const int *stamps)
+{
+    if (!states)
+        return;
+
+    InputInjection args(0, stamps != NULL);
+    CKBYTE body[KEYBOARD_BUFFER_SIZE * (1 + sizeof(int))];
+    memcpy(body, states, KEYBOARD_BUFFER_SIZE);
+    if (stamps)
+        memcpy(body + KEYBOARD_BUFFER_SIZE, stamps, KEYBOARD_BUFFER_SIZE * sizeof(int));
+    if (!RecordInjection(INJECT_KEYBOARD_STATE, &args, sizeof(args), body, stamps ? sizeof(body) : KEYBOARD_BUFFER_SIZE))
+        return;
+
+    m_Keyboard.SetState(states, stamps);
+}
+
+void DX8InputManager::SetMouseState(const Vx2DVector &pos, const CKBYTE *buttons, const VxVector &delta)
+{
+    InputInjection args(0, buttons != NULL);
+    args.Values[0] = pos.x;
+    args.Values[1] = pos.y;
+    args.Values[2] = delta.x;
+    args.Values[3] = delta.y;
+    args.Values[4] = delta.z;
+    if (buttons)
+        memcpy(&args.Buttons, buttons, 4);
+    if (!RecordInjection(INJECT_MOUSE_STATE, &args, sizeof(args)))
+        return;
+
+    m_Mouse.m_Position[0] = pos.x;
+    m_Mouse.m_Position[1] = pos.y;
+    if (buttons)
+        memcpy(m_Mouse.m_State.rgbButtons, buttons, 4);
+    m_Mouse.m_State.lX = (long)delta.x;
+    m_Mouse.m_State.lY = (long)delta.y;
+    m_Mouse.m_State.lZ = (long)delta.z;
+    m_Mouse.m_Time = m_Backend->GetTime();
+    if (buttons)
+    {
+        for (int i = 0; i < 4; i++)
+            m_Mouse.m_ButtonTimes[i] = m_Mouse.m_Time;
+    }
+}
+
+void DX8InputManager::SetJoystickState(int iJoystick, const VxVector &pos, const VxVector &rot, const Vx2DVector &sliders, CKDWORD buttons, CKDWORD pov)
+{
+    InputInjection args(iJoystick);
+    args.Values[0] = pos.x;
+    args.Values[1] = pos.y;
+    args.Values[2] = pos.z;
+    args.Values[3] = rot.x;
+    args.Values[4] = rot.y;
+    args.Values[5] = rot.z;
+    args.Values[6] = sliders.x;
+    args.Values[7] = sliders.y;
+    args.Buttons = buttons;
+    args.Pov = pov;
+    if (!RecordInjection(INJECT_JOYSTICK_STATE, &args, sizeof(args)))
+        return;
+
+    if (iJoystick >= 0 && iJoystick < m_JoystickCount)
+    {
+        CKJoystick &joystick = m_Joysticks[iJoystick];
+        joystick.m_Position[0] = pos.x;
+        joystick.m_Position[1] = pos.y;
+        joystick.m_Position[2] = pos.z;
+        joystick.m_Rotation[0] = rot.x;
+        joystick.m_Rotation[1] = rot.y;
+        joystick.m_Rotation[2] = rot.z;
+        joystick.m_Sliders[0] = sliders.x;
+        joystick.m_Sliders[1] = sliders.y;
+        // Buttons 32 to 127 are left as they are
+        DWORD mask[JOYSTICK_BUTTON_WORDS];
+        memcpy(mask, joystick.m_ButtonMask, sizeof(mask));
+        mask[0] = buttons;
+        joystick.SetButtons(mask);
+        joystick.m_PointOfViewAngle = (pov == 0xFFFFFFFF) ? -1 : (LONG)pov;
+        joystick.m_Polled = TRUE;
+        joystick.m_Time = m_Backend->GetTime();
+    }
+}
+
+void DX8InputManager::ClearKeyboardState()
+{
+    InputInjection args;
+    if (!RecordInjection(INJECT_CLEAR_KEYBOARD, &args, sizeof(args)))
+        return;
+
+    m_Keyboard.Clear();
+}
+
+void DX8InputManager::ClearMouseState()
+{
+    InputInjection args;
+    if (!RecordInjection(INJECT_CLEAR_MOUSE, &args, sizeof(args)))
+        return;
+
+    m_Mouse.Clear();
+}
+
+void DX8InputManager::ClearJoystickState(int joystickIndex)
+{
+    InputInjection args(joystickIndex);
+    if (!RecordInjection(INJECT_CLEAR_JOYSTICK, &args, sizeof(args)))
+        return;
+
+    if (joystickIndex >= 0 && joystickIndex < m_JoystickCount)
+    {
+        // Clear specific joystick
+        m_Joysticks[joystickIndex].Clear();
+    }
+    else
+    {
+        // Clear all joysticks
+        for (int i = 0; i < m_JoystickCount; i++)
+        {
+            m_Joysticks[i].Clear();
+        }
+    }
+}
+
+void DX8InputManager::ClearInputState()
+{
+    ClearKeyboardState();
+    ClearMouseState();
+    ClearJoystickState();
+}
+
+CKBOOL DX8InputManager::StartInputRecording(CKSTRING path)
+{
+    StopInputJournal();
+
+    RecordingInputBackend *recorder = new RecordingInputBackend(m_Backend);
+    if (!recorder->Open(path))
+    {
+        ::OutputDebugString(TEXT("DX8InputManager: Cannot create the input journal"));
+        recorder->DetachBackend();
+        recorder->Release();
+        return FALSE;
+    }
+
+    // The devices are reopened so that the journal starts from their creation
+    m_Recorder = recorder;
+    ExchangeBackend(recorder);
+    return TRUE;
+}
+
+CKBOOL DX8InputManager::StartInputReplay(CKSTRING path)
+{
+    StopInputJournal();
+
+    ReplayInputBackend *replay = new ReplayInputBackend;
+    if (!replay->Open(path))
+    {
+        ::OutputDebugString(TEXT("DX8InputManager: Cannot open the input journal"));
+        replay->Release();
+        return FALSE;
+    }
+
+    replay->SetInjectionCallback(ReplayInjection, this);
+    m_Replay = replay;
+    m_LiveBackend = ExchangeBackend(replay);
+    return TRUE;
+}
+
+void DX8InputManager::StopInputJournal()
+{
+    if (m_Recorder)
+    {
+        RecordingInputBackend *recorder = m_Recorder;
+        m_Recorder = NULL;
+        ExchangeBackend(recorder->GetBackend());
+        recorder->DetachBackend();
+        recorder->Release();
+    }
+
+    if (m_Replay)
+    {
+        InputBackend *live = m_LiveBackend;
+        m_Replay = NULL;
+        m_LiveBackend = NULL;
+        ExchangeBackend(live)->Release();
+    }
+}
+
+CKBOOL DX8InputManager::IsRecordingInput()
+{
+    return m_Recorder != NULL;
+}
+
+CKBOOL DX8InputManager::IsReplayingInput()
+{
+    return m_Replay != NULL;
+}
+
+CKBOOL DX8InputManager::IsInputReplayFinished()
+{
+    return m_Replay && m_Replay->IsFinished();
+}
+
+void DX8InputManager::EnableInputThread(CKBOOL iEnable)
+{
+    if ((m_Threaded != NULL) == (iEnable != FALSE))
+        return;
+
+    StopInputJournal();
+    if (iEnable)
+    {
+        ThreadedInputBackend *threaded = new ThreadedInputBackend(m_Backend);
+        threaded->SetPollInterval(m_InputThreadPollInterval);
+        m_Threaded = threaded;
+        ExchangeBackend(threaded);
+    }
+    else
+    {
+        ThreadedInputBackend *threaded = m_Threaded;
+        m_Threaded = NULL;
+        ExchangeBackend(threaded->GetBackend());
+        threaded->DetachBackend();
+        threaded->Release();
+    }
+}
+
+CKBOOL DX8InputManager::IsInputThreadEnabled()
+{
+    return m_Threaded != NULL;
+}
+
+void DX8InputManager::SetInputThreadPollInterval(CKDWORD ms)
+{
+    m_InputThreadPollInterval = (ms > 0) ? ms : 1;
+    if (m_Threaded)
+        m_Threaded->SetPollInterval(m_InputThreadPollInterval);
+}
+
+CKBOOL DX8InputManager::LoadActionMap(CKSTRING path)
+{
+    UpdateKeyNames();
+
+    InputActionMap *map = new InputActionMap;
+    int line = 0;
+    if (!map->Load(path, &m_KeyNames, &line))
+    {
+        char message[64];
+        sprintf(message, "DX8InputManager: Cannot load the action map (line %d)", line);
+        ::OutputDebugStringA(message);
+        delete map;
+        return FALSE;
     }
 
+    SetActionTable(map->Compile());
+    delete map;
     return TRUE;
 }
 
-CKDWORD DX8InputManager::GetKeyboardRepeatDelay()
+void DX8InputManager::SetActionTable(InputActionTable *table)
 {
-    return m_KeyboardRepeatDelay;
+    InputMutexLock lock(m_ActionsLock);
+    if (m_PendingActions != table)
+        delete m_PendingActions;
+    m_PendingActions = table;
+    InputAtomicStore(&m_ActionsPending, 1);
 }
 
-void DX8InputManager::SetKeyboardRepeatDelay(CKDWORD delay)
+void DX8InputManager::SwapActionTable()
 {
-    m_KeyboardRepeatDelay = delay;
+    InputActionTable *table;
+    {
+        InputMutexLock lock(m_ActionsLock);
+        table = m_PendingActions;
+        m_PendingActions = NULL;
+        InputAtomicStore(&m_ActionsPending, 0);
+    }
+
+    if (table == m_Actions)
+        return;
+    if (table && m_Actions)
+        table->Adopt(*m_Actions);
+    delete m_Actions;
+    m_Actions = table;
 }
 
-CKDWORD DX8InputManager::GetKeyboardRepeatInterval()
+const InputActionTable *DX8InputManager::GetActionTable()
 {
-    return m_KeyboardRepeatInterval;
+    return m_Actions;
 }
 
-void DX8InputManager::SetKeyboardRepeatInterval(CKDWORD interval)
+int DX8InputManager::GetActionHandle(CKSTRING name)
 {
-    m_KeyboardRepeatInterval = interval;
+    return m_Actions ? m_Actions->Find(name) : -1;
 }
 
-int DX8InputManager::GetMouseWheelDelta()
+CKBOOL DX8InputManager::IsActionDown(int handle)
 {
-    return m_Mouse.m_State.lZ;
+    return m_Actions && (m_Actions->GetState(handle) & INPUT_ACTION_DOWN) != 0;
 }
 
-int DX8InputManager::GetMouseWheelPosition()
+CKBOOL DX8InputManager::IsActionPressed(int handle)
 {
-    return m_Mouse.m_WheelPosition;
+    return m_Actions && (m_Actions->GetState(handle) & INPUT_ACTION_PRESSED) != 0;
 }
 
-void DX8InputManager::SetKeyDown(CKDWORD iKey)
+CKBOOL DX8InputManager::IsActionReleased(int handle)
 {
-    if (iKey < KEYBOARD_BUFFER_SIZE)
-    {
-        m_KeyboardState[iKey] |= KS_PRESSED;
-        m_KeyboardStamps[iKey] = ::GetTickCount();
-    }
+    return m_Actions && (m_Actions->GetState(handle) & INPUT_ACTION_RELEASED) != 0;
 }
 
-void DX8InputManager::SetKeyUp(CKDWORD iKey)
+float DX8InputManager::GetActionValue(int handle)
 {
-    if (iKey < KEYBOARD_BUFFER_SIZE)
-    {
-        m_KeyboardState[iKey] |= KS_RELEASED;
-        m_KeyboardStamps[iKey] = ::GetTickCount();
-    }
+    return m_Actions ? m_Actions->GetValue(handle) : 0.0f;
 }
 
-void DX8InputManager::SetMultipleKeys(const CKDWORD *keys, int count, CKBOOL pressed)
+int DX8InputManager::GetActionCount()
 {
-    if (!keys)
-        return;
+    return m_Actions ? m_Actions->GetActionCount() : 0;
+}
 
-    for (int i = 0; i < count; i++)
-    {
-        CKDWORD key = keys[i];
-        if (key < KEYBOARD_BUFFER_SIZE)
-        {
-            if (pressed)
-            {
-                m_KeyboardState[key] |= KS_PRESSED;
-                m_KeyboardStamps[key] = ::GetTickCount();
-            }
-            else
-            {
-                m_KeyboardState[key] |= KS_RELEASED;
-                m_KeyboardStamps[key] = ::GetTickCount();
-            }
-        }
-    }
+const CKBYTE *DX8InputManager::GetActionStates()
+{
+    return m_Actions ? m_Actions->GetStates() : NULL;
 }
 
-void DX8InputManager::SetMouseButtonDown(CK_MOUSEBUTTON iButton)
+const float *DX8InputManager::GetActionValues()
 {
-    if (iButton < 4)
-    {
-        m_Mouse.m_State.rgbButtons[iButton] |= KS_PRESSED;
-    }
+    return m_Actions ? m_Actions->GetValues() : NULL;
 }
 
-void DX8InputManager::SetMouseButtonUp(CK_MOUSEBUTTON iButton)
+void DX8InputManager::SetComboRecognizer(InputComboRecognizer *recognizer)
 {
-    if (iButton < 4)
-    {
-        m_Mouse.m_State.rgbButtons[iButton] |= KS_RELEASED;
-    }
+    if (recognizer != m_Combos)
+        delete m_Combos;
+    m_Combos = recognizer;
 }
 
-void DX8InputManager::SetMousePosition(const Vx2DVector &position)
+InputComboRecognizer *DX8InputManager::GetComboRecognizer()
 {
-    m_Mouse.m_Position = position;
-    ::SetCursorPos((int)position.x, (int)position.y);
+    return m_Combos;
 }
 
-void DX8InputManager::SetMouseWheel(int wheelDelta)
+int DX8InputManager::GetComboMatchCount()
 {
-    m_Mouse.m_State.lZ = wheelDelta;
-    m_Mouse.m_WheelPosition += wheelDelta;
+    return m_Combos ? m_Combos->GetMatchCount() : 0;
 }
 
-void DX8InputManager::SetMouseWheelPosition(int position)
+CKBOOL DX8InputManager::GetComboMatch(int i, InputComboMatch *oMatch)
 {
-    int delta = position - m_Mouse.m_WheelPosition;
-    m_Mouse.m_State.lZ = delta;
-    m_Mouse.m_WheelPosition = position;
+    const InputComboMatch *match = m_Combos ? m_Combos->GetMatch(i) : NULL;
+    if (!match || !oMatch)
+        return FALSE;
+    *oMatch = *match;
+    return TRUE;
 }
 
-void DX8InputManager::SetJoystickButtonDown(int iJoystick, int iButton)
+CKBOOL DX8InputManager::IsComboMatched(int pattern)
 {
-    if (iJoystick >= 0 && iJoystick < m_JoystickCount && iButton >= 0 && iButton < 32)
-    {
-        m_Joysticks[iJoystick].m_Buttons |= (1 << iButton);
-        m_Joysticks[iJoystick].m_Polled = TRUE;
-    }
+    return m_Combos && m_Combos->IsMatched(pattern);
 }
 
-void DX8InputManager::SetJoystickButtonUp(int iJoystick, int iButton)
+void DX8InputManager::EnableInputSnapshots(CKBOOL iEnable)
 {
-    if (iJoystick >= 0 && iJoystick < m_JoystickCount && iButton >= 0 && iButton < 32)
+    if (iEnable && !m_Snapshots)
+        m_Snapshots = new InputSnapshotBuffer;
+    else if (!iEnable && m_Snapshots)
     {
-        m_Joysticks[iJoystick].m_Buttons &= ~(1 << iButton);
-        m_Joysticks[iJoystick].m_Polled = TRUE;
+        delete m_Snapshots;
+        m_Snapshots = NULL;
     }
 }
 
-void DX8InputManager::SetJoystickPosition(int iJoystick, const VxVector &position)
+CKBOOL DX8InputManager::EnableEagerJoystickPolling(CKBOOL iEnable, int workers)
 {
-    if (iJoystick >= 0 && iJoystick < m_JoystickCount)
+    if (!iEnable)
     {
-        m_Joysticks[iJoystick].m_Position = position;
-        m_Joysticks[iJoystick].m_Polled = TRUE;
+        delete m_JoystickPoller;
+        m_JoystickPoller = NULL;
+        return TRUE;
     }
-}
 
-void DX8InputManager::SetJoystickRotation(int iJoystick, const VxVector &rotation)
-{
-    if (iJoystick >= 0 && iJoystick < m_JoystickCount)
+    if (!m_JoystickPoller)
+        m_JoystickPoller = new InputJoystickPoller;
+    if (!m_JoystickPoller->Start(workers))
     {
-        m_Joysticks[iJoystick].m_Rotation = rotation;
-        m_Joysticks[iJoystick].m_Polled = TRUE;
+        ::OutputDebugString(TEXT("DX8InputManager::EnableEagerJoystickPolling: Failed to start the poll workers"));
+        m_JoystickPoller->Start(0);
+        return FALSE;
     }
+    return TRUE;
 }
 
-void DX8InputManager::SetJoystickSliders(int iJoystick, const Vx2DVector &sliders)
+CKBOOL DX8InputManager::IsEagerJoystickPollingEnabled()
 {
-    if (iJoystick >= 0 && iJoystick < m_JoystickCount)
-    {
-        m_Joysticks[iJoystick].m_Sliders = sliders;
-        m_Joysticks[iJoystick].m_Polled = TRUE;
-    }
+    return m_JoystickPoller != NULL;
 }
 
-void DX8InputManager::SetJoystickPOV(int iJoystick, float angle)
+float DX8InputManager::GetJoystickPollTime(int iJoystick)
 {
-    if (iJoystick >= 0 && iJoystick < m_JoystickCount)
+    if (iJoystick < 0 || iJoystick >= m_JoystickCount)
+        return 0.0f;
+    return InputFrameStats::TicksToMicroseconds(m_Joysticks[iJoystick].GetPollTicks());
+}
+
+void DX8InputManager::EnableJoystickHotPlug(CKBOOL iEnable, CKDWORD intervalMs)
+{
+    m_JoystickHotPlug = iEnable;
+    if (!iEnable)
     {
-        // Convert angle from radians to the format expected by DirectInput (degrees * 100)
-        // -1.0f is a special value indicating POV is not pressed/centered
-        if (angle < 0.0f)
-        {
-            m_Joysticks[iJoystick].m_PointOfViewAngle = -1;
-        }
+        // A startup in progress still needs the watcher for its first scan
+        if (m_JoystickStartupPending)
+            m_JoystickWatcher->SetInterval(0);
         else
         {
-            // Convert radians to degrees * 100 (DirectInput format)
-            float degrees = angle * 180.0f / PI;
-            m_Joysticks[iJoystick].m_PointOfViewAngle = (CKDWORD)(degrees * 100.0f);
+            delete m_JoystickWatcher;
+            m_JoystickWatcher = NULL;
         }
-        m_Joysticks[iJoystick].m_Polled = TRUE;
+        return;
     }
-}
 
-void DX8InputManager::SetKeyboardState(const CKBYTE *states, const int *stamps)
-{
-    if (states)
-    {
-        memcpy(m_KeyboardState, states, sizeof(m_KeyboardState));
-        if (stamps)
-            memcpy(m_KeyboardStamps, stamps, sizeof(m_KeyboardStamps));
-    }
+    if (!m_JoystickWatcher)
+        m_JoystickWatcher = new InputJoystickWatcher;
+    m_JoystickWatcher->SetInterval(intervalMs);
+    if (!m_JoystickWatcher->IsRunning())
+        StartJoystickWatcher();
 }
 
-void DX8InputManager::SetMouseState(const Vx2DVector &pos, const CKBYTE *buttons, const VxVector &delta)
+CKBOOL DX8InputManager::IsJoystickHotPlugEnabled()
 {
-    m_Mouse.m_Position = pos;
-    if (buttons)
-        memcpy(m_Mouse.m_State.rgbButtons, buttons, 4);
-    m_Mouse.m_State.lX = (long)delta.x;
-    m_Mouse.m_State.lY = (long)delta.y;
-    m_Mouse.m_State.lZ = (long)delta.z;
+    return m_JoystickHotPlug;
 }
 
-void DX8InputManager::SetJoystickState(int iJoystick, const VxVector &pos, const VxVector &rot, const Vx2DVector &sliders, CKDWORD buttons, CKDWORD pov)
+void DX8InputManager::RescanJoysticks()
 {
-    if (iJoystick >= 0 && iJoystick < m_JoystickCount)
-    {
-        m_Joysticks[iJoystick].m_Position = pos;
-        m_Joysticks[iJoystick].m_Rotation = rot;
-        m_Joysticks[iJoystick].m_Sliders = sliders;
-        m_Joysticks[iJoystick].m_Buttons = buttons;
-        m_Joysticks[iJoystick].m_PointOfViewAngle = (pov == 0xFFFFFFFF) ? -1 : (LONG)pov;
-        m_Joysticks[iJoystick].m_Polled = TRUE;
-    }
+    if (m_JoystickWatcher)
+        m_JoystickWatcher->Rescan();
 }
 
-void DX8InputManager::ClearKeyboardState()
+CKBOOL DX8InputManager::IsJoystickDetached(int iJoystick)
 {
-    memset(m_KeyboardState, 0, sizeof(m_KeyboardState));
-    memset(m_KeyboardStamps, 0, sizeof(m_KeyboardStamps));
+    return 0 <= iJoystick && iJoystick < m_JoystickCount && m_Joysticks[iJoystick].IsDetached();
 }
 
-void DX8InputManager::ClearMouseState()
+CKBOOL DX8InputManager::IsJoystickStartupPending()
 {
-    m_Mouse.Clear();
+    return m_JoystickStartupPending;
 }
 
-void DX8InputManager::ClearJoystickState(int joystickIndex)
+void DX8InputManager::StartJoystickWatcher()
 {
-    if (joystickIndex >= 0 && joystickIndex < m_JoystickCount)
-    {
-        // Clear specific joystick
-        m_Joysticks[joystickIndex].m_Buttons = 0;
-        m_Joysticks[joystickIndex].m_Position.Set(0, 0, 0);
-        m_Joysticks[joystickIndex].m_Rotation.Set(0, 0, 0);
-        m_Joysticks[joystickIndex].m_Sliders.Set(0, 0);
-        m_Joysticks[joystickIndex].m_PointOfViewAngle = -1;
-    }
-    else
+    // The journal backends are not safe to enumerate from another thread
+    if (!m_JoystickWatcher || !m_Joysticks || m_Recorder || m_Replay)
+        return;
+    if (!m_JoystickHotPlug && !m_JoystickStartupPending)
+        return;
+    if (!m_Keyboard.IsAttached() && !m_Mouse.IsAttached() && m_JoystickCount == 0 && !m_JoystickStartupPending)
+        return;
+
+    HWND hWnd = (HWND)m_Context->GetMainWindow();
+    if (!m_JoystickWatcher->Start(m_Backend, hWnd, m_Joysticks, m_JoystickCount, m_MaxJoysticks, m_JoystickStartupPending))
     {
-        // Clear all joysticks
-        for (int i = 0; i < m_JoystickCount; i++)
+        ::OutputDebugString(TEXT("DX8InputManager::StartJoystickWatcher: Failed to start the watcher thread"));
+        if (m_JoystickStartupPending)
         {
-            m_Joysticks[i].m_Buttons = 0;
-            m_Joysticks[i].m_Position.Set(0, 0, 0);
-            m_Joysticks[i].m_Rotation.Set(0, 0, 0);
-            m_Joysticks[i].m_Sliders.Set(0, 0);
-            m_Joysticks[i].m_PointOfViewAngle = -1;
+            m_JoystickStartupPending = FALSE;
+            OpenJoysticks(hWnd);
         }
     }
 }
 
-void DX8InputManager::ClearInputState()
+CKBOOL DX8InputManager::IsInputSnapshotsEnabled()
 {
-    ClearKeyboardState();
-    ClearMouseState();
-    ClearJoystickState();
+    return m_Snapshots != NULL;
+}
+
+InputSnapshotBuffer *DX8InputManager::GetInputSnapshots()
+{
+    return m_Snapshots;
 }
 
 CKERROR DX8InputManager::OnCKInit()
 {
-    if (!m_Keyboard)
+    if (!m_Keyboard.IsAttached())
         Initialize((HWND)m_Context->GetMainWindow());
+    UpdateKeyNames();
     return CK_OK;
 }
 
@@ -848,6 +2078,7 @@ CKERROR DX8InputManager::OnCKEnd()
 CKERROR DX8InputManager::OnCKReset()
 {
     m_ShowCursor = TRUE;
+    InvalidateWindowGeometry();
     ClearBuffers();
     return CK_OK;
 }
@@ -862,11 +2093,11 @@ CKERROR DX8InputManager::OnCKPause()
 CKERROR DX8InputManager::OnCKPlay()
 {
     HWND hWnd = (HWND)m_Context->GetMainWindow();
-    if (m_Keyboard)
+    if (m_Keyboard.m_Device)
     {
-        m_Keyboard->Unacquire();
-        m_Keyboard->SetCooperativeLevel(hWnd, DISCL_NONEXCLUSIVE | DISCL_BACKGROUND);
-        m_Keyboard->Acquire();
+        m_Keyboard.m_Device->Unacquire();
+        m_Keyboard.m_Device->SetCooperativeLevel(hWnd, DISCL_NONEXCLUSIVE | DISCL_BACKGROUND);
+        m_Keyboard.m_Device->Acquire();
     }
     if (m_Mouse.m_Device)
     {
@@ -883,24 +2114,12 @@ CKERROR DX8InputManager::OnCKPlay()
             m_Joysticks[i].m_Device->Acquire();
         }
     }
+    if (m_JoystickWatcher)
+        m_JoystickWatcher->SetWindow(hWnd);
 
     m_Mouse.Poll(m_Paused);
 
-    memset(m_KeyboardState, 0, sizeof(m_KeyboardState));
-    if (m_Keyboard)
-    {
-        m_NumberOfKeyInBuffer = KEYBOARD_BUFFER_SIZE;
-        HRESULT hr;
-        do
-        {
-            hr = m_Keyboard->GetDeviceData(sizeof(DIDEVICEOBJECTDATA), m_KeyInBuffer, (LPDWORD)&m_NumberOfKeyInBuffer, 0);
-            if (hr == DIERR_INPUTLOST || hr == DIERR_NOTACQUIRED)
-            {
-                m_Keyboard->Acquire();
-                hr = m_Keyboard->GetDeviceData(sizeof(DIDEVICEOBJECTDATA), m_KeyInBuffer, (LPDWORD)&m_NumberOfKeyInBuffer, 0);
-            }
-        } while (hr == DI_NOTATTACHED);
-    }
+    m_Keyboard.Flush();
 
     if (!m_ShowCursor)
         EnsureCursorVisible(FALSE);
@@ -910,80 +2129,25 @@ CKERROR DX8InputManager::OnCKPlay()
 
 CKERROR DX8InputManager::PreProcess()
 {
-    if (m_Keyboard)
-    {
-        m_NumberOfKeyInBuffer = KEYBOARD_BUFFER_SIZE;
-        HRESULT hr = m_Keyboard->GetDeviceData(sizeof(DIDEVICEOBJECTDATA), m_KeyInBuffer, (LPDWORD)&m_NumberOfKeyInBuffer, 0);
-        if (hr == DIERR_INPUTLOST || hr == DIERR_NOTACQUIRED)
-        {
-            m_Keyboard->Acquire();
-            hr = m_Keyboard->GetDeviceData(sizeof(DIDEVICEOBJECTDATA), m_KeyInBuffer, (LPDWORD)&m_NumberOfKeyInBuffer, 0);
-        }
+    if (m_FrameStats)
+        m_FrameStats->BeginFrame();
+    InputStageTimer timer(m_FrameStats, INPUT_STAGE_PREPROCESS);
 
-        if (!m_Paused)
-        {
-            if (hr <= DI_NOTATTACHED)
-            {
-                CKDWORD iKey;
-                for (int i = 0; i < m_NumberOfKeyInBuffer; i++)
-                {
-                    iKey = m_KeyInBuffer[i].dwOfs;
-                    if (iKey < KEYBOARD_BUFFER_SIZE)
-                    {
-                        if ((m_KeyInBuffer[i].dwData & 0x80) != 0)
-                        {
-                            m_KeyboardState[iKey] |= KS_PRESSED;
-                            m_KeyboardStamps[iKey] = m_KeyInBuffer[i].dwTimeStamp;
-                        }
-                        else
-                        {
-                            m_KeyboardState[iKey] |= KS_RELEASED;
-                            m_KeyboardStamps[iKey] = m_KeyInBuffer[i].dwTimeStamp - m_KeyboardStamps[iKey];
-                        }
-                    }
-                }
-            }
+    if (m_Recorder)
+        m_Recorder->BeginFrame();
+    if (m_Replay)
+        m_Replay->BeginFrame();
 
-            // Keyboard repetition: generates synthetic key events for held keys
-            // Uses timestamp negation to track repetition state:
-            // - Positive timestamp: Initial press, waiting for repeat delay
-            // - Negative timestamp: Actively repeating at repeat interval
-            if (m_EnableKeyboardRepetition)
-            {
-                for (int i = 0; i < KEYBOARD_BUFFER_SIZE; i++)
-                {
-                    if (m_KeyboardState[i] == KS_PRESSED)
-                    {
-                        if (m_KeyboardStamps[i] > 0 && ::GetTickCount() - m_KeyboardStamps[i] > m_KeyboardRepeatDelay)
-                            m_KeyboardStamps[i] = -m_KeyboardStamps[i];
-                        if (m_KeyboardStamps[i] < 0)
-                        {
-                            for (int t = m_KeyboardStamps[i] - m_KeyboardRepeatDelay + ::GetTickCount(); t > (int)m_KeyboardRepeatInterval;)
-                            {
-                                t -= m_KeyboardRepeatInterval;
-                                m_KeyboardStamps[i] -= m_KeyboardRepeatInterval;
-                                if (m_NumberOfKeyInBuffer < KEYBOARD_BUFFER_SIZE)
-                                {
-                                    m_KeyInBuffer[m_NumberOfKeyInBuffer].dwData = 0x80;
-                                    m_KeyInBuffer[m_NumberOfKeyInBuffer].dwOfs = i;
-                                    m_KeyInBuffer[m_NumberOfKeyInBuffer].dwTimeStamp = -m_KeyboardStamps[i];
-                                    ++m_NumberOfKeyInBuffer;
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-        }
-        else
+    if (m_Keyboard.IsAttached())
+    {
+        m_Keyboard.Poll(m_Paused);
+
+        if (m_Paused)
         {
             // Only clear buffers when transitioning to pause state, not every frame
             if (!m_WasPaused)
             {
-                memset(m_KeyInBuffer, 0, sizeof(m_KeyInBuffer));
-                memset(m_KeyboardStamps, 0, sizeof(m_KeyboardStamps));
-                memset(m_KeyboardState, 0, sizeof(m_KeyboardState));
-                m_NumberOfKeyInBuffer = 0;
+                m_Keyboard.Reset();
                 m_WasPaused = TRUE;
             }
         }
@@ -995,44 +2159,157 @@ CKERROR DX8InputManager::PreProcess()
     }
 
     m_Mouse.Poll(m_Paused);
+    UpdateWindowGeometry();
 
     for (int i = 0; i < m_JoystickCount; i++)
-        m_Joysticks[i].m_Polled = FALSE;
+        m_Joysticks[i].BeginFrame();
+
+    // Controllers plugged or unplugged since the last frame take their slots before the
+    // polls; the buttons an unplugged one held read as released during this frame
+    if (m_JoystickWatcher && m_JoystickWatcher->HasChanges())
+    {
+        m_JoystickWatcher->ApplyChanges(m_Joysticks, &m_JoystickCount);
+        for (int i = 0; i < m_JoystickCount; i++)
+            m_Joysticks[i].SetFrameStats(m_FrameStats);
+    }
+    // The scan count is read first: a finished scan has published all of its changes
+    if (m_JoystickStartupPending && m_JoystickWatcher->GetScanCount() > 0 && !m_JoystickWatcher->HasChanges())
+    {
+        m_JoystickStartupPending = FALSE;
+        if (!m_JoystickHotPlug)
+        {
+            delete m_JoystickWatcher;
+            m_JoystickWatcher = NULL;
+        }
+    }
+    // The journal backends must see the polls from one thread, in a fixed order
+    if (m_JoystickPoller)
+        m_JoystickPoller->PollAll(m_Joysticks, m_JoystickCount, !m_Recorder && !m_Replay);
+
+    if (m_Latency)
+        m_LatencyPending = (1u << (CK_LATENCY_JOYSTICK + m_JoystickCount)) - 1;
+
+    // Injections recorded after the polls apply before the behaviors run
+    if (m_Replay)
+        m_Replay->DispatchInjections();
+
+    // The filter sees the injected motion too, and starts over after a pause
+    if (m_MouseFilter)
+    {
+        if (m_Paused)
+        {
+            m_MouseFilter->Reset();
+        }
+        else
+        {
+            float motion[2] = {(float)m_Mouse.m_State.lX, (float)m_Mouse.m_State.lY};
+            m_MouseFilter->Apply(motion, m_Mouse.GetTime(), m_FilteredMotion);
+        }
+    }
+
+    // Actions see the injected state too
+    if (InputAtomicLoad(&m_ActionsPending))
+        SwapActionTable();
+    if (m_Actions)
+    {
+        InputStageTimer actionTimer(m_FrameStats, INPUT_STAGE_ACTIONS);
+        actionTimer.SetEvents(m_Actions->Evaluate(m_Keyboard, m_Mouse, m_Joysticks, m_JoystickCount));
+    }
+    if (m_Combos)
+    {
+        InputStageTimer comboTimer(m_FrameStats, INPUT_STAGE_COMBOS);
+        comboTimer.SetEvents(m_Combos->Process(m_Keyboard, m_Mouse, m_Joysticks, m_JoystickCount));
+    }
+    if (m_Snapshots)
+    {
+        InputStageTimer snapshotTimer(m_FrameStats, INPUT_STAGE_SNAPSHOT);
+        // Skipped while readers hold every other slot, see InputSnapshotBuffer::GetSkippedCount
+        BOOL published = m_Snapshots->Publish(m_Keyboard, m_Mouse, m_Joysticks, m_JoystickCount, m_Backend ? m_Backend->GetTime() : 0);
+        snapshotTimer.SetEvents(published ? 1 : 0);
+    }
 
+    timer.SetEvents(m_Keyboard.GetEventCount() + m_Mouse.m_NumberOfBuffer);
     return CK_OK;
 }
 
 CKERROR DX8InputManager::PostProcess()
 {
-    for (int iKey = 0; iKey < KEYBOARD_BUFFER_SIZE; iKey++)
     {
-        if ((m_KeyboardState[iKey] & KS_RELEASED) != 0)
-            m_KeyboardState[iKey] = KS_IDLE;
-    }
+        InputStageTimer timer(m_FrameStats, INPUT_STAGE_POSTPROCESS);
 
-    for (int iButton = 0; iButton < 4; iButton++)
-    {
-        if ((m_Mouse.m_State.rgbButtons[iButton] & KS_RELEASED) != 0)
-            m_Mouse.m_State.rgbButtons[iButton] = KS_IDLE;
+        if (m_Recorder)
+            m_Recorder->EndFrame();
+        if (m_Replay)
+            m_Replay->EndFrame();
+
+        m_Keyboard.PostProcess();
+        m_Mouse.PostProcess();
     }
 
+    if (m_FrameStats && m_FrameStatsDumpInterval > 0 && m_FrameStats->GetFrameCount() % m_FrameStatsDumpInterval == 0)
+        DumpFrameStats();
+
     return CK_OK;
 }
 
 DX8InputManager::~DX8InputManager()
 {
-    // Ensure DirectInput resources are released even if OnCKEnd was not called
+    // Ensure device resources are released even if OnCKEnd was not called
     Uninitialize();
 
     delete[] m_Joysticks;
     m_Joysticks = NULL;
     m_JoystickCount = 0;
+
+    if (m_Backend)
+    {
+        m_Backend->Release();
+        m_Backend = NULL;
+    }
+    m_Recorder = NULL;
+    m_Replay = NULL;
+    m_Threaded = NULL;
+
+    if (m_LiveBackend)
+    {
+        m_LiveBackend->Release();
+        m_LiveBackend = NULL;
+    }
+
+    delete[] m_Latency;
+    m_Latency = NULL;
+
+    delete m_FrameStats;
+    m_FrameStats = NULL;
+
+    delete m_Actions;
+    m_Actions = NULL;
+    delete m_PendingActions;
+    m_PendingActions = NULL;
+
+    delete m_Combos;
+    m_Combos = NULL;
+
+    delete m_Snapshots;
+    m_Snapshots = NULL;
+
+    delete m_JoystickPoller;
+    m_JoystickPoller = NULL;
+
+    delete m_JoystickWatcher;
+    m_JoystickWatcher = NULL;
+
+    m_Mouse.SetMotionHistory(NULL);
+    delete m_MotionHistory;
+    m_MotionHistory = NULL;
+
+    delete m_MouseFilter;
+    m_MouseFilter = NULL;
 }
 
-DX8InputManager::DX8InputManager(CKContext *context) : CKInputManager(context, "DirectX Input Manager")
+DX8InputManager::DX8InputManager(CKContext *context, CKBOOL iDeferredStartup) : CKInputManager(context, "DirectX Input Manager")
 {
-    m_DirectInput = NULL;
-    m_Keyboard = NULL;
+    m_Backend = new DI8InputBackend;
     m_Joysticks = NULL;
     m_JoystickCount = 0;
     m_MaxJoysticks = 4;
@@ -1041,17 +2318,45 @@ DX8InputManager::DX8InputManager(CKContext *context) : CKInputManager(context, "
     DWORD keyboardSpeed;
     ::SystemParametersInfo(SPI_GETKEYBOARDDELAY, 0, &keyboardDelay, 0);
     ::SystemParametersInfo(SPI_GETKEYBOARDSPEED, 0, &keyboardSpeed, 0);
-    m_KeyboardRepeatDelay = 50 * (5 * keyboardDelay + 5);
-    m_KeyboardRepeatInterval = (CKDWORD)(1000.0 / (keyboardSpeed + 2.5));
+    m_Keyboard.m_RepeatDelay = 50 * (5 * keyboardDelay + 5);
+    m_Keyboard.m_RepeatInterval = (CKDWORD)(1000.0 / (keyboardSpeed + 2.5));
     m_Paused = FALSE;
     m_WasPaused = FALSE;
-    m_EnableKeyboardRepetition = FALSE;
-
-    Initialize((HWND)m_Context->GetMainWindow());
+    m_KeyboardLayout = NULL;
+    m_Recorder = NULL;
+    m_Replay = NULL;
+    m_LiveBackend = NULL;
+    m_ReplayingInjection = FALSE;
+    m_Threaded = NULL;
+    m_InputThreadPollInterval = THREADED_POLL_INTERVAL;
+    m_Actions = NULL;
+    m_PendingActions = NULL;
+    m_ActionsPending = 0;
+    m_Combos = NULL;
+    m_Snapshots = NULL;
+    m_JoystickPoller = NULL;
+    m_JoystickWatcher = NULL;
+    m_JoystickHotPlug = FALSE;
+    m_DeferredStartup = iDeferredStartup;
+    m_JoystickStartupPending = FALSE;
+    m_MotionHistory = NULL;
+    m_MouseBufferSize = MOUSE_BUFFER_SIZE;
+    m_MouseFilter = NULL;
+    m_FilteredMotion[0] = m_FilteredMotion[1] = 0.0f;
+    m_GeometryContext = NULL;
+    m_ClientOrigin[0] = m_ClientOrigin[1] = 0;
+    m_ClientSize[0] = m_ClientSize[1] = 0;
+    m_WindowOrigin[0] = m_WindowOrigin[1] = 0.0f;
+    m_DpiScale = 1.0f;
+    m_Latency = NULL;
+    m_LatencyPending = 0;
+    m_FrameStats = NULL;
+    m_FrameStatsDumpInterval = 0;
+
+    // Deferred, the devices are opened by OnCKInit once every manager is registered
+    if (!m_DeferredStartup)
+        Initialize((HWND)m_Context->GetMainWindow());
 
-    memset(m_KeyboardState, 0, sizeof(m_KeyboardState));
-    memset(m_KeyInBuffer, 0, sizeof(m_KeyInBuffer));
-    m_NumberOfKeyInBuffer = KEYBOARD_BUFFER_SIZE;
     m_ShowCursor = TRUE;
     SetSystemCursor(VXCURSOR_NORMALSELECT);
 
@@ -1071,110 +2376,162 @@ void DX8InputManager::Initialize(HWND hWnd)
         }
     }
 
-    // Register with the DirectInput subsystem and get a pointer
-    // to a IDirectInput interface we can use.
-    // Create a DInput object
-    HRESULT hr = DirectInput8Create(::GetModuleHandle(TEXT("CK2.dll")), DIRECTINPUT_VERSION, IID_IDirectInput8, (void **)&m_DirectInput, NULL);
-    if (!m_DirectInput || FAILED(hr))
+    if (!m_Backend)
+        m_Backend = new DI8InputBackend;
+
+    HRESULT hr = m_Backend->Initialize(hWnd);
+    if (FAILED(hr))
     {
-        ::OutputDebugString(TEXT("DX8InputManager: DirectInput8Create failed"));
+        ::OutputDebugString(TEXT("DX8InputManager: Input backend initialization failed"));
         ::MessageBox(hWnd, TEXT("Cannot Initialize Input Manager"), TEXT("Initialization Error"), MB_OK);
         // Note: Continues execution to allow graceful degradation - methods check device availability
+        return;
     }
 
     // Obtain an interface to the system keyboard device.
-    if (m_DirectInput)
+    InputDevice *keyboard = NULL;
+    hr = m_Backend->CreateKeyboard(KEYBOARD_BUFFER_SIZE, &keyboard);
+    if (FAILED(hr))
     {
-        hr = m_DirectInput->CreateDevice(GUID_SysKeyboard, &m_Keyboard, NULL);
-        if (FAILED(hr))
-        {
-            ::OutputDebugString(TEXT("DX8InputManager: CreateDevice for keyboard failed"));
-        }
-
-        // Obtain an interface to the system mouse device.
-        hr = m_DirectInput->CreateDevice(GUID_SysMouse, &m_Mouse.m_Device, NULL);
-        if (FAILED(hr))
-        {
-            ::OutputDebugString(TEXT("DX8InputManager: CreateDevice for mouse failed"));
-        }
-
-        // Enumerate DirectInput devices (joysticks, gamepads, wheels, flight sticks, etc.)
-        ::OutputDebugString(TEXT("DX8InputManager: Enumerating DirectInput devices"));
-        m_DirectInput->EnumDevices(DI8DEVCLASS_GAMECTRL, JoystickEnum, this, DIEDFL_ATTACHEDONLY);
+        ::OutputDebugString(TEXT("DX8InputManager: CreateDevice for keyboard failed"));
     }
 
-    if (m_Keyboard)
+    // Obtain an interface to the system mouse device.
+    InputDevice *mouse = NULL;
+    hr = m_Backend->CreateMouse(m_MouseBufferSize, &mouse);
+    if (FAILED(hr))
     {
-        // Set the data format to "keyboard format".
-        // This tells DirectInput that we will be passing an array
-        // of 256 bytes to IDirectInputDevice::GetDeviceState.
-        m_Keyboard->SetDataFormat(&c_dfDIKeyboard);
-
-        // Set the cooperative level to let DirectInput know how
-        // this device should interact with the system and with
-        // other DirectInput applications.
-        m_Keyboard->SetCooperativeLevel(hWnd, DISCL_NONEXCLUSIVE | DISCL_BACKGROUND);
+        ::OutputDebugString(TEXT("DX8InputManager: CreateDevice for mouse failed"));
+    }
 
-        // Set the buffer size to 256 to let DirectInput uses
-        // buffered I/O (buffer size = 256).
-        DIPROPDWORD dipdw;
-        dipdw.diph.dwSize = sizeof(DIPROPDWORD);
-        dipdw.diph.dwHeaderSize = sizeof(DIPROPHEADER);
-        dipdw.diph.dwObj = 0;
-        dipdw.diph.dwHow = DIPH_DEVICE;
-        dipdw.dwData = KEYBOARD_BUFFER_SIZE;
-        m_Keyboard->SetProperty(DIPROP_BUFFERSIZE, &dipdw.diph);
+    m_Keyboard.Init(m_Backend, keyboard, hWnd);
+    m_Mouse.Init(m_Backend, mouse, hWnd);
 
-        // Acquire the newly created device.
-        m_Keyboard->Acquire();
+    // Deferred, the joysticks are left to the watcher; a journal needs them opened in order
+    if (m_DeferredStartup && !m_Recorder && !m_Replay && m_MaxJoysticks > 0)
+    {
+        if (!m_JoystickWatcher)
+        {
+            m_JoystickWatcher = new InputJoystickWatcher;
+            m_JoystickWatcher->SetInterval(0);
+        }
+        m_JoystickWatcher->SetOpenThreads(m_MaxJoysticks);
+        m_JoystickStartupPending = TRUE;
+    }
+    else
+    {
+        OpenJoysticks(hWnd);
     }
 
-    m_Mouse.Init(hWnd);
+    StartJoystickWatcher();
+}
+
+void DX8InputManager::OpenJoysticks(HWND hWnd)
+{
+    // Enumerate game controllers (joysticks, gamepads, wheels, flight sticks, etc.)
+    ::OutputDebugString(TEXT("DX8InputManager: Enumerating DirectInput devices"));
+    m_Backend->EnumJoysticks(JoystickEnum, this);
 
     for (int i = 0; i < m_JoystickCount; i++)
+    {
+        m_Joysticks[i].SetFrameStats(m_FrameStats);
         m_Joysticks[i].Init(hWnd);
+    }
 }
 
 void DX8InputManager::Uninitialize()
 {
-    if (m_Keyboard)
-    {
-        // Unacquire the device.
-        m_Keyboard->Unacquire();
-        m_Keyboard->Release();
-        m_Keyboard = NULL;
-    }
+    // The watcher opens devices through the backend, so it stops first
+    if (m_JoystickWatcher)
+        m_JoystickWatcher->Stop();
+    m_JoystickStartupPending = FALSE;
+
+    m_Keyboard.Release();
 
     m_Mouse.Release();
 
     // Only release joysticks that were actually initialized
     for (int i = 0; i < m_JoystickCount; i++)
         m_Joysticks[i].Release();
+    m_JoystickCount = 0;
 
-    if (m_DirectInput)
-    {
-        m_DirectInput->Release();
-        m_DirectInput = NULL;
-    }
+    if (m_Backend)
+        m_Backend->Shutdown();
+}
+
+void DX8InputManager::ReopenMouse()
+{
+    if (!m_Mouse.IsAttached())
+        return;
+
+    m_Mouse.Release();
+    InputDevice *mouse = NULL;
+    if (FAILED(m_Backend->CreateMouse(m_MouseBufferSize, &mouse)))
+        ::OutputDebugString(TEXT("DX8InputManager: CreateDevice for mouse failed"));
+    m_Mouse.Init(m_Backend, mouse, (HWND)m_Context->GetMainWindow());
 }
 
 void DX8InputManager::ClearBuffers()
 {
-    if (m_Keyboard)
-    {
-        HRESULT hr;
-        do
-        {
-            m_NumberOfKeyInBuffer = KEYBOARD_BUFFER_SIZE;
-            hr = m_Keyboard->GetDeviceData(sizeof(DIDEVICEOBJECTDATA), m_KeyInBuffer, (LPDWORD)&m_NumberOfKeyInBuffer, 0);
-            if (hr == DIERR_INPUTLOST || hr == DIERR_NOTACQUIRED)
-            {
-                m_Keyboard->Acquire();
-                hr = m_Keyboard->GetDeviceData(sizeof(DIDEVICEOBJECTDATA), m_KeyInBuffer, (LPDWORD)&m_NumberOfKeyInBuffer, 0);
-            }
-        } while (hr == DI_NOTATTACHED);
-    }
+    InputStageTimer timer(m_FrameStats, INPUT_STAGE_CLEAR_BUFFERS);
+    m_Keyboard.Flush();
     m_Mouse.Clear();
-    memset(m_KeyboardState, 0, sizeof(m_KeyboardState));
 }
 
+void DX8InputManager::SetInputBackend(InputBackend *backend)
+{
+    if (backend == m_Backend)
+        return;
+
+    StopInputJournal();
+    if (backend == m_Backend)
+        return;
+
+    // The input thread goes with the backend it wraps
+    m_Threaded = NULL;
+    InputBackend *previous = ExchangeBackend(backend ? backend : new DI8InputBackend);
+    if (previous)
+        previous->Release();
+}
+
+InputBackend *DX8InputManager::ExchangeBackend(InputBackend *backend)
+{
+    CKBOOL initialized = m_Keyboard.IsAttached() || m_Mouse.IsAttached() || m_JoystickCount > 0;
+    Uninitialize();
+
+    InputBackend *previous = m_Backend;
+    m_Backend = backend;
+
+    if (initialized)
+        Initialize((HWND)m_Context->GetMainWindow());
+    return previous;
+}
+
+static BOOL GetJoystickEnumerationAction(int joystickCount, int maxJoysticks, HRESULT createDeviceResult, BOOL deviceCreated)
+{
+    if (joystickCount >= maxJoysticks)
+        return DIENUM_STOP;
+
+    if (FAILED(createDeviceResult) || !deviceCreated)
+        return DIENUM_CONTINUE;
+
+    return DIENUM_CONTINUE;
+}
+
+BOOL DX8InputManager::JoystickEnum(const InputDeviceInfo *info, void *pContext)
+{
+    DX8InputManager *im = (DX8InputManager *)pContext;
+
+    if (im->m_JoystickCount >= im->m_MaxJoysticks)
+        return DIENUM_STOP;
+
+    InputDevice *pJoystick = NULL;
+    HRESULT hr = im->m_Backend->CreateJoystick(info->InstanceGUID, &pJoystick);
+    if (FAILED(hr) || !pJoystick)
+        return GetJoystickEnumerationAction(im->m_JoystickCount, im->m_MaxJoysticks, hr, FALSE);
+
+    im->m_Joysticks[im->m_JoystickCount].Attach(im->m_Backend, pJoystick, *info);
+
+    ++im->m_JoystickCount;
+    return GetJoystickEnumerationAction(im->m_JoystickCount, im->m_MaxJoysticks, hr, TRUE);
+}
@@ -1,13 +1,23 @@
 #ifndef DX8INPUTMANAGER_H
 #define DX8INPUTMANAGER_H
 
-#define DIRECTINPUT_VERSION 0x800
-#include <dinput.h>
+#include "ActionMap.h"
+#include "ComboRecognizer.h"
+#include "InputDevices.h"
+#include "InputSnapshot.h"
+#include "JoystickPoller.h"
+#include "JoystickWatcher.h"
+#include "JournalBackend.h"
+#include "ThreadedBackend.h"
+#include "KeyNames.h"
+#include "MotionFilter.h"
 
 #include "CKInputManager.h"
 
-#define KEYBOARD_BUFFER_SIZE 256
-#define MOUSE_BUFFER_SIZE 256
+// Non-zero makes the deferred startup the default (see the constructor)
+#ifndef DX8INPUT_DEFERRED_STARTUP
+#define DX8INPUT_DEFERRED_STARTUP 0
+#endif
 
 // Joystick axis enumeration for configuration methods
 enum CK_JOYSTICK_AXIS
@@ -51,92 +61,76 @@ inline CKBOOL HasJoystickSlider0(CKDWORD caps) { return (caps & CK_JOYSTICK_HAS_
 inline CKBOOL HasJoystickSlider1(CKDWORD caps) { return (caps & CK_JOYSTICK_HAS_SLIDER1) != 0; }
 inline CKBOOL HasJoystickPOV(CKDWORD caps) { return (caps & CK_JOYSTICK_HAS_POV) != 0; }
 
+// Sources and stages of the input latency statistics
+enum CK_INPUT_LATENCY_SOURCE
+{
+    CK_LATENCY_KEYBOARD = 0,
+    CK_LATENCY_MOUSE = 1,
+    CK_LATENCY_JOYSTICK = 2,
+    CK_LATENCY_SOURCE_COUNT = 3
+};
+
+enum CK_INPUT_LATENCY_STAGE
+{
+    CK_LATENCY_INGEST = 0,  // Event timestamp to the PreProcess that reads the event (keyboard and mouse)
+    CK_LATENCY_CONSUME = 1, // Event timestamp, or sample time of polled state, to the first query of the frame
+    CK_LATENCY_STAGE_COUNT = 2
+};
+
+// Helpers for the keyboard masks (KEYMASK_WORDS words, bit n of the mask is scancode n)
+inline CKBOOL IsKeyInMask(const CKDWORD *mask, CKDWORD iKey) { return iKey < KEYBOARD_BUFFER_SIZE && (mask[iKey >> 5] & (1u << (iKey & 31))) != 0; }
+inline CKBOOL AnyKeyInMask(const CKDWORD *mask, const CKDWORD *keys) // True if mask & keys is non-zero
+{
+    CKDWORD any = 0;
+    for (int i = 0; i < KEYMASK_WORDS; i++)
+        any |= mask[i] & keys[i];
+    return any != 0;
+}
+
+// Mouse state of the frame, filled in one call by DX8InputManager::GetMouseState
+struct CKInputMouseState
+{
+    Vx2DVector Position; // Screen coordinates
+    VxVector Motion;     // Relative motion of the frame, wheel delta in z
+    VxVector FilteredMotion; // Motion through the mouse filter, the raw motion without one
+    CKBYTE Buttons[4];   // KS_PRESSED and KS_RELEASED bits per button
+    CKDWORD Clicked;     // Bit per button pressed this frame
+    int WheelPosition;
+    CKBOOL Attached;
+    InputTime Time; // When position and motion were sampled
+};
+
+// Cursor position in every coordinate space, filled in one call by DX8InputManager::GetMouseCoordinates
+struct CKMouseCoordinates
+{
+    Vx2DVector Screen;
+    Vx2DVector Window;    // Relative to the window rectangle of the player render context
+    Vx2DVector Client;    // Client area of the render context, clamped to its size
+    Vx2DVector Scaled;    // Client, in 96 DPI units
+    float DpiScale;       // Window DPI over 96
+};
+
+// Joystick state of the frame, filled in one call by DX8InputManager::GetJoystickState
+struct CKInputJoystickState
+{
+    VxVector Position;
+    VxVector Rotation;
+    Vx2DVector Sliders;
+    float PointOfViewAngle; // Radians, -1 when centered
+    CKDWORD Buttons;        // Buttons 0 to 31
+    CKDWORD ButtonMask[JOYSTICK_BUTTON_WORDS]; // All buttons, see DX8InputManager::GetJoystickButtonsMask
+    CKDWORD Pressed[JOYSTICK_BUTTON_WORDS];
+    CKDWORD Released[JOYSTICK_BUTTON_WORDS];
+    CKBOOL Attached;
+    InputTime Time; // When the state was read
+};
+
 class DX8InputManager : public CKInputManager
 {
 public:
-    class CKMouse
-    {
-        friend DX8InputManager;
-
-    public:
-        CKMouse();
-        void Init(HWND hWnd);
-        void Release();
-        void Clear();
-        void Poll(CKBOOL pause);
-
-    private:
-        LPDIRECTINPUTDEVICE8 m_Device;
-        Vx2DVector m_Position;
-        DIMOUSESTATE m_State;
-        CKBYTE m_LastButtons[4];
-        DIDEVICEOBJECTDATA m_Buffer[MOUSE_BUFFER_SIZE];
-        int m_NumberOfBuffer;
-        int m_WheelPosition;
-    };
-
-    class CKJoystick
-    {
-        friend DX8InputManager;
-
-    public:
-        CKJoystick();
-        void Init(HWND hWnd);
-        void Release();
-        void Poll();
-        void GetInfo();
-        CKBOOL IsAttached();
-
-    private:
-        void ResetState();
-
-        // Axis capability flags
-        struct AxisCapabilities
-        {
-            CKBOOL hasX, hasY, hasZ;
-            CKBOOL hasRx, hasRy, hasRz;
-            CKBOOL hasSlider0, hasSlider1;
-
-            AxisCapabilities()
-            {
-                hasX = hasY = hasZ = FALSE;
-                hasRx = hasRy = hasRz = FALSE;
-                hasSlider0 = hasSlider1 = FALSE;
-            }
-        };
-
-        static BOOL CALLBACK EnumAxesCallback(LPCDIDEVICEOBJECTINSTANCE lpddoi, LPVOID pvRef);
-
-        LPDIRECTINPUTDEVICE8 m_Device;
-        GUID m_DeviceGUID;           // Device instance GUID
-        char m_DeviceName[MAX_PATH]; // Device product name
-        AxisCapabilities m_AxisCaps; // Track which axes are available on this device
-        float m_DeadzoneRadius;      // Deadzone radius (0.0 to 1.0, default 0.01)
-        float m_Gain;                // Sensitivity gain multiplier (0.0 to 2.0, default 1.0)
-        int m_ButtonCount;           // Number of buttons on this device
-        CKDWORD m_Polled;
-        VxVector m_Position;
-        VxVector m_Rotation;
-        Vx2DVector m_Sliders;
-        CKDWORD m_PointOfViewAngle;
-        CKDWORD m_Buttons;
-        LONG m_Xmin;  // Minimum X-coordinate
-        LONG m_Xmax;  // Maximum X-coordinate
-        LONG m_Ymin;  // Minimum Y-coordinate
-        LONG m_Ymax;  // Maximum Y-coordinate
-        LONG m_Zmin;  // Minimum Z-coordinate
-        LONG m_Zmax;  // Maximum Z-coordinate
-        LONG m_XRmin; // Minimum X-rotation
-        LONG m_XRmax; // Maximum X-rotation
-        LONG m_YRmin; // Minimum Y-rotation
-        LONG m_YRmax; // Maximum Y-rotation
-        LONG m_ZRmin; // Minimum Z-rotation
-        LONG m_ZRmax; // Maximum Z-rotation
-        LONG m_Umin;  // Minimum u-coordinate (fifth axis)
-        LONG m_Vmin;  // Minimum v-coordinate (sixth axis)
-        LONG m_Umax;  // Maximum u-coordinate (fifth axis)
-        LONG m_Vmax;  // Maximum v-coordinate (sixth axis)
-    };
+    typedef InputKeyboard CKKeyboard;
+    typedef InputMouse CKMouse;
+    typedef InputJoystick CKJoystick;
 
     virtual void EnableKeyboardRepetition(CKBOOL iEnable = TRUE);
     virtual CKBOOL IsKeyboardRepetitionEnabled();
@@ -147,12 +141,49 @@ public:
 
     virtual int GetKeyName(CKDWORD iKey, char *oKeyName);
     virtual CKDWORD GetKeyFromName(CKSTRING iKeyName);
-    virtual unsigned char *GetKeyboardState();
+    virtual unsigned char *GetKeyboardState(); // Writes are synced into the keyboard masks at the next PostProcess
 
     virtual CKBOOL IsKeyboardAttached();
 
+    // Keyboard masks, valid until the end of the frame
+    virtual const CKDWORD *GetKeyboardDownMask();     // Keys currently held
+    virtual const CKDWORD *GetKeyboardPressedMask();  // Keys pressed this frame
+    virtual const CKDWORD *GetKeyboardReleasedMask(); // Keys released this frame
+
     virtual int GetNumberOfKeyInBuffer();
     virtual int GetKeyFromBuffer(int i, CKDWORD &oKey, CKDWORD *oTimeStamp = NULL);
+    virtual int GetKeyRepeatCount(int i); // Repeats a buffered synthetic event stands for, 0 for hardware events
+    // Microsecond timeline (InputBackend::GetTime); 0 means no event yet.
+    // The CKDWORD stamps above stay in milliseconds for compatibility.
+    virtual InputTime GetInputTime();
+    virtual InputTime GetKeyPressTime(CKDWORD iKey);
+    virtual InputTime GetKeyReleaseTime(CKDWORD iKey);
+    virtual InputTime GetKeyTimeFromBuffer(int i);
+    virtual InputTime GetMouseTime(); // When the mouse position and motion were sampled
+    virtual InputTime GetMouseButtonTime(CK_MOUSEBUTTON iButton);
+    virtual InputTime GetJoystickTime(int iJoystick); // When the joystick state was read
+
+    // Input latency statistics, in microseconds. Disabled by default, where they cost one
+    // test per query. They read the backend clock, so enable them both when recording
+    // and when replaying a journal, or in neither.
+    virtual void EnableLatencyStats(CKBOOL iEnable);
+    virtual CKBOOL IsLatencyStatsEnabled();
+    virtual void ResetLatencyStats();
+    virtual const LatencyHistogram *GetLatencyHistogram(CK_INPUT_LATENCY_SOURCE source, CK_INPUT_LATENCY_STAGE stage); // NULL when disabled
+    virtual CKDWORD GetLatencyPercentile(CK_INPUT_LATENCY_SOURCE source, CK_INPUT_LATENCY_STAGE stage, float fraction);
+
+    // Per-stage frame costs (see FrameStats.h): stopwatch time, calls, events processed and
+    // failed device calls, kept for the last FRAMESTATS_HISTORY frames. Disabled by default,
+    // where each stage costs one test.
+    virtual void EnableFrameStats(CKBOOL iEnable);
+    virtual CKBOOL IsFrameStatsEnabled();
+    virtual void ResetFrameStats();
+    virtual const InputFrameStats *GetFrameStats(); // NULL when disabled
+    virtual CKBOOL GetFrameStageCost(INPUT_STAGE stage, int age, InputStageCost *oCost); // age 0 is the frame in progress
+    virtual void SetFrameStatsDumpInterval(int frames); // Summary sent to the debugger every N frames, 0 disables
+
+    virtual CKDWORD GetKeyboardOverflowCount();     // Times the device buffer overflowed and events were lost
+    virtual CKDWORD GetKeyboardDroppedEventCount(); // Events dropped because the event buffer reached its limit
 
     virtual CKBOOL IsMouseButtonDown(CK_MOUSEBUTTON iButton);
     virtual CKBOOL IsMouseClicked(CK_MOUSEBUTTON iButton);
@@ -164,14 +195,67 @@ public:
 
     virtual CKBOOL IsMouseAttached();
 
+    // Buffered-only mouse (see InputMouse::SetBufferedOnly): motion, wheel and buttons come
+    // from the buffered events alone. Combined with a cursor source other than
+    // INPUT_CURSOR_QUERY, each frame reads the mouse with a single device call. Use the same
+    // settings when recording and when replaying a journal.
+    virtual void EnableMouseBufferedOnly(CKBOOL iEnable);
+    virtual CKBOOL IsMouseBufferedOnly();
+    virtual void SetMouseCursorSource(INPUT_CURSOR_SOURCE source, CKDWORD resyncFrames = 0);
+    virtual INPUT_CURSOR_SOURCE GetMouseCursorSource();
+    // Cursor position in screen coordinates from the window messages, for INPUT_CURSOR_FED;
+    // unlike SetMousePosition it does not move the system cursor
+    virtual void FeedMouseCursorPosition(const Vx2DVector &position);
+
+    // Mouse motion history (see MotionHistory.h): the motion reports of the frame as
+    // timestamped samples, for aim and gestures to follow the path within a frame. The
+    // ring and the device buffer are sized for pollingRate reports per second at
+    // minFrameRate frames per second, reopening the mouse if needed. 0 disables it.
+    // Enable it before recording or replaying a journal.
+    virtual CKBOOL EnableMouseMotionHistory(CKDWORD pollingRate, CKDWORD minFrameRate = MOTION_MIN_FRAME_RATE);
+    virtual CKBOOL IsMouseMotionHistoryEnabled();
+    virtual void SetMouseMotionCoalescing(INPUT_MOTION_COALESCING mode, int samples = 0);
+    virtual const InputMotionHistory *GetMouseMotionHistory(); // NULL when disabled
+    // Copies up to max samples of the frame, oldest first; returns the number copied
+    virtual int GetMouseMotionPath(InputMotionSample *oSamples, int max);
+
+    // Coordinate spaces of the cursor. The render context geometry is cached: PreProcess
+    // checks the client origin and size once per frame and reads the window rectangle and
+    // DPI again only when they changed, so the queries below make no system call.
+    virtual void GetMouseCoordinates(CKMouseCoordinates *oCoordinates);
+    // Client coordinates clamped to the render context, in 96 DPI units when iScaled
+    virtual void GetMouseClientPosition(Vx2DVector &oPosition, CKBOOL iScaled = FALSE);
+    // Forces the geometry to be read again, e.g. on WM_DPICHANGED
+    virtual void InvalidateWindowGeometry();
+
+    // Mouse filter (see MotionFilter.h), run once per frame after the polls over the X and Y
+    // motion. The raw motion stays in GetMouseRelativePosition; the filtered one is read
+    // apart, so callers that do their own smoothing are unaffected.
+    virtual void SetMouseFilter(InputMotionFilter *filter); // The manager takes ownership, NULL removes it
+    virtual InputMotionFilter *GetMouseFilter();
+    virtual void GetMouseFilteredMotion(VxVector &oMotion); // Wheel delta unfiltered in z
+
     virtual CKBOOL IsJoystickAttached(int iJoystick);
 
     virtual void GetJoystickPosition(int iJoystick, VxVector *oPosition);
     virtual void GetJoystickRotation(int iJoystick, VxVector *oRotation);
     virtual void GetJoystickSliders(int iJoystick, Vx2DVector *oPosition);
     virtual void GetJoystickPointOfViewAngle(int iJoystick, float *oAngle);
-    virtual CKDWORD GetJoystickButtonsState(int iJoystick);
+    virtual CKDWORD GetJoystickButtonsState(int iJoystick); // Buttons 0 to 31
     virtual CKBOOL IsJoystickButtonDown(int iJoystick, int iButton);
+    // All 128 buttons as JOYSTICK_BUTTON_WORDS words each, bit (b & 31) of word (b >> 5) for
+    // button b. Pressed and released are the edges of the frame, like KS_PRESSED and KS_RELEASED
+    // for keys: a button pressed and released within one frame shows in both.
+    virtual CKBOOL GetJoystickButtonsMask(int iJoystick, CKDWORD *oDown, CKDWORD *oPressed = NULL, CKDWORD *oReleased = NULL);
+    virtual CKBOOL IsJoystickButtonPressed(int iJoystick, int iButton);  // Went down this frame
+    virtual CKBOOL IsJoystickButtonReleased(int iJoystick, int iButton); // Went up this frame
+
+    // Batched queries: one call fills a caller array instead of one virtual call per key,
+    // button or axis. Unknown keys and joysticks read as idle and detached.
+    virtual int GetKeysState(const CKDWORD *iKeys, int count, CKBYTE *oStates, CKDWORD *oStamps = NULL); // Returns the keys down
+    virtual void GetMouseState(CKInputMouseState *oState);
+    virtual CKBOOL GetJoystickState(int iJoystick, CKInputJoystickState *oState);
+    virtual int GetJoystickStates(CKInputJoystickState *oStates, int count); // Joysticks 0 to count - 1, returns those filled
 
     virtual void Pause(CKBOOL pause);
 
@@ -200,6 +284,14 @@ public:
     virtual CKBOOL SetJoystickAxisRange(int iJoystick, CK_JOYSTICK_AXIS axis, LONG min, LONG max);   // Set custom axis range
     virtual CKBOOL ResetJoystickAxisRanges(int iJoystick);                                           // Reset all axes to device defaults
 
+    // Response curves (see ResponseCurve.h): an axis with a curve is mapped through it after
+    // the deadzone instead of being scaled by the gain. The curve is compiled into a lookup
+    // table here, so the polls only interpolate in it. With iSymmetric, iX goes from 0 to 1
+    // and the curve is mirrored for negative values; otherwise iX covers -1 to 1.
+    virtual CKBOOL SetJoystickResponseCurve(int iJoystick, CK_JOYSTICK_AXIS axis, const float *iX, const float *iY, int iCount, CKBOOL iSymmetric = TRUE);
+    virtual void ClearJoystickResponseCurve(int iJoystick, CK_JOYSTICK_AXIS axis); // Back to the gain
+    virtual CKBOOL HasJoystickResponseCurve(int iJoystick, CK_JOYSTICK_AXIS axis);
+
     // Keyboard repeat configuration methods
     virtual CKDWORD GetKeyboardRepeatDelay();
     virtual void SetKeyboardRepeatDelay(CKDWORD delay);
@@ -237,6 +329,75 @@ public:
     virtual void ClearJoystickState(int joystickIndex = -1);
     virtual void ClearInputState();
 
+    // Input journal: recording captures everything read from the backend plus the
+    // state setting calls above; replay serves both back frame by frame. While a
+    // journal is replayed, state setting calls made by the application are ignored.
+    virtual CKBOOL StartInputRecording(CKSTRING path);
+    virtual CKBOOL StartInputReplay(CKSTRING path);
+    virtual void StopInputJournal();
+    virtual CKBOOL IsRecordingInput();
+    virtual CKBOOL IsReplayingInput();
+    virtual CKBOOL IsInputReplayFinished();
+
+    // Background input thread (see ThreadedBackend.h): the devices are drained as their
+    // data arrives and PreProcess consumes what the thread handed off. Disabled by default.
+    // Enabling or disabling it stops the input journal; a journal started afterwards
+    // records what the thread hands off.
+    virtual void EnableInputThread(CKBOOL iEnable);
+    virtual CKBOOL IsInputThreadEnabled();
+    virtual void SetInputThreadPollInterval(CKDWORD ms); // Wait when no device signals
+
+    // Action map (see ActionMap.h), evaluated once at the end of PreProcess. A table given
+    // to SetActionTable replaces the current one at the next PreProcess, so it can be
+    // compiled on any thread; held actions keep their state across the swap by name.
+    // Handles are indices in the current table, stable as long as the actions keep their order.
+    virtual CKBOOL LoadActionMap(CKSTRING path);
+    virtual void SetActionTable(InputActionTable *table); // The manager takes ownership, NULL removes the map
+    virtual const InputActionTable *GetActionTable();     // NULL when no map is active
+    virtual int GetActionHandle(CKSTRING name);           // -1 for an unknown action
+    virtual CKBOOL IsActionDown(int handle);
+    virtual CKBOOL IsActionPressed(int handle);  // Went down this frame
+    virtual CKBOOL IsActionReleased(int handle); // Went up this frame
+    virtual float GetActionValue(int handle);
+    virtual int GetActionCount();
+    virtual const CKBYTE *GetActionStates(); // INPUT_ACTION_STATE bits indexed by handle, NULL when no map is active
+    virtual const float *GetActionValues();
+
+    // Combo recognizer (see ComboRecognizer.h), run at the end of PreProcess over the key,
+    // mouse button and joystick button presses of the frame in time order. Matches are
+    // reported in the frame that read the press completing them.
+    virtual void SetComboRecognizer(InputComboRecognizer *recognizer); // The manager takes ownership, NULL removes it
+    virtual InputComboRecognizer *GetComboRecognizer();
+    virtual int GetComboMatchCount();
+    virtual CKBOOL GetComboMatch(int i, InputComboMatch *oMatch);
+    virtual CKBOOL IsComboMatched(int pattern); // pattern is the handle given by InputComboSet
+
+    // Eager joystick polling (see JoystickPoller.h): every joystick is polled at the start
+    // of PreProcess instead of by the first query of the frame, so the queries only read
+    // memory. workers > 0 shares the polls between the main thread and that many threads.
+    virtual CKBOOL EnableEagerJoystickPolling(CKBOOL iEnable, int workers = 0);
+    virtual CKBOOL IsEagerJoystickPollingEnabled();
+    virtual float GetJoystickPollTime(int iJoystick); // Microseconds the last poll took
+
+    // Joystick hot-plug (see JoystickWatcher.h): the controllers are enumerated again every
+    // intervalMs on a background thread, 0 on RescanJoysticks only. A new controller takes
+    // the next free index; an unplugged one keeps its index, reads as detached, and gets it
+    // back when plugged in again. Paused while a journal is recorded or replayed.
+    virtual void EnableJoystickHotPlug(CKBOOL iEnable, CKDWORD intervalMs = JOYSTICK_WATCH_INTERVAL);
+    virtual CKBOOL IsJoystickHotPlugEnabled();
+    virtual void RescanJoysticks(); // Scans at once, e.g. on WM_DEVICECHANGE
+    virtual CKBOOL IsJoystickDetached(int iJoystick);
+    // TRUE until every joystick found by a deferred startup is attached
+    virtual CKBOOL IsJoystickStartupPending();
+
+    // Input snapshots (see InputSnapshot.h): a read-only copy of the keyboard, mouse and
+    // joystick states published at the end of each PreProcess, for worker threads to read
+    // without locks while the main thread goes on. Joysticks are then polled every frame.
+    // Disabled by default; disable them only once no worker holds a snapshot.
+    virtual void EnableInputSnapshots(CKBOOL iEnable);
+    virtual CKBOOL IsInputSnapshotsEnabled();
+    virtual InputSnapshotBuffer *GetInputSnapshots(); // NULL when disabled; acquire through InputSnapshotRef
+
     // Internal functions
 
     virtual CKERROR OnCKInit();
@@ -262,35 +423,93 @@ public:
 
     virtual ~DX8InputManager();
 
-    DX8InputManager(CKContext *context);
+    // A deferred startup registers the manager without opening any device; OnCKInit opens the
+    // keyboard and mouse, and the joysticks are enumerated and opened on background threads.
+    // They read as not attached until a later PreProcess attaches them.
+    DX8InputManager(CKContext *context, CKBOOL iDeferredStartup = DX8INPUT_DEFERRED_STARTUP);
 
     void Initialize(HWND hWnd);
     void Uninitialize();
     void ClearBuffers();
 
-    static BOOL CALLBACK JoystickEnum(const DIDEVICEINSTANCE *pdidInstance, void *pContext);
+    // Replaces the device backend (DirectInput 8 by default). The manager takes ownership.
+    // Devices already open are closed and reopened through the new backend.
+    void SetInputBackend(InputBackend *backend);
+    InputBackend *GetInputBackend() { return m_Backend; }
+
+    static BOOL JoystickEnum(const InputDeviceInfo *info, void *pContext);
+
+    // Rebuilds the key name table if it is missing or the keyboard layout changed
+    void UpdateKeyNames();
 
 protected:
-    LPDIRECTINPUT8 m_DirectInput;
-    LPDIRECTINPUTDEVICE8 m_Keyboard;
+    InputBackend *m_Backend;
     VXCURSOR_POINTER m_Cursor;
+    CKKeyboard m_Keyboard;
     CKMouse m_Mouse;
     CKJoystick *m_Joysticks;
     int m_JoystickCount;
     int m_MaxJoysticks;
-    CKBYTE m_KeyboardState[KEYBOARD_BUFFER_SIZE];
-    int m_KeyboardStamps[KEYBOARD_BUFFER_SIZE];
-    DIDEVICEOBJECTDATA m_KeyInBuffer[KEYBOARD_BUFFER_SIZE];
-    int m_NumberOfKeyInBuffer;
     CKBOOL m_Paused;
     CKBOOL m_WasPaused;
-    CKBOOL m_EnableKeyboardRepetition;
-    CKDWORD m_KeyboardRepeatDelay;
-    CKDWORD m_KeyboardRepeatInterval;
     CKBOOL m_ShowCursor;
+    KeyNameTable m_KeyNames;
+    HKL m_KeyboardLayout;
+    RecordingInputBackend *m_Recorder; // Current backend while recording
+    ReplayInputBackend *m_Replay;      // Current backend while replaying
+    InputBackend *m_LiveBackend;       // Backend to restore when the replay stops
+    CKBOOL m_ReplayingInjection;
+    ThreadedInputBackend *m_Threaded; // Wraps the live backend while the input thread is enabled
+    CKDWORD m_InputThreadPollInterval;
+    InputActionTable *m_Actions;        // NULL when no map is active
+    InputActionTable *m_PendingActions; // Replaces m_Actions at the next PreProcess
+    volatile LONG m_ActionsPending;
+    InputMutex m_ActionsLock; // Guards m_PendingActions
+    InputComboRecognizer *m_Combos; // NULL when no pattern is registered
+    InputSnapshotBuffer *m_Snapshots; // NULL when disabled
+    InputJoystickPoller *m_JoystickPoller; // NULL when joysticks are polled lazily
+    InputJoystickWatcher *m_JoystickWatcher; // NULL unless hot-plug is enabled or the joysticks start up
+    CKBOOL m_JoystickHotPlug;
+    CKBOOL m_DeferredStartup;
+    CKBOOL m_JoystickStartupPending; // The watcher's first scan is not applied yet
+    InputMotionHistory *m_MotionHistory; // NULL when disabled
+    CKDWORD m_MouseBufferSize;           // Device buffer of the mouse, in events
+    InputMotionFilter *m_MouseFilter;    // NULL when disabled
+    float m_FilteredMotion[2];
+    CKRenderContext *m_GeometryContext; // Render context the geometry was read from, NULL when invalid
+    LONG m_ClientOrigin[2];             // Screen coordinates of the client area
+    int m_ClientSize[2];
+    float m_WindowOrigin[2]; // Screen coordinates of the window rectangle
+    float m_DpiScale;
+    LatencyHistogram *m_Latency; // CK_LATENCY_SOURCE_COUNT x CK_LATENCY_STAGE_COUNT histograms, NULL when disabled
+    CKDWORD m_LatencyPending;    // Bit per source not queried yet this frame (joystick i uses bit CK_LATENCY_JOYSTICK + i)
+    InputFrameStats *m_FrameStats; // NULL when disabled
+    int m_FrameStatsDumpInterval;
 
 private:
     void EnsureCursorVisible(CKBOOL iShow);
+    // Records the consume latency the first time a source is queried in a frame
+    void NoteRead(int source)
+    {
+        if (m_LatencyPending & (1u << source))
+            RecordReadLatency(source);
+    }
+    void RecordReadLatency(int source);
+    void DumpFrameStats();
+    void SwapActionTable();
+    // Reads the render context geometry again if its client area moved or was resized
+    void UpdateWindowGeometry();
+    // Closes the mouse and opens it again with a buffer of m_MouseBufferSize events
+    void ReopenMouse();
+    // Starts the watcher for hot-plug or a deferred startup, unless a journal is active
+    void StartJoystickWatcher();
+    // Enumerates and opens the joysticks on the calling thread
+    void OpenJoysticks(HWND hWnd);
+    // Swaps the backend, reopening the devices through the new one; returns the previous backend
+    InputBackend *ExchangeBackend(InputBackend *backend);
+    // Journals a state setting call; FALSE if the call must be ignored because a journal is replayed
+    CKBOOL RecordInjection(CKDWORD call, const void *args, CKDWORD size, const void *body = NULL, CKDWORD bodySize = 0);
+    static void ReplayInjection(DWORD call, const void *data, DWORD size, void *context);
 };
 
 #endif // DX8INPUTMANAGER_H
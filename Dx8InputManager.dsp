@@ -92,14 +92,86 @@ LINK32=link.exe
 # PROP Default_Filter "cpp;c;cxx;rc;def;r;odl;idl;hpj;bat"
 # Begin Source File
 
+SOURCE=.\ActionMap.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\ComboRecognizer.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\DI8Backend.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\DX8InputManager.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\EventQueue.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\EventRing.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\FrameStats.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\InputSnapshot.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\InputThread.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Journal.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\JournalBackend.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\Joystick.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\JoystickPoller.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\JoystickWatcher.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Keyboard.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\KeyNames.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\KeyRepeat.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\LatencyHistogram.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\MotionFilter.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\MotionHistory.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\Mouse.cpp
 # End Source File
 # Begin Source File
@@ -110,14 +182,122 @@ SOURCE=.\Parameters.cpp
 
 SOURCE=.\Plugin.cpp
 # End Source File
+# Begin Source File
+
+SOURCE=.\ResponseCurve.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\ScriptedBackend.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\ThreadedBackend.cpp
+# End Source File
 # End Group
 # Begin Group "Header Files"
 
 # PROP Default_Filter "h;hpp;hxx;hm;inl"
 # Begin Source File
 
+SOURCE=.\ActionMap.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\AxisKernel.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\ComboRecognizer.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\DI8Backend.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\DX8InputManager.h
 # End Source File
+# Begin Source File
+
+SOURCE=.\EventQueue.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\EventRing.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\FrameStats.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\InputBackend.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\InputDevices.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\InputSnapshot.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\InputThread.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\Journal.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\JournalBackend.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\JoystickPoller.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\JoystickWatcher.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\KeyMask.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\KeyNames.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\KeyRepeat.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\LatencyHistogram.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\MotionFilter.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\MotionHistory.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\ResponseCurve.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\ScriptedBackend.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\ThreadedBackend.h
+# End Source File
 # End Group
 # Begin Group "Resource Files"
 
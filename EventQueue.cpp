@@ -0,0 +1,93 @@
+#include "EventQueue.h"
+
+#include <string.h>
+
+//
+// InputEventQueue
+//
+
+InputEventQueue::InputEventQueue(DWORD capacity) : m_Head(0), m_Tail(0)
+{
+    DWORD size = 1;
+    while (size < capacity)
+        size <<= 1;
+    m_Events = new DIDEVICEOBJECTDATA[size];
+    m_Mask = size - 1;
+}
+
+InputEventQueue::~InputEventQueue()
+{
+    delete[] m_Events;
+}
+
+BOOL InputEventQueue::Push(const DIDEVICEOBJECTDATA &event)
+{
+    DWORD tail = (DWORD)m_Tail; // Only the producer writes it
+    DWORD head = (DWORD)InputAtomicLoad(&m_Head);
+    if (tail - head > m_Mask)
+        return FALSE;
+
+    m_Events[tail & m_Mask] = event;
+    InputAtomicStore(&m_Tail, (LONG)(tail + 1));
+    return TRUE;
+}
+
+DWORD InputEventQueue::Pop(DIDEVICEOBJECTDATA *events, DWORD count, BOOL peek)
+{
+    DWORD head = (DWORD)m_Head; // Only the consumer writes it
+    DWORD tail = (DWORD)InputAtomicLoad(&m_Tail);
+    DWORD n = tail - head;
+    if (n > count)
+        n = count;
+
+    if (events)
+    {
+        for (DWORD i = 0; i < n; i++)
+            events[i] = m_Events[(head + i) & m_Mask];
+    }
+    if (!peek)
+        InputAtomicStore(&m_Head, (LONG)(head + n));
+    return n;
+}
+
+void InputEventQueue::Clear()
+{
+    InputAtomicStore(&m_Head, InputAtomicLoad(&m_Tail));
+}
+
+DWORD InputEventQueue::GetCount() const
+{
+    DWORD head = (DWORD)InputAtomicLoad(&m_Head);
+    DWORD tail = (DWORD)InputAtomicLoad(&m_Tail);
+    return tail - head;
+}
+
+//
+// InputStateBuffer
+//
+
+InputStateBuffer::InputStateBuffer(DWORD size) : m_Size(size), m_Middle(1), m_Back(2), m_Front(0), m_HasState(FALSE)
+{
+    m_Buffers = new BYTE[3 * size];
+    memset(m_Buffers, 0, 3 * size);
+}
+
+InputStateBuffer::~InputStateBuffer()
+{
+    delete[] m_Buffers;
+}
+
+void InputStateBuffer::Publish()
+{
+    m_Back = InputAtomicExchange(&m_Middle, m_Back | FRESH) & ~FRESH;
+}
+
+const void *InputStateBuffer::Acquire()
+{
+    if (InputAtomicLoad(&m_Middle) & FRESH)
+    {
+        m_Front = InputAtomicExchange(&m_Middle, m_Front) & ~FRESH;
+        m_HasState = TRUE;
+    }
+    return m_HasState ? m_Buffers + m_Front * m_Size : NULL;
+}
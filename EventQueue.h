@@ -0,0 +1,74 @@
+#ifndef EVENTQUEUE_H
+#define EVENTQUEUE_H
+
+#include "InputThread.h"
+
+#define INPUT_EVENT_QUEUE_CAPACITY 4096 // Power of two
+#define INPUT_CACHE_LINE 64
+
+// Lock-free single-producer single-consumer queue of device events, the
+// hand-off between the input thread and the main thread. The capacity is
+// fixed; pushes into a full queue fail and are left to the producer to count.
+class InputEventQueue
+{
+public:
+    explicit InputEventQueue(DWORD capacity = INPUT_EVENT_QUEUE_CAPACITY);
+    ~InputEventQueue();
+
+    // Producer side
+    BOOL Push(const DIDEVICEOBJECTDATA &event);
+
+    // Consumer side: copies up to count of the oldest events, removing them unless peek is set
+    DWORD Pop(DIDEVICEOBJECTDATA *events, DWORD count, BOOL peek = FALSE);
+    void Clear();
+
+    // Either side; the other side may change it at any time
+    DWORD GetCount() const;
+    DWORD GetCapacity() const { return m_Mask + 1; }
+
+private:
+    InputEventQueue(const InputEventQueue &);
+    InputEventQueue &operator=(const InputEventQueue &);
+
+    // Free-running counters, the producer and consumer indices live on separate cache lines
+    volatile LONG m_Head; // Consumer
+    char m_HeadPad[INPUT_CACHE_LINE - sizeof(LONG)];
+    volatile LONG m_Tail; // Producer
+    char m_TailPad[INPUT_CACHE_LINE - sizeof(LONG)];
+    DIDEVICEOBJECTDATA *m_Events;
+    DWORD m_Mask;
+};
+
+// Lock-free triple buffer holding the latest immediate state of a device. The
+// producer publishes complete states and never waits; the consumer always
+// reads the most recent complete state.
+class InputStateBuffer
+{
+public:
+    explicit InputStateBuffer(DWORD size);
+    ~InputStateBuffer();
+
+    // Producer side: fill GetBackBuffer(), then Publish()
+    void *GetBackBuffer() { return m_Buffers + m_Back * m_Size; }
+    void Publish();
+
+    // Consumer side: the latest published state, NULL if none was published yet
+    const void *Acquire();
+
+    DWORD GetSize() const { return m_Size; }
+
+private:
+    InputStateBuffer(const InputStateBuffer &);
+    InputStateBuffer &operator=(const InputStateBuffer &);
+
+    enum { FRESH = 4 };
+
+    BYTE *m_Buffers;
+    DWORD m_Size;
+    volatile LONG m_Middle; // Buffer index, with FRESH set when published and not yet acquired
+    LONG m_Back;            // Producer's buffer
+    LONG m_Front;           // Consumer's buffer
+    BOOL m_HasState;        // Consumer saw at least one state
+};
+
+#endif // EVENTQUEUE_H
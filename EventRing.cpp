@@ -0,0 +1,93 @@
+#include "EventRing.h"
+
+#include <string.h>
+
+InputEventRing::InputEventRing(DWORD limit)
+    : m_Events(NULL), m_Capacity(0), m_Limit(limit), m_Head(0), m_Count(0), m_Dropped(0)
+{
+}
+
+InputEventRing::~InputEventRing()
+{
+    delete[] m_Events;
+}
+
+BOOL InputEventRing::Push(const DIDEVICEOBJECTDATA &data, InputTime time)
+{
+    InputEvent event;
+    event.Data = data;
+    event.Time = time;
+    return Push(event);
+}
+
+BOOL InputEventRing::Push(const InputEvent &event)
+{
+    if (m_Count == m_Capacity && !Reserve(m_Count + 1))
+    {
+        ++m_Dropped;
+        return FALSE;
+    }
+    m_Events[(m_Head + m_Count) & (m_Capacity - 1)] = event;
+    ++m_Count;
+    return TRUE;
+}
+
+DWORD InputEventRing::Push(const InputEvent *events, DWORD count)
+{
+    if (!events || count == 0)
+        return 0;
+
+    if (m_Count + count > m_Capacity)
+        Reserve(m_Count + count);
+
+    DWORD stored = m_Capacity - m_Count;
+    if (stored > count)
+        stored = count;
+    m_Dropped += count - stored;
+    if (stored == 0)
+        return 0;
+
+    // Copy in at most two runs around the end of the storage
+    DWORD tail = (m_Head + m_Count) & (m_Capacity - 1);
+    DWORD first = m_Capacity - tail;
+    if (first > stored)
+        first = stored;
+    memcpy(m_Events + tail, events, first * sizeof(InputEvent));
+    memcpy(m_Events, events + first, (stored - first) * sizeof(InputEvent));
+    m_Count += stored;
+    return stored;
+}
+
+BOOL InputEventRing::Pop(InputEvent *event)
+{
+    if (m_Count == 0)
+        return FALSE;
+    if (event)
+        *event = m_Events[m_Head];
+    m_Head = (m_Head + 1) & (m_Capacity - 1);
+    --m_Count;
+    return TRUE;
+}
+
+BOOL InputEventRing::Reserve(DWORD count)
+{
+    if (count <= m_Capacity)
+        return TRUE;
+    if (m_Capacity >= m_Limit)
+        return FALSE;
+
+    DWORD capacity = (m_Capacity > 0) ? m_Capacity : INPUT_EVENT_RING_MIN_CAPACITY;
+    while (capacity < count && capacity < m_Limit)
+        capacity *= 2;
+    if (capacity > m_Limit)
+        capacity = m_Limit;
+
+    InputEvent *events = new InputEvent[capacity];
+    for (DWORD i = 0; i < m_Count; i++)
+        events[i] = Get(i);
+    delete[] m_Events;
+    m_Events = events;
+    m_Capacity = capacity;
+    m_Head = 0;
+    return TRUE;
+}
@@ -0,0 +1,54 @@
+#ifndef EVENTRING_H
+#define EVENTRING_H
+
+#include "InputBackend.h"
+
+#define INPUT_EVENT_RING_MIN_CAPACITY 256
+#define INPUT_EVENT_RING_LIMIT 65536 // Power of two
+
+// A device event and its time on the backend's microsecond clock
+struct InputEvent
+{
+    DIDEVICEOBJECTDATA Data;
+    InputTime Time;
+};
+
+// Growable FIFO of device events. The capacity doubles on demand up to a limit;
+// events pushed past the limit are dropped and counted.
+class InputEventRing
+{
+public:
+    explicit InputEventRing(DWORD limit = INPUT_EVENT_RING_LIMIT);
+    ~InputEventRing();
+
+    void Clear() { m_Head = 0; m_Count = 0; }
+    BOOL Push(const InputEvent &event);
+    BOOL Push(const DIDEVICEOBJECTDATA &data, InputTime time);
+    // Returns the number of events stored
+    DWORD Push(const InputEvent *events, DWORD count);
+    BOOL Pop(InputEvent *event);
+
+    DWORD GetCount() const { return m_Count; }
+    BOOL IsEmpty() const { return m_Count == 0; }
+    // i-th oldest event, i must be less than GetCount()
+    const InputEvent &Get(DWORD i) const { return m_Events[(m_Head + i) & (m_Capacity - 1)]; }
+    InputEvent &Get(DWORD i) { return m_Events[(m_Head + i) & (m_Capacity - 1)]; }
+
+    DWORD GetDroppedCount() const { return m_Dropped; }
+    void ResetDroppedCount() { m_Dropped = 0; }
+
+private:
+    InputEventRing(const InputEventRing &);
+    InputEventRing &operator=(const InputEventRing &);
+
+    BOOL Reserve(DWORD count);
+
+    InputEvent *m_Events;
+    DWORD m_Capacity; // Zero or a power of two
+    DWORD m_Limit;
+    DWORD m_Head;
+    DWORD m_Count;
+    DWORD m_Dropped;
+};
+
+#endif // EVENTRING_H
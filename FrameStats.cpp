@@ -0,0 +1,167 @@
+#include "FrameStats.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+InputTime InputStopwatch()
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    ::QueryPerformanceCounter(&counter);
+    return (InputTime)counter.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (InputTime)ts.tv_sec * 1000000000 + (InputTime)ts.tv_nsec;
+#endif
+}
+
+InputTime InputStopwatchFrequency()
+{
+#ifdef _WIN32
+    static InputTime frequency = 0;
+    if (frequency == 0)
+    {
+        LARGE_INTEGER value;
+        ::QueryPerformanceFrequency(&value);
+        frequency = (InputTime)value.QuadPart;
+    }
+    return frequency;
+#else
+    return 1000000000;
+#endif
+}
+
+static const char *const g_StageNames[INPUT_STAGE_COUNT] = {
+    "PreProcess",
+    "PostProcess",
+    "Keyboard Poll",
+    "Mouse Poll",
+    "Joystick Poll",
+    "Reacquire",
+    "ClearBuffers",
+    "Actions",
+    "Combos",
+    "Snapshot",
+};
+
+InputFrameStats::InputFrameStats()
+{
+    Clear();
+}
+
+void InputFrameStats::Clear()
+{
+    memset(m_Frames, 0, sizeof(m_Frames));
+    memset(m_Totals, 0, sizeof(m_Totals));
+    m_Current = 0;
+    m_FrameCount = 0;
+}
+
+void InputFrameStats::Accumulate(const InputFrameCost &frame)
+{
+    for (int s = 0; s < INPUT_STAGE_COUNT; s++)
+    {
+        m_Totals[s].Ticks += frame.Stages[s].Ticks;
+        m_Totals[s].Calls += frame.Stages[s].Calls;
+        m_Totals[s].Events += frame.Stages[s].Events;
+        m_Totals[s].Failures += frame.Stages[s].Failures;
+    }
+}
+
+void InputFrameStats::BeginFrame()
+{
+    // Costs counted before the first frame (ClearBuffers at reset) are not kept
+    if (m_FrameCount > 0)
+        Accumulate(m_Frames[m_Current]);
+    ++m_FrameCount;
+    m_Current = (m_Current + 1) & (FRAMESTATS_HISTORY - 1);
+    memset(&m_Frames[m_Current], 0, sizeof(InputFrameCost));
+    m_Frames[m_Current].Frame = m_FrameCount;
+}
+
+const InputFrameCost *InputFrameStats::GetFrame(int age) const
+{
+    if (age < 0 || age >= FRAMESTATS_HISTORY || (DWORD)age >= m_FrameCount)
+        return NULL;
+    return &m_Frames[(m_Current - age) & (FRAMESTATS_HISTORY - 1)];
+}
+
+int InputFrameStats::Sum(InputStageCost costs[INPUT_STAGE_COUNT], int frameCount) const
+{
+    memset(costs, 0, INPUT_STAGE_COUNT * sizeof(InputStageCost));
+    if (frameCount <= 0 || frameCount > FRAMESTATS_HISTORY - 1)
+        frameCount = FRAMESTATS_HISTORY - 1;
+
+    int summed = 0;
+    for (int age = 1; age <= frameCount; age++)
+    {
+        const InputFrameCost *frame = GetFrame(age);
+        if (!frame)
+            break;
+        for (int s = 0; s < INPUT_STAGE_COUNT; s++)
+        {
+            costs[s].Ticks += frame->Stages[s].Ticks;
+            costs[s].Calls += frame->Stages[s].Calls;
+            costs[s].Events += frame->Stages[s].Events;
+            costs[s].Failures += frame->Stages[s].Failures;
+        }
+        ++summed;
+    }
+    return summed;
+}
+
+const char *InputFrameStats::GetStageName(INPUT_STAGE stage)
+{
+    return (stage >= 0 && stage < INPUT_STAGE_COUNT) ? g_StageNames[stage] : "Unknown";
+}
+
+float InputFrameStats::TicksToMicroseconds(InputTime ticks)
+{
+    return (float)((double)ticks * 1000000.0 / (double)InputStopwatchFrequency());
+}
+
+int InputFrameStats::Format(char *buffer, int size, int frameCount) const
+{
+    if (!buffer || size <= 0)
+        return 0;
+    buffer[0] = '\0';
+
+    InputStageCost costs[INPUT_STAGE_COUNT];
+    int frames = Sum(costs, frameCount);
+    if (frames == 0)
+        return 0;
+
+    // Lines are formatted separately and only appended whole
+    char line[256];
+    int length = 0;
+    for (int s = -1; s < INPUT_STAGE_COUNT; s++)
+    {
+        if (s < 0)
+        {
+            sprintf(line, "Input frame costs, average of %d frames:\n", frames);
+        }
+        else
+        {
+            const InputStageCost &cost = costs[s];
+            sprintf(line, "  %-14s %9.2f us %7.2f calls %8.2f events %u failed\n",
+                    GetStageName((INPUT_STAGE)s),
+                    TicksToMicroseconds(cost.Ticks) / frames,
+                    (float)cost.Calls / frames,
+                    (float)cost.Events / frames,
+                    (unsigned int)cost.Failures);
+        }
+        int n = (int)strlen(line);
+        if (length + n >= size)
+            break;
+        memcpy(buffer + length, line, n + 1);
+        length += n;
+    }
+    return length;
+}
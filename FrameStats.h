@@ -0,0 +1,125 @@
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include "InputBackend.h"
+
+#define FRAMESTATS_HISTORY 128 // Frames kept in the ring, power of two
+
+// Stages of the input manager whose cost is counted. Stages nest: PreProcess
+// includes the keyboard and mouse polls, and the polls include reacquisition.
+enum INPUT_STAGE
+{
+    INPUT_STAGE_PREPROCESS = 0,
+    INPUT_STAGE_POSTPROCESS = 1,
+    INPUT_STAGE_KEYBOARD_POLL = 2,
+    INPUT_STAGE_MOUSE_POLL = 3,
+    INPUT_STAGE_JOYSTICK_POLL = 4, // Lazy polls where a query triggers them, or all of them at frame start when eager
+    INPUT_STAGE_REACQUIRE = 5,     // Acquire calls after a device was lost
+    INPUT_STAGE_CLEAR_BUFFERS = 6,
+    INPUT_STAGE_ACTIONS = 7,  // Action map evaluation, events are the bindings read
+    INPUT_STAGE_COMBOS = 8,   // Combo recognition, events are the presses fed
+    INPUT_STAGE_SNAPSHOT = 9, // Snapshot publication, joystick polls included
+    INPUT_STAGE_COUNT = 10
+};
+
+struct InputStageCost
+{
+    InputTime Ticks; // Stopwatch ticks (InputStopwatchFrequency per second)
+    DWORD Calls;
+    DWORD Events; // Device events and states processed
+    DWORD Failures; // Failed HRESULTs returned by the device
+};
+
+struct InputFrameCost
+{
+    DWORD Frame; // Frame number, counted from 1
+    InputStageCost Stages[INPUT_STAGE_COUNT];
+};
+
+// High resolution stopwatch for the stage costs: the performance counter on
+// Windows, the monotonic clock in nanoseconds elsewhere.
+InputTime InputStopwatch();
+InputTime InputStopwatchFrequency();
+
+// Per-frame stage costs in a ring of the last FRAMESTATS_HISTORY frames, plus
+// running totals. Single writer, no locks.
+class InputFrameStats
+{
+public:
+    InputFrameStats();
+    void Clear();
+
+    // Starts a new frame in the ring
+    void BeginFrame();
+
+    void Add(INPUT_STAGE stage, InputTime ticks, DWORD events, HRESULT hr)
+    {
+        InputStageCost &cost = m_Frames[m_Current].Stages[stage];
+        ++cost.Calls;
+        cost.Ticks += ticks;
+        cost.Events += events;
+        if (FAILED(hr))
+            ++cost.Failures;
+    }
+    // Counts a failed device call in a stage without timing it
+    void AddFailure(INPUT_STAGE stage) { ++m_Frames[m_Current].Stages[stage].Failures; }
+
+    DWORD GetFrameCount() const { return m_FrameCount; }
+    // Frame by age: 0 is the frame in progress, 1 the previous one. NULL past the history.
+    const InputFrameCost *GetFrame(int age) const;
+    // Sums over the last frameCount completed frames (all of the history when 0); returns the frames summed
+    int Sum(InputStageCost costs[INPUT_STAGE_COUNT], int frameCount = 0) const;
+    // Totals since the last Clear, completed frames only
+    const InputStageCost &GetTotal(INPUT_STAGE stage) const { return m_Totals[stage]; }
+
+    static const char *GetStageName(INPUT_STAGE stage);
+    static float TicksToMicroseconds(InputTime ticks);
+
+    // One line per stage, averaged over the last frameCount frames; returns the length written
+    int Format(char *buffer, int size, int frameCount = 0) const;
+
+private:
+    void Accumulate(const InputFrameCost &frame);
+
+    InputFrameCost m_Frames[FRAMESTATS_HISTORY];
+    InputStageCost m_Totals[INPUT_STAGE_COUNT];
+    int m_Current;
+    DWORD m_FrameCount;
+};
+
+// Times a stage from construction to destruction; does nothing without stats
+class InputStageTimer
+{
+public:
+    InputStageTimer(InputFrameStats *stats, INPUT_STAGE stage)
+        : m_Stats(stats), m_Stage(stage), m_Events(0), m_Result(DI_OK), m_Start(stats ? InputStopwatch() : 0) {}
+    ~InputStageTimer()
+    {
+        if (m_Stats)
+            m_Stats->Add(m_Stage, InputStopwatch() - m_Start, m_Events, m_Result);
+    }
+
+    void SetEvents(DWORD events) { m_Events = events; }
+    void SetResult(HRESULT hr) { m_Result = hr; }
+
+private:
+    InputStageTimer(const InputStageTimer &);
+    InputStageTimer &operator=(const InputStageTimer &);
+
+    InputFrameStats *m_Stats;
+    INPUT_STAGE m_Stage;
+    DWORD m_Events;
+    HRESULT m_Result;
+    InputTime m_Start;
+};
+
+// Acquires a lost device, timed as INPUT_STAGE_REACQUIRE when stats are given
+inline HRESULT InputReacquire(InputDevice *device, InputFrameStats *stats)
+{
+    InputStageTimer timer(stats, INPUT_STAGE_REACQUIRE);
+    HRESULT hr = device->Acquire();
+    timer.SetResult(hr);
+    return hr;
+}
+
+#endif // FRAMESTATS_H
@@ -0,0 +1,250 @@
+#ifndef INPUTBACKEND_H
+#define INPUTBACKEND_H
+
+#ifdef _WIN32
+#ifndef DIRECTINPUT_VERSION
+#define DIRECTINPUT_VERSION 0x800
+#endif
+#include <dinput.h>
+#else
+#include <stddef.h>
+#include <string.h>
+
+// Subset of the DirectInput 8 vocabulary used by the input state machine, so that
+// it can be built and driven by the scripted backend on platforms without DirectX.
+// Sizes match the Win32 definitions (DWORD, LONG and HRESULT are 32-bit).
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef unsigned int DWORD;
+typedef int LONG;
+typedef int HRESULT;
+typedef DWORD *LPDWORD;
+typedef size_t UINT_PTR;
+typedef void *HWND;
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef MAX_PATH
+#define MAX_PATH 260
+#endif
+
+struct GUID
+{
+    DWORD Data1;
+    WORD Data2;
+    WORD Data3;
+    BYTE Data4[8];
+};
+
+inline bool operator==(const GUID &a, const GUID &b) { return memcmp(&a, &b, sizeof(GUID)) == 0; }
+inline bool operator!=(const GUID &a, const GUID &b) { return !(a == b); }
+
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+
+#define S_OK ((HRESULT)0)
+#define S_FALSE ((HRESULT)1)
+#define E_FAIL ((HRESULT)0x80004005)
+
+#define DI_OK S_OK
+#define DI_NOTATTACHED S_FALSE
+#define DI_BUFFEROVERFLOW S_FALSE
+#define DI_NOEFFECT S_FALSE
+#define DIERR_GENERIC E_FAIL
+#define DIERR_INPUTLOST ((HRESULT)0x8007001E)
+#define DIERR_NOTACQUIRED ((HRESULT)0x8007000C)
+#define DIERR_NOTINITIALIZED ((HRESULT)0x80070015)
+#define DIERR_DEVICENOTREG ((HRESULT)0x80040154)
+#define DIERR_UNPLUGGED ((HRESULT)0x80040209)
+#define DIERR_INVALIDPARAM ((HRESULT)0x80070057)
+#define DIERR_ACQUIRED ((HRESULT)0x800700AA)
+
+#define DIENUM_STOP 0
+#define DIENUM_CONTINUE 1
+
+#define DISCL_EXCLUSIVE 0x00000001
+#define DISCL_NONEXCLUSIVE 0x00000002
+#define DISCL_FOREGROUND 0x00000004
+#define DISCL_BACKGROUND 0x00000008
+
+#define DIGDD_PEEK 0x00000001
+
+typedef struct DIDEVICEOBJECTDATA
+{
+    DWORD dwOfs;
+    DWORD dwData;
+    DWORD dwTimeStamp;
+    DWORD dwSequence;
+    UINT_PTR uAppData;
+} DIDEVICEOBJECTDATA;
+
+typedef struct DIMOUSESTATE
+{
+    LONG lX;
+    LONG lY;
+    LONG lZ;
+    BYTE rgbButtons[4];
+} DIMOUSESTATE;
+
+typedef struct DIJOYSTATE2
+{
+    LONG lX;
+    LONG lY;
+    LONG lZ;
+    LONG lRx;
+    LONG lRy;
+    LONG lRz;
+    LONG rglSlider[2];
+    DWORD rgdwPOV[4];
+    BYTE rgbButtons[128];
+    LONG lVX;
+    LONG lVY;
+    LONG lVZ;
+    LONG lVRx;
+    LONG lVRy;
+    LONG lVRz;
+    LONG rglVSlider[2];
+    LONG lAX;
+    LONG lAY;
+    LONG lAZ;
+    LONG lARx;
+    LONG lARy;
+    LONG lARz;
+    LONG rglASlider[2];
+    LONG lFX;
+    LONG lFY;
+    LONG lFZ;
+    LONG lFRx;
+    LONG lFRy;
+    LONG lFRz;
+    LONG rglFSlider[2];
+} DIJOYSTATE2;
+
+#define DIMOFS_X offsetof(DIMOUSESTATE, lX)
+#define DIMOFS_Y offsetof(DIMOUSESTATE, lY)
+#define DIMOFS_Z offsetof(DIMOUSESTATE, lZ)
+#define DIMOFS_BUTTON0 (offsetof(DIMOUSESTATE, rgbButtons) + 0)
+#define DIMOFS_BUTTON1 (offsetof(DIMOUSESTATE, rgbButtons) + 1)
+#define DIMOFS_BUTTON2 (offsetof(DIMOUSESTATE, rgbButtons) + 2)
+#define DIMOFS_BUTTON3 (offsetof(DIMOUSESTATE, rgbButtons) + 3)
+#endif
+
+// Microseconds on the backend's monotonic clock
+#if defined(_MSC_VER)
+typedef unsigned __int64 InputTime;
+#else
+typedef unsigned long long InputTime;
+#endif
+
+// Maps a millisecond device timestamp onto the microsecond clock, given the clock
+// and the millisecond tick count sampled together.
+inline InputTime InputTimeFromTick(InputTime now, DWORD tick, DWORD stamp)
+{
+    DWORD age = tick - stamp;
+    if ((LONG)age < 0)
+        age = 0; // Stamped after the tick was sampled
+    InputTime offset = (InputTime)age * 1000;
+    return (offset < now) ? now - offset : 0;
+}
+
+// Joystick axes in the order reported by InputDevice::GetAxisRanges (same order as CK_JOYSTICK_AXIS)
+enum INPUT_AXIS
+{
+    INPUT_AXIS_X = 0,
+    INPUT_AXIS_Y = 1,
+    INPUT_AXIS_Z = 2,
+    INPUT_AXIS_RX = 3,
+    INPUT_AXIS_RY = 4,
+    INPUT_AXIS_RZ = 5,
+    INPUT_AXIS_SLIDER0 = 6,
+    INPUT_AXIS_SLIDER1 = 7,
+    INPUT_AXIS_COUNT = 8
+};
+
+struct InputAxisRange
+{
+    BOOL Present;
+    LONG Min;
+    LONG Max;
+};
+
+struct InputDeviceCaps
+{
+    DWORD Axes;
+    DWORD Buttons;
+    DWORD POVs;
+};
+
+struct InputDeviceInfo
+{
+    GUID InstanceGUID;
+    char ProductName[MAX_PATH]; // UTF-8 product name
+};
+
+class InputSignal;
+
+// A single keyboard, mouse or game controller opened through an InputBackend.
+// Methods mirror the IDirectInputDevice8 calls made by the input state machine.
+class InputDevice
+{
+public:
+    virtual ~InputDevice() {}
+
+    virtual HRESULT Acquire() = 0;
+    virtual HRESULT Unacquire() = 0;
+    virtual HRESULT Poll() = 0;
+    virtual HRESULT SetCooperativeLevel(HWND hWnd, DWORD flags) = 0;
+
+    // Reads up to *count buffered events; *count receives the number actually read.
+    virtual HRESULT GetDeviceData(DIDEVICEOBJECTDATA *data, DWORD *count, DWORD flags) = 0;
+    virtual HRESULT GetDeviceState(DWORD size, void *state) = 0;
+    // Sets the signal raised when new data arrives, NULL to remove it. The device must not be acquired.
+    virtual HRESULT SetEventNotification(InputSignal *signal) = 0;
+
+    virtual HRESULT GetCapabilities(InputDeviceCaps *caps) = 0;
+    // Fills one entry per INPUT_AXIS; absent axes have Present == FALSE.
+    virtual HRESULT GetAxisRanges(InputAxisRange ranges[INPUT_AXIS_COUNT]) = 0;
+
+    // Underlying API object (IDirectInputDevice8 for the DirectInput backend), or NULL.
+    virtual void *GetNativeInterface() = 0;
+
+    // Closes the device. The pointer must not be used afterwards.
+    virtual void Release() = 0;
+};
+
+typedef BOOL (*InputDeviceEnumCallback)(const InputDeviceInfo *info, void *context);
+
+// Source of devices, time and cursor position for the input state machine.
+class InputBackend
+{
+public:
+    virtual ~InputBackend() {}
+
+    virtual HRESULT Initialize(HWND hWnd) = 0;
+    virtual void Shutdown() = 0;
+
+    // Keyboard and mouse are returned with their data format and buffer size already set.
+    virtual HRESULT CreateKeyboard(DWORD bufferSize, InputDevice **device) = 0;
+    virtual HRESULT CreateMouse(DWORD bufferSize, InputDevice **device) = 0;
+
+    // Enumerates attached game controllers; the callback returns DIENUM_CONTINUE or DIENUM_STOP.
+    virtual HRESULT EnumJoysticks(InputDeviceEnumCallback callback, void *context) = 0;
+    virtual HRESULT CreateJoystick(const GUID &instance, InputDevice **device) = 0;
+
+    // Millisecond tick on the same time base as the event timestamps.
+    virtual DWORD GetTickCount() = 0;
+    // Monotonic microsecond clock; it must not go backwards.
+    virtual InputTime GetTime() = 0;
+    virtual BOOL GetCursorPos(LONG *x, LONG *y) = 0;
+    virtual BOOL SetCursorPos(LONG x, LONG y) = 0;
+
+    // Destroys the backend. All devices must have been released first.
+    virtual void Release() = 0;
+};
+
+#endif // INPUTBACKEND_H
@@ -0,0 +1,330 @@
+#ifndef INPUTDEVICES_H
+#define INPUTDEVICES_H
+
+#include "InputBackend.h"
+#include "AxisKernel.h"
+#include "EventRing.h"
+#include "FrameStats.h"
+#include "KeyMask.h"
+#include "KeyRepeat.h"
+#include "LatencyHistogram.h"
+#include "MotionHistory.h"
+#include "ResponseCurve.h"
+
+#define KEYBOARD_BUFFER_SIZE 256
+#define MOUSE_BUFFER_SIZE 256
+#define KEYBOARD_MAX_READS 64 // GetDeviceData calls per drain, bounds a device that never empties
+#define MOUSE_MAX_READS 16    // GetDeviceData calls per mouse drain
+#define JOYSTICK_BUTTON_COUNT 128 // Buttons of DIJOYSTATE2
+#define JOYSTICK_BUTTON_WORDS 4   // 32-bit words of a joystick button mask
+
+// Per-key and per-button state bits (same values as KS_IDLE, KS_PRESSED and KS_RELEASED)
+enum INPUT_KEY_STATE
+{
+    INPUT_KS_IDLE = 0,
+    INPUT_KS_PRESSED = 1,
+    INPUT_KS_RELEASED = 2
+};
+
+// Where the mouse takes the cursor position from at each poll
+enum INPUT_CURSOR_SOURCE
+{
+    INPUT_CURSOR_QUERY = 0,  // InputBackend::GetCursorPos
+    INPUT_CURSOR_FED = 1,    // Only InputMouse::SetCursorPosition, e.g. from WM_MOUSEMOVE
+    INPUT_CURSOR_MOTION = 2, // Cached position moved by the relative motion, queried again every N polls
+    INPUT_CURSOR_SOURCE_COUNT = 3
+};
+
+class InputKeyboard
+{
+    friend class DX8InputManager;
+
+public:
+    InputKeyboard();
+    void Init(InputBackend *backend, InputDevice *device, HWND hWnd);
+    void Release();
+    void Clear();
+    void Reset();
+    void Flush();
+    void Poll(BOOL pause);
+    void PostProcess();
+    void SetKey(DWORD key, BOOL pressed, int stamp, InputTime time);
+    void SetState(const BYTE *states, const int *stamps);
+    BOOL IsAttached() const { return m_Device != NULL; }
+    // Only held keys are scheduled, and only while repetition is enabled
+    void EnableRepetition(BOOL enable);
+    BOOL IsRepetitionEnabled() const { return m_EnableRepetition; }
+    DWORD GetRepeatDelay() const { return m_RepeatDelay; }
+    DWORD GetRepeatInterval() const { return m_RepeatInterval; }
+    // Receives the delay between each event and the poll that reads it; NULL disables it
+    void SetIngestLatency(LatencyHistogram *histogram) { m_IngestLatency = histogram; }
+    // Receives the cost of the polls and reacquisitions; NULL disables it
+    void SetFrameStats(InputFrameStats *stats) { m_Stats = stats; }
+
+    const BYTE *GetState() const { return m_State; }
+    // For callers that write the bytes directly: the next PostProcess rebuilds the masks
+    // and the active keys from all 256 of them
+    BYTE *GetWritableState();
+    // Clock time of the latest press and release of a key, 0 if none yet
+    InputTime GetPressTime(DWORD key) const { return (key < KEYBOARD_BUFFER_SIZE) ? m_PressTimes[key] : 0; }
+    InputTime GetReleaseTime(DWORD key) const { return (key < KEYBOARD_BUFFER_SIZE) ? m_ReleaseTimes[key] : 0; }
+
+    // Events of the current frame: hardware events first, then synthetic repeats,
+    // which carry the number of repeats they stand for in uAppData
+    int GetEventCount() const { return (int)(m_Events.GetCount() + m_RepeatEvents.GetCount()); }
+    const InputEvent *GetEvent(int i) const;
+    const InputEventRing &GetHardwareEvents() const { return m_Events; }
+    const InputEventRing &GetRepeatEvents() const { return m_RepeatEvents; }
+
+    DWORD GetOverflowCount() const { return m_OverflowCount; } // Device buffer overflows (events lost by the device)
+    DWORD GetDroppedCount() const;                             // Events dropped because a ring reached its limit
+
+    // Key masks (see KeyMask.h), kept in sync with the byte-per-key state
+    const DWORD *GetDownMask() const { return m_DownMask; }         // Keys with INPUT_KS_PRESSED set
+    const DWORD *GetPressedMask() const { return m_PressedMask; }   // Keys that went down this frame
+    const DWORD *GetReleasedMask() const { return m_ReleasedMask; } // Keys with INPUT_KS_RELEASED set
+
+    // Keys whose state is not idle, in no particular order. PostProcess and the clears
+    // only visit these, so their cost follows the activity rather than the key count.
+    int GetActiveKeyCount() const { return m_ActiveCount; }
+    const BYTE *GetActiveKeys() const { return m_ActiveKeys; }
+
+private:
+    HRESULT Read();
+    InputTime Now() const;
+    void Press(DWORD key, DWORD stamp, InputTime time);
+    void Release(DWORD key, int stamp, InputTime time);
+    void Resync();
+    void Repeat(DWORD now, InputTime time);
+    void Activate(DWORD key);
+    void SyncState(); // Rebuilds the masks and the active keys from the bytes
+    void ClearState(); // Idles the active keys, clears the masks and the repeats
+    void ClearTimes(); // Forgets the stamps and times of the touched keys
+
+    InputBackend *m_Backend;
+    InputDevice *m_Device;
+    DWORD m_DownMask[KEYMASK_WORDS];
+    DWORD m_PressedMask[KEYMASK_WORDS];
+    DWORD m_ReleasedMask[KEYMASK_WORDS];
+    DWORD m_ActiveMask[KEYMASK_WORDS];  // Keys in m_ActiveKeys
+    DWORD m_TouchedMask[KEYMASK_WORDS]; // Keys in m_TouchedKeys
+    BYTE m_ActiveKeys[KEYBOARD_BUFFER_SIZE];
+    BYTE m_TouchedKeys[KEYBOARD_BUFFER_SIZE]; // Keys with stamps or times set since the last Clear or Reset
+    int m_ActiveCount;
+    int m_TouchedCount;
+    KeyRepeatQueue m_Repeats;
+    BYTE m_State[KEYBOARD_BUFFER_SIZE];
+    BOOL m_StateDirty; // m_State was handed out writable since the last sweep
+    int m_Stamps[KEYBOARD_BUFFER_SIZE]; // Legacy millisecond stamps: press time, or press duration once released
+    InputTime m_PressTimes[KEYBOARD_BUFFER_SIZE];
+    InputTime m_ReleaseTimes[KEYBOARD_BUFFER_SIZE];
+    InputTime m_LastEventTime;
+    DIDEVICEOBJECTDATA m_ReadBuffer[KEYBOARD_BUFFER_SIZE];
+    InputEventRing m_Events;
+    InputEventRing m_RepeatEvents;
+    BOOL m_Overflowed;
+    DWORD m_OverflowCount;
+    BOOL m_EnableRepetition;
+    DWORD m_RepeatDelay;
+    DWORD m_RepeatInterval;
+    LatencyHistogram *m_IngestLatency;
+    InputFrameStats *m_Stats;
+};
+
+class InputMouse
+{
+    friend class DX8InputManager;
+
+public:
+    InputMouse();
+    void Init(InputBackend *backend, InputDevice *device, HWND hWnd);
+    void Release();
+    void Clear();
+    void Poll(BOOL pause);
+    void PostProcess();
+    BOOL IsAttached() const { return m_Device != NULL; }
+    // Receives the delay between each buffered event and the poll that reads it; NULL disables it
+    void SetIngestLatency(LatencyHistogram *histogram) { m_IngestLatency = histogram; }
+    // Receives the cost of the polls and reacquisitions; NULL disables it
+    void SetFrameStats(InputFrameStats *stats) { m_Stats = stats; }
+    // Receives the motion reports of each poll; NULL disables it. With a history the
+    // default mode also drains the whole device buffer, like the buffered-only mode.
+    void SetMotionHistory(InputMotionHistory *history) { m_Motion = history; }
+    const InputMotionHistory *GetMotionHistory() const { return m_Motion; }
+
+    // Buffered-only mode: motion, wheel and buttons all come from the buffered events,
+    // drained without the GetDeviceState call of the default mode. With a cursor source
+    // other than INPUT_CURSOR_QUERY a poll is then a single device call.
+    void SetBufferedOnly(BOOL enable);
+    BOOL IsBufferedOnly() const { return m_BufferedOnly; }
+    // resyncPolls is the query interval of INPUT_CURSOR_MOTION, 0 never queries. The motion
+    // is in device units, which only match pixels without pointer acceleration.
+    void SetCursorSource(INPUT_CURSOR_SOURCE source, DWORD resyncPolls = 0);
+    INPUT_CURSOR_SOURCE GetCursorSource() const { return m_CursorSource; }
+    // Cursor in screen coordinates, as reported by the window messages
+    void SetCursorPosition(float x, float y);
+
+    const DIMOUSESTATE &GetState() const { return m_State; }
+    const float *GetPosition() const { return m_Position; } // Cursor, in screen coordinates
+    int GetWheelPosition() const { return m_WheelPosition; }
+    InputTime GetTime() const { return m_Time; } // When position and motion were last sampled
+    InputTime GetButtonTime(int button) const { return (button >= 0 && button < 4) ? m_ButtonTimes[button] : 0; }
+
+    // Buffered events of the current frame, i must be less than GetEventCount()
+    int GetEventCount() const { return m_NumberOfBuffer; }
+    const DIDEVICEOBJECTDATA &GetEvent(int i) const { return m_Buffer[i]; }
+    InputTime GetEventTime(int i) const { return InputTimeFromTick(m_PollTime, m_PollTick, m_Buffer[i].dwTimeStamp); }
+
+private:
+    HRESULT ReadData(DIDEVICEOBJECTDATA *buffer, DWORD *count);
+    // Applies the button events, and sums the motion events into motion when given
+    void ApplyEvents(const DIDEVICEOBJECTDATA *events, int count, InputTime now, DWORD tick, LONG *motion);
+    HRESULT PollBuffered(BOOL pause, LONG *motion);
+    // Reads the events left once m_Buffer was filled with count events
+    HRESULT DrainSpill(DWORD count, BOOL pause, InputTime now, DWORD tick, LONG *motion);
+    void QueryCursor();
+    void MoveCursor(const LONG *motion);
+
+    InputBackend *m_Backend;
+    InputDevice *m_Device;
+    float m_Position[2];
+    DIMOUSESTATE m_State;
+    BYTE m_LastButtons[4];
+    InputTime m_ButtonTimes[4]; // Time of the latest edge of each button
+    InputTime m_Time;
+    InputTime m_PollTime; // Clock and tick count sampled together when the buffer was read
+    DWORD m_PollTick;
+    DIDEVICEOBJECTDATA m_Buffer[MOUSE_BUFFER_SIZE];
+    int m_NumberOfBuffer;
+    int m_WheelPosition;
+    BOOL m_BufferedOnly;
+    INPUT_CURSOR_SOURCE m_CursorSource;
+    DWORD m_CursorResync; // Polls between two queries of INPUT_CURSOR_MOTION, 0 for none
+    DWORD m_CursorPolls;  // Polls since the last query
+    LatencyHistogram *m_IngestLatency;
+    InputFrameStats *m_Stats;
+    InputMotionHistory *m_Motion;
+};
+
+class InputJoystick
+{
+    friend class DX8InputManager;
+
+public:
+    InputJoystick();
+    void Attach(InputBackend *backend, InputDevice *device, const InputDeviceInfo &info);
+    // Attaches a device already acquired and queried elsewhere, without calling it
+    void Attach(InputBackend *backend, InputDevice *device, const InputDeviceInfo &info,
+                const InputDeviceCaps &caps, const InputAxisRange ranges[INPUT_AXIS_COUNT]);
+    void Init(HWND hWnd);
+    void Release();
+    void Clear();
+    void Poll();
+    // Polls like Poll without touching the frame stats, so it can run on another thread;
+    // ReportPollCost then adds the cost to them from the thread that owns them
+    void PollDetached();
+    void ReportPollCost();
+    void GetInfo();
+    BOOL IsAttached() const { return m_Device != NULL; }
+    // Releases the device of an unplugged controller, keeping its identity for when it returns
+    void Detach();
+    BOOL IsDetached() const { return m_Detached; }
+    const GUID &GetGUID() const { return m_DeviceGUID; }
+    // Marks the cached state stale so the next query polls the device again
+    void Invalidate() { m_Polled = FALSE; }
+    // Starts a frame: the buttons become the previous frame's and the edges are cleared
+    void BeginFrame();
+    // Receives the cost of the polls and reacquisitions; NULL disables it
+    void SetFrameStats(InputFrameStats *stats) { m_Stats = stats; }
+
+    const float *GetPosition() const { return m_Position; }
+    const float *GetRotation() const { return m_Rotation; }
+    const float *GetSliders() const { return m_Sliders; }
+    DWORD GetPointOfViewAngle() const { return m_PointOfViewAngle; } // Hundredths of degrees, -1 when centered
+    DWORD GetButtons() const { return m_ButtonMask[0]; } // Buttons 0 to 31
+    // JOYSTICK_BUTTON_WORDS words each, bit (b & 31) of word (b >> 5) for button b
+    const DWORD *GetButtonMask() const { return m_ButtonMask; }
+    const DWORD *GetLastButtonMask() const { return m_LastButtonMask; } // At the end of the previous frame
+    const DWORD *GetPressedMask() const { return m_PressedMask; }       // Went down during the frame
+    const DWORD *GetReleasedMask() const { return m_ReleasedMask; }     // Went up during the frame
+    // Replaces the buttons, adding the differences to the edges of the frame
+    void SetButtons(const DWORD *mask);
+    InputTime GetTime() const { return m_Time; } // When the state was last read from the device
+    InputTime GetPollTicks() const { return m_PollTicks; } // Cost of the last poll, in stopwatch ticks
+    HRESULT GetPollResult() const { return m_PollResult; }
+
+    // A response curve replaces the gain of its axis (0 to AXIS_KERNEL_AXES - 1, in
+    // DIJOYSTATE2 order); FALSE if the axis or the points are invalid
+    BOOL SetResponseCurve(int axis, const float *x, const float *y, int count, BOOL symmetric);
+    void ClearResponseCurve(int axis);
+    BOOL HasResponseCurve(int axis) const { return axis >= 0 && axis < AXIS_KERNEL_AXES && m_Curves[axis].Enabled; }
+
+private:
+    void ResetState();
+    // Reads the device into the state, timing it in stats when given
+    HRESULT Read(InputFrameStats *stats);
+    // Recomputes m_AxisScale; call whenever the capabilities or a range change
+    void UpdateAxisScale();
+    // Replaces the capabilities and ranges; absent axes get the default range
+    void SetAxisRanges(const InputAxisRange ranges[INPUT_AXIS_COUNT]);
+
+    // Axis capability flags
+    struct AxisCapabilities
+    {
+        BOOL hasX, hasY, hasZ;
+        BOOL hasRx, hasRy, hasRz;
+        BOOL hasSlider0, hasSlider1;
+
+        AxisCapabilities()
+        {
+            hasX = hasY = hasZ = FALSE;
+            hasRx = hasRy = hasRz = FALSE;
+            hasSlider0 = hasSlider1 = FALSE;
+        }
+    };
+
+    InputBackend *m_Backend;
+    InputDevice *m_Device;
+    InputFrameStats *m_Stats;
+    GUID m_DeviceGUID;           // Device instance GUID
+    char m_DeviceName[MAX_PATH]; // Device product name
+    AxisCapabilities m_AxisCaps; // Track which axes are available on this device
+    float m_DeadzoneRadius;      // Deadzone radius (0.0 to 1.0, default 0.01)
+    float m_Gain;                // Sensitivity gain multiplier (0.0 to 2.0, default 1.0)
+    int m_ButtonCount;           // Number of buttons on this device
+    BOOL m_Polled;
+    BOOL m_Detached;             // Device unplugged since it was attached
+    InputTime m_PollTicks;
+    HRESULT m_PollResult;
+    BOOL m_PollPending; // PollDetached cost not reported yet
+    float m_Position[3];
+    float m_Rotation[3];
+    float m_Sliders[2];
+    DWORD m_PointOfViewAngle;
+    DWORD m_ButtonMask[JOYSTICK_BUTTON_WORDS];
+    DWORD m_LastButtonMask[JOYSTICK_BUTTON_WORDS];
+    DWORD m_PressedMask[JOYSTICK_BUTTON_WORDS];
+    DWORD m_ReleasedMask[JOYSTICK_BUTTON_WORDS];
+    InputTime m_Time;
+    LONG m_Xmin;  // Minimum X-coordinate
+    LONG m_Xmax;  // Maximum X-coordinate
+    LONG m_Ymin;  // Minimum Y-coordinate
+    LONG m_Ymax;  // Maximum Y-coordinate
+    LONG m_Zmin;  // Minimum Z-coordinate
+    LONG m_Zmax;  // Maximum Z-coordinate
+    LONG m_XRmin; // Minimum X-rotation
+    LONG m_XRmax; // Maximum X-rotation
+    LONG m_YRmin; // Minimum Y-rotation
+    LONG m_YRmax; // Maximum Y-rotation
+    LONG m_ZRmin; // Minimum Z-rotation
+    LONG m_ZRmax; // Maximum Z-rotation
+    LONG m_Umin;  // Minimum u-coordinate (fifth axis)
+    LONG m_Vmin;  // Minimum v-coordinate (sixth axis)
+    LONG m_Umax;  // Maximum u-coordinate (fifth axis)
+    LONG m_Vmax;  // Maximum v-coordinate (sixth axis)
+    InputAxisScale m_AxisScale; // Normalization derived from the ranges above
+    InputResponseCurve m_Curves[AXIS_KERNEL_AXES];
+    int m_CurveCount; // Axes with a curve
+};
+
+#endif // INPUTDEVICES_H
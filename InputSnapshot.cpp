@@ -0,0 +1,101 @@
+#include "InputSnapshot.h"
+
+#include <string.h>
+
+InputSnapshotBuffer::InputSnapshotBuffer() : m_Current(-1), m_Frame(0), m_Skipped(0)
+{
+    m_Slots = new InputSnapshot[INPUT_SNAPSHOT_SLOTS];
+    memset(m_Slots, 0, INPUT_SNAPSHOT_SLOTS * sizeof(InputSnapshot));
+    for (int i = 0; i < INPUT_SNAPSHOT_SLOTS; i++)
+        m_Readers[i] = 0;
+}
+
+InputSnapshotBuffer::~InputSnapshotBuffer()
+{
+    delete[] m_Slots;
+}
+
+BOOL InputSnapshotBuffer::Publish(const InputKeyboard &keyboard, const InputMouse &mouse, InputJoystick *joysticks, int joystickCount, InputTime time)
+{
+    // Only this thread changes m_Current. A reader that still sees an older slot as
+    // current fails its check once the exchange below made another slot current,
+    // so a slot without readers here cannot gain one before it is published again.
+    LONG current = m_Current;
+    int slot = -1;
+    for (int i = 0; i < INPUT_SNAPSHOT_SLOTS && slot < 0; i++)
+    {
+        if (i != current && InputAtomicAdd(&m_Readers[i], 0) == 0)
+            slot = i;
+    }
+    if (slot < 0)
+    {
+        ++m_Skipped;
+        return FALSE;
+    }
+
+    InputSnapshot &snapshot = m_Slots[slot];
+    snapshot.Frame = ++m_Frame;
+    snapshot.Time = time;
+
+    snapshot.KeyboardAttached = keyboard.IsAttached();
+    memcpy(snapshot.KeyboardState, keyboard.GetState(), sizeof(snapshot.KeyboardState));
+    memcpy(snapshot.KeyboardDown, keyboard.GetDownMask(), sizeof(snapshot.KeyboardDown));
+    memcpy(snapshot.KeyboardPressed, keyboard.GetPressedMask(), sizeof(snapshot.KeyboardPressed));
+    memcpy(snapshot.KeyboardReleased, keyboard.GetReleasedMask(), sizeof(snapshot.KeyboardReleased));
+
+    snapshot.MouseAttached = mouse.IsAttached();
+    snapshot.MouseState = mouse.GetState();
+    snapshot.MousePosition[0] = mouse.GetPosition()[0];
+    snapshot.MousePosition[1] = mouse.GetPosition()[1];
+    snapshot.MouseWheelPosition = mouse.GetWheelPosition();
+    snapshot.MouseTime = mouse.GetTime();
+
+    if (joystickCount > INPUT_SNAPSHOT_MAX_JOYSTICKS)
+        joystickCount = INPUT_SNAPSHOT_MAX_JOYSTICKS;
+    snapshot.JoystickCount = joystickCount;
+    for (int i = 0; i < joystickCount; i++)
+    {
+        InputJoystick &joystick = joysticks[i];
+        InputJoystickSnapshot &state = snapshot.Joysticks[i];
+        state.Attached = joystick.IsAttached();
+        if (state.Attached)
+            joystick.Poll();
+        memcpy(state.Position, joystick.GetPosition(), sizeof(state.Position));
+        memcpy(state.Rotation, joystick.GetRotation(), sizeof(state.Rotation));
+        memcpy(state.Sliders, joystick.GetSliders(), sizeof(state.Sliders));
+        state.PointOfViewAngle = joystick.GetPointOfViewAngle();
+        memcpy(state.Buttons, joystick.GetButtonMask(), sizeof(state.Buttons));
+        memcpy(state.Pressed, joystick.GetPressedMask(), sizeof(state.Pressed));
+        memcpy(state.Released, joystick.GetReleasedMask(), sizeof(state.Released));
+        state.Time = joystick.GetTime();
+    }
+
+    InputAtomicExchange(&m_Current, slot);
+    return TRUE;
+}
+
+const InputSnapshot *InputSnapshotBuffer::Acquire()
+{
+    for (;;)
+    {
+        LONG slot = InputAtomicLoad(&m_Current);
+        if (slot < 0)
+            return NULL;
+
+        // Still current once counted: the writer will not reuse it until released
+        InputAtomicAdd(&m_Readers[slot], 1);
+        if (InputAtomicLoad(&m_Current) == slot)
+            return &m_Slots[slot];
+        InputAtomicAdd(&m_Readers[slot], -1);
+    }
+}
+
+void InputSnapshotBuffer::Release(const InputSnapshot *snapshot)
+{
+    if (!snapshot)
+        return;
+
+    int slot = (int)(snapshot - m_Slots);
+    if (slot >= 0 && slot < INPUT_SNAPSHOT_SLOTS)
+        InputAtomicAdd(&m_Readers[slot], -1);
+}
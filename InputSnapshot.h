@@ -0,0 +1,100 @@
+#ifndef INPUTSNAPSHOT_H
+#define INPUTSNAPSHOT_H
+
+#include "InputDevices.h"
+#include "InputThread.h"
+
+#define INPUT_SNAPSHOT_SLOTS 4          // Current snapshot plus the older ones readers may still hold
+#define INPUT_SNAPSHOT_MAX_JOYSTICKS 16 // DX8InputManager::SetMaxJoysticks limit
+
+struct InputJoystickSnapshot
+{
+    BOOL Attached;
+    float Position[3];
+    float Rotation[3];
+    float Sliders[2];
+    DWORD PointOfViewAngle; // Hundredths of degrees, -1 when centered
+    DWORD Buttons[JOYSTICK_BUTTON_WORDS];  // Buttons held
+    DWORD Pressed[JOYSTICK_BUTTON_WORDS];  // Went down during the frame
+    DWORD Released[JOYSTICK_BUTTON_WORDS]; // Went up during the frame
+    InputTime Time; // When the state was read from the device
+};
+
+// Device states as PreProcess left them. Never modified once published.
+struct InputSnapshot
+{
+    DWORD Frame;    // Publication number, counted from 1
+    InputTime Time; // Backend clock when published
+
+    BOOL KeyboardAttached;
+    BYTE KeyboardState[KEYBOARD_BUFFER_SIZE]; // INPUT_KEY_STATE bits per scancode
+    DWORD KeyboardDown[KEYMASK_WORDS];
+    DWORD KeyboardPressed[KEYMASK_WORDS];
+    DWORD KeyboardReleased[KEYMASK_WORDS];
+
+    BOOL MouseAttached;
+    DIMOUSESTATE MouseState; // Motion of the frame and INPUT_KEY_STATE bits per button
+    float MousePosition[2];
+    int MouseWheelPosition;
+    InputTime MouseTime;
+
+    int JoystickCount;
+    InputJoystickSnapshot Joysticks[INPUT_SNAPSHOT_MAX_JOYSTICKS];
+};
+
+// Snapshots published by one thread and read by any number of others without
+// locks. Each slot counts its readers; the writer fills a slot that is neither
+// current nor read, then swaps it in as current with one atomic exchange.
+// Readers hold a snapshot as long as they need, it stays valid until released.
+class InputSnapshotBuffer
+{
+public:
+    InputSnapshotBuffer();
+    ~InputSnapshotBuffer(); // No reader may hold a snapshot
+
+    // Writer side. Copies the device states into a free slot and makes it current;
+    // joysticks are polled here, so later queries of the frame reuse the poll.
+    // Returns FALSE, leaving the previous snapshot current, when readers hold every other slot.
+    BOOL Publish(const InputKeyboard &keyboard, const InputMouse &mouse, InputJoystick *joysticks, int joystickCount, InputTime time);
+    DWORD GetPublishedCount() const { return m_Frame; }
+    DWORD GetSkippedCount() const { return m_Skipped; }
+
+    // Reader side, any thread. The current snapshot, NULL before the first Publish;
+    // every snapshot acquired must be released.
+    const InputSnapshot *Acquire();
+    void Release(const InputSnapshot *snapshot);
+
+private:
+    InputSnapshotBuffer(const InputSnapshotBuffer &);
+    InputSnapshotBuffer &operator=(const InputSnapshotBuffer &);
+
+    InputSnapshot *m_Slots;
+    volatile LONG m_Readers[INPUT_SNAPSHOT_SLOTS];
+    volatile LONG m_Current; // Slot index, -1 before the first Publish
+    DWORD m_Frame;
+    DWORD m_Skipped;
+};
+
+// Holds the current snapshot from construction to destruction
+class InputSnapshotRef
+{
+public:
+    explicit InputSnapshotRef(InputSnapshotBuffer *buffer) : m_Buffer(buffer), m_Snapshot(buffer ? buffer->Acquire() : NULL) {}
+    ~InputSnapshotRef()
+    {
+        if (m_Snapshot)
+            m_Buffer->Release(m_Snapshot);
+    }
+
+    const InputSnapshot *Get() const { return m_Snapshot; } // NULL when there is none
+    const InputSnapshot *operator->() const { return m_Snapshot; }
+
+private:
+    InputSnapshotRef(const InputSnapshotRef &);
+    InputSnapshotRef &operator=(const InputSnapshotRef &);
+
+    InputSnapshotBuffer *m_Buffer;
+    const InputSnapshot *m_Snapshot;
+};
+
+#endif // INPUTSNAPSHOT_H
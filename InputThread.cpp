@@ -0,0 +1,193 @@
+#include "InputThread.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <time.h>
+#endif
+
+void InputSleep(DWORD ms)
+{
+#ifdef _WIN32
+    ::Sleep(ms);
+#else
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        continue;
+#endif
+}
+
+//
+// InputMutex
+//
+
+InputMutex::InputMutex()
+{
+#ifdef _WIN32
+    ::InitializeCriticalSection(&m_Section);
+#else
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&m_Mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+#endif
+}
+
+InputMutex::~InputMutex()
+{
+#ifdef _WIN32
+    ::DeleteCriticalSection(&m_Section);
+#else
+    pthread_mutex_destroy(&m_Mutex);
+#endif
+}
+
+void InputMutex::Lock()
+{
+#ifdef _WIN32
+    ::EnterCriticalSection(&m_Section);
+#else
+    pthread_mutex_lock(&m_Mutex);
+#endif
+}
+
+void InputMutex::Unlock()
+{
+#ifdef _WIN32
+    ::LeaveCriticalSection(&m_Section);
+#else
+    pthread_mutex_unlock(&m_Mutex);
+#endif
+}
+
+//
+// InputSignal
+//
+
+InputSignal::InputSignal()
+{
+#ifdef _WIN32
+    m_Event = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+#else
+    m_Event = NULL;
+    pthread_mutex_init(&m_Mutex, NULL);
+    pthread_cond_init(&m_Cond, NULL);
+    m_Signaled = FALSE;
+#endif
+}
+
+InputSignal::~InputSignal()
+{
+#ifdef _WIN32
+    if (m_Event)
+        ::CloseHandle(m_Event);
+#else
+    pthread_cond_destroy(&m_Cond);
+    pthread_mutex_destroy(&m_Mutex);
+#endif
+}
+
+void InputSignal::Set()
+{
+#ifdef _WIN32
+    ::SetEvent(m_Event);
+#else
+    pthread_mutex_lock(&m_Mutex);
+    m_Signaled = TRUE;
+    pthread_cond_signal(&m_Cond);
+    pthread_mutex_unlock(&m_Mutex);
+#endif
+}
+
+BOOL InputSignal::Wait(DWORD ms)
+{
+#ifdef _WIN32
+    return ::WaitForSingleObject(m_Event, ms) == WAIT_OBJECT_0;
+#else
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ms / 1000;
+    deadline.tv_nsec += (long)(ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_nsec -= 1000000000;
+        ++deadline.tv_sec;
+    }
+
+    pthread_mutex_lock(&m_Mutex);
+    while (!m_Signaled)
+    {
+        if (pthread_cond_timedwait(&m_Cond, &m_Mutex, &deadline) == ETIMEDOUT)
+            break;
+    }
+    BOOL signaled = m_Signaled;
+    m_Signaled = FALSE;
+    pthread_mutex_unlock(&m_Mutex);
+    return signaled;
+#endif
+}
+
+//
+// InputThread
+//
+
+InputThread::InputThread() : m_Function(NULL), m_Arg(NULL), m_Running(FALSE)
+{
+#ifdef _WIN32
+    m_Thread = NULL;
+#endif
+}
+
+InputThread::~InputThread()
+{
+    Join();
+}
+
+#ifdef _WIN32
+DWORD WINAPI InputThread::Entry(LPVOID arg)
+{
+    InputThread *thread = (InputThread *)arg;
+    thread->m_Function(thread->m_Arg);
+    return 0;
+}
+#else
+void *InputThread::Entry(void *arg)
+{
+    InputThread *thread = (InputThread *)arg;
+    thread->m_Function(thread->m_Arg);
+    return NULL;
+}
+#endif
+
+BOOL InputThread::Start(Function function, void *arg)
+{
+    if (m_Running || !function)
+        return FALSE;
+
+    m_Function = function;
+    m_Arg = arg;
+#ifdef _WIN32
+    m_Thread = ::CreateThread(NULL, 0, Entry, this, 0, NULL);
+    m_Running = m_Thread != NULL;
+#else
+    m_Running = pthread_create(&m_Thread, NULL, Entry, this) == 0;
+#endif
+    return m_Running;
+}
+
+void InputThread::Join()
+{
+    if (!m_Running)
+        return;
+
+#ifdef _WIN32
+    ::WaitForSingleObject(m_Thread, INFINITE);
+    ::CloseHandle(m_Thread);
+    m_Thread = NULL;
+#else
+    pthread_join(m_Thread, NULL);
+#endif
+    m_Running = FALSE;
+}
@@ -0,0 +1,124 @@
+#ifndef INPUTTHREAD_H
+#define INPUTTHREAD_H
+
+#include "InputBackend.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// Minimal threading layer for the input core: Win32 primitives on Windows,
+// pthreads elsewhere. The code base is C++98, so there is no std::thread or
+// std::atomic to build on.
+
+// Atomic accesses to an aligned 32-bit word. Loads have acquire and stores
+// release semantics; Exchange is a full barrier.
+#if defined(_MSC_VER)
+inline LONG InputAtomicLoad(const volatile LONG *p)
+{
+    LONG value = *p;
+    _ReadWriteBarrier();
+    return value;
+}
+inline void InputAtomicStore(volatile LONG *p, LONG value) { ::InterlockedExchange(p, value); }
+inline LONG InputAtomicExchange(volatile LONG *p, LONG value) { return ::InterlockedExchange(p, value); }
+inline LONG InputAtomicAdd(volatile LONG *p, LONG value) { return ::InterlockedExchangeAdd(p, value) + value; }
+#else
+inline LONG InputAtomicLoad(const volatile LONG *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+inline void InputAtomicStore(volatile LONG *p, LONG value) { __atomic_store_n(p, value, __ATOMIC_RELEASE); }
+inline LONG InputAtomicExchange(volatile LONG *p, LONG value) { return __atomic_exchange_n(p, value, __ATOMIC_SEQ_CST); }
+inline LONG InputAtomicAdd(volatile LONG *p, LONG value) { return __atomic_add_fetch(p, value, __ATOMIC_SEQ_CST); }
+#endif
+
+void InputSleep(DWORD ms);
+
+// Recursive mutex
+class InputMutex
+{
+public:
+    InputMutex();
+    ~InputMutex();
+    void Lock();
+    void Unlock();
+
+private:
+    InputMutex(const InputMutex &);
+    InputMutex &operator=(const InputMutex &);
+
+#ifdef _WIN32
+    CRITICAL_SECTION m_Section;
+#else
+    pthread_mutex_t m_Mutex;
+#endif
+};
+
+class InputMutexLock
+{
+public:
+    explicit InputMutexLock(InputMutex &mutex) : m_Mutex(mutex) { m_Mutex.Lock(); }
+    ~InputMutexLock() { m_Mutex.Unlock(); }
+
+private:
+    InputMutexLock(const InputMutexLock &);
+    InputMutexLock &operator=(const InputMutexLock &);
+
+    InputMutex &m_Mutex;
+};
+
+// Auto-reset event: Set wakes one waiter, or the next one to wait
+class InputSignal
+{
+public:
+    InputSignal();
+    ~InputSignal();
+    void Set();
+    // Returns TRUE if signaled, FALSE on timeout
+    BOOL Wait(DWORD ms);
+    // Win32 event handle (for IDirectInputDevice8::SetEventNotification), NULL elsewhere
+    void *GetNativeHandle() { return m_Event; }
+
+private:
+    InputSignal(const InputSignal &);
+    InputSignal &operator=(const InputSignal &);
+
+#ifdef _WIN32
+    HANDLE m_Event;
+#else
+    void *m_Event;
+    pthread_mutex_t m_Mutex;
+    pthread_cond_t m_Cond;
+    BOOL m_Signaled;
+#endif
+};
+
+class InputThread
+{
+public:
+    typedef void (*Function)(void *arg);
+
+    InputThread();
+    ~InputThread(); // Joins a thread still running
+
+    BOOL Start(Function function, void *arg);
+    void Join();
+    BOOL IsRunning() const { return m_Running; }
+
+private:
+    InputThread(const InputThread &);
+    InputThread &operator=(const InputThread &);
+
+#ifdef _WIN32
+    static DWORD WINAPI Entry(LPVOID arg);
+    HANDLE m_Thread;
+#else
+    static void *Entry(void *arg);
+    pthread_t m_Thread;
+#endif
+    Function m_Function;
+    void *m_Arg;
+    BOOL m_Running;
+};
+
+#endif // INPUTTHREAD_H
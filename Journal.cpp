@@ -0,0 +1,679 @@
+#include "Journal.h"
+
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static DWORD ZigZag(LONG value)
+{
+    return ((DWORD)value << 1) ^ (DWORD)(value >> 31);
+}
+
+static LONG UnZigZag(DWORD value)
+{
+    return (LONG)(value >> 1) ^ -(LONG)(value & 1);
+}
+
+static InputTime ZigZag64(JournalInt64 value)
+{
+    return ((InputTime)value << 1) ^ (InputTime)(value >> 63);
+}
+
+static JournalInt64 UnZigZag64(InputTime value)
+{
+    return (JournalInt64)(value >> 1) ^ -(JournalInt64)(value & 1);
+}
+
+//
+// JournalWriter
+//
+
+JournalWriter::JournalWriter() : m_File(NULL), m_Size(0)
+{
+    Close();
+}
+
+JournalWriter::~JournalWriter()
+{
+    Close();
+}
+
+BOOL JournalWriter::Open(const char *path)
+{
+    Close();
+    if (!path)
+        return FALSE;
+
+    m_File = fopen(path, "wb");
+    if (!m_File)
+        return FALSE;
+
+    DWORD header[2] = {JOURNAL_MAGIC, JOURNAL_VERSION};
+    PutBytes(header, sizeof(header));
+    Flush();
+    return TRUE;
+}
+
+void JournalWriter::Close()
+{
+    if (m_File)
+    {
+        Flush();
+        fclose(m_File);
+        m_File = NULL;
+    }
+
+    m_Size = 0;
+    m_LastTick = 0;
+    m_LastTime = 0;
+    m_LastCursor[0] = m_LastCursor[1] = 0;
+    m_LastSequence = 0;
+    memset(m_LastStamp, 0, sizeof(m_LastStamp));
+    memset(m_States, 0, sizeof(m_States));
+}
+
+void JournalWriter::WriteFrameBegin()
+{
+    PutByte(JOURNAL_FRAME_BEGIN);
+}
+
+void JournalWriter::WriteFrameEnd()
+{
+    PutByte(JOURNAL_FRAME_END);
+    Flush();
+}
+
+void JournalWriter::WriteInitialize(HRESULT hr)
+{
+    PutByte(JOURNAL_INITIALIZE);
+    PutSigned(hr);
+}
+
+void JournalWriter::WriteEnumDevice(const InputDeviceInfo &info)
+{
+    DWORD length = (DWORD)strlen(info.ProductName);
+    PutByte(JOURNAL_ENUM_DEVICE);
+    PutBytes(&info.InstanceGUID, sizeof(GUID));
+    PutVarint(length);
+    PutBytes(info.ProductName, length);
+}
+
+void JournalWriter::WriteEnumEnd(HRESULT hr)
+{
+    PutByte(JOURNAL_ENUM_END);
+    PutSigned(hr);
+}
+
+void JournalWriter::WriteCreateDevice(DWORD kind, const GUID &guid, HRESULT hr, DWORD device)
+{
+    PutByte(JOURNAL_CREATE_DEVICE);
+    PutVarint(kind);
+    PutBytes(&guid, sizeof(GUID));
+    PutSigned(hr);
+    PutVarint(device);
+}
+
+void JournalWriter::WriteCapabilities(DWORD device, HRESULT hr, const InputDeviceCaps &caps)
+{
+    PutByte(JOURNAL_CAPABILITIES);
+    PutVarint(device);
+    PutSigned(hr);
+    PutVarint(caps.Axes);
+    PutVarint(caps.Buttons);
+    PutVarint(caps.POVs);
+}
+
+void JournalWriter::WriteAxisRanges(DWORD device, HRESULT hr, const InputAxisRange ranges[INPUT_AXIS_COUNT])
+{
+    PutByte(JOURNAL_AXIS_RANGES);
+    PutVarint(device);
+    PutSigned(hr);
+    for (int i = 0; i < INPUT_AXIS_COUNT; i++)
+    {
+        PutByte(ranges[i].Present ? 1 : 0);
+        PutSigned(ranges[i].Min);
+        PutSigned(ranges[i].Max);
+    }
+}
+
+void JournalWriter::WriteAcquire(DWORD device, HRESULT hr)
+{
+    PutByte(JOURNAL_ACQUIRE);
+    PutVarint(device);
+    PutSigned(hr);
+}
+
+void JournalWriter::WritePoll(DWORD device, HRESULT hr)
+{
+    PutByte(JOURNAL_POLL);
+    PutVarint(device);
+    PutSigned(hr);
+}
+
+void JournalWriter::WriteDeviceData(DWORD device, HRESULT hr, const DIDEVICEOBJECTDATA *events, DWORD count)
+{
+    if (device >= JOURNAL_MAX_DEVICES)
+        return;
+    if (!events || count > JOURNAL_MAX_EVENTS)
+        count = 0;
+
+    PutByte(JOURNAL_DEVICE_DATA);
+    PutVarint(device);
+    PutSigned(hr);
+    PutVarint(count);
+    for (DWORD i = 0; i < count; i++)
+    {
+        const DIDEVICEOBJECTDATA &event = events[i];
+        PutVarint(event.dwOfs);
+        PutSigned((LONG)event.dwData);
+        PutSigned((LONG)(event.dwTimeStamp - m_LastStamp[device]));
+        PutSigned((LONG)(event.dwSequence - m_LastSequence));
+        PutVarint64((InputTime)event.uAppData);
+        m_LastStamp[device] = event.dwTimeStamp;
+        m_LastSequence = event.dwSequence;
+    }
+}
+
+void JournalWriter::WriteDeviceState(DWORD device, HRESULT hr, const void *state, DWORD size)
+{
+    if (device >= JOURNAL_MAX_DEVICES)
+        return;
+    if (!state)
+        size = 0;
+    if (size > JOURNAL_MAX_STATE_SIZE)
+        size = JOURNAL_MAX_STATE_SIZE;
+
+    PutByte(JOURNAL_DEVICE_STATE);
+    PutVarint(device);
+    PutSigned(hr);
+    PutVarint(size);
+
+    // Runs of bytes that changed since the previous state, stored XORed with it
+    const BYTE *current = (const BYTE *)state;
+    BYTE *previous = m_States[device];
+    DWORD pos = 0;
+    while (pos < size)
+    {
+        DWORD start = pos;
+        while (start < size && current[start] == previous[start])
+            ++start;
+        if (start == size)
+            break;
+        DWORD end = start;
+        while (end < size && current[end] != previous[end])
+            ++end;
+
+        PutVarint(start - pos);
+        PutVarint(end - start);
+        for (DWORD i = start; i < end; i++)
+        {
+            PutByte((BYTE)(current[i] ^ previous[i]));
+            previous[i] = current[i];
+        }
+        pos = end;
+    }
+    PutVarint(0);
+    PutVarint(0);
+}
+
+void JournalWriter::WriteTick(DWORD tick)
+{
+    PutByte(JOURNAL_TICK);
+    PutSigned((LONG)(tick - m_LastTick));
+    m_LastTick = tick;
+}
+
+void JournalWriter::WriteTime(InputTime time)
+{
+    PutByte(JOURNAL_TIME);
+    PutSigned64((JournalInt64)(time - m_LastTime));
+    m_LastTime = time;
+}
+
+void JournalWriter::WriteCursor(BOOL result, LONG x, LONG y)
+{
+    PutByte(JOURNAL_CURSOR);
+    PutByte(result ? 1 : 0);
+    PutSigned(x - m_LastCursor[0]);
+    PutSigned(y - m_LastCursor[1]);
+    m_LastCursor[0] = x;
+    m_LastCursor[1] = y;
+}
+
+void JournalWriter::WriteInjection(DWORD call, const void *head, DWORD headSize, const void *body, DWORD bodySize)
+{
+    if (!head)
+        headSize = 0;
+    if (!body)
+        bodySize = 0;
+
+    PutByte(JOURNAL_INJECTION);
+    PutVarint(call);
+    PutVarint(headSize + bodySize);
+    PutBytes(head, headSize);
+    PutBytes(body, bodySize);
+}
+
+void JournalWriter::Flush()
+{
+    if (m_File && m_Size > 0)
+    {
+        fwrite(m_Buffer, 1, m_Size, m_File);
+        fflush(m_File);
+    }
+    m_Size = 0;
+}
+
+void JournalWriter::PutByte(BYTE value)
+{
+    if (!m_File)
+        return;
+    if (m_Size == JOURNAL_BUFFER_SIZE)
+        Flush();
+    m_Buffer[m_Size++] = value;
+}
+
+void JournalWriter::PutBytes(const void *data, DWORD size)
+{
+    if (!m_File)
+        return;
+
+    const BYTE *bytes = (const BYTE *)data;
+    while (size > 0)
+    {
+        if (m_Size == JOURNAL_BUFFER_SIZE)
+            Flush();
+        DWORD chunk = JOURNAL_BUFFER_SIZE - m_Size;
+        if (chunk > size)
+            chunk = size;
+        memcpy(m_Buffer + m_Size, bytes, chunk);
+        m_Size += chunk;
+        bytes += chunk;
+        size -= chunk;
+    }
+}
+
+void JournalWriter::PutVarint(DWORD value)
+{
+    while (value >= 0x80)
+    {
+        PutByte((BYTE)(value | 0x80));
+        value >>= 7;
+    }
+    PutByte((BYTE)value);
+}
+
+void JournalWriter::PutVarint64(InputTime value)
+{
+    while (value >= 0x80)
+    {
+        PutByte((BYTE)(value | 0x80));
+        value >>= 7;
+    }
+    PutByte((BYTE)value);
+}
+
+void JournalWriter::PutSigned(LONG value)
+{
+    PutVarint(ZigZag(value));
+}
+
+void JournalWriter::PutSigned64(JournalInt64 value)
+{
+    PutVarint64(ZigZag64(value));
+}
+
+//
+// JournalReader
+//
+
+JournalReader::JournalReader() : m_Begin(NULL), m_End(NULL), m_Cursor(NULL), m_Corrupt(FALSE)
+{
+#ifdef _WIN32
+    m_FileHandle = INVALID_HANDLE_VALUE;
+    m_MappingHandle = NULL;
+#else
+    m_MappedSize = 0;
+#endif
+    Close();
+}
+
+JournalReader::~JournalReader()
+{
+    Close();
+}
+
+BOOL JournalReader::Open(const char *path)
+{
+    Close();
+    if (!path)
+        return FALSE;
+
+#ifdef _WIN32
+    m_FileHandle = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_FileHandle == INVALID_HANDLE_VALUE)
+        return FALSE;
+    DWORD size = ::GetFileSize(m_FileHandle, NULL);
+    if (size != INVALID_FILE_SIZE && size > 0)
+        m_MappingHandle = ::CreateFileMapping(m_FileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_MappingHandle)
+        m_Begin = (const BYTE *)::MapViewOfFile(m_MappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (!m_Begin)
+    {
+        Close();
+        return FALSE;
+    }
+    m_End = m_Begin + size;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return FALSE;
+    struct stat st;
+    void *mapping = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return FALSE;
+    m_MappedSize = (size_t)st.st_size;
+    m_Begin = (const BYTE *)mapping;
+    m_End = m_Begin + m_MappedSize;
+#endif
+
+    m_Cursor = m_Begin;
+    DWORD header[2];
+    if (!GetBytes(header, sizeof(header)) || header[0] != JOURNAL_MAGIC || header[1] != JOURNAL_VERSION)
+    {
+        Close();
+        return FALSE;
+    }
+    m_Corrupt = FALSE;
+    return TRUE;
+}
+
+void JournalReader::Close()
+{
+#ifdef _WIN32
+    if (m_Begin)
+        ::UnmapViewOfFile(m_Begin);
+    if (m_MappingHandle)
+        ::CloseHandle(m_MappingHandle);
+    if (m_FileHandle != INVALID_HANDLE_VALUE)
+        ::CloseHandle(m_FileHandle);
+    m_FileHandle = INVALID_HANDLE_VALUE;
+    m_MappingHandle = NULL;
+#else
+    if (m_Begin)
+        munmap((void *)m_Begin, m_MappedSize);
+    m_MappedSize = 0;
+#endif
+
+    m_Begin = m_End = m_Cursor = NULL;
+    m_Corrupt = FALSE;
+    m_LastTick = 0;
+    m_LastTime = 0;
+    m_LastCursor[0] = m_LastCursor[1] = 0;
+    m_LastSequence = 0;
+    memset(m_LastStamp, 0, sizeof(m_LastStamp));
+    memset(m_States, 0, sizeof(m_States));
+}
+
+DWORD JournalReader::Peek() const
+{
+    if (m_Corrupt || !m_Cursor || m_Cursor >= m_End)
+        return JOURNAL_END;
+    DWORD type = *m_Cursor;
+    return (type > JOURNAL_END && type < JOURNAL_RECORD_COUNT) ? type : (DWORD)JOURNAL_END;
+}
+
+BOOL JournalReader::Next(JournalRecord &record)
+{
+    DWORD type = Peek();
+    if (type == JOURNAL_END)
+        return FALSE;
+
+    const BYTE *start = m_Cursor++;
+    memset(&record, 0, sizeof(record));
+    record.Type = type;
+    if (!Decode(type, record))
+    {
+        // Leave the cursor on the damaged record so that Peek keeps reporting the end
+        m_Cursor = start;
+        m_Corrupt = TRUE;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+const BYTE *JournalReader::GetState(DWORD device) const
+{
+    return (device < JOURNAL_MAX_DEVICES) ? m_States[device] : NULL;
+}
+
+BOOL JournalReader::Decode(DWORD type, JournalRecord &record)
+{
+    LONG value;
+    switch (type)
+    {
+    case JOURNAL_FRAME_BEGIN:
+    case JOURNAL_FRAME_END:
+        return TRUE;
+
+    case JOURNAL_INITIALIZE:
+    case JOURNAL_ENUM_END:
+        if (!GetSigned(value))
+            return FALSE;
+        record.Result = value;
+        return TRUE;
+
+    case JOURNAL_ENUM_DEVICE:
+    {
+        DWORD length;
+        if (!GetBytes(&m_Info.InstanceGUID, sizeof(GUID)) || !GetVarint(length) || length >= MAX_PATH)
+            return FALSE;
+        if (!GetBytes(m_Info.ProductName, length))
+            return FALSE;
+        m_Info.ProductName[length] = '\0';
+        record.Info = &m_Info;
+        return TRUE;
+    }
+
+    case JOURNAL_CREATE_DEVICE:
+        if (!GetVarint(record.Kind) || !GetBytes(&record.Guid, sizeof(GUID)) || !GetSigned(value) || !GetVarint(record.Device))
+            return FALSE;
+        record.Result = value;
+        return record.Device < JOURNAL_MAX_DEVICES;
+
+    default:
+        break;
+    }
+
+    if (type == JOURNAL_TICK)
+    {
+        if (!GetSigned(value))
+            return FALSE;
+        m_LastTick += (DWORD)value;
+        record.Tick = m_LastTick;
+        return TRUE;
+    }
+    if (type == JOURNAL_TIME)
+    {
+        JournalInt64 delta;
+        if (!GetSigned64(delta))
+            return FALSE;
+        m_LastTime += (InputTime)delta;
+        record.Time = m_LastTime;
+        return TRUE;
+    }
+    if (type == JOURNAL_CURSOR)
+    {
+        BYTE result;
+        LONG dx, dy;
+        if (!GetByte(result) || !GetSigned(dx) || !GetSigned(dy))
+            return FALSE;
+        m_LastCursor[0] += dx;
+        m_LastCursor[1] += dy;
+        record.Result = result;
+        record.X = m_LastCursor[0];
+        record.Y = m_LastCursor[1];
+        return TRUE;
+    }
+    if (type == JOURNAL_INJECTION)
+    {
+        if (!GetVarint(record.Call) || !GetVarint(record.Count) || (DWORD)(m_End - m_Cursor) < record.Count)
+            return FALSE;
+        record.Data = m_Cursor;
+        m_Cursor += record.Count;
+        return TRUE;
+    }
+
+    // Device records: device id and call result first
+    if (!GetVarint(record.Device) || record.Device >= JOURNAL_MAX_DEVICES || !GetSigned(value))
+        return FALSE;
+    record.Result = value;
+
+    switch (type)
+    {
+    case JOURNAL_ACQUIRE:
+    case JOURNAL_POLL:
+        return TRUE;
+
+    case JOURNAL_CAPABILITIES:
+        if (!GetVarint(m_Caps.Axes) || !GetVarint(m_Caps.Buttons) || !GetVarint(m_Caps.POVs))
+            return FALSE;
+        record.Caps = &m_Caps;
+        return TRUE;
+
+    case JOURNAL_AXIS_RANGES:
+        for (int i = 0; i < INPUT_AXIS_COUNT; i++)
+        {
+            BYTE present;
+            if (!GetByte(present) || !GetSigned(m_Ranges[i].Min) || !GetSigned(m_Ranges[i].Max))
+                return FALSE;
+            m_Ranges[i].Present = present != 0;
+        }
+        record.Ranges = m_Ranges;
+        return TRUE;
+
+    case JOURNAL_DEVICE_DATA:
+    {
+        if (!GetVarint(record.Count) || record.Count > JOURNAL_MAX_EVENTS)
+            return FALSE;
+        DWORD &lastStamp = m_LastStamp[record.Device];
+        for (DWORD i = 0; i < record.Count; i++)
+        {
+            DIDEVICEOBJECTDATA &event = m_Events[i];
+            LONG data, stamp, sequence;
+            InputTime appData;
+            if (!GetVarint(event.dwOfs) || !GetSigned(data) || !GetSigned(stamp) || !GetSigned(sequence) || !GetVarint64(appData))
+                return FALSE;
+            lastStamp += (DWORD)stamp;
+            m_LastSequence += (DWORD)sequence;
+            event.dwData = (DWORD)data;
+            event.dwTimeStamp = lastStamp;
+            event.dwSequence = m_LastSequence;
+            event.uAppData = (UINT_PTR)appData;
+        }
+        record.Events = m_Events;
+        return TRUE;
+    }
+
+    case JOURNAL_DEVICE_STATE:
+    {
+        if (!GetVarint(record.Count) || record.Count > JOURNAL_MAX_STATE_SIZE)
+            return FALSE;
+        BYTE *state = m_States[record.Device];
+        DWORD pos = 0;
+        for (;;)
+        {
+            DWORD skip, length;
+            if (!GetVarint(skip) || !GetVarint(length))
+                return FALSE;
+            if (length == 0)
+                break;
+            pos += skip;
+            if (pos + length > record.Count || (DWORD)(m_End - m_Cursor) < length)
+                return FALSE;
+            for (DWORD i = 0; i < length; i++)
+                state[pos + i] ^= m_Cursor[i];
+            m_Cursor += length;
+            pos += length;
+        }
+        record.Data = state;
+        return TRUE;
+    }
+
+    default:
+        return FALSE;
+    }
+}
+
+BOOL JournalReader::GetByte(BYTE &value)
+{
+    if (m_Cursor >= m_End)
+        return FALSE;
+    value = *m_Cursor++;
+    return TRUE;
+}
+
+BOOL JournalReader::GetBytes(void *data, DWORD size)
+{
+    if ((DWORD)(m_End - m_Cursor) < size)
+        return FALSE;
+    memcpy(data, m_Cursor, size);
+    m_Cursor += size;
+    return TRUE;
+}
+
+BOOL JournalReader::GetVarint(DWORD &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        BYTE b;
+        if (!GetByte(b))
+            return FALSE;
+        value |= (DWORD)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+BOOL JournalReader::GetVarint64(InputTime &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 70; shift += 7)
+    {
+        BYTE b;
+        if (!GetByte(b))
+            return FALSE;
+        value |= (InputTime)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+BOOL JournalReader::GetSigned(LONG &value)
+{
+    DWORD encoded;
+    if (!GetVarint(encoded))
+        return FALSE;
+    value = UnZigZag(encoded);
+    return TRUE;
+}
+
+BOOL JournalReader::GetSigned64(JournalInt64 &value)
+{
+    InputTime encoded;
+    if (!GetVarint64(encoded))
+        return FALSE;
+    value = UnZigZag64(encoded);
+    return TRUE;
+}
@@ -0,0 +1,181 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdio.h>
+
+#include "InputBackend.h"
+
+// Input journal file format
+//
+// A header (magic, version) followed by records. Each record starts with a
+// JOURNAL_RECORD byte; integers are LEB128 varints, signed values are
+// zigzag-encoded. Event timestamps and sequence numbers are stored as deltas
+// from the previous event of the same device, device states as the XOR runs
+// against the previous state of the same device, and clock readings as deltas
+// from the previous reading.
+#define JOURNAL_MAGIC 0x4A495844 // "DXIJ"
+#define JOURNAL_VERSION 1
+
+#define JOURNAL_MAX_DEVICES 64
+#define JOURNAL_MAX_STATE_SIZE 512 // Larger device states are truncated
+#define JOURNAL_MAX_EVENTS 1024    // Per GetDeviceData record
+#define JOURNAL_BUFFER_SIZE 65536
+
+#if defined(_MSC_VER)
+typedef __int64 JournalInt64;
+#else
+typedef long long JournalInt64;
+#endif
+
+enum JOURNAL_RECORD
+{
+    JOURNAL_END = 0, // Not stored; returned at the end of the journal
+    JOURNAL_FRAME_BEGIN,
+    JOURNAL_FRAME_END,
+    JOURNAL_INITIALIZE,
+    JOURNAL_ENUM_DEVICE,
+    JOURNAL_ENUM_END,
+    JOURNAL_CREATE_DEVICE,
+    JOURNAL_CAPABILITIES,
+    JOURNAL_AXIS_RANGES,
+    JOURNAL_ACQUIRE,
+    JOURNAL_POLL,
+    JOURNAL_DEVICE_DATA,
+    JOURNAL_DEVICE_STATE,
+    JOURNAL_TICK,
+    JOURNAL_TIME,
+    JOURNAL_CURSOR,
+    JOURNAL_INJECTION,
+    JOURNAL_RECORD_COUNT
+};
+
+enum JOURNAL_DEVICE_KIND
+{
+    JOURNAL_KEYBOARD = 0,
+    JOURNAL_MOUSE = 1,
+    JOURNAL_JOYSTICK = 2
+};
+
+// A decoded record. Pointers refer to the reader's buffers or to the mapped
+// file and stay valid until the next call to JournalReader::Next().
+struct JournalRecord
+{
+    DWORD Type;
+    DWORD Device;  // Device id, in creation order
+    HRESULT Result;
+    DWORD Kind;    // JOURNAL_CREATE_DEVICE
+    GUID Guid;     // JOURNAL_CREATE_DEVICE
+    DWORD Count;   // Events in JOURNAL_DEVICE_DATA, bytes in JOURNAL_DEVICE_STATE and JOURNAL_INJECTION
+    DWORD Tick;    // JOURNAL_TICK
+    InputTime Time; // JOURNAL_TIME
+    LONG X, Y;     // JOURNAL_CURSOR
+    DWORD Call;    // JOURNAL_INJECTION
+    const DIDEVICEOBJECTDATA *Events;
+    const BYTE *Data; // Device state or injection payload
+    const InputDeviceInfo *Info;
+    const InputDeviceCaps *Caps;
+    const InputAxisRange *Ranges;
+};
+
+// Append-only journal writer. Records are buffered and written to the file at
+// every frame end, so a crash loses at most the current frame.
+class JournalWriter
+{
+public:
+    JournalWriter();
+    ~JournalWriter();
+
+    BOOL Open(const char *path);
+    void Close();
+    BOOL IsOpen() const { return m_File != NULL; }
+
+    void WriteFrameBegin();
+    void WriteFrameEnd();
+    void WriteInitialize(HRESULT hr);
+    void WriteEnumDevice(const InputDeviceInfo &info);
+    void WriteEnumEnd(HRESULT hr);
+    void WriteCreateDevice(DWORD kind, const GUID &guid, HRESULT hr, DWORD device);
+    void WriteCapabilities(DWORD device, HRESULT hr, const InputDeviceCaps &caps);
+    void WriteAxisRanges(DWORD device, HRESULT hr, const InputAxisRange ranges[INPUT_AXIS_COUNT]);
+    void WriteAcquire(DWORD device, HRESULT hr);
+    void WritePoll(DWORD device, HRESULT hr);
+    void WriteDeviceData(DWORD device, HRESULT hr, const DIDEVICEOBJECTDATA *events, DWORD count);
+    void WriteDeviceState(DWORD device, HRESULT hr, const void *state, DWORD size);
+    void WriteTick(DWORD tick);
+    void WriteTime(InputTime time);
+    void WriteCursor(BOOL result, LONG x, LONG y);
+    // The payload is written as head followed by body
+    void WriteInjection(DWORD call, const void *head, DWORD headSize, const void *body = NULL, DWORD bodySize = 0);
+
+private:
+    void Flush();
+    void PutByte(BYTE value);
+    void PutBytes(const void *data, DWORD size);
+    void PutVarint(DWORD value);
+    void PutVarint64(InputTime value);
+    void PutSigned(LONG value);
+    void PutSigned64(JournalInt64 value);
+
+    FILE *m_File;
+    BYTE m_Buffer[JOURNAL_BUFFER_SIZE];
+    DWORD m_Size;
+    DWORD m_LastTick;
+    InputTime m_LastTime;
+    LONG m_LastCursor[2];
+    DWORD m_LastSequence;
+    DWORD m_LastStamp[JOURNAL_MAX_DEVICES];
+    BYTE m_States[JOURNAL_MAX_DEVICES][JOURNAL_MAX_STATE_SIZE];
+};
+
+// Journal reader over a memory-mapped file. Decoding uses fixed buffers owned
+// by the reader, so reading does not allocate.
+class JournalReader
+{
+public:
+    JournalReader();
+    ~JournalReader();
+
+    BOOL Open(const char *path);
+    void Close();
+    BOOL IsOpen() const { return m_Begin != NULL; }
+
+    // Type of the next record without consuming it, JOURNAL_END at the end or on a corrupt record
+    DWORD Peek() const;
+    // Decodes the next record; returns FALSE at the end or on a corrupt record
+    BOOL Next(JournalRecord &record);
+    // Last state decoded for a device (zeros before the first one)
+    const BYTE *GetState(DWORD device) const;
+    BOOL IsCorrupt() const { return m_Corrupt; }
+
+private:
+    BOOL GetByte(BYTE &value);
+    BOOL GetBytes(void *data, DWORD size);
+    BOOL GetVarint(DWORD &value);
+    BOOL GetVarint64(InputTime &value);
+    BOOL GetSigned(LONG &value);
+    BOOL GetSigned64(JournalInt64 &value);
+    BOOL Decode(DWORD type, JournalRecord &record);
+
+    const BYTE *m_Begin;
+    const BYTE *m_End;
+    const BYTE *m_Cursor;
+    BOOL m_Corrupt;
+#ifdef _WIN32
+    HANDLE m_FileHandle;
+    HANDLE m_MappingHandle;
+#else
+    size_t m_MappedSize;
+#endif
+    DWORD m_LastTick;
+    InputTime m_LastTime;
+    LONG m_LastCursor[2];
+    DWORD m_LastSequence;
+    DWORD m_LastStamp[JOURNAL_MAX_DEVICES];
+    BYTE m_States[JOURNAL_MAX_DEVICES][JOURNAL_MAX_STATE_SIZE];
+    DIDEVICEOBJECTDATA m_Events[JOURNAL_MAX_EVENTS];
+    InputDeviceInfo m_Info;
+    InputDeviceCaps m_Caps;
+    InputAxisRange m_Ranges[INPUT_AXIS_COUNT];
+};
+
+#endif // JOURNAL_H
@@ -0,0 +1,523 @@
+#include "JournalBackend.h"
+
+#include <string.h>
+
+static const DWORD JOURNAL_ANY_DEVICE = 0xFFFFFFFF;
+
+static const GUID NullGuid = {0, 0, 0, {0, 0, 0, 0, 0, 0, 0, 0}};
+
+//
+// RecordingInputDevice
+//
+
+RecordingInputDevice::RecordingInputDevice(RecordingInputBackend *owner, InputDevice *device, DWORD id)
+    : m_Owner(owner), m_Device(device), m_Id(id) {}
+
+RecordingInputDevice::~RecordingInputDevice() {}
+
+HRESULT RecordingInputDevice::Acquire()
+{
+    HRESULT hr = m_Device->Acquire();
+    m_Owner->m_Writer.WriteAcquire(m_Id, hr);
+    return hr;
+}
+
+HRESULT RecordingInputDevice::Unacquire()
+{
+    return m_Device->Unacquire();
+}
+
+HRESULT RecordingInputDevice::Poll()
+{
+    HRESULT hr = m_Device->Poll();
+    m_Owner->m_Writer.WritePoll(m_Id, hr);
+    return hr;
+}
+
+HRESULT RecordingInputDevice::SetCooperativeLevel(HWND hWnd, DWORD flags)
+{
+    return m_Device->SetCooperativeLevel(hWnd, flags);
+}
+
+HRESULT RecordingInputDevice::GetDeviceData(DIDEVICEOBJECTDATA *data, DWORD *count, DWORD flags)
+{
+    HRESULT hr = m_Device->GetDeviceData(data, count, flags);
+    m_Owner->m_Writer.WriteDeviceData(m_Id, hr, data, (count && SUCCEEDED(hr)) ? *count : 0);
+    return hr;
+}
+
+HRESULT RecordingInputDevice::GetDeviceState(DWORD size, void *state)
+{
+    HRESULT hr = m_Device->GetDeviceState(size, state);
+    if (SUCCEEDED(hr))
+        m_Owner->m_Writer.WriteDeviceState(m_Id, hr, state, size);
+    else
+        m_Owner->m_Writer.WriteDeviceState(m_Id, hr, NULL, 0);
+    return hr;
+}
+
+HRESULT RecordingInputDevice::SetEventNotification(InputSignal *signal)
+{
+    return m_Device->SetEventNotification(signal);
+}
+
+HRESULT RecordingInputDevice::GetCapabilities(InputDeviceCaps *caps)
+{
+    HRESULT hr = m_Device->GetCapabilities(caps);
+    if (caps)
+        m_Owner->m_Writer.WriteCapabilities(m_Id, hr, *caps);
+    return hr;
+}
+
+HRESULT RecordingInputDevice::GetAxisRanges(InputAxisRange ranges[INPUT_AXIS_COUNT])
+{
+    HRESULT hr = m_Device->GetAxisRanges(ranges);
+    if (ranges)
+        m_Owner->m_Writer.WriteAxisRanges(m_Id, hr, ranges);
+    return hr;
+}
+
+void *RecordingInputDevice::GetNativeInterface()
+{
+    return m_Device->GetNativeInterface();
+}
+
+void RecordingInputDevice::Release()
+{
+    m_Device->Release();
+    delete this;
+}
+
+//
+// RecordingInputBackend
+//
+
+RecordingInputBackend::RecordingInputBackend(InputBackend *backend) : m_Backend(backend), m_DeviceCount(0) {}
+
+RecordingInputBackend::~RecordingInputBackend()
+{
+    m_Writer.Close();
+}
+
+HRESULT RecordingInputBackend::Initialize(HWND hWnd)
+{
+    HRESULT hr = m_Backend->Initialize(hWnd);
+    m_Writer.WriteInitialize(hr);
+    return hr;
+}
+
+void RecordingInputBackend::Shutdown()
+{
+    m_Backend->Shutdown();
+}
+
+HRESULT RecordingInputBackend::CreateKeyboard(DWORD bufferSize, InputDevice **device)
+{
+    return Wrap(JOURNAL_KEYBOARD, NullGuid, m_Backend->CreateKeyboard(bufferSize, device), device);
+}
+
+HRESULT RecordingInputBackend::CreateMouse(DWORD bufferSize, InputDevice **device)
+{
+    return Wrap(JOURNAL_MOUSE, NullGuid, m_Backend->CreateMouse(bufferSize, device), device);
+}
+
+BOOL RecordingInputBackend::JoystickEnum(const InputDeviceInfo *info, void *context)
+{
+    EnumContext *ctx = (EnumContext *)context;
+    ctx->Owner->m_Writer.WriteEnumDevice(*info);
+    return ctx->Callback(info, ctx->Context);
+}
+
+HRESULT RecordingInputBackend::EnumJoysticks(InputDeviceEnumCallback callback, void *context)
+{
+    EnumContext ctx;
+    ctx.Owner = this;
+    ctx.Callback = callback;
+    ctx.Context = context;
+    HRESULT hr = m_Backend->EnumJoysticks(JoystickEnum, &ctx);
+    m_Writer.WriteEnumEnd(hr);
+    return hr;
+}
+
+HRESULT RecordingInputBackend::CreateJoystick(const GUID &instance, InputDevice **device)
+{
+    return Wrap(JOURNAL_JOYSTICK, instance, m_Backend->CreateJoystick(instance, device), device);
+}
+
+HRESULT RecordingInputBackend::Wrap(DWORD kind, const GUID &guid, HRESULT hr, InputDevice **device)
+{
+    if (FAILED(hr) || !device || !*device)
+    {
+        m_Writer.WriteCreateDevice(kind, guid, FAILED(hr) ? hr : DIERR_GENERIC, 0);
+        return hr;
+    }
+
+    // Out of device ids: the device works but is not recorded, and the replay will not create it
+    if (m_DeviceCount >= JOURNAL_MAX_DEVICES)
+        return hr;
+
+    DWORD id = m_DeviceCount++;
+    m_Writer.WriteCreateDevice(kind, guid, hr, id);
+    *device = new RecordingInputDevice(this, *device, id);
+    return hr;
+}
+
+DWORD RecordingInputBackend::GetTickCount()
+{
+    DWORD tick = m_Backend->GetTickCount();
+    m_Writer.WriteTick(tick);
+    return tick;
+}
+
+InputTime RecordingInputBackend::GetTime()
+{
+    InputTime time = m_Backend->GetTime();
+    m_Writer.WriteTime(time);
+    return time;
+}
+
+BOOL RecordingInputBackend::GetCursorPos(LONG *x, LONG *y)
+{
+    LONG cx = 0, cy = 0;
+    BOOL result = m_Backend->GetCursorPos(&cx, &cy);
+    m_Writer.WriteCursor(result, cx, cy);
+    if (x)
+        *x = cx;
+    if (y)
+        *y = cy;
+    return result;
+}
+
+BOOL RecordingInputBackend::SetCursorPos(LONG x, LONG y)
+{
+    return m_Backend->SetCursorPos(x, y);
+}
+
+InputBackend *RecordingInputBackend::DetachBackend()
+{
+    InputBackend *backend = m_Backend;
+    m_Backend = NULL;
+    return backend;
+}
+
+void RecordingInputBackend::Release()
+{
+    if (m_Backend)
+        m_Backend->Release();
+    delete this;
+}
+
+//
+// ReplayInputDevice
+//
+
+ReplayInputDevice::ReplayInputDevice(ReplayInputBackend *owner, DWORD id) : m_Owner(owner), m_Id(id) {}
+
+ReplayInputDevice::~ReplayInputDevice() {}
+
+HRESULT ReplayInputDevice::Acquire()
+{
+    JournalRecord record;
+    return m_Owner->Expect(JOURNAL_ACQUIRE, m_Id, record) ? record.Result : DI_OK;
+}
+
+HRESULT ReplayInputDevice::Unacquire()
+{
+    return DI_OK;
+}
+
+HRESULT ReplayInputDevice::Poll()
+{
+    JournalRecord record;
+    return m_Owner->Expect(JOURNAL_POLL, m_Id, record) ? record.Result : DI_OK;
+}
+
+HRESULT ReplayInputDevice::SetCooperativeLevel(HWND /*hWnd*/, DWORD /*flags*/)
+{
+    return DI_OK;
+}
+
+HRESULT ReplayInputDevice::GetDeviceData(DIDEVICEOBJECTDATA *data, DWORD *count, DWORD /*flags*/)
+{
+    if (!count)
+        return DIERR_INVALIDPARAM;
+
+    JournalRecord record;
+    if (!m_Owner->Expect(JOURNAL_DEVICE_DATA, m_Id, record))
+    {
+        *count = 0;
+        return DI_OK;
+    }
+
+    DWORD n = record.Count;
+    if (n > *count)
+        n = *count;
+    if (data && n > 0)
+        memcpy(data, record.Events, n * sizeof(DIDEVICEOBJECTDATA));
+    *count = n;
+    return record.Result;
+}
+
+HRESULT ReplayInputDevice::GetDeviceState(DWORD size, void *state)
+{
+    if (!state)
+        return DIERR_INVALIDPARAM;
+
+    JournalRecord record;
+    HRESULT hr = m_Owner->Expect(JOURNAL_DEVICE_STATE, m_Id, record) ? record.Result : DI_OK;
+    if (FAILED(hr))
+        return hr;
+
+    // The reader keeps the last state of every device, which is also the answer when the record is missing
+    DWORD stored = (size < JOURNAL_MAX_STATE_SIZE) ? size : JOURNAL_MAX_STATE_SIZE;
+    memcpy(state, m_Owner->m_Reader.GetState(m_Id), stored);
+    if (size > stored)
+        memset((BYTE *)state + stored, 0, size - stored);
+    return hr;
+}
+
+HRESULT ReplayInputDevice::SetEventNotification(InputSignal * /*signal*/)
+{
+    // Replayed data is read on demand, it never arrives on its own
+    return DI_OK;
+}
+
+HRESULT ReplayInputDevice::GetCapabilities(InputDeviceCaps *caps)
+{
+    if (!caps)
+        return DIERR_INVALIDPARAM;
+
+    JournalRecord record;
+    if (!m_Owner->Expect(JOURNAL_CAPABILITIES, m_Id, record))
+        return DIERR_GENERIC;
+    *caps = *record.Caps;
+    return record.Result;
+}
+
+HRESULT ReplayInputDevice::GetAxisRanges(InputAxisRange ranges[INPUT_AXIS_COUNT])
+{
+    if (!ranges)
+        return DIERR_INVALIDPARAM;
+
+    JournalRecord record;
+    if (!m_Owner->Expect(JOURNAL_AXIS_RANGES, m_Id, record))
+        return DIERR_GENERIC;
+    memcpy(ranges, record.Ranges, INPUT_AXIS_COUNT * sizeof(InputAxisRange));
+    return record.Result;
+}
+
+void *ReplayInputDevice::GetNativeInterface()
+{
+    return NULL;
+}
+
+void ReplayInputDevice::Release()
+{
+    delete this;
+}
+
+//
+// ReplayInputBackend
+//
+
+ReplayInputBackend::ReplayInputBackend()
+    : m_Callback(NULL), m_Context(NULL), m_Tick(0), m_Time(0), m_CursorResult(FALSE),
+      m_FrameCount(0), m_MissCount(0), m_SkippedCount(0)
+{
+    m_Cursor[0] = m_Cursor[1] = 0;
+}
+
+ReplayInputBackend::~ReplayInputBackend()
+{
+    m_Reader.Close();
+}
+
+BOOL ReplayInputBackend::Open(const char *path)
+{
+    m_Tick = 0;
+    m_Time = 0;
+    m_Cursor[0] = m_Cursor[1] = 0;
+    m_CursorResult = FALSE;
+    m_FrameCount = 0;
+    m_MissCount = 0;
+    m_SkippedCount = 0;
+    return m_Reader.Open(path);
+}
+
+void ReplayInputBackend::SetInjectionCallback(JournalInjectionCallback callback, void *context)
+{
+    m_Callback = callback;
+    m_Context = context;
+}
+
+HRESULT ReplayInputBackend::Initialize(HWND /*hWnd*/)
+{
+    JournalRecord record;
+    return Expect(JOURNAL_INITIALIZE, JOURNAL_ANY_DEVICE, record) ? record.Result : DI_OK;
+}
+
+void ReplayInputBackend::Shutdown() {}
+
+HRESULT ReplayInputBackend::CreateKeyboard(DWORD /*bufferSize*/, InputDevice **device)
+{
+    return Create(JOURNAL_KEYBOARD, NULL, device);
+}
+
+HRESULT ReplayInputBackend::CreateMouse(DWORD /*bufferSize*/, InputDevice **device)
+{
+    return Create(JOURNAL_MOUSE, NULL, device);
+}
+
+HRESULT ReplayInputBackend::EnumJoysticks(InputDeviceEnumCallback callback, void *context)
+{
+    JournalRecord record;
+    while (PeekRecord() == JOURNAL_ENUM_DEVICE)
+    {
+        if (!m_Reader.Next(record))
+            break;
+        if (callback(record.Info, context) == DIENUM_STOP)
+            break;
+    }
+    return Expect(JOURNAL_ENUM_END, JOURNAL_ANY_DEVICE, record) ? record.Result : DI_OK;
+}
+
+HRESULT ReplayInputBackend::CreateJoystick(const GUID &instance, InputDevice **device)
+{
+    return Create(JOURNAL_JOYSTICK, &instance, device);
+}
+
+HRESULT ReplayInputBackend::Create(DWORD kind, const GUID *guid, InputDevice **device)
+{
+    if (!device)
+        return DIERR_INVALIDPARAM;
+    *device = NULL;
+
+    JournalRecord record;
+    if (!Expect(JOURNAL_CREATE_DEVICE, JOURNAL_ANY_DEVICE, record))
+        return DIERR_DEVICENOTREG;
+    if (record.Kind != kind || (guid && record.Guid != *guid))
+    {
+        ++m_MissCount;
+        return DIERR_DEVICENOTREG;
+    }
+    if (FAILED(record.Result))
+        return record.Result;
+
+    *device = new ReplayInputDevice(this, record.Device);
+    return record.Result;
+}
+
+DWORD ReplayInputBackend::GetTickCount()
+{
+    JournalRecord record;
+    if (Expect(JOURNAL_TICK, JOURNAL_ANY_DEVICE, record))
+        m_Tick = record.Tick;
+    return m_Tick;
+}
+
+InputTime ReplayInputBackend::GetTime()
+{
+    JournalRecord record;
+    if (Expect(JOURNAL_TIME, JOURNAL_ANY_DEVICE, record))
+        m_Time = record.Time;
+    return m_Time;
+}
+
+BOOL ReplayInputBackend::GetCursorPos(LONG *x, LONG *y)
+{
+    JournalRecord record;
+    if (Expect(JOURNAL_CURSOR, JOURNAL_ANY_DEVICE, record))
+    {
+        m_Cursor[0] = record.X;
+        m_Cursor[1] = record.Y;
+        m_CursorResult = record.Result != 0;
+    }
+    if (x)
+        *x = m_Cursor[0];
+    if (y)
+        *y = m_Cursor[1];
+    return m_CursorResult;
+}
+
+BOOL ReplayInputBackend::SetCursorPos(LONG /*x*/, LONG /*y*/)
+{
+    return TRUE;
+}
+
+void ReplayInputBackend::Release()
+{
+    delete this;
+}
+
+void ReplayInputBackend::BeginFrame()
+{
+    SkipTo(JOURNAL_FRAME_BEGIN);
+    ++m_FrameCount;
+}
+
+void ReplayInputBackend::DispatchInjections()
+{
+    PeekRecord();
+}
+
+void ReplayInputBackend::EndFrame()
+{
+    SkipTo(JOURNAL_FRAME_END);
+}
+
+DWORD ReplayInputBackend::PeekRecord()
+{
+    JournalRecord record;
+    DWORD type = m_Reader.Peek();
+    while (type == JOURNAL_INJECTION)
+    {
+        // The reader has moved past the injection before it is applied, so it may read the journal again
+        if (!m_Reader.Next(record))
+            break;
+        Dispatch(record);
+        type = m_Reader.Peek();
+    }
+    return type;
+}
+
+BOOL ReplayInputBackend::Expect(DWORD type, DWORD device, JournalRecord &record)
+{
+    for (;;)
+    {
+        DWORD next = PeekRecord();
+        if (next == JOURNAL_END)
+            break;
+        // Never read past the frame the caller is in
+        if (next != type && (next == JOURNAL_FRAME_BEGIN || next == JOURNAL_FRAME_END))
+            break;
+        if (!m_Reader.Next(record))
+            break;
+        if (record.Type == type && (device == JOURNAL_ANY_DEVICE || record.Device == device))
+            return TRUE;
+        ++m_SkippedCount;
+    }
+
+    ++m_MissCount;
+    return FALSE;
+}
+
+void ReplayInputBackend::SkipTo(DWORD type)
+{
+    JournalRecord record;
+    for (;;)
+    {
+        DWORD next = PeekRecord();
+        if (next == JOURNAL_END || !m_Reader.Next(record))
+            return;
+        if (record.Type == type)
+            return;
+        if (record.Type != JOURNAL_FRAME_BEGIN && record.Type != JOURNAL_FRAME_END)
+            ++m_SkippedCount;
+    }
+}
+
+void ReplayInputBackend::Dispatch(const JournalRecord &record)
+{
+    if (m_Callback)
+        m_Callback(record.Call, record.Data, record.Count, m_Context);
+}
@@ -0,0 +1,175 @@
+#ifndef JOURNALBACKEND_H
+#define JOURNALBACKEND_H
+
+#include "InputBackend.h"
+#include "Journal.h"
+
+class RecordingInputBackend;
+class ReplayInputBackend;
+
+// Device wrapper that forwards every call and journals its result
+class RecordingInputDevice : public InputDevice
+{
+public:
+    RecordingInputDevice(RecordingInputBackend *owner, InputDevice *device, DWORD id);
+    virtual ~RecordingInputDevice();
+
+    virtual HRESULT Acquire();
+    virtual HRESULT Unacquire();
+    virtual HRESULT Poll();
+    virtual HRESULT SetCooperativeLevel(HWND hWnd, DWORD flags);
+    virtual HRESULT GetDeviceData(DIDEVICEOBJECTDATA *data, DWORD *count, DWORD flags);
+    virtual HRESULT GetDeviceState(DWORD size, void *state);
+    virtual HRESULT SetEventNotification(InputSignal *signal);
+    virtual HRESULT GetCapabilities(InputDeviceCaps *caps);
+    virtual HRESULT GetAxisRanges(InputAxisRange ranges[INPUT_AXIS_COUNT]);
+    virtual void *GetNativeInterface();
+    virtual void Release();
+
+private:
+    RecordingInputBackend *m_Owner;
+    InputDevice *m_Device;
+    DWORD m_Id;
+};
+
+// Backend decorator that records everything the input state machine reads
+// from the wrapped backend: device results, buffered events, device states,
+// ticks, clock readings and cursor positions. The backend owns the wrapped one.
+class RecordingInputBackend : public InputBackend
+{
+    friend class RecordingInputDevice;
+
+public:
+    explicit RecordingInputBackend(InputBackend *backend);
+    virtual ~RecordingInputBackend();
+
+    virtual HRESULT Initialize(HWND hWnd);
+    virtual void Shutdown();
+    virtual HRESULT CreateKeyboard(DWORD bufferSize, InputDevice **device);
+    virtual HRESULT CreateMouse(DWORD bufferSize, InputDevice **device);
+    virtual HRESULT EnumJoysticks(InputDeviceEnumCallback callback, void *context);
+    virtual HRESULT CreateJoystick(const GUID &instance, InputDevice **device);
+    virtual DWORD GetTickCount();
+    virtual InputTime GetTime();
+    virtual BOOL GetCursorPos(LONG *x, LONG *y);
+    virtual BOOL SetCursorPos(LONG x, LONG y);
+    virtual void Release();
+
+    BOOL Open(const char *path) { return m_Writer.Open(path); }
+    void Close() { m_Writer.Close(); }
+    InputBackend *GetBackend() { return m_Backend; }
+    // Gives the wrapped backend back to the caller; Release() then only destroys the recorder
+    InputBackend *DetachBackend();
+
+    void BeginFrame() { m_Writer.WriteFrameBegin(); }
+    void EndFrame() { m_Writer.WriteFrameEnd(); }
+    // Records a call that changed the input state from outside the devices
+    void WriteInjection(DWORD call, const void *head, DWORD headSize, const void *body = NULL, DWORD bodySize = 0)
+    {
+        m_Writer.WriteInjection(call, head, headSize, body, bodySize);
+    }
+
+private:
+    struct EnumContext
+    {
+        RecordingInputBackend *Owner;
+        InputDeviceEnumCallback Callback;
+        void *Context;
+    };
+
+    static BOOL JoystickEnum(const InputDeviceInfo *info, void *context);
+    HRESULT Wrap(DWORD kind, const GUID &guid, HRESULT hr, InputDevice **device);
+
+    InputBackend *m_Backend;
+    JournalWriter m_Writer;
+    DWORD m_DeviceCount;
+};
+
+// Device served from a journal
+class ReplayInputDevice : public InputDevice
+{
+public:
+    ReplayInputDevice(ReplayInputBackend *owner, DWORD id);
+    virtual ~ReplayInputDevice();
+
+    virtual HRESULT Acquire();
+    virtual HRESULT Unacquire();
+    virtual HRESULT Poll();
+    virtual HRESULT SetCooperativeLevel(HWND hWnd, DWORD flags);
+    virtual HRESULT GetDeviceData(DIDEVICEOBJECTDATA *data, DWORD *count, DWORD flags);
+    virtual HRESULT GetDeviceState(DWORD size, void *state);
+    virtual HRESULT SetEventNotification(InputSignal *signal);
+    virtual HRESULT GetCapabilities(InputDeviceCaps *caps);
+    virtual HRESULT GetAxisRanges(InputAxisRange ranges[INPUT_AXIS_COUNT]);
+    virtual void *GetNativeInterface();
+    virtual void Release();
+
+private:
+    ReplayInputBackend *m_Owner;
+    DWORD m_Id;
+};
+
+// Applies an injection recorded by RecordingInputBackend::WriteInjection
+typedef void (*JournalInjectionCallback)(DWORD call, const void *data, DWORD size, void *context);
+
+// Backend that plays a journal back. Each call consumes the next matching
+// record of the current frame; calls without a record get a neutral answer
+// (no events, the previous state, the previous clock reading) and are counted
+// as misses. Injections are dispatched in journal order as they are passed.
+class ReplayInputBackend : public InputBackend
+{
+    friend class ReplayInputDevice;
+
+public:
+    ReplayInputBackend();
+    virtual ~ReplayInputBackend();
+
+    virtual HRESULT Initialize(HWND hWnd);
+    virtual void Shutdown();
+    virtual HRESULT CreateKeyboard(DWORD bufferSize, InputDevice **device);
+    virtual HRESULT CreateMouse(DWORD bufferSize, InputDevice **device);
+    virtual HRESULT EnumJoysticks(InputDeviceEnumCallback callback, void *context);
+    virtual HRESULT CreateJoystick(const GUID &instance, InputDevice **device);
+    virtual DWORD GetTickCount();
+    virtual InputTime GetTime();
+    virtual BOOL GetCursorPos(LONG *x, LONG *y);
+    virtual BOOL SetCursorPos(LONG x, LONG y);
+    virtual void Release();
+
+    BOOL Open(const char *path);
+    void Close() { m_Reader.Close(); }
+    void SetInjectionCallback(JournalInjectionCallback callback, void *context);
+
+    // Skips the rest of the previous frame and enters the next one
+    void BeginFrame();
+    // Dispatches the injections that come before the next device call
+    void DispatchInjections();
+    // Dispatches the injections left in the frame and leaves it
+    void EndFrame();
+
+    BOOL IsFinished() const { return m_Reader.Peek() == JOURNAL_END; }
+    BOOL IsCorrupt() const { return m_Reader.IsCorrupt(); }
+    DWORD GetFrameCount() const { return m_FrameCount; }
+    DWORD GetMissCount() const { return m_MissCount; }       // Calls that found no matching record
+    DWORD GetSkippedCount() const { return m_SkippedCount; } // Records no call asked for
+
+private:
+    DWORD PeekRecord();
+    BOOL Expect(DWORD type, DWORD device, JournalRecord &record);
+    void SkipTo(DWORD type);
+    void Dispatch(const JournalRecord &record);
+    HRESULT Create(DWORD kind, const GUID *guid, InputDevice **device);
+
+    JournalReader m_Reader;
+    JournalInjectionCallback m_Callback;
+    void *m_Context;
+    DWORD m_Tick;
+    InputTime m_Time;
+    LONG m_Cursor[2];
+    BOOL m_CursorResult;
+    DWORD m_FrameCount;
+    DWORD m_MissCount;
+    DWORD m_SkippedCount;
+};
+
+#endif // JOURNALBACKEND_H
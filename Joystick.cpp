@@ -1,36 +1,10 @@
-#include "DX8InputManager.h"
+#include "InputDevices.h"
 
-static double NormalizeAxis(LONG value, LONG minValue, LONG maxValue)
-{
-    if (maxValue == minValue)
-        return 0.0;
-
-    double dMin = static_cast<double>(minValue);
-    double range = static_cast<double>(maxValue) - dMin;
-    if (range == 0.0)
-        return 0.0;
-
-    double normalized = (static_cast<double>(value) - dMin) * 2.0 / range - 1.0;
-    if (normalized > 1.0)
-        normalized = 1.0;
-    else if (normalized < -1.0)
-        normalized = -1.0;
-
-    return normalized;
-}
-
-static float ClampAxis(float value)
-{
-    if (value > 1.0f)
-        return 1.0f;
-    if (value < -1.0f)
-        return -1.0f;
-    return value;
-}
-
-DX8InputManager::CKJoystick::CKJoystick()
+InputJoystick::InputJoystick()
 {
+    m_Backend = NULL;
     m_Device = NULL;
+    m_Stats = NULL;
     memset(&m_DeviceGUID, 0, sizeof(GUID));        // Initialize to empty GUID
     memset(m_DeviceName, 0, sizeof(m_DeviceName)); // Initialize device name to empty
     // Default 1% deadzone for all devices
@@ -38,11 +12,19 @@ DX8InputManager::CKJoystick::CKJoystick()
     m_Gain = 1.0f;     // Default gain (no scaling)
     m_ButtonCount = 0; // Will be set during initialization
     m_Polled = FALSE;
-    m_Position.Set(0.0f, 0.0f, 0.0f);
-    m_Rotation.Set(0.0f, 0.0f, 0.0f);
-    m_Sliders.Set(0.0f, 0.0f);
+    m_Detached = FALSE;
+    m_PollTicks = 0;
+    m_PollResult = DI_OK;
+    m_PollPending = FALSE;
+    m_Position[0] = m_Position[1] = m_Position[2] = 0.0f;
+    m_Rotation[0] = m_Rotation[1] = m_Rotation[2] = 0.0f;
+    m_Sliders[0] = m_Sliders[1] = 0.0f;
     m_PointOfViewAngle = -1;
-    m_Buttons = 0;
+    memset(m_ButtonMask, 0, sizeof(m_ButtonMask));
+    memset(m_LastButtonMask, 0, sizeof(m_LastButtonMask));
+    memset(m_PressedMask, 0, sizeof(m_PressedMask));
+    memset(m_ReleasedMask, 0, sizeof(m_ReleasedMask));
+    m_Time = 0;
     m_AxisCaps = AxisCapabilities();
     m_Xmin = m_Ymin = m_Zmin = -1000;
     m_Xmax = m_Ymax = m_Zmax = 1000;
@@ -50,20 +32,72 @@ DX8InputManager::CKJoystick::CKJoystick()
     m_XRmax = m_YRmax = m_ZRmax = 1000;
     m_Umin = m_Vmin = -1000;
     m_Umax = m_Vmax = 1000;
+    UpdateAxisScale();
+    memset(m_Curves, 0, sizeof(m_Curves));
+    m_CurveCount = 0;
 }
 
-void DX8InputManager::CKJoystick::Init(HWND hWnd)
+void InputJoystick::Attach(InputBackend *backend, InputDevice *device, const InputDeviceInfo &info)
+{
+    m_Backend = backend;
+    m_Device = device;
+    m_Detached = FALSE;
+
+    // Store the device GUID
+    m_DeviceGUID = info.InstanceGUID;
+
+    // Store the device product name
+    strncpy(m_DeviceName, info.ProductName, MAX_PATH - 1);
+    m_DeviceName[MAX_PATH - 1] = '\0';
+
+    // Query button count from device capabilities
+    InputDeviceCaps caps;
+    memset(&caps, 0, sizeof(InputDeviceCaps));
+    if (m_Device && SUCCEEDED(m_Device->GetCapabilities(&caps)))
+    {
+        m_ButtonCount = (int)caps.Buttons;
+    }
+    else
+    {
+        m_ButtonCount = JOYSTICK_BUTTON_COUNT; // Default to maximum
+    }
+}
+
+void InputJoystick::Attach(InputBackend *backend, InputDevice *device, const InputDeviceInfo &info,
+                           const InputDeviceCaps &caps, const InputAxisRange ranges[INPUT_AXIS_COUNT])
+{
+    Release();
+    m_Backend = backend;
+    m_Device = device;
+    m_Detached = FALSE;
+    m_DeviceGUID = info.InstanceGUID;
+    strncpy(m_DeviceName, info.ProductName, MAX_PATH - 1);
+    m_DeviceName[MAX_PATH - 1] = '\0';
+    m_ButtonCount = (int)caps.Buttons;
+    SetAxisRanges(ranges);
+    ResetState();
+    m_Polled = FALSE;
+}
+
+// The slot keeps the GUID, name and settings, so the device gets them back when it returns
+void InputJoystick::Detach()
+{
+    Release();
+    ResetState();
+    m_Detached = TRUE;
+}
+
+void InputJoystick::Init(HWND hWnd)
 {
     if (m_Device)
     {
-        m_Device->SetDataFormat(&c_dfDIJoystick2);
         m_Device->SetCooperativeLevel(hWnd, DISCL_NONEXCLUSIVE | DISCL_BACKGROUND);
         m_Device->Acquire();
     }
     GetInfo();
 }
 
-void DX8InputManager::CKJoystick::Release()
+void InputJoystick::Release()
 {
     if (m_Device)
     {
@@ -74,37 +108,93 @@ void DX8InputManager::CKJoystick::Release()
     }
 }
 
-void DX8InputManager::CKJoystick::ResetState()
+void InputJoystick::Clear()
 {
-    m_Position.Set(0.0f, 0.0f, 0.0f);
-    m_Rotation.Set(0.0f, 0.0f, 0.0f);
-    m_Sliders.Set(0.0f, 0.0f);
+    m_Position[0] = m_Position[1] = m_Position[2] = 0.0f;
+    m_Rotation[0] = m_Rotation[1] = m_Rotation[2] = 0.0f;
+    m_Sliders[0] = m_Sliders[1] = 0.0f;
+    m_PointOfViewAngle = -1;
+    memset(m_ButtonMask, 0, sizeof(m_ButtonMask));
+    memset(m_PressedMask, 0, sizeof(m_PressedMask));
+    memset(m_ReleasedMask, 0, sizeof(m_ReleasedMask));
+}
+
+// A lost device reads as centered with every button released
+void InputJoystick::ResetState()
+{
+    DWORD up[JOYSTICK_BUTTON_WORDS] = {0, 0, 0, 0};
+    SetButtons(up);
+    m_Position[0] = m_Position[1] = m_Position[2] = 0.0f;
+    m_Rotation[0] = m_Rotation[1] = m_Rotation[2] = 0.0f;
+    m_Sliders[0] = m_Sliders[1] = 0.0f;
     m_PointOfViewAngle = -1;
-    m_Buttons = 0;
     m_Polled = TRUE;
 }
 
-void DX8InputManager::CKJoystick::Poll()
+void InputJoystick::BeginFrame()
+{
+    memcpy(m_LastButtonMask, m_ButtonMask, sizeof(m_ButtonMask));
+    memset(m_PressedMask, 0, sizeof(m_PressedMask));
+    memset(m_ReleasedMask, 0, sizeof(m_ReleasedMask));
+    m_Polled = FALSE;
+}
+
+// Edges accumulate over the frame, so a button pressed and released between two
+// polls or injections of the same frame shows in both masks
+void InputJoystick::SetButtons(const DWORD *mask)
+{
+    for (int i = 0; i < JOYSTICK_BUTTON_WORDS; i++)
+    {
+        m_PressedMask[i] |= mask[i] & ~m_ButtonMask[i];
+        m_ReleasedMask[i] |= m_ButtonMask[i] & ~mask[i];
+        m_ButtonMask[i] = mask[i];
+    }
+}
+
+void InputJoystick::Poll()
+{
+    if (m_Polled)
+        return;
+
+    InputTime start = InputStopwatch();
+    m_PollResult = Read(m_Stats);
+    m_PollTicks = InputStopwatch() - start;
+}
+
+void InputJoystick::PollDetached()
 {
     if (m_Polled)
         return;
 
+    InputTime start = InputStopwatch();
+    m_PollResult = Read(NULL);
+    m_PollTicks = InputStopwatch() - start;
+    m_PollPending = m_Device != NULL;
+}
+
+void InputJoystick::ReportPollCost()
+{
+    if (m_PollPending && m_Stats)
+        m_Stats->Add(INPUT_STAGE_JOYSTICK_POLL, m_PollTicks, SUCCEEDED(m_PollResult) ? 1 : 0, m_PollResult);
+    m_PollPending = FALSE;
+}
+
+HRESULT InputJoystick::Read(InputFrameStats *stats)
+{
     if (m_Device)
     {
+        InputStageTimer timer(stats, INPUT_STAGE_JOYSTICK_POLL);
         HRESULT hr = m_Device->Poll();
         if (FAILED(hr))
         {
-            hr = m_Device->Acquire();
+            hr = InputReacquire(m_Device, stats);
+            if (SUCCEEDED(hr))
+                hr = m_Device->Poll();
             if (FAILED(hr))
             {
+                timer.SetResult(hr);
                 ResetState();
-                return;
-            }
-            hr = m_Device->Poll();
-            if (FAILED(hr))
-            {
-                ResetState();
-                return;
+                return hr;
             }
         }
 
@@ -113,82 +203,52 @@ void DX8InputManager::CKJoystick::Poll()
         hr = m_Device->GetDeviceState(sizeof(DIJOYSTATE2), &state);
         if (hr == DIERR_INPUTLOST || hr == DIERR_NOTACQUIRED)
         {
-            hr = m_Device->Acquire();
-            if (FAILED(hr))
-            {
-                ResetState();
-                return;
-            }
-            hr = m_Device->GetDeviceState(sizeof(DIJOYSTATE2), &state);
+            hr = InputReacquire(m_Device, stats);
+            if (SUCCEEDED(hr))
+                hr = m_Device->GetDeviceState(sizeof(DIJOYSTATE2), &state);
         }
+        timer.SetResult(hr);
         if (FAILED(hr))
         {
             ResetState();
-            return;
+            return hr;
         }
+        timer.SetEvents(1);
+        m_Time = m_Backend ? m_Backend->GetTime() : 0;
 
-        double x = m_AxisCaps.hasX ? NormalizeAxis(state.lX, m_Xmin, m_Xmax) : 0.0;
-        double y = m_AxisCaps.hasY ? NormalizeAxis(state.lY, m_Ymin, m_Ymax) : 0.0;
-        double z = m_AxisCaps.hasZ ? NormalizeAxis(state.lZ, m_Zmin, m_Zmax) : 0.0;
-
-        const double deadzone = static_cast<double>(m_DeadzoneRadius);
-        double xyMagnitude = sqrt(x * x + y * y);
-        if (xyMagnitude < deadzone || deadzone >= 1.0)
-        {
-            x = y = 0.0;
-        }
-        else if (xyMagnitude > 0.0)
+        // lX through rglSlider[1] are contiguous in DIJOYSTATE2
+        float axes[AXIS_KERNEL_AXES];
+        if (m_CurveCount == 0)
         {
-            double scale = (xyMagnitude - deadzone) / (1.0 - deadzone);
-            x = (x / xyMagnitude) * scale;
-            y = (y / xyMagnitude) * scale;
+            InputNormalizeAxes(&state.lX, m_AxisScale, m_DeadzoneRadius, m_Gain, axes);
         }
-
-        if (fabs(z) < deadzone)
-            z = 0.0;
-
-        // Apply gain/sensitivity multiplier and clamp to [-1.0, 1.0]
-        const double gain = static_cast<double>(m_Gain);
-        m_Position.Set(ClampAxis((float)(x * gain)), ClampAxis((float)(y * gain)), ClampAxis((float)(z * gain)));
-
-        double xr = m_AxisCaps.hasRx ? NormalizeAxis(state.lRx, m_XRmin, m_XRmax) : 0.0;
-        double yr = m_AxisCaps.hasRy ? NormalizeAxis(state.lRy, m_YRmin, m_YRmax) : 0.0;
-        double zr = m_AxisCaps.hasRz ? NormalizeAxis(state.lRz, m_ZRmin, m_ZRmax) : 0.0;
-
-        double rxryMagnitude = sqrt(xr * xr + yr * yr);
-        if (rxryMagnitude < deadzone || deadzone >= 1.0)
+        else
         {
-            xr = yr = 0.0;
-        }
-        else if (rxryMagnitude > 0.0)
-        {
-            double scale = (rxryMagnitude - deadzone) / (1.0 - deadzone);
-            xr = (xr / rxryMagnitude) * scale;
-            yr = (yr / rxryMagnitude) * scale;
+            // Curved axes reach their curve unscaled, in [-1, 1]
+            float gains[AXIS_KERNEL_AXES];
+            for (int i = 0; i < AXIS_KERNEL_AXES; i++)
+                gains[i] = m_Curves[i].Enabled ? 1.0f : m_Gain;
+            InputNormalizeAxes(&state.lX, m_AxisScale, m_DeadzoneRadius, gains, axes);
+            for (int i = 0; i < AXIS_KERNEL_AXES; i++)
+            {
+                if (m_Curves[i].Enabled)
+                    axes[i] = InputResponseCurveLookup(m_Curves[i], axes[i]);
+            }
         }
+        m_Position[0] = axes[0];
+        m_Position[1] = axes[1];
+        m_Position[2] = axes[2];
+        m_Rotation[0] = axes[3];
+        m_Rotation[1] = axes[4];
+        m_Rotation[2] = axes[5];
+        m_Sliders[0] = axes[6];
+        m_Sliders[1] = axes[7];
 
-        if (fabs(zr) < deadzone)
-            zr = 0.0;
-
-        // Apply gain/sensitivity multiplier and clamp to [-1.0, 1.0]
-        m_Rotation.Set(ClampAxis((float)(xr * gain)), ClampAxis((float)(yr * gain)), ClampAxis((float)(zr * gain)));
-
-        double slider0 = m_AxisCaps.hasSlider0 ? NormalizeAxis(state.rglSlider[0], m_Umin, m_Umax) : 0.0;
-        double slider1 = m_AxisCaps.hasSlider1 ? NormalizeAxis(state.rglSlider[1], m_Vmin, m_Vmax) : 0.0;
-        if (fabs(slider0) < deadzone)
-            slider0 = 0.0;
-        if (fabs(slider1) < deadzone)
-            slider1 = 0.0;
-        m_Sliders.Set(ClampAxis((float)(slider0 * gain)), ClampAxis((float)(slider1 * gain)));
-
-        m_PointOfViewAngle = (state.rgdwPOV[0] != 0xFFFF) ? static_cast<CKDWORD>(state.rgdwPOV[0]) : -1;
+        m_PointOfViewAngle = (state.rgdwPOV[0] != 0xFFFF) ? static_cast<DWORD>(state.rgdwPOV[0]) : -1;
 
-        m_Buttons = 0;
-        for (int i = 0; i < 32; i++)
-        {
-            if ((state.rgbButtons[i] & 0x80) != 0)
-                m_Buttons |= (1 << i);
-        }
+        DWORD buttons[JOYSTICK_BUTTON_WORDS];
+        KeyMaskFromStates(buttons, state.rgbButtons, 0x80, JOYSTICK_BUTTON_WORDS);
+        SetButtons(buttons);
 
         m_Polled = TRUE;
     }
@@ -196,167 +256,113 @@ void DX8InputManager::CKJoystick::Poll()
     {
         ResetState();
     }
+    return DI_OK;
 }
 
-// EnumAxesCallback: Enumerate device axes and query their properties
-BOOL CALLBACK DX8InputManager::CKJoystick::EnumAxesCallback(LPCDIDEVICEOBJECTINSTANCE lpddoi, LPVOID pvRef)
+void InputJoystick::GetInfo()
 {
-    CKJoystick *joystick = (CKJoystick *)pvRef;
-
-    if (!joystick || !joystick->m_Device)
-        return DIENUM_STOP;
-
-    // Set up the property range structure
-    DIPROPRANGE range;
-    memset(&range, 0, sizeof(DIPROPRANGE));
-    range.diph.dwSize = sizeof(DIPROPRANGE);
-    range.diph.dwHeaderSize = sizeof(DIPROPHEADER);
-    range.diph.dwHow = DIPH_BYID;
-    range.diph.dwObj = lpddoi->dwType & ~DIDFT_COLLECTION;
-
-    HRESULT hr = joystick->m_Device->GetProperty(DIPROP_RANGE, &range.diph);
-    if (FAILED(hr) || range.lMax == range.lMin)
+    if (m_Device)
     {
-        // Fall back to a symmetric range to keep normalization stable
-        range.lMin = -1000;
-        range.lMax = 1000;
-        if (FAILED(joystick->m_Device->SetProperty(DIPROP_RANGE, &range.diph)))
-            return DIENUM_CONTINUE;
+        // Enumerate all axes on the device to determine capabilities
+        InputAxisRange ranges[INPUT_AXIS_COUNT];
+        memset(ranges, 0, sizeof(ranges));
+        if (FAILED(m_Device->GetAxisRanges(ranges)))
+            memset(ranges, 0, sizeof(ranges));
+        SetAxisRanges(ranges);
     }
+}
 
-    // Determine which axis this is and store its range
-    GUID guidType = lpddoi->guidType;
+void InputJoystick::SetAxisRanges(const InputAxisRange ranges[INPUT_AXIS_COUNT])
+{
+    m_AxisCaps = AxisCapabilities();
+    // Initialize default ranges (in case device has no axes)
+    m_Xmin = m_Ymin = m_Zmin = -1000;
+    m_Xmax = m_Ymax = m_Zmax = 1000;
+    m_XRmin = m_YRmin = m_ZRmin = -1000;
+    m_XRmax = m_YRmax = m_ZRmax = 1000;
+    m_Umin = m_Vmin = -1000;
+    m_Umax = m_Vmax = 1000;
 
-    if (guidType == GUID_XAxis)
+    if (ranges[INPUT_AXIS_X].Present)
     {
-        joystick->m_AxisCaps.hasX = TRUE;
-        joystick->m_Xmin = range.lMin;
-        joystick->m_Xmax = range.lMax;
+        m_AxisCaps.hasX = TRUE;
+        m_Xmin = ranges[INPUT_AXIS_X].Min;
+        m_Xmax = ranges[INPUT_AXIS_X].Max;
     }
-    else if (guidType == GUID_YAxis)
+    if (ranges[INPUT_AXIS_Y].Present)
     {
-        joystick->m_AxisCaps.hasY = TRUE;
-        joystick->m_Ymin = range.lMin;
-        joystick->m_Ymax = range.lMax;
+        m_AxisCaps.hasY = TRUE;
+        m_Ymin = ranges[INPUT_AXIS_Y].Min;
+        m_Ymax = ranges[INPUT_AXIS_Y].Max;
     }
-    else if (guidType == GUID_ZAxis)
+    if (ranges[INPUT_AXIS_Z].Present)
     {
-        joystick->m_AxisCaps.hasZ = TRUE;
-        joystick->m_Zmin = range.lMin;
-        joystick->m_Zmax = range.lMax;
+        m_AxisCaps.hasZ = TRUE;
+        m_Zmin = ranges[INPUT_AXIS_Z].Min;
+        m_Zmax = ranges[INPUT_AXIS_Z].Max;
     }
-    else if (guidType == GUID_RxAxis)
+    if (ranges[INPUT_AXIS_RX].Present)
     {
-        joystick->m_AxisCaps.hasRx = TRUE;
-        joystick->m_XRmin = range.lMin;
-        joystick->m_XRmax = range.lMax;
+        m_AxisCaps.hasRx = TRUE;
+        m_XRmin = ranges[INPUT_AXIS_RX].Min;
+        m_XRmax = ranges[INPUT_AXIS_RX].Max;
     }
-    else if (guidType == GUID_RyAxis)
+    if (ranges[INPUT_AXIS_RY].Present)
     {
-        joystick->m_AxisCaps.hasRy = TRUE;
-        joystick->m_YRmin = range.lMin;
-        joystick->m_YRmax = range.lMax;
+        m_AxisCaps.hasRy = TRUE;
+        m_YRmin = ranges[INPUT_AXIS_RY].Min;
+        m_YRmax = ranges[INPUT_AXIS_RY].Max;
     }
-    else if (guidType == GUID_RzAxis)
+    if (ranges[INPUT_AXIS_RZ].Present)
     {
-        joystick->m_AxisCaps.hasRz = TRUE;
-        joystick->m_ZRmin = range.lMin;
-        joystick->m_ZRmax = range.lMax;
+        m_AxisCaps.hasRz = TRUE;
+        m_ZRmin = ranges[INPUT_AXIS_RZ].Min;
+        m_ZRmax = ranges[INPUT_AXIS_RZ].Max;
     }
-    else if (guidType == GUID_Slider)
+    if (ranges[INPUT_AXIS_SLIDER0].Present)
     {
-        // Sliders are numbered sequentially
-        if (!joystick->m_AxisCaps.hasSlider0)
-        {
-            joystick->m_AxisCaps.hasSlider0 = TRUE;
-            joystick->m_Umin = range.lMin;
-            joystick->m_Umax = range.lMax;
-        }
-        else if (!joystick->m_AxisCaps.hasSlider1)
-        {
-            joystick->m_AxisCaps.hasSlider1 = TRUE;
-            joystick->m_Vmin = range.lMin;
-            joystick->m_Vmax = range.lMax;
-        }
+        m_AxisCaps.hasSlider0 = TRUE;
+        m_Umin = ranges[INPUT_AXIS_SLIDER0].Min;
+        m_Umax = ranges[INPUT_AXIS_SLIDER0].Max;
     }
-
-    return DIENUM_CONTINUE;
-}
-
-void DX8InputManager::CKJoystick::GetInfo()
-{
-    if (m_Device)
+    if (ranges[INPUT_AXIS_SLIDER1].Present)
     {
-        m_AxisCaps = AxisCapabilities();
-        // Initialize default ranges (in case device has no axes)
-        m_Xmin = m_Ymin = m_Zmin = -1000;
-        m_Xmax = m_Ymax = m_Zmax = 1000;
-        m_XRmin = m_YRmin = m_ZRmin = -1000;
-        m_XRmax = m_YRmax = m_ZRmax = 1000;
-        m_Umin = m_Vmin = -1000;
-        m_Umax = m_Vmax = 1000;
-
-        // Enumerate all axes on the device to determine capabilities
-        m_Device->EnumObjects(EnumAxesCallback, (LPVOID)this, DIDFT_AXIS);
+        m_AxisCaps.hasSlider1 = TRUE;
+        m_Vmin = ranges[INPUT_AXIS_SLIDER1].Min;
+        m_Vmax = ranges[INPUT_AXIS_SLIDER1].Max;
     }
+    UpdateAxisScale();
 }
 
-CKBOOL DX8InputManager::CKJoystick::IsAttached()
+BOOL InputJoystick::SetResponseCurve(int axis, const float *x, const float *y, int count, BOOL symmetric)
 {
-    return m_Device != NULL;
+    if (axis < 0 || axis >= AXIS_KERNEL_AXES)
+        return FALSE;
+    BOOL enabled = m_Curves[axis].Enabled;
+    if (!InputResponseCurveCompile(m_Curves[axis], x, y, count, symmetric))
+        return FALSE;
+    if (!enabled)
+        ++m_CurveCount;
+    return TRUE;
 }
 
-static BOOL GetJoystickEnumerationAction(int joystickCount, int maxJoysticks, HRESULT createDeviceResult, BOOL deviceCreated)
+void InputJoystick::ClearResponseCurve(int axis)
 {
-    if (joystickCount >= maxJoysticks)
-        return DIENUM_STOP;
-
-    if (FAILED(createDeviceResult) || !deviceCreated)
-        return DIENUM_CONTINUE;
-
-    return DIENUM_CONTINUE;
+    if (axis < 0 || axis >= AXIS_KERNEL_AXES || !m_Curves[axis].Enabled)
+        return;
+    m_Curves[axis].Enabled = FALSE;
+    --m_CurveCount;
 }
 
-BOOL DX8InputManager::JoystickEnum(const DIDEVICEINSTANCE *pdidInstance, void *pContext)
+void InputJoystick::UpdateAxisScale()
 {
-    DX8InputManager *im = (DX8InputManager *)pContext;
-
-    if (im->m_JoystickCount >= im->m_MaxJoysticks)
-        return DIENUM_STOP;
-
-    LPDIRECTINPUTDEVICE8 pJoystick = NULL;
-    HRESULT hr = im->m_DirectInput->CreateDevice(pdidInstance->guidInstance, &pJoystick, NULL);
-    if (FAILED(hr) || !pJoystick)
-        return GetJoystickEnumerationAction(im->m_JoystickCount, im->m_MaxJoysticks, hr, FALSE);
-
-    CKJoystick &joystick = im->m_Joysticks[im->m_JoystickCount];
-    joystick.m_Device = pJoystick;
-
-    // Store the device GUID
-    joystick.m_DeviceGUID = pdidInstance->guidInstance;
-
-    // Store the device product name (convert from TCHAR to char if needed)
-#ifdef UNICODE
-    WideCharToMultiByte(CP_UTF8, 0, pdidInstance->tszProductName, -1,
-                        joystick.m_DeviceName, MAX_PATH, NULL, NULL);
-#else
-    strncpy(joystick.m_DeviceName, pdidInstance->tszProductName, MAX_PATH - 1);
-    joystick.m_DeviceName[MAX_PATH - 1] = '\0';
-#endif
-
-    // Query button count from device capabilities
-    DIDEVCAPS caps;
-    memset(&caps, 0, sizeof(DIDEVCAPS));
-    caps.dwSize = sizeof(DIDEVCAPS);
-    if (SUCCEEDED(pJoystick->GetCapabilities(&caps)))
-    {
-        joystick.m_ButtonCount = (int)caps.dwButtons;
-    }
-    else
-    {
-        joystick.m_ButtonCount = 32; // Default to maximum
-    }
-
-    ++im->m_JoystickCount;
-    return GetJoystickEnumerationAction(im->m_JoystickCount, im->m_MaxJoysticks, hr, TRUE);
+    InputAxisScaleSet(m_AxisScale, 0, m_AxisCaps.hasX, m_Xmin, m_Xmax);
+    InputAxisScaleSet(m_AxisScale, 1, m_AxisCaps.hasY, m_Ymin, m_Ymax);
+    InputAxisScaleSet(m_AxisScale, 2, m_AxisCaps.hasZ, m_Zmin, m_Zmax);
+    InputAxisScaleSet(m_AxisScale, 3, m_AxisCaps.hasRx, m_XRmin, m_XRmax);
+    InputAxisScaleSet(m_AxisScale, 4, m_AxisCaps.hasRy, m_YRmin, m_YRmax);
+    InputAxisScaleSet(m_AxisScale, 5, m_AxisCaps.hasRz, m_ZRmin, m_ZRmax);
+    InputAxisScaleSet(m_AxisScale, 6, m_AxisCaps.hasSlider0, m_Umin, m_Umax);
+    InputAxisScaleSet(m_AxisScale, 7, m_AxisCaps.hasSlider1, m_Vmin, m_Vmax);
 }
+
@@ -0,0 +1,117 @@
+#include "JoystickPoller.h"
+
+// m_Next between batches: a worker waking late claims past the end of any batch
+#define JOYSTICK_POLL_IDLE_INDEX 0x40000000
+
+InputJoystickPoller::InputJoystickPoller()
+    : m_Workers(NULL), m_WorkerCount(0), m_Batch(NULL), m_Count(0),
+      m_Next(JOYSTICK_POLL_IDLE_INDEX), m_Remaining(0), m_Active(0), m_Stop(0)
+{
+}
+
+InputJoystickPoller::~InputJoystickPoller()
+{
+    Stop();
+}
+
+BOOL InputJoystickPoller::Start(int workers)
+{
+    Stop();
+    if (workers <= 0)
+        return TRUE;
+    if (workers > JOYSTICK_POLL_MAX_WORKERS)
+        workers = JOYSTICK_POLL_MAX_WORKERS;
+
+    InputAtomicStore(&m_Stop, 0);
+    m_Workers = new Worker[workers];
+    for (int i = 0; i < workers; i++)
+    {
+        m_Workers[i].Owner = this;
+        if (!m_Workers[i].Thread.Start(WorkerMain, &m_Workers[i]))
+        {
+            m_WorkerCount = i;
+            Stop();
+            return FALSE;
+        }
+    }
+    m_WorkerCount = workers;
+    return TRUE;
+}
+
+void InputJoystickPoller::Stop()
+{
+    if (!m_Workers)
+        return;
+
+    InputAtomicStore(&m_Stop, 1);
+    for (int i = 0; i < m_WorkerCount; i++)
+        m_Workers[i].Wake.Set();
+    for (int i = 0; i < m_WorkerCount; i++)
+        m_Workers[i].Thread.Join();
+    delete[] m_Workers;
+    m_Workers = NULL;
+    m_WorkerCount = 0;
+}
+
+void InputJoystickPoller::WorkerMain(void *arg)
+{
+    Worker *worker = (Worker *)arg;
+    InputJoystickPoller *owner = worker->Owner;
+    while (!InputAtomicLoad(&owner->m_Stop))
+    {
+        if (!worker->Wake.Wait(JOYSTICK_POLL_IDLE_WAIT))
+            continue;
+        InputAtomicAdd(&owner->m_Active, 1);
+        owner->Drain();
+        if (InputAtomicAdd(&owner->m_Active, -1) == 0)
+            owner->m_Done.Set();
+    }
+}
+
+void InputJoystickPoller::Drain()
+{
+    for (;;)
+    {
+        // A claim made between two batches gets an index past the idle mark, beyond
+        // any count; PollAll does not return while a worker is here, so an index of
+        // a finished batch is never checked against the count of the next one
+        LONG index = InputAtomicAdd(&m_Next, 1) - 1;
+        if (index >= InputAtomicLoad(&m_Count))
+            return;
+        m_Batch[index].PollDetached();
+        if (InputAtomicAdd(&m_Remaining, -1) == 0)
+            m_Done.Set();
+    }
+}
+
+void InputJoystickPoller::PollAll(InputJoystick *joysticks, int count, BOOL useWorkers)
+{
+    if (!joysticks || count <= 0)
+        return;
+
+    if (m_WorkerCount == 0 || !useWorkers)
+    {
+        for (int i = 0; i < count; i++)
+            joysticks[i].Poll();
+        return;
+    }
+
+    m_Batch = joysticks;
+    InputAtomicStore(&m_Count, count);
+    InputAtomicStore(&m_Remaining, count);
+    InputAtomicStore(&m_Next, 0);
+    int wake = (count - 1 < m_WorkerCount) ? count - 1 : m_WorkerCount;
+    for (int i = 0; i < wake; i++)
+        m_Workers[i].Wake.Set();
+
+    Drain();
+    while (InputAtomicLoad(&m_Remaining) > 0)
+        m_Done.Wait(JOYSTICK_POLL_IDLE_WAIT);
+    InputAtomicStore(&m_Next, JOYSTICK_POLL_IDLE_INDEX);
+    while (InputAtomicLoad(&m_Active) > 0)
+        m_Done.Wait(JOYSTICK_POLL_IDLE_WAIT);
+
+    // Frame stats have a single writer, so the workers leave them to this thread
+    for (int i = 0; i < count; i++)
+        joysticks[i].ReportPollCost();
+}
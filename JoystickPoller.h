@@ -0,0 +1,56 @@
+#ifndef JOYSTICKPOLLER_H
+#define JOYSTICKPOLLER_H
+
+#include "InputDevices.h"
+#include "InputThread.h"
+
+#define JOYSTICK_POLL_MAX_WORKERS 8
+#define JOYSTICK_POLL_IDLE_WAIT 100 // Milliseconds a worker sleeps between checks for a stop request
+
+// Polls every joystick at once at the start of the frame, so the queries of the
+// frame only read memory. The polls run on the calling thread, or are shared
+// between it and up to JOYSTICK_POLL_MAX_WORKERS worker threads; each device is
+// polled by exactly one thread. The costs still land in each joystick's frame
+// stats, added on the calling thread once every poll is done.
+class InputJoystickPoller
+{
+public:
+    InputJoystickPoller();
+    ~InputJoystickPoller(); // Stops the workers
+
+    // Starts the workers, 0 polls on the calling thread only; FALSE if a thread failed to start
+    BOOL Start(int workers);
+    void Stop();
+    int GetWorkerCount() const { return m_WorkerCount; }
+
+    // Polls joysticks 0 to count - 1 that are not polled yet, and returns once all are;
+    // without useWorkers they are polled in order on the calling thread
+    void PollAll(InputJoystick *joysticks, int count, BOOL useWorkers = TRUE);
+
+private:
+    InputJoystickPoller(const InputJoystickPoller &);
+    InputJoystickPoller &operator=(const InputJoystickPoller &);
+
+    struct Worker
+    {
+        InputJoystickPoller *Owner;
+        InputThread Thread;
+        InputSignal Wake;
+    };
+
+    static void WorkerMain(void *arg);
+    // Claims and polls devices of the batch until none is left
+    void Drain();
+
+    Worker *m_Workers;
+    int m_WorkerCount;
+    InputJoystick *m_Batch;
+    volatile LONG m_Count;
+    volatile LONG m_Next;      // Next device to claim; past any count between batches
+    volatile LONG m_Remaining; // Devices of the batch not polled yet
+    volatile LONG m_Active;    // Workers inside Drain
+    volatile LONG m_Stop;
+    InputSignal m_Done; // Set by whichever thread polls the last device, and by the last worker leaving Drain
+};
+
+#endif // JOYSTICKPOLLER_H
@@ -0,0 +1,326 @@
+#include "JoystickWatcher.h"
+
+InputJoystickWatcher::InputJoystickWatcher()
+    : m_Backend(NULL), m_Window(NULL), m_Interval(JOYSTICK_WATCH_INTERVAL), m_OpenThreads(1), m_ScanNow(FALSE),
+      m_Stop(0), m_Scans(0),
+      m_SlotGUIDs(NULL), m_Slots(NULL), m_SlotCount(0), m_FoundCount(0), m_ChangeCount(0), m_Pending(0)
+{
+}
+
+InputJoystickWatcher::~InputJoystickWatcher()
+{
+    Stop();
+}
+
+BOOL InputJoystickWatcher::Start(InputBackend *backend, HWND hWnd, const InputJoystick *joysticks, int count, int slots,
+                                 BOOL scanNow)
+{
+    Stop();
+    if (!backend || slots <= 0)
+        return FALSE;
+    if (count > slots)
+        count = slots;
+
+    m_Backend = backend;
+    m_Window = hWnd;
+    m_ScanNow = scanNow;
+    m_SlotGUIDs = new GUID[slots];
+    m_Slots = new BYTE[slots];
+    m_SlotCount = slots;
+    memset(m_SlotGUIDs, 0, slots * sizeof(GUID));
+    memset(m_Slots, SLOT_EMPTY, slots);
+    for (int i = 0; i < count; i++)
+    {
+        m_SlotGUIDs[i] = joysticks[i].GetGUID();
+        if (joysticks[i].IsAttached())
+            m_Slots[i] = SLOT_ATTACHED;
+        else if (joysticks[i].IsDetached())
+            m_Slots[i] = SLOT_DETACHED;
+    }
+
+    InputAtomicStore(&m_Stop, 0);
+    InputAtomicStore(&m_Scans, 0);
+    if (!m_Thread.Start(ThreadMain, this))
+    {
+        Stop();
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void InputJoystickWatcher::Stop()
+{
+    if (!m_Slots)
+        return;
+
+    InputAtomicStore(&m_Stop, 1);
+    m_Wake.Set();
+    m_Thread.Join();
+
+    // Arrivals nobody took would leak their device
+    InputMutexLock lock(m_Lock);
+    for (int i = 0; i < m_ChangeCount; i++)
+    {
+        if (m_Changes[i].Type == INPUT_JOYSTICK_ARRIVED && m_Changes[i].Device)
+        {
+            m_Changes[i].Device->Unacquire();
+            m_Changes[i].Device->Release();
+        }
+    }
+    m_ChangeCount = 0;
+    InputAtomicStore(&m_Pending, 0);
+
+    delete[] m_SlotGUIDs;
+    m_SlotGUIDs = NULL;
+    delete[] m_Slots;
+    m_Slots = NULL;
+    m_SlotCount = 0;
+    m_Backend = NULL;
+}
+
+void InputJoystickWatcher::SetWindow(HWND hWnd)
+{
+    InputMutexLock lock(m_Lock);
+    m_Window = hWnd;
+}
+
+void InputJoystickWatcher::SetOpenThreads(int threads)
+{
+    if (threads < 1)
+        threads = 1;
+    if (threads > JOYSTICK_WATCH_MAX_OPENERS)
+        threads = JOYSTICK_WATCH_MAX_OPENERS;
+    m_OpenThreads = threads;
+}
+
+void InputJoystickWatcher::Rescan()
+{
+    m_Wake.Set();
+}
+
+void InputJoystickWatcher::ThreadMain(void *arg)
+{
+    InputJoystickWatcher *watcher = (InputJoystickWatcher *)arg;
+    if (watcher->m_ScanNow)
+    {
+        watcher->Scan();
+        InputAtomicAdd(&watcher->m_Scans, 1);
+    }
+    while (!InputAtomicLoad(&watcher->m_Stop))
+    {
+        // An interval of 0 scans on request only
+        DWORD interval = watcher->m_Interval;
+        BOOL woken = watcher->m_Wake.Wait(interval ? interval : JOYSTICK_WATCH_INTERVAL);
+        if (InputAtomicLoad(&watcher->m_Stop))
+            break;
+        if (!woken && interval == 0)
+            continue;
+        watcher->Scan();
+        InputAtomicAdd(&watcher->m_Scans, 1);
+    }
+}
+
+BOOL InputJoystickWatcher::Enumerate(const InputDeviceInfo *info, void *context)
+{
+    InputJoystickWatcher *watcher = (InputJoystickWatcher *)context;
+    if (watcher->m_FoundCount >= JOYSTICK_WATCH_MAX_DEVICES)
+        return DIENUM_STOP;
+    watcher->m_Found[watcher->m_FoundCount++] = *info;
+    return DIENUM_CONTINUE;
+}
+
+void InputJoystickWatcher::Scan()
+{
+    m_FoundCount = 0;
+    if (FAILED(m_Backend->EnumJoysticks(Enumerate, this)))
+        return;
+
+    // Removals first, so a device moving to another port keeps its slot
+    for (int s = 0; s < m_SlotCount; s++)
+    {
+        if (m_Slots[s] != SLOT_ATTACHED)
+            continue;
+        int f = 0;
+        while (f < m_FoundCount && m_Found[f].InstanceGUID != m_SlotGUIDs[s])
+            ++f;
+        if (f < m_FoundCount)
+            continue;
+
+        InputJoystickChange change;
+        memset(&change, 0, sizeof(InputJoystickChange));
+        change.Type = INPUT_JOYSTICK_REMOVED;
+        change.Slot = s;
+        if (Publish(change))
+            m_Slots[s] = SLOT_DETACHED;
+    }
+
+    // Slots are chosen here, so the openings of one scan never compete for one
+    Opening openings[JOYSTICK_WATCH_MAX_DEVICES];
+    int count = 0;
+    for (int f = 0; f < m_FoundCount; f++)
+    {
+        int slot = -1;
+        int empty = -1;
+        BOOL known = FALSE;
+        for (int s = 0; s < m_SlotCount && !known; s++)
+        {
+            if (m_Slots[s] == SLOT_EMPTY)
+            {
+                BOOL taken = FALSE;
+                for (int o = 0; o < count && !taken; o++)
+                    taken = openings[o].Slot == s;
+                if (empty < 0 && !taken)
+                    empty = s;
+            }
+            else if (m_SlotGUIDs[s] == m_Found[f].InstanceGUID)
+            {
+                if (m_Slots[s] == SLOT_ATTACHED)
+                    known = TRUE;
+                else
+                    slot = s;
+            }
+        }
+        if (known)
+            continue;
+        if (slot < 0)
+            slot = empty;
+        if (slot < 0)
+            continue;
+        openings[count].Slot = slot;
+        openings[count].Found = f;
+        openings[count].Opened = FALSE;
+        ++count;
+    }
+
+    int threads = (count < m_OpenThreads) ? count : m_OpenThreads;
+    if (threads > 1)
+    {
+        InputThread helpers[JOYSTICK_WATCH_MAX_OPENERS];
+        Opener openers[JOYSTICK_WATCH_MAX_OPENERS];
+        for (int t = 1; t < threads; t++)
+        {
+            openers[t].Owner = this;
+            openers[t].Openings = openings;
+            openers[t].Count = count;
+            openers[t].First = t;
+            openers[t].Stride = threads;
+            if (!helpers[t].Start(OpenerMain, &openers[t]))
+                OpenRange(openings, count, t, threads);
+        }
+        OpenRange(openings, count, 0, threads);
+        for (int t = 1; t < threads; t++)
+            helpers[t].Join();
+    }
+    else
+    {
+        OpenRange(openings, count, 0, 1);
+    }
+
+    // A device that failed to open is retried on the next scan
+    for (int o = 0; o < count; o++)
+    {
+        if (!openings[o].Opened)
+            continue;
+        m_SlotGUIDs[openings[o].Slot] = m_Found[openings[o].Found].InstanceGUID;
+        m_Slots[openings[o].Slot] = SLOT_ATTACHED;
+    }
+}
+
+void InputJoystickWatcher::OpenerMain(void *arg)
+{
+    Opener *opener = (Opener *)arg;
+    opener->Owner->OpenRange(opener->Openings, opener->Count, opener->First, opener->Stride);
+}
+
+void InputJoystickWatcher::OpenRange(Opening *openings, int count, int first, int stride)
+{
+    for (int o = first; o < count; o += stride)
+        openings[o].Opened = Open(openings[o].Slot, m_Found[openings[o].Found]);
+}
+
+BOOL InputJoystickWatcher::Open(int slot, const InputDeviceInfo &info)
+{
+    InputJoystickChange change;
+    memset(&change, 0, sizeof(InputJoystickChange));
+    change.Type = INPUT_JOYSTICK_ARRIVED;
+    change.Slot = slot;
+    change.Info = info;
+
+    if (FAILED(m_Backend->CreateJoystick(info.InstanceGUID, &change.Device)) || !change.Device)
+        return FALSE;
+
+    HWND hWnd;
+    {
+        InputMutexLock lock(m_Lock);
+        hWnd = m_Window;
+    }
+    change.Device->SetCooperativeLevel(hWnd, DISCL_NONEXCLUSIVE | DISCL_BACKGROUND);
+    change.Device->Acquire();
+    if (FAILED(change.Device->GetCapabilities(&change.Caps)))
+    {
+        memset(&change.Caps, 0, sizeof(InputDeviceCaps));
+        change.Caps.Buttons = JOYSTICK_BUTTON_COUNT; // Default to maximum, as InputJoystick::Attach does
+    }
+    if (FAILED(change.Device->GetAxisRanges(change.Ranges)))
+        memset(change.Ranges, 0, sizeof(change.Ranges));
+
+    if (!Publish(change))
+    {
+        change.Device->Unacquire();
+        change.Device->Release();
+        return FALSE;
+    }
+    return TRUE;
+}
+
+BOOL InputJoystickWatcher::Publish(const InputJoystickChange &change)
+{
+    InputMutexLock lock(m_Lock);
+    if (m_ChangeCount >= JOYSTICK_WATCH_MAX_CHANGES)
+        return FALSE;
+    m_Changes[m_ChangeCount++] = change;
+    InputAtomicStore(&m_Pending, 1);
+    return TRUE;
+}
+
+int InputJoystickWatcher::TakeChanges(InputJoystickChange *changes, int max)
+{
+    if (!HasChanges() || max <= 0)
+        return 0;
+
+    InputMutexLock lock(m_Lock);
+    int count = (m_ChangeCount < max) ? m_ChangeCount : max;
+    for (int i = 0; i < count; i++)
+        changes[i] = m_Changes[i];
+    m_ChangeCount -= count;
+    memmove(m_Changes, m_Changes + count, m_ChangeCount * sizeof(InputJoystickChange));
+    InputAtomicStore(&m_Pending, m_ChangeCount > 0 ? 1 : 0);
+    return count;
+}
+
+int InputJoystickWatcher::ApplyChanges(InputJoystick *joysticks, int *count)
+{
+    int applied = 0;
+    InputJoystickChange changes[8];
+    int taken;
+    while ((taken = TakeChanges(changes, 8)) > 0)
+    {
+        for (int i = 0; i < taken; i++)
+        {
+            const InputJoystickChange &change = changes[i];
+            InputJoystick &joystick = joysticks[change.Slot];
+            if (change.Type == INPUT_JOYSTICK_ARRIVED)
+            {
+                joystick.Attach(m_Backend, change.Device, change.Info, change.Caps, change.Ranges);
+                if (change.Slot >= *count)
+                    *count = change.Slot + 1;
+            }
+            else
+            {
+                joystick.Detach();
+            }
+        }
+        applied += taken;
+    }
+    return applied;
+}
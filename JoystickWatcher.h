@@ -0,0 +1,125 @@
+#ifndef JOYSTICKWATCHER_H
+#define JOYSTICKWATCHER_H
+
+#include "InputDevices.h"
+#include "InputThread.h"
+
+#define JOYSTICK_WATCH_INTERVAL 2000    // Default milliseconds between two scans
+#define JOYSTICK_WATCH_MAX_DEVICES 64   // Devices considered per scan
+#define JOYSTICK_WATCH_MAX_CHANGES 64   // Changes waiting for the main thread
+#define JOYSTICK_WATCH_MAX_OPENERS 8    // Threads opening the new devices of one scan
+
+enum INPUT_JOYSTICK_CHANGE
+{
+    INPUT_JOYSTICK_ARRIVED, // Device opened, acquired and characterized for the slot
+    INPUT_JOYSTICK_REMOVED  // Device of the slot is gone; the slot keeps its identity
+};
+
+struct InputJoystickChange
+{
+    INPUT_JOYSTICK_CHANGE Type;
+    int Slot;
+    InputDevice *Device; // Arrivals only, owned by the receiver once taken
+    InputDeviceInfo Info;
+    InputDeviceCaps Caps;
+    InputAxisRange Ranges[INPUT_AXIS_COUNT];
+};
+
+// Re-enumerates the game controllers on a background thread and keeps them in
+// stable slots: a new device takes the slot it had before it was unplugged, or
+// else the first slot never used, so indices never shift. Devices are opened,
+// acquired and queried on the watcher thread; the main thread only picks up the
+// finished changes with ApplyChanges, which is lock free when nothing changed.
+// Several new devices found by one scan can be opened in parallel.
+// The backend must allow enumeration and device creation from other threads.
+class InputJoystickWatcher
+{
+public:
+    InputJoystickWatcher();
+    ~InputJoystickWatcher(); // Stops the thread
+
+    // Starts watching with joysticks 0 to count - 1 already in their slots, out of slots,
+    // scanning at once when scanNow is set; FALSE if the thread failed to start
+    BOOL Start(InputBackend *backend, HWND hWnd, const InputJoystick *joysticks, int count, int slots,
+               BOOL scanNow = FALSE);
+    // Stops the thread and releases the devices of changes not applied yet
+    void Stop();
+    BOOL IsRunning() const { return m_Slots != NULL; }
+
+    DWORD GetInterval() const { return m_Interval; }
+    void SetInterval(DWORD ms) { m_Interval = ms; }
+    // Threads opening the devices found by one scan, the watcher thread included
+    int GetOpenThreads() const { return m_OpenThreads; }
+    void SetOpenThreads(int threads);
+    void SetWindow(HWND hWnd);
+    // Scans at once instead of at the end of the interval, e.g. on WM_DEVICECHANGE
+    void Rescan();
+    DWORD GetScanCount() const { return (DWORD)InputAtomicLoad(&m_Scans); } // Since Start
+
+    BOOL HasChanges() const { return InputAtomicLoad(&m_Pending) != 0; }
+    // Moves up to max pending changes into changes, oldest first
+    int TakeChanges(InputJoystickChange *changes, int max);
+    // Applies the pending changes to the slots, raising count past the highest slot
+    // used; returns the number of changes applied
+    int ApplyChanges(InputJoystick *joysticks, int *count);
+
+private:
+    InputJoystickWatcher(const InputJoystickWatcher &);
+    InputJoystickWatcher &operator=(const InputJoystickWatcher &);
+
+    enum SlotState
+    {
+        SLOT_EMPTY,
+        SLOT_ATTACHED,
+        SLOT_DETACHED
+    };
+
+    struct Opening
+    {
+        int Slot;
+        int Found; // Index in m_Found
+        BOOL Opened;
+    };
+
+    struct Opener
+    {
+        InputJoystickWatcher *Owner;
+        Opening *Openings;
+        int Count;
+        int First;
+        int Stride;
+    };
+
+    static void ThreadMain(void *arg);
+    static void OpenerMain(void *arg);
+    static BOOL Enumerate(const InputDeviceInfo *info, void *context);
+    void Scan();
+    // Opens every stride-th device of openings from first on
+    void OpenRange(Opening *openings, int count, int first, int stride);
+    BOOL Open(int slot, const InputDeviceInfo &info);
+    BOOL Publish(const InputJoystickChange &change);
+
+    InputBackend *m_Backend;
+    HWND m_Window;
+    volatile DWORD m_Interval;
+    int m_OpenThreads;
+    BOOL m_ScanNow;
+    InputThread m_Thread;
+    InputSignal m_Wake;
+    volatile LONG m_Stop;
+    volatile LONG m_Scans;
+
+    // Watcher thread only, once started
+    GUID *m_SlotGUIDs;
+    BYTE *m_Slots; // SlotState of each slot, NULL when stopped
+    int m_SlotCount;
+    InputDeviceInfo m_Found[JOYSTICK_WATCH_MAX_DEVICES];
+    int m_FoundCount;
+
+    InputMutex m_Lock; // Guards the changes and the window
+    InputJoystickChange m_Changes[JOYSTICK_WATCH_MAX_CHANGES];
+    int m_ChangeCount;
+    volatile LONG m_Pending;
+};
+
+#endif // JOYSTICKWATCHER_H
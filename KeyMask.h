@@ -0,0 +1,133 @@
+#ifndef KEYMASK_H
+#define KEYMASK_H
+
+#include "InputBackend.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define KEYMASK_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KEYMASK_SSE2 1
+#endif
+#if defined(_MSC_VER) && _MSC_VER >= 1400
+#include <intrin.h>
+#endif
+
+// 256-bit key mask: bit (key & 31) of word (key >> 5) is set for scancode key
+#define KEYMASK_WORDS 8
+
+inline BOOL KeyMaskTest(const DWORD *mask, DWORD key)
+{
+    return (mask[key >> 5] & (1u << (key & 31))) != 0;
+}
+
+inline void KeyMaskSet(DWORD *mask, DWORD key)
+{
+    mask[key >> 5] |= 1u << (key & 31);
+}
+
+inline void KeyMaskReset(DWORD *mask, DWORD key)
+{
+    mask[key >> 5] &= ~(1u << (key & 31));
+}
+
+inline void KeyMaskClear(DWORD *mask)
+{
+#if defined(KEYMASK_AVX2)
+    _mm256_storeu_si256((__m256i *)mask, _mm256_setzero_si256());
+#elif defined(KEYMASK_SSE2)
+    _mm_storeu_si128((__m128i *)mask, _mm_setzero_si128());
+    _mm_storeu_si128((__m128i *)(mask + 4), _mm_setzero_si128());
+#else
+    for (int i = 0; i < KEYMASK_WORDS; i++)
+        mask[i] = 0;
+#endif
+}
+
+inline BOOL KeyMaskIsEmpty(const DWORD *mask)
+{
+#if defined(KEYMASK_AVX2)
+    __m256i v = _mm256_loadu_si256((const __m256i *)mask);
+    return _mm256_testz_si256(v, v) != 0;
+#elif defined(KEYMASK_SSE2)
+    __m128i v = _mm_or_si128(_mm_loadu_si128((const __m128i *)mask), _mm_loadu_si128((const __m128i *)(mask + 4)));
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(v, _mm_setzero_si128())) == 0xFFFF;
+#else
+    DWORD any = 0;
+    for (int i = 0; i < KEYMASK_WORDS; i++)
+        any |= mask[i];
+    return any == 0;
+#endif
+}
+
+// dst &= ~src
+inline void KeyMaskAndNot(DWORD *dst, const DWORD *src)
+{
+#if defined(KEYMASK_AVX2)
+    __m256i d = _mm256_loadu_si256((const __m256i *)dst);
+    __m256i s = _mm256_loadu_si256((const __m256i *)src);
+    _mm256_storeu_si256((__m256i *)dst, _mm256_andnot_si256(s, d));
+#elif defined(KEYMASK_SSE2)
+    for (int i = 0; i < KEYMASK_WORDS; i += 4)
+    {
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_andnot_si128(s, d));
+    }
+#else
+    for (int i = 0; i < KEYMASK_WORDS; i++)
+        dst[i] &= ~src[i];
+#endif
+}
+
+// Builds a mask from a byte-per-key array: bit k is set when (states[k] & bit) != 0.
+// bit must be a single bit; words * 32 states are read.
+inline void KeyMaskFromStates(DWORD *mask, const BYTE *states, BYTE bit, int words = KEYMASK_WORDS)
+{
+#if defined(KEYMASK_SSE2)
+    const __m128i sel = _mm_set1_epi8((char)bit);
+    for (int i = 0; i < words; i++)
+    {
+        const BYTE *p = states + i * 32;
+        // Expand the selected bit to a full byte, then gather one bit per byte
+        __m128i lo = _mm_cmpeq_epi8(_mm_and_si128(_mm_loadu_si128((const __m128i *)p), sel), sel);
+        __m128i hi = _mm_cmpeq_epi8(_mm_and_si128(_mm_loadu_si128((const __m128i *)(p + 16)), sel), sel);
+        mask[i] = (DWORD)(_mm_movemask_epi8(lo) & 0xFFFF) | ((DWORD)(_mm_movemask_epi8(hi) & 0xFFFF) << 16);
+    }
+#else
+    for (int i = 0; i < words; i++)
+    {
+        DWORD word = 0;
+        for (int b = 0; b < 32; b++)
+        {
+            if ((states[i * 32 + b] & bit) != 0)
+                word |= 1u << b;
+        }
+        mask[i] = word;
+    }
+#endif
+}
+
+// Index of the lowest set bit of a non-zero word
+inline int KeyMaskLowestBit(DWORD word)
+{
+#if defined(_MSC_VER) && _MSC_VER >= 1400
+    unsigned long index;
+    _BitScanForward(&index, word);
+    return (int)index;
+#elif defined(__GNUC__)
+    return __builtin_ctz(word);
+#else
+    int index = 0;
+    while ((word & 1u) == 0)
+    {
+        word >>= 1;
+        ++index;
+    }
+    return index;
+#endif
+}
+
+#endif // KEYMASK_H
@@ -0,0 +1,98 @@
+#include "KeyNames.h"
+
+#include <string.h>
+
+static inline char FoldCase(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+KeyNameTable::KeyNameTable()
+{
+    Clear();
+}
+
+void KeyNameTable::Clear()
+{
+    m_Built = FALSE;
+    memset(m_Results, 0, sizeof(m_Results));
+    memset(m_Offsets, 0, sizeof(m_Offsets));
+    memset(m_Slots, -1, sizeof(m_Slots));
+    m_Pool[0] = '\0';
+    m_PoolSize = 1; // Offset 0 is the shared empty name
+}
+
+void KeyNameTable::Build(NameFunction func)
+{
+    Clear();
+    if (!func) return;
+
+    char name[256];
+    for (DWORD key = 0; key < KEYNAME_KEY_COUNT; key++)
+    {
+        name[0] = '\0';
+        m_Results[key] = func(key, name);
+        if (m_Results[key] == 0 || name[0] == '\0')
+            continue;
+
+        size_t length = strlen(name);
+        if (length >= KEYNAME_MAX_LENGTH)
+            length = KEYNAME_MAX_LENGTH - 1;
+        m_Offsets[key] = (WORD)m_PoolSize;
+        memcpy(m_Pool + m_PoolSize, name, length);
+        m_Pool[m_PoolSize + length] = '\0';
+        m_PoolSize += (int)length + 1;
+
+        // The first scancode with a given name wins, as with a linear search
+        const char *interned = m_Pool + m_Offsets[key];
+        DWORD slot = Hash(interned) & (KEYNAME_HASH_SIZE - 1);
+        while (m_Slots[slot] >= 0 && !Equal(m_Pool + m_Offsets[m_Slots[slot]], interned))
+            slot = (slot + 1) & (KEYNAME_HASH_SIZE - 1);
+        if (m_Slots[slot] < 0)
+            m_Slots[slot] = (short)key;
+    }
+    m_Built = TRUE;
+}
+
+int KeyNameTable::GetName(DWORD key, char *name) const
+{
+    if (key >= KEYNAME_KEY_COUNT)
+        return 0;
+    if (name)
+        strcpy(name, m_Pool + m_Offsets[key]);
+    return m_Results[key];
+}
+
+DWORD KeyNameTable::GetKey(const char *name) const
+{
+    if (!name || name[0] == '\0')
+        return KEYNAME_KEY_COUNT;
+
+    DWORD slot = Hash(name) & (KEYNAME_HASH_SIZE - 1);
+    while (m_Slots[slot] >= 0)
+    {
+        if (Equal(m_Pool + m_Offsets[m_Slots[slot]], name))
+            return (DWORD)m_Slots[slot];
+        slot = (slot + 1) & (KEYNAME_HASH_SIZE - 1);
+    }
+    return KEYNAME_KEY_COUNT;
+}
+
+// FNV-1a over the case-folded name
+DWORD KeyNameTable::Hash(const char *name)
+{
+    DWORD hash = 2166136261u;
+    for (; *name != '\0'; ++name)
+    {
+        hash ^= (BYTE)FoldCase(*name);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+BOOL KeyNameTable::Equal(const char *a, const char *b)
+{
+    for (; *a != '\0' && FoldCase(*a) == FoldCase(*b); ++a, ++b)
+        ;
+    return FoldCase(*a) == FoldCase(*b);
+}
@@ -0,0 +1,40 @@
+#ifndef KEYNAMES_H
+#define KEYNAMES_H
+
+#include "InputBackend.h"
+
+#define KEYNAME_KEY_COUNT 256
+#define KEYNAME_MAX_LENGTH 32
+#define KEYNAME_HASH_SIZE 512 // Power of two, at least twice KEYNAME_KEY_COUNT
+
+// Scancode <-> name index built once from a name function (VxScanCodeToName in the manager).
+// Names are interned in a single pool; lookups by name are case-insensitive (ASCII).
+class KeyNameTable
+{
+public:
+    // Writes the name of a scancode and returns the same value as VxScanCodeToName (0 if unnamed)
+    typedef int (*NameFunction)(DWORD key, char *name);
+
+    KeyNameTable();
+    void Build(NameFunction func);
+    void Clear();
+    BOOL IsBuilt() const { return m_Built; }
+
+    // Copies the cached name, returns the cached result of the name function
+    int GetName(DWORD key, char *name) const;
+    // Returns KEYNAME_KEY_COUNT when no scancode has this name
+    DWORD GetKey(const char *name) const;
+
+private:
+    static DWORD Hash(const char *name);
+    static BOOL Equal(const char *a, const char *b);
+
+    BOOL m_Built;
+    int m_Results[KEYNAME_KEY_COUNT];
+    WORD m_Offsets[KEYNAME_KEY_COUNT];
+    short m_Slots[KEYNAME_HASH_SIZE]; // Scancode per hash slot, -1 when empty
+    char m_Pool[KEYNAME_KEY_COUNT * KEYNAME_MAX_LENGTH];
+    int m_PoolSize;
+};
+
+#endif // KEYNAMES_H
@@ -0,0 +1,95 @@
+#include "KeyRepeat.h"
+
+KeyRepeatQueue::KeyRepeatQueue() : m_Count(0)
+{
+    for (int i = 0; i < KEYREPEAT_MAX_KEYS; i++)
+        m_Slots[i] = -1;
+}
+
+void KeyRepeatQueue::Clear()
+{
+    for (int i = 0; i < m_Count; i++)
+        m_Slots[m_Heap[i].Key] = -1;
+    m_Count = 0;
+}
+
+void KeyRepeatQueue::Schedule(DWORD key, DWORD deadline)
+{
+    if (key >= KEYREPEAT_MAX_KEYS) return;
+
+    int i = m_Slots[key];
+    if (i < 0)
+    {
+        i = m_Count++;
+        m_Heap[i].Key = key;
+        m_Heap[i].Deadline = deadline;
+        m_Slots[key] = (short)i;
+        SiftUp(i);
+        return;
+    }
+
+    BOOL later = (int)(deadline - m_Heap[i].Deadline) > 0;
+    m_Heap[i].Deadline = deadline;
+    if (later)
+        SiftDown(i);
+    else
+        SiftUp(i);
+}
+
+void KeyRepeatQueue::Cancel(DWORD key)
+{
+    if (key >= KEYREPEAT_MAX_KEYS) return;
+
+    int i = m_Slots[key];
+    if (i < 0) return;
+
+    m_Slots[key] = -1;
+    if (--m_Count == i) return;
+
+    // Move the last entry into the hole and restore the heap in whichever direction it needs
+    Entry last = m_Heap[m_Count];
+    BOOL earlier = Earlier(last, m_Heap[i]);
+    Place(i, last);
+    if (earlier)
+        SiftUp(i);
+    else
+        SiftDown(i);
+}
+
+void KeyRepeatQueue::Place(int i, const Entry &entry)
+{
+    m_Heap[i] = entry;
+    m_Slots[entry.Key] = (short)i;
+}
+
+void KeyRepeatQueue::SiftUp(int i)
+{
+    Entry entry = m_Heap[i];
+    while (i > 0)
+    {
+        int parent = (i - 1) / 2;
+        if (!Earlier(entry, m_Heap[parent]))
+            break;
+        Place(i, m_Heap[parent]);
+        i = parent;
+    }
+    Place(i, entry);
+}
+
+void KeyRepeatQueue::SiftDown(int i)
+{
+    Entry entry = m_Heap[i];
+    for (;;)
+    {
+        int child = 2 * i + 1;
+        if (child >= m_Count)
+            break;
+        if (child + 1 < m_Count && Earlier(m_Heap[child + 1], m_Heap[child]))
+            ++child;
+        if (!Earlier(m_Heap[child], entry))
+            break;
+        Place(i, m_Heap[child]);
+        i = child;
+    }
+    Place(i, entry);
+}
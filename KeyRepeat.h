@@ -0,0 +1,42 @@
+#ifndef KEYREPEAT_H
+#define KEYREPEAT_H
+
+#include "InputBackend.h"
+
+#define KEYREPEAT_MAX_KEYS 256
+
+// Min-heap of repeat deadlines over the keys currently held.
+// Deadlines are millisecond tick counts and compare correctly across wraparound.
+class KeyRepeatQueue
+{
+public:
+    KeyRepeatQueue();
+    void Clear();
+    // Inserts the key, or moves it if it is already scheduled
+    void Schedule(DWORD key, DWORD deadline);
+    void Cancel(DWORD key);
+
+    BOOL IsEmpty() const { return m_Count == 0; }
+    int GetCount() const { return m_Count; }
+    // Earliest deadline; the queue must not be empty
+    DWORD GetTopKey() const { return m_Heap[0].Key; }
+    DWORD GetTopDeadline() const { return m_Heap[0].Deadline; }
+
+private:
+    struct Entry
+    {
+        DWORD Deadline;
+        DWORD Key;
+    };
+
+    static BOOL Earlier(const Entry &a, const Entry &b) { return (int)(a.Deadline - b.Deadline) < 0; }
+    void Place(int i, const Entry &entry);
+    void SiftUp(int i);
+    void SiftDown(int i);
+
+    Entry m_Heap[KEYREPEAT_MAX_KEYS];
+    short m_Slots[KEYREPEAT_MAX_KEYS]; // Heap index of each key, -1 when not scheduled
+    int m_Count;
+};
+
+#endif // KEYREPEAT_H
@@ -0,0 +1,433 @@
+#include "InputDevices.h"
+
+InputKeyboard::InputKeyboard() : m_Backend(NULL), m_Device(NULL), m_IngestLatency(NULL), m_Stats(NULL)
+{
+    memset(m_State, 0, sizeof(m_State));
+    memset(m_Stamps, 0, sizeof(m_Stamps));
+    memset(m_ReadBuffer, 0, sizeof(m_ReadBuffer));
+    memset(m_PressTimes, 0, sizeof(m_PressTimes));
+    memset(m_ReleaseTimes, 0, sizeof(m_ReleaseTimes));
+    m_LastEventTime = 0;
+    m_ActiveCount = 0;
+    m_TouchedCount = 0;
+    m_StateDirty = FALSE;
+    KeyMaskClear(m_ActiveMask);
+    KeyMaskClear(m_TouchedMask);
+    ClearState();
+    m_Overflowed = FALSE;
+    m_OverflowCount = 0;
+    m_EnableRepetition = FALSE;
+    m_RepeatDelay = 500;
+    m_RepeatInterval = 33;
+}
+
+void InputKeyboard::Init(InputBackend *backend, InputDevice *device, HWND hWnd)
+{
+    m_Backend = backend;
+    m_Device = device;
+    if (!m_Device) return;
+
+    // Set the cooperative level to let DirectInput know how
+    // this device should interact with the system and with
+    // other DirectInput applications.
+    m_Device->SetCooperativeLevel(hWnd, DISCL_NONEXCLUSIVE | DISCL_BACKGROUND);
+
+    // Acquire the newly created device.
+    m_Device->Acquire();
+}
+
+void InputKeyboard::Release()
+{
+    if (m_Device)
+    {
+        // Unacquire the device.
+        m_Device->Unacquire();
+        m_Device->Release();
+        m_Device = NULL;
+    }
+}
+
+void InputKeyboard::Clear()
+{
+    ClearState();
+    ClearTimes();
+}
+
+void InputKeyboard::Reset()
+{
+    ClearTimes();
+    ClearState();
+    m_Events.Clear();
+    m_RepeatEvents.Clear();
+}
+
+void InputKeyboard::Flush()
+{
+    if (m_Device)
+        Read();
+    m_Events.Clear();
+    m_RepeatEvents.Clear();
+    m_Overflowed = FALSE;
+    ClearState();
+}
+
+void InputKeyboard::EnableRepetition(BOOL enable)
+{
+    if (enable == m_EnableRepetition)
+        return;
+    m_EnableRepetition = enable;
+    m_Repeats.Clear();
+    if (!enable)
+        return;
+
+    // Keys already held start repeating from their press stamp
+    for (int w = 0; w < KEYMASK_WORDS; w++)
+    {
+        for (DWORD word = m_DownMask[w] & ~m_ReleasedMask[w]; word != 0; word &= word - 1)
+        {
+            DWORD key = w * 32 + KeyMaskLowestBit(word);
+            m_Repeats.Schedule(key, m_Stamps[key] + m_RepeatDelay);
+        }
+    }
+}
+
+void InputKeyboard::Activate(DWORD key)
+{
+    if (!KeyMaskTest(m_ActiveMask, key))
+    {
+        KeyMaskSet(m_ActiveMask, key);
+        m_ActiveKeys[m_ActiveCount++] = (BYTE)key;
+    }
+    if (!KeyMaskTest(m_TouchedMask, key))
+    {
+        KeyMaskSet(m_TouchedMask, key);
+        m_TouchedKeys[m_TouchedCount++] = (BYTE)key;
+    }
+}
+
+void InputKeyboard::ClearState()
+{
+    if (m_StateDirty)
+    {
+        memset(m_State, INPUT_KS_IDLE, sizeof(m_State));
+        m_StateDirty = FALSE;
+    }
+    for (int i = 0; i < m_ActiveCount; i++)
+        m_State[m_ActiveKeys[i]] = INPUT_KS_IDLE;
+    m_ActiveCount = 0;
+    KeyMaskClear(m_ActiveMask);
+    KeyMaskClear(m_DownMask);
+    KeyMaskClear(m_PressedMask);
+    KeyMaskClear(m_ReleasedMask);
+    m_Repeats.Clear();
+}
+
+void InputKeyboard::ClearTimes()
+{
+    for (int i = 0; i < m_TouchedCount; i++)
+    {
+        DWORD key = m_TouchedKeys[i];
+        m_Stamps[key] = 0;
+        m_PressTimes[key] = 0;
+        m_ReleaseTimes[key] = 0;
+    }
+    m_TouchedCount = 0;
+    KeyMaskClear(m_TouchedMask);
+}
+
+DWORD InputKeyboard::GetDroppedCount() const
+{
+    return m_Events.GetDroppedCount() + m_RepeatEvents.GetDroppedCount();
+}
+
+const InputEvent *InputKeyboard::GetEvent(int i) const
+{
+    if (i < 0)
+        return NULL;
+    if ((DWORD)i < m_Events.GetCount())
+        return &m_Events.Get(i);
+    i -= (int)m_Events.GetCount();
+    if ((DWORD)i < m_RepeatEvents.GetCount())
+        return &m_RepeatEvents.Get(i);
+    return NULL;
+}
+
+InputTime InputKeyboard::Now() const
+{
+    return m_Backend ? m_Backend->GetTime() : 0;
+}
+
+// Drains the device buffer into the event ring, reading until the device has nothing left
+HRESULT InputKeyboard::Read()
+{
+    m_Events.Clear();
+    m_Overflowed = FALSE;
+
+    // Device stamps are milliseconds; place them on the microsecond clock, never going backwards
+    InputTime now = m_Backend->GetTime();
+    DWORD tick = m_Backend->GetTickCount();
+
+    HRESULT hr = DI_OK;
+    for (int i = 0; i < KEYBOARD_MAX_READS; i++)
+    {
+        DWORD count = KEYBOARD_BUFFER_SIZE;
+        hr = m_Device->GetDeviceData(m_ReadBuffer, &count, 0);
+        if (hr == DIERR_INPUTLOST || hr == DIERR_NOTACQUIRED)
+        {
+            InputReacquire(m_Device, m_Stats);
+            count = KEYBOARD_BUFFER_SIZE;
+            hr = m_Device->GetDeviceData(m_ReadBuffer, &count, 0);
+        }
+        if (FAILED(hr))
+            break;
+
+        // The device buffer overflowed before this read: events were lost
+        if (hr == DI_BUFFEROVERFLOW)
+        {
+            m_Overflowed = TRUE;
+            ++m_OverflowCount;
+        }
+
+        for (DWORD e = 0; e < count; e++)
+        {
+            InputTime time = InputTimeFromTick(now, tick, m_ReadBuffer[e].dwTimeStamp);
+            if (time < m_LastEventTime)
+                time = m_LastEventTime;
+            m_LastEventTime = time;
+            m_Events.Push(m_ReadBuffer[e], time);
+        }
+        if (count < KEYBOARD_BUFFER_SIZE)
+            break;
+    }
+
+    if (m_IngestLatency)
+    {
+        for (DWORD i = 0; i < m_Events.GetCount(); i++)
+            m_IngestLatency->Add(m_Events.Get(i).Time, now);
+    }
+    return hr;
+}
+
+void InputKeyboard::Press(DWORD key, DWORD stamp, InputTime time)
+{
+    // A press is an edge unless the key is still held from an earlier frame
+    if (!KeyMaskTest(m_DownMask, key) || KeyMaskTest(m_ReleasedMask, key))
+        KeyMaskSet(m_PressedMask, key);
+    KeyMaskSet(m_DownMask, key);
+    Activate(key);
+    m_State[key] |= INPUT_KS_PRESSED;
+    m_Stamps[key] = stamp;
+    m_PressTimes[key] = time;
+    if (m_EnableRepetition)
+        m_Repeats.Schedule(key, stamp + m_RepeatDelay);
+}
+
+void InputKeyboard::Release(DWORD key, int stamp, InputTime time)
+{
+    KeyMaskSet(m_ReleasedMask, key);
+    Activate(key);
+    m_Repeats.Cancel(key);
+    m_State[key] |= INPUT_KS_RELEASED;
+    m_Stamps[key] = stamp;
+    m_ReleaseTimes[key] = time;
+}
+
+// After lost events, brings the key state back in line with the device's immediate state
+void InputKeyboard::Resync()
+{
+    BYTE state[KEYBOARD_BUFFER_SIZE];
+    if (FAILED(m_Device->GetDeviceState(sizeof(state), state)))
+        return;
+
+    DIDEVICEOBJECTDATA event;
+    memset(&event, 0, sizeof(event));
+    event.dwTimeStamp = m_Backend->GetTickCount();
+    InputTime time = m_Backend->GetTime();
+    if (time < m_LastEventTime)
+        time = m_LastEventTime;
+
+    for (DWORD key = 0; key < KEYBOARD_BUFFER_SIZE; key++)
+    {
+        BOOL held = KeyMaskTest(m_DownMask, key) && !KeyMaskTest(m_ReleasedMask, key);
+        BOOL down = (state[key] & 0x80) != 0;
+        if (held == down)
+            continue;
+
+        m_LastEventTime = time;
+        event.dwOfs = key;
+        event.dwData = down ? 0x80 : 0;
+        m_Events.Push(event, time);
+        if (down)
+            Press(key, event.dwTimeStamp, time);
+        else
+            Release(key, event.dwTimeStamp - m_Stamps[key], time);
+    }
+}
+
+void InputKeyboard::Poll(BOOL pause)
+{
+    if (!m_Device) return;
+
+    InputStageTimer timer(m_Stats, INPUT_STAGE_KEYBOARD_POLL);
+    timer.SetResult(Read());
+    timer.SetEvents(m_Events.GetCount());
+    m_RepeatEvents.Clear();
+    if (pause) return;
+
+    // Events read before a failed chunk are still applied
+    DWORD count = m_Events.GetCount();
+    for (DWORD i = 0; i < count; i++)
+    {
+        const InputEvent &event = m_Events.Get(i);
+        DWORD iKey = event.Data.dwOfs;
+        if (iKey < KEYBOARD_BUFFER_SIZE)
+        {
+            if ((event.Data.dwData & 0x80) != 0)
+                Press(iKey, event.Data.dwTimeStamp, event.Time);
+            else
+                Release(iKey, event.Data.dwTimeStamp - m_Stamps[iKey], event.Time);
+        }
+    }
+
+    if (m_Overflowed)
+        Resync();
+
+    // Keyboard repetition: only the held keys are scheduled, so an idle keyboard or a
+    // disabled repetition costs nothing
+    if (!m_Repeats.IsEmpty())
+        Repeat(m_Backend->GetTickCount(), m_Backend->GetTime());
+}
+
+void InputKeyboard::Repeat(DWORD now, InputTime time)
+{
+    const DWORD interval = (m_RepeatInterval > 0) ? m_RepeatInterval : 1;
+
+    while (!m_Repeats.IsEmpty())
+    {
+        DWORD key = m_Repeats.GetTopKey();
+        DWORD deadline = m_Repeats.GetTopDeadline();
+        if ((int)(now - deadline) < 0)
+            break;
+
+        // Drop keys whose state was changed behind the keyboard's back
+        if (m_State[key] != INPUT_KS_PRESSED)
+        {
+            m_Repeats.Cancel(key);
+            continue;
+        }
+
+        // Repeats missed during a stall are coalesced into one event;
+        // its timestamp is the last repeat and uAppData holds the count
+        DWORD count = (now - deadline) / interval + 1;
+        DWORD last = deadline + (count - 1) * interval;
+        DIDEVICEOBJECTDATA event;
+        event.dwOfs = key;
+        event.dwData = 0x80;
+        event.dwTimeStamp = last;
+        event.dwSequence = 0;
+        event.uAppData = count;
+        m_RepeatEvents.Push(event, InputTimeFromTick(time, now, last));
+        m_Repeats.Schedule(key, last + interval);
+    }
+}
+
+BYTE *InputKeyboard::GetWritableState()
+{
+    m_StateDirty = TRUE;
+    return m_State;
+}
+
+void InputKeyboard::PostProcess()
+{
+    // Bytes written through GetWritableState are only seen by a full sweep
+    if (m_StateDirty)
+    {
+        m_StateDirty = FALSE;
+        SyncState();
+    }
+
+    // Released keys go idle and leave the active list; an idle keyboard does nothing
+    for (int i = 0; i < m_ActiveCount;)
+    {
+        DWORD key = m_ActiveKeys[i];
+        KeyMaskReset(m_PressedMask, key);
+        BYTE state = m_State[key];
+        if ((state & INPUT_KS_RELEASED) == 0 && state != INPUT_KS_IDLE)
+        {
+            ++i;
+            continue;
+        }
+
+        m_State[key] = INPUT_KS_IDLE;
+        KeyMaskReset(m_DownMask, key);
+        KeyMaskReset(m_ReleasedMask, key);
+        KeyMaskReset(m_ActiveMask, key);
+        m_ActiveKeys[i] = m_ActiveKeys[--m_ActiveCount];
+    }
+}
+
+void InputKeyboard::SetKey(DWORD key, BOOL pressed, int stamp, InputTime time)
+{
+    if (key >= KEYBOARD_BUFFER_SIZE) return;
+
+    if (pressed)
+        Press(key, stamp, time);
+    else
+        Release(key, stamp, time);
+}
+
+void InputKeyboard::SetState(const BYTE *states, const int *stamps)
+{
+    if (!states) return;
+
+    memcpy(m_State, states, sizeof(m_State));
+    if (stamps)
+        memcpy(m_Stamps, stamps, sizeof(m_Stamps));
+    m_StateDirty = FALSE;
+    SyncState();
+
+    // Every key given a stamp counts as touched
+    if (stamps)
+    {
+        for (DWORD key = 0; key < KEYBOARD_BUFFER_SIZE; key++)
+        {
+            if (m_Stamps[key] != 0 && !KeyMaskTest(m_TouchedMask, key))
+            {
+                KeyMaskSet(m_TouchedMask, key);
+                m_TouchedKeys[m_TouchedCount++] = (BYTE)key;
+            }
+        }
+    }
+}
+
+void InputKeyboard::SyncState()
+{
+    DWORD previous[KEYMASK_WORDS];
+    memcpy(previous, m_DownMask, sizeof(previous));
+    InputTime now = Now();
+
+    KeyMaskFromStates(m_DownMask, m_State, INPUT_KS_PRESSED);
+    KeyMaskFromStates(m_ReleasedMask, m_State, INPUT_KS_RELEASED);
+
+    // The active list is rebuilt from the masks
+    m_ActiveCount = 0;
+    KeyMaskClear(m_ActiveMask);
+    for (int w = 0; w < KEYMASK_WORDS; w++)
+    {
+        for (DWORD word = m_DownMask[w] | m_ReleasedMask[w]; word != 0; word &= word - 1)
+            Activate(w * 32 + KeyMaskLowestBit(word));
+    }
+
+    for (int w = 0; w < KEYMASK_WORDS; w++)
+    {
+        DWORD pressed = m_DownMask[w] & ~previous[w];
+        m_PressedMask[w] |= pressed;
+        for (; pressed != 0; pressed &= pressed - 1)
+        {
+            DWORD key = w * 32 + KeyMaskLowestBit(pressed);
+            m_PressTimes[key] = now;
+            if (m_EnableRepetition)
+                m_Repeats.Schedule(key, m_Stamps[key] + m_RepeatDelay);
+        }
+    }
+}
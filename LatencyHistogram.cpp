@@ -0,0 +1,90 @@
+#include "LatencyHistogram.h"
+
+#include <string.h>
+
+#if defined(_MSC_VER) && _MSC_VER >= 1400
+#include <intrin.h>
+#endif
+
+static int HighestBit(DWORD value)
+{
+#if defined(_MSC_VER) && _MSC_VER >= 1400
+    unsigned long index;
+    _BitScanReverse(&index, value);
+    return (int)index;
+#elif defined(__GNUC__)
+    return 31 - __builtin_clz(value);
+#else
+    int index = 0;
+    while (value >>= 1)
+        ++index;
+    return index;
+#endif
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    Clear();
+}
+
+void LatencyHistogram::Clear()
+{
+    memset(m_Counts, 0, sizeof(m_Counts));
+    m_Count = 0;
+    m_Max = 0;
+    m_Sum = 0;
+}
+
+int LatencyHistogram::GetBucket(DWORD value)
+{
+    if (value < LATENCY_SUB_BUCKETS)
+        return (int)value;
+    int exponent = HighestBit(value);
+    int sub = (int)(value >> (exponent - LATENCY_SUB_BITS)) & (LATENCY_SUB_BUCKETS - 1);
+    return (exponent - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS + sub;
+}
+
+DWORD LatencyHistogram::GetBucketLowerBound(int bucket)
+{
+    if (bucket < LATENCY_SUB_BUCKETS)
+        return (DWORD)bucket;
+    int exponent = bucket / LATENCY_SUB_BUCKETS + LATENCY_SUB_BITS - 1;
+    DWORD sub = (DWORD)(bucket % LATENCY_SUB_BUCKETS);
+    return (LATENCY_SUB_BUCKETS + sub) << (exponent - LATENCY_SUB_BITS);
+}
+
+DWORD LatencyHistogram::GetBucketUpperBound(int bucket)
+{
+    if (bucket >= LATENCY_BUCKET_COUNT - 1)
+        return 0xFFFFFFFF;
+    return GetBucketLowerBound(bucket + 1) - 1;
+}
+
+DWORD LatencyHistogram::GetPercentile(float fraction) const
+{
+    if (m_Count == 0)
+        return 0;
+    if (fraction < 0.0f)
+        fraction = 0.0f;
+    if (fraction > 1.0f)
+        fraction = 1.0f;
+
+    // Rank of the sample, counted from 1
+    DWORD rank = (DWORD)((double)fraction * m_Count + 0.5);
+    if (rank < 1)
+        rank = 1;
+    if (rank > m_Count)
+        rank = m_Count;
+
+    DWORD seen = 0;
+    for (int i = 0; i < LATENCY_BUCKET_COUNT; i++)
+    {
+        seen += m_Counts[i];
+        if (seen >= rank)
+        {
+            DWORD bound = GetBucketUpperBound(i);
+            return (bound < m_Max) ? bound : m_Max;
+        }
+    }
+    return m_Max;
+}
@@ -0,0 +1,54 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include "InputBackend.h"
+
+// Log-linear buckets: values below 8 get their own bucket, larger values share
+// 8 linear sub-buckets per power of two (at most 12.5% relative error).
+#define LATENCY_SUB_BITS 3
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+#define LATENCY_BUCKET_COUNT ((32 - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+// Histogram of microsecond latencies. It has a single writer and takes no
+// locks: the counts and the maximum are aligned 32-bit words, so other threads
+// may read them at any time and see a slightly stale but never torn value.
+// The 64-bit sum behind GetMean is not read whole on 32-bit targets, so the
+// mean is only exact on the writer thread.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+    void Clear();
+
+    // Values beyond 2^32 microseconds land in the last bucket
+    void Add(InputTime latency)
+    {
+        DWORD value = (latency < 0xFFFFFFFF) ? (DWORD)latency : 0xFFFFFFFF;
+        ++m_Counts[GetBucket(value)];
+        ++m_Count;
+        m_Sum += value;
+        if (value > m_Max)
+            m_Max = value;
+    }
+    // Latency from one clock reading to a later one; 0 if they are out of order
+    void Add(InputTime from, InputTime to) { Add((to > from) ? to - from : 0); }
+
+    DWORD GetCount() const { return m_Count; }
+    DWORD GetMax() const { return m_Max; }
+    DWORD GetMean() const { return m_Count ? (DWORD)(m_Sum / m_Count) : 0; } // Exact on the writer thread only
+    // Smallest bucket bound at or above the given fraction of the samples (0.5 is the median)
+    DWORD GetPercentile(float fraction) const;
+
+    DWORD GetBucketCount(int bucket) const { return (bucket >= 0 && bucket < LATENCY_BUCKET_COUNT) ? m_Counts[bucket] : 0; }
+    static int GetBucket(DWORD value);
+    static DWORD GetBucketLowerBound(int bucket);
+    static DWORD GetBucketUpperBound(int bucket); // Inclusive
+
+private:
+    DWORD m_Counts[LATENCY_BUCKET_COUNT];
+    DWORD m_Count;
+    DWORD m_Max;
+    InputTime m_Sum;
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -0,0 +1,163 @@
+#include "MotionFilter.h"
+
+#include <math.h>
+#include <string.h>
+
+#define MOTION_PI 3.14159265f
+
+InputMotionFilter::InputMotionFilter()
+{
+    Clear();
+}
+
+void InputMotionFilter::Clear()
+{
+    memset(m_Stages, 0, sizeof(m_Stages));
+    m_StageCount = 0;
+    Reset();
+}
+
+void InputMotionFilter::Reset()
+{
+    for (int i = 0; i < m_StageCount; i++)
+    {
+        m_Stages[i].Value[0] = m_Stages[i].Value[1] = 0.0f;
+        m_Stages[i].Derivative[0] = m_Stages[i].Derivative[1] = 0.0f;
+    }
+    m_LastTime = 0;
+    m_Primed = FALSE;
+}
+
+InputMotionFilter::Stage *InputMotionFilter::AddStage(INPUT_MOTION_FILTER type)
+{
+    if (m_StageCount >= MOTION_FILTER_MAX_STAGES)
+        return NULL;
+    Stage *stage = &m_Stages[m_StageCount++];
+    memset(stage, 0, sizeof(Stage));
+    stage->Type = type;
+    return stage;
+}
+
+int InputMotionFilter::AddExponential(float timeConstant)
+{
+    if (!(timeConstant > 0.0f))
+        return -1;
+    Stage *stage = AddStage(INPUT_FILTER_EXPONENTIAL);
+    if (!stage)
+        return -1;
+    stage->Params[0] = timeConstant * 0.001f;
+    return m_StageCount - 1;
+}
+
+int InputMotionFilter::AddOneEuro(float minCutoff, float beta, float derivativeCutoff)
+{
+    if (!(minCutoff > 0.0f) || beta < 0.0f || !(derivativeCutoff > 0.0f))
+        return -1;
+    Stage *stage = AddStage(INPUT_FILTER_ONE_EURO);
+    if (!stage)
+        return -1;
+    stage->Params[0] = minCutoff;
+    stage->Params[1] = beta;
+    stage->Params[2] = derivativeCutoff;
+    return m_StageCount - 1;
+}
+
+int InputMotionFilter::AddCurve(const float *speeds, const float *gains, int count)
+{
+    if (!speeds || !gains || count < 1 || count > MOTION_CURVE_MAX_POINTS)
+        return -1;
+    for (int i = 1; i < count; i++)
+    {
+        if (!(speeds[i] > speeds[i - 1]))
+            return -1;
+    }
+    Stage *stage = AddStage(INPUT_FILTER_CURVE);
+    if (!stage)
+        return -1;
+    stage->PointCount = count;
+    memcpy(stage->Speeds, speeds, count * sizeof(float));
+    memcpy(stage->Gains, gains, count * sizeof(float));
+    return m_StageCount - 1;
+}
+
+float InputMotionFilter::Interpolate(const Stage &stage, float speed)
+{
+    if (speed <= stage.Speeds[0])
+        return stage.Gains[0];
+    for (int i = 1; i < stage.PointCount; i++)
+    {
+        if (speed < stage.Speeds[i])
+        {
+            float t = (speed - stage.Speeds[i - 1]) / (stage.Speeds[i] - stage.Speeds[i - 1]);
+            return stage.Gains[i - 1] + t * (stage.Gains[i] - stage.Gains[i - 1]);
+        }
+    }
+    return stage.Gains[stage.PointCount - 1];
+}
+
+// Smoothing factor of a first order low-pass at cutoff Hz over dt seconds
+static float LowPassAlpha(float cutoff, float dt)
+{
+    float tau = 1.0f / (2.0f * MOTION_PI * cutoff);
+    return 1.0f / (1.0f + tau / dt);
+}
+
+void InputMotionFilter::Apply(const float motion[2], InputTime time, float out[2])
+{
+    InputTime period = (m_Primed && time > m_LastTime) ? time - m_LastTime : MOTION_FILTER_DEFAULT_PERIOD;
+    float dt = (float)period * 0.000001f;
+    float speed[2] = {motion[0] / dt, motion[1] / dt};
+
+    for (int i = 0; i < m_StageCount; i++)
+    {
+        Stage &stage = m_Stages[i];
+        switch (stage.Type)
+        {
+        case INPUT_FILTER_EXPONENTIAL:
+        {
+            float alpha = m_Primed ? 1.0f - expf(-dt / stage.Params[0]) : 1.0f;
+            for (int axis = 0; axis < 2; axis++)
+            {
+                stage.Value[axis] += alpha * (speed[axis] - stage.Value[axis]);
+                speed[axis] = stage.Value[axis];
+            }
+            break;
+        }
+        case INPUT_FILTER_ONE_EURO:
+        {
+            // Positions are taken relative to the previous filtered one, so only the lag
+            // is kept and the filter never loses precision as the position grows
+            for (int axis = 0; axis < 2; axis++)
+            {
+                if (!m_Primed)
+                {
+                    stage.Value[axis] = 0.0f;
+                    stage.Derivative[axis] = speed[axis];
+                    continue;
+                }
+                float position = stage.Value[axis] + speed[axis] * dt;
+                stage.Derivative[axis] += LowPassAlpha(stage.Params[2], dt) * (position / dt - stage.Derivative[axis]);
+                float cutoff = stage.Params[0] + stage.Params[1] * fabsf(stage.Derivative[axis]);
+                float filtered = LowPassAlpha(cutoff, dt) * position;
+                stage.Value[axis] = position - filtered;
+                speed[axis] = filtered / dt;
+            }
+            break;
+        }
+        case INPUT_FILTER_CURVE:
+        {
+            float gain = Interpolate(stage, sqrtf(speed[0] * speed[0] + speed[1] * speed[1]));
+            speed[0] *= gain;
+            speed[1] *= gain;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    m_LastTime = time;
+    m_Primed = TRUE;
+    out[0] = speed[0] * dt;
+    out[1] = speed[1] * dt;
+}
@@ -0,0 +1,67 @@
+#ifndef MOTIONFILTER_H
+#define MOTIONFILTER_H
+
+#include "InputBackend.h"
+
+#define MOTION_FILTER_MAX_STAGES 8
+#define MOTION_CURVE_MAX_POINTS 16
+#define MOTION_FILTER_DEFAULT_PERIOD 16667 // Microseconds assumed for the first frame or a clock that did not move
+
+enum INPUT_MOTION_FILTER
+{
+    INPUT_FILTER_EXPONENTIAL = 0, // Exponential moving average
+    INPUT_FILTER_ONE_EURO = 1,    // Low-pass on the position whose cutoff rises with the speed (Casiez et al. 2012)
+    INPUT_FILTER_CURVE = 2,       // Gain looked up from the speed, linear between the points
+    INPUT_FILTER_COUNT = 3
+};
+
+// Filter chain run once per frame over the X and Y motion. Stages are applied in
+// the order they were added; each works on the speed (device units per second)
+// so the result does not depend on the frame rate. All state is inline: adding
+// stages and filtering never allocate.
+class InputMotionFilter
+{
+public:
+    InputMotionFilter();
+
+    // Removes every stage
+    void Clear();
+    // Forgets the motion seen so far, keeping the stages
+    void Reset();
+
+    // Each returns the stage index, -1 when the chain is full or the parameters are invalid.
+    // timeConstant in milliseconds: the average reaches 63% of a step after that time
+    int AddExponential(float timeConstant);
+    // minCutoff in Hz at rest, beta in Hz per unit of speed, derivativeCutoff in Hz
+    int AddOneEuro(float minCutoff, float beta, float derivativeCutoff = 1.0f);
+    // speeds in device units per second, increasing; gains multiply the motion at those speeds
+    int AddCurve(const float *speeds, const float *gains, int count);
+
+    int GetStageCount() const { return m_StageCount; }
+    INPUT_MOTION_FILTER GetStageType(int i) const { return (i >= 0 && i < m_StageCount) ? m_Stages[i].Type : INPUT_FILTER_COUNT; }
+
+    // Filters the motion of a frame sampled at time; out may be motion
+    void Apply(const float motion[2], InputTime time, float out[2]);
+
+private:
+    struct Stage
+    {
+        INPUT_MOTION_FILTER Type;
+        float Params[3];
+        float Value[2];      // Exponential: filtered speed; One Euro: lag of the filtered position
+        float Derivative[2]; // One Euro: filtered speed driving the cutoff
+        int PointCount;
+        float Speeds[MOTION_CURVE_MAX_POINTS];
+        float Gains[MOTION_CURVE_MAX_POINTS];
+    };
+
+    Stage *AddStage(INPUT_MOTION_FILTER type);
+    static float Interpolate(const Stage &stage, float speed);
+
+    Stage m_Stages[MOTION_FILTER_MAX_STAGES];
+    int m_StageCount;
+    InputTime m_LastTime;
+    BOOL m_Primed; // The stages hold a previous frame
+};
+
+#endif // MOTIONFILTER_H
@@ -0,0 +1,167 @@
+#include "MotionHistory.h"
+
+#include <string.h>
+
+InputMotionHistory::InputMotionHistory()
+    : m_Samples(NULL), m_Capacity(0), m_Start(0), m_Count(0), m_PollingRate(0),
+      m_Mode(INPUT_MOTION_SUM), m_Target(0), m_Stride(1), m_Sequence(0), m_Reports(0)
+{
+}
+
+InputMotionHistory::~InputMotionHistory()
+{
+    delete[] m_Samples;
+}
+
+BOOL InputMotionHistory::Configure(DWORD pollingRate, DWORD minFrameRate)
+{
+    if (pollingRate == 0 || minFrameRate == 0)
+        return FALSE;
+
+    // One more sample than whole reports per frame, for a frame straddling a report
+    DWORD capacity = (pollingRate + minFrameRate - 1) / minFrameRate + 1;
+    if (capacity > MOTION_MAX_SAMPLES)
+        capacity = MOTION_MAX_SAMPLES;
+
+    if ((int)capacity != m_Capacity)
+    {
+        delete[] m_Samples;
+        m_Samples = new InputMotionSample[capacity];
+        m_Capacity = (int)capacity;
+    }
+    m_PollingRate = pollingRate;
+    Clear();
+    return TRUE;
+}
+
+void InputMotionHistory::SetCoalescing(INPUT_MOTION_COALESCING mode, int samples)
+{
+    if (mode < 0 || mode >= INPUT_MOTION_COALESCING_COUNT)
+        return;
+    m_Mode = mode;
+    m_Target = (samples > 0) ? samples : 0;
+    Clear();
+}
+
+void InputMotionHistory::Clear()
+{
+    m_Start = 0;
+    m_Count = 0;
+    m_Stride = 1;
+    m_Reports = 0;
+}
+
+void InputMotionHistory::Add(DWORD sequence, InputTime time, int axis, LONG value)
+{
+    if (m_Capacity == 0 || axis < 0 || axis >= 3)
+        return;
+
+    if (m_Count > 0 && sequence == m_Sequence)
+    {
+        InputMotionSample &last = m_Samples[(m_Start + m_Count - 1) % m_Capacity];
+        last.Delta[axis] += value;
+        return;
+    }
+
+    InputMotionSample sample;
+    memset(&sample, 0, sizeof(sample));
+    sample.Time = time;
+    sample.Delta[axis] = value;
+    sample.Reports = 1;
+    m_Sequence = sequence;
+    ++m_Reports;
+    Push(sample);
+}
+
+void InputMotionHistory::Push(const InputMotionSample &sample)
+{
+    if (m_Mode == INPUT_MOTION_DECIMATE)
+    {
+        // The last sample takes reports until it holds a full stride
+        if (m_Count > 0 && m_Samples[m_Count - 1].Reports < m_Stride)
+        {
+            Merge(m_Samples[m_Count - 1], sample);
+            return;
+        }
+        if (m_Count == m_Capacity)
+        {
+            Halve();
+            if (m_Samples[m_Count - 1].Reports < m_Stride)
+            {
+                Merge(m_Samples[m_Count - 1], sample);
+                return;
+            }
+        }
+        m_Samples[m_Count++] = sample;
+        return;
+    }
+
+    if (m_Count < m_Capacity)
+    {
+        m_Samples[(m_Start + m_Count) % m_Capacity] = sample;
+        ++m_Count;
+        return;
+    }
+
+    if (m_Mode == INPUT_MOTION_SUM)
+    {
+        Merge(m_Samples[(m_Start + m_Count - 1) % m_Capacity], sample);
+    }
+    else
+    {
+        m_Samples[m_Start] = sample;
+        m_Start = (m_Start + 1) % m_Capacity;
+    }
+}
+
+void InputMotionHistory::Merge(InputMotionSample &into, const InputMotionSample &sample)
+{
+    into.Time = sample.Time;
+    into.Delta[0] += sample.Delta[0];
+    into.Delta[1] += sample.Delta[1];
+    into.Delta[2] += sample.Delta[2];
+    into.Reports += sample.Reports;
+}
+
+// Decimation keeps the ring unwrapped, so samples are merged in place
+void InputMotionHistory::Halve()
+{
+    int count = 0;
+    for (int i = 0; i < m_Count; i += 2, count++)
+    {
+        m_Samples[count] = m_Samples[i];
+        if (i + 1 < m_Count)
+            Merge(m_Samples[count], m_Samples[i + 1]);
+    }
+    m_Count = count;
+    m_Stride *= 2;
+}
+
+void InputMotionHistory::Finish()
+{
+    int target = GetDecimation();
+    if (m_Mode != INPUT_MOTION_DECIMATE || m_Count <= target)
+        return;
+
+    // Sample i of the result merges the samples from i * count / target on
+    int count = m_Count;
+    for (int i = 0; i < target; i++)
+    {
+        int first = i * count / target;
+        int end = (i + 1) * count / target;
+        m_Samples[i] = m_Samples[first];
+        for (int j = first + 1; j < end; j++)
+            Merge(m_Samples[i], m_Samples[j]);
+    }
+    m_Count = target;
+}
+
+int InputMotionHistory::GetSamples(InputMotionSample *samples, int max) const
+{
+    if (!samples || max <= 0)
+        return 0;
+    int count = (m_Count < max) ? m_Count : max;
+    for (int i = 0; i < count; i++)
+        samples[i] = GetSample(i);
+    return count;
+}
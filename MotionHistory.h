@@ -0,0 +1,81 @@
+#ifndef MOTIONHISTORY_H
+#define MOTIONHISTORY_H
+
+#include "InputBackend.h"
+
+#define MOTION_MAX_SAMPLES 4096
+#define MOTION_MIN_FRAME_RATE 30 // Default slowest frame rate the ring must cover without coalescing
+#define MOTION_EVENTS_PER_REPORT 3 // X, Y and wheel events of one device report
+
+enum INPUT_MOTION_COALESCING
+{
+    INPUT_MOTION_SUM = 0,      // A full ring merges the new reports into its last sample
+    INPUT_MOTION_LATEST = 1,   // A full ring drops its oldest sample; the path then starts late
+    INPUT_MOTION_DECIMATE = 2, // A full ring merges its samples in pairs; the frame ends with at most N evenly spread samples
+    INPUT_MOTION_COALESCING_COUNT = 3
+};
+
+struct InputMotionSample
+{
+    InputTime Time; // When the latest report merged into the sample was made
+    LONG Delta[3];  // X, Y and wheel motion, in device units
+    DWORD Reports;  // Device reports merged into the sample
+};
+
+// Mouse motion of one frame as individual timestamped samples, one per device
+// report while they fit. The ring is allocated once for the polling rate, so a
+// frame never allocates; reports beyond its capacity are coalesced.
+class InputMotionHistory
+{
+public:
+    InputMotionHistory();
+    ~InputMotionHistory();
+
+    // Sizes the ring for the reports of one frame at minFrameRate; FALSE if either rate is 0
+    BOOL Configure(DWORD pollingRate, DWORD minFrameRate = MOTION_MIN_FRAME_RATE);
+    DWORD GetPollingRate() const { return m_PollingRate; }
+    int GetCapacity() const { return m_Capacity; }
+    // Device buffer, in events, holding the reports of one frame
+    DWORD GetDeviceBufferSize() const { return (DWORD)m_Capacity * MOTION_EVENTS_PER_REPORT; }
+
+    // samples is the count INPUT_MOTION_DECIMATE reduces the frame to, the capacity when 0
+    void SetCoalescing(INPUT_MOTION_COALESCING mode, int samples = 0);
+    INPUT_MOTION_COALESCING GetCoalescing() const { return m_Mode; }
+    int GetDecimation() const { return (m_Target > 0 && m_Target < m_Capacity) ? m_Target : m_Capacity; }
+
+    // Starts a new frame
+    void Clear();
+    // One axis event; events sharing a sequence number belong to the same report
+    void Add(DWORD sequence, InputTime time, int axis, LONG value);
+    // Ends the frame, applying the decimation
+    void Finish();
+
+    // Samples of the frame, oldest first
+    int GetCount() const { return m_Count; }
+    const InputMotionSample &GetSample(int i) const { return m_Samples[(m_Start + i) % m_Capacity]; }
+    // Copies up to max samples, oldest first; returns the number copied
+    int GetSamples(InputMotionSample *samples, int max) const;
+    DWORD GetReportCount() const { return m_Reports; }     // Reports of the frame
+    DWORD GetCoalescedCount() const { return m_Reports - (DWORD)m_Count; } // Reports of the frame merged or dropped
+
+private:
+    InputMotionHistory(const InputMotionHistory &);
+    InputMotionHistory &operator=(const InputMotionHistory &);
+
+    void Push(const InputMotionSample &sample);
+    static void Merge(InputMotionSample &into, const InputMotionSample &sample);
+    void Halve();
+
+    InputMotionSample *m_Samples;
+    int m_Capacity;
+    int m_Start;
+    int m_Count;
+    DWORD m_PollingRate;
+    INPUT_MOTION_COALESCING m_Mode;
+    int m_Target; // Decimation asked for, 0 for the capacity
+    DWORD m_Stride; // Reports per sample while decimating, doubled at each halving
+    DWORD m_Sequence; // Of the report in the last sample
+    DWORD m_Reports;
+};
+
+#endif // MOTIONHISTORY_H
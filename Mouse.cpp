@@ -1,43 +1,33 @@
-#include "DX8InputManager.h"
+#include "InputDevices.h"
 
-DX8InputManager::CKMouse::CKMouse() : m_Device(NULL)
+InputMouse::InputMouse() : m_Backend(NULL), m_Device(NULL), m_IngestLatency(NULL), m_Stats(NULL), m_Motion(NULL)
 {
+    m_Position[0] = m_Position[1] = 0.0f;
     memset(&m_State, 0, sizeof(m_State));
     memset(m_LastButtons, 0, sizeof(m_LastButtons));
     memset(m_Buffer, 0, sizeof(m_Buffer));
+    memset(m_ButtonTimes, 0, sizeof(m_ButtonTimes));
     m_NumberOfBuffer = 0;
     m_WheelPosition = 0;
+    m_Time = 0;
+    m_PollTime = 0;
+    m_PollTick = 0;
+    m_BufferedOnly = FALSE;
+    m_CursorSource = INPUT_CURSOR_QUERY;
+    m_CursorResync = 0;
+    m_CursorPolls = 0;
 }
 
-void DX8InputManager::CKMouse::Init(HWND hWnd)
+void InputMouse::Init(InputBackend *backend, InputDevice *device, HWND hWnd)
 {
+    m_Backend = backend;
+    m_Device = device;
     if (!m_Device) return;
 
-    if (FAILED(m_Device->SetDataFormat(&c_dfDIMouse)))
-        ::OutputDebugString(TEXT("Input Manager =  Failed : SetDataFormat (Mouse)"));
-
-    if (FAILED(m_Device->SetCooperativeLevel(hWnd, DISCL_NONEXCLUSIVE | DISCL_FOREGROUND)))
-        ::OutputDebugString(TEXT("Input Manager =  Failed : SetCooperativeLevel (Mouse)"));
-
-    DIPROPDWORD dipdw;
-    dipdw.diph.dwSize = sizeof(DIPROPDWORD);
-    dipdw.diph.dwHeaderSize = sizeof(DIPROPHEADER);
-    dipdw.diph.dwObj = 0;
-    dipdw.diph.dwHow = DIPH_DEVICE;
-    dipdw.dwData = DIPROPAXISMODE_REL;
-    if (FAILED(m_Device->SetProperty(DIPROP_AXISMODE, &dipdw.diph)))
-        ::OutputDebugString(TEXT("Input Manager =  Failed : SetProperty (Mouse) Relative Coord"));
-
-    dipdw.diph.dwSize = sizeof(DIPROPDWORD);
-    dipdw.diph.dwHeaderSize = sizeof(DIPROPHEADER);
-    dipdw.diph.dwObj = 0;
-    dipdw.diph.dwHow = DIPH_DEVICE;
-    dipdw.dwData = 256;
-    if (FAILED(m_Device->SetProperty(DIPROP_BUFFERSIZE, &dipdw.diph)))
-        ::OutputDebugString(TEXT("Input Manager =  Failed : SetProperty (Mouse) Buffered Data"));
+    m_Device->SetCooperativeLevel(hWnd, DISCL_NONEXCLUSIVE | DISCL_FOREGROUND);
 }
 
-void DX8InputManager::CKMouse::Release()
+void InputMouse::Release()
 {
     if (m_Device)
     {
@@ -48,7 +38,7 @@ void DX8InputManager::CKMouse::Release()
     }
 }
 
-void DX8InputManager::CKMouse::Clear()
+void InputMouse::Clear()
 {
     for (int i = 0; i < 4; ++i)
     {
@@ -59,66 +49,225 @@ void DX8InputManager::CKMouse::Clear()
     m_State.lX = 0;
     m_State.lY = 0;
     m_State.lZ = 0;
-    m_Position.Set(0.0f, 0.0f);
+    m_Position[0] = m_Position[1] = 0.0f;
     m_WheelPosition = 0;
+    memset(m_ButtonTimes, 0, sizeof(m_ButtonTimes));
 
     m_NumberOfBuffer = 0;
     memset(m_Buffer, 0, sizeof(m_Buffer));
+    if (m_Motion)
+        m_Motion->Clear();
 }
 
-void DX8InputManager::CKMouse::Poll(CKBOOL pause)
+void InputMouse::SetBufferedOnly(BOOL enable)
 {
-    if (!m_Device) return;
+    // The relative axes of the immediate state summed the motion of the buffered-only
+    // polls; read it once so the next poll only reports its own frame
+    if (m_BufferedOnly && !enable && m_Device)
+    {
+        DIMOUSESTATE state;
+        m_Device->GetDeviceState(sizeof(DIMOUSESTATE), &state);
+    }
+    m_BufferedOnly = enable;
+}
 
-    HRESULT hr;
+void InputMouse::SetCursorSource(INPUT_CURSOR_SOURCE source, DWORD resyncPolls)
+{
+    if (source < 0 || source >= INPUT_CURSOR_SOURCE_COUNT)
+        return;
+    m_CursorSource = source;
+    m_CursorResync = resyncPolls;
+    m_CursorPolls = 0;
+}
 
-    *(CKDWORD *)m_LastButtons = *(CKDWORD *)m_State.rgbButtons;
-    m_NumberOfBuffer = MOUSE_BUFFER_SIZE;
-    hr = m_Device->GetDeviceData(sizeof(DIDEVICEOBJECTDATA), m_Buffer, (LPDWORD)&m_NumberOfBuffer, 0);
+void InputMouse::SetCursorPosition(float x, float y)
+{
+    m_Position[0] = x;
+    m_Position[1] = y;
+}
+
+HRESULT InputMouse::ReadData(DIDEVICEOBJECTDATA *buffer, DWORD *count)
+{
+    DWORD size = *count;
+    HRESULT hr = m_Device->GetDeviceData(buffer, count, 0);
     if (hr == DIERR_INPUTLOST || hr == DIERR_NOTACQUIRED)
     {
-        m_Device->Acquire();
-        m_NumberOfBuffer = MOUSE_BUFFER_SIZE;
-        hr = m_Device->GetDeviceData(sizeof(DIDEVICEOBJECTDATA), m_Buffer, (LPDWORD)&m_NumberOfBuffer, 0);
+        InputReacquire(m_Device, m_Stats);
+        *count = size;
+        hr = m_Device->GetDeviceData(buffer, count, 0);
     }
+    if (FAILED(hr))
+        *count = 0;
+    return hr;
+}
 
-    if (pause) m_NumberOfBuffer = 0;
+void InputMouse::ApplyEvents(const DIDEVICEOBJECTDATA *events, int count, InputTime now, DWORD tick, LONG *motion)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const DIDEVICEOBJECTDATA &event = events[i];
+        switch (event.dwOfs)
+        {
+        case DIMOFS_BUTTON0:
+        case DIMOFS_BUTTON1:
+        case DIMOFS_BUTTON2:
+        case DIMOFS_BUTTON3:
+            m_ButtonTimes[event.dwOfs - DIMOFS_BUTTON0] = InputTimeFromTick(now, tick, event.dwTimeStamp);
+            if ((event.dwData & 0x80) != 0)
+                m_State.rgbButtons[event.dwOfs - DIMOFS_BUTTON0] |= INPUT_KS_PRESSED;
+            else
+                m_State.rgbButtons[event.dwOfs - DIMOFS_BUTTON0] |= INPUT_KS_RELEASED;
+            break;
+        case DIMOFS_X:
+        case DIMOFS_Y:
+        case DIMOFS_Z:
+            // Axis events carry the signed relative motion
+            if (motion)
+                motion[(event.dwOfs - DIMOFS_X) / sizeof(LONG)] += (LONG)event.dwData;
+            if (m_Motion)
+                m_Motion->Add(event.dwSequence, InputTimeFromTick(now, tick, event.dwTimeStamp), (event.dwOfs - DIMOFS_X) / sizeof(LONG), (LONG)event.dwData);
+            break;
+        }
+    }
+
+    if (m_IngestLatency)
+    {
+        for (int i = 0; i < count; i++)
+            m_IngestLatency->Add(InputTimeFromTick(now, tick, events[i].dwTimeStamp), now);
+    }
+}
+
+void InputMouse::Poll(BOOL pause)
+{
+    if (!m_Device) return;
+
+    InputStageTimer timer(m_Stats, INPUT_STAGE_MOUSE_POLL);
+    *(DWORD *)m_LastButtons = *(DWORD *)m_State.rgbButtons;
+
+    if (m_Motion)
+        m_Motion->Clear();
 
-    if (SUCCEEDED(hr))
+    LONG motion[3] = {0, 0, 0};
+    if (m_BufferedOnly)
     {
-        for (int i = 0; i < m_NumberOfBuffer; i++)
+        timer.SetResult(PollBuffered(pause, motion));
+        timer.SetEvents(m_NumberOfBuffer);
+        if (m_Motion)
+            m_Motion->Finish();
+        if (pause)
+            return;
+        if (m_CursorSource == INPUT_CURSOR_QUERY)
+            QueryCursor();
+    }
+    else
+    {
+        DWORD count = MOUSE_BUFFER_SIZE;
+        HRESULT hr = ReadData(m_Buffer, &count);
+        m_NumberOfBuffer = pause ? 0 : (int)count;
+        timer.SetResult(hr);
+        timer.SetEvents(m_NumberOfBuffer);
+
+        InputTime now = m_Backend->GetTime();
+        if (SUCCEEDED(hr))
         {
-            switch (m_Buffer[i].dwOfs)
+            m_PollTime = now;
+            m_PollTick = m_Backend->GetTickCount();
+            ApplyEvents(m_Buffer, m_NumberOfBuffer, m_PollTime, m_PollTick, NULL);
+            if (m_Motion)
             {
-            case DIMOFS_BUTTON0:
-            case DIMOFS_BUTTON1:
-            case DIMOFS_BUTTON2:
-            case DIMOFS_BUTTON3:
-                if ((m_Buffer[i].dwData & 0x80) != 0)
-                    m_State.rgbButtons[m_Buffer[i].dwOfs - DIMOFS_BUTTON0] |= KS_PRESSED;
-                else
-                    m_State.rgbButtons[m_Buffer[i].dwOfs - DIMOFS_BUTTON0] |= KS_RELEASED;
-                break;
+                DrainSpill(count, pause, m_PollTime, m_PollTick, NULL);
+                m_Motion->Finish();
             }
         }
-    }
+        if (pause)
+            return;
+        m_Time = now;
 
-    if (!pause)
-    {
-        POINT pt;
-        ::GetCursorPos(&pt);
+        if (m_CursorSource == INPUT_CURSOR_QUERY)
+            QueryCursor();
         DIMOUSESTATE state;
         memset(&state, 0, sizeof(DIMOUSESTATE));
-        m_Position.x = (float)pt.x;
-        m_Position.y = (float)pt.y;
         hr = m_Device->GetDeviceState(sizeof(DIMOUSESTATE), &state);
         if (hr == DIERR_INPUTLOST || hr == DIERR_NOTACQUIRED)
         {
-            m_Device->Acquire();
-            m_Device->GetDeviceState(sizeof(DIMOUSESTATE), &state);
+            InputReacquire(m_Device, m_Stats);
+            hr = m_Device->GetDeviceState(sizeof(DIMOUSESTATE), &state);
         }
-        m_State.lX = state.lX;
-        m_State.lY = state.lY;
-        m_State.lZ = state.lZ;
+        if (FAILED(hr) && m_Stats)
+            m_Stats->AddFailure(INPUT_STAGE_MOUSE_POLL);
+        motion[0] = state.lX;
+        motion[1] = state.lY;
+        motion[2] = state.lZ;
+    }
+
+    m_State.lX = motion[0];
+    m_State.lY = motion[1];
+    m_State.lZ = motion[2];
+    if (m_CursorSource == INPUT_CURSOR_MOTION)
+        MoveCursor(motion);
+}
+
+// Drains the device buffer, m_Buffer keeps the first MOUSE_BUFFER_SIZE events of the frame
+HRESULT InputMouse::PollBuffered(BOOL pause, LONG *motion)
+{
+    InputTime now = m_Backend->GetTime();
+    DWORD tick = m_Backend->GetTickCount();
+    if (!pause)
+        m_Time = now;
+    m_PollTime = now;
+    m_PollTick = tick;
+
+    DWORD count = MOUSE_BUFFER_SIZE;
+    HRESULT hr = ReadData(m_Buffer, &count);
+    m_NumberOfBuffer = pause ? 0 : (int)count;
+    if (!pause)
+        ApplyEvents(m_Buffer, m_NumberOfBuffer, now, tick, motion);
+
+    HRESULT spillResult = DrainSpill(count, pause, now, tick, motion);
+    return FAILED(spillResult) ? spillResult : hr;
+}
+
+HRESULT InputMouse::DrainSpill(DWORD count, BOOL pause, InputTime now, DWORD tick, LONG *motion)
+{
+    // Events past the first chunk still move the mouse and its buttons
+    HRESULT hr = DI_OK;
+    DIDEVICEOBJECTDATA spill[MOUSE_BUFFER_SIZE];
+    for (int i = 1; i < MOUSE_MAX_READS && count == MOUSE_BUFFER_SIZE; i++)
+    {
+        HRESULT spillResult = ReadData(spill, &count);
+        if (FAILED(spillResult))
+            hr = spillResult;
+        else if (!pause)
+            ApplyEvents(spill, (int)count, now, tick, motion);
+    }
+    return hr;
+}
+
+void InputMouse::QueryCursor()
+{
+    LONG x = 0, y = 0;
+    m_Backend->GetCursorPos(&x, &y);
+    m_Position[0] = (float)x;
+    m_Position[1] = (float)y;
+}
+
+void InputMouse::MoveCursor(const LONG *motion)
+{
+    if (m_CursorResync > 0 && ++m_CursorPolls >= m_CursorResync)
+    {
+        m_CursorPolls = 0;
+        QueryCursor();
+        return;
+    }
+    m_Position[0] += (float)motion[0];
+    m_Position[1] += (float)motion[1];
+}
+
+void InputMouse::PostProcess()
+{
+    for (int iButton = 0; iButton < 4; iButton++)
+    {
+        if ((m_State.rgbButtons[iButton] & INPUT_KS_RELEASED) != 0)
+            m_State.rgbButtons[iButton] = INPUT_KS_IDLE;
     }
 }
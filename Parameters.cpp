@@ -2,9 +2,17 @@
 
 #include "CKAll.h"
 
+#include "DX8InputManager.h"
+
 #define CKOGUID_GETMOUSEPOSITION CKGUID(0x6ea0201, 0x680e3a62)
 #define CKOGUID_GETMOUSEX CKGUID(0x53c51abe, 0xeba68de)
 #define CKOGUID_GETMOUSEY CKGUID(0x27af3c9f, 0xdbc4eb3)
+#define CKOGUID_GETMOUSEMOTION CKGUID(0x4d1f6a2e, 0x1b7c3e59)
+#define CKOGUID_GETKEYSDOWN CKGUID(0x7a3e51c4, 0x2f9d0b86)
+#define CKOGUID_GETJOYSTICKPOSITION CKGUID(0x1e6b2d97, 0x5c40a3f1)
+#define CKOGUID_GETJOYSTICKROTATION CKGUID(0x6f2c8e13, 0x3ad57b20)
+#define CKOGUID_GETJOYSTICKSLIDERS CKGUID(0x2b97f4a6, 0x70e1c85d)
+#define CKOGUID_GETJOYSTICKBUTTONS CKGUID(0x58d03b7e, 0x14a6f29c)
 
 int CKKeyStringFunc(CKParameter *param, char *ValueString, CKBOOL ReadFromString)
 {
@@ -29,9 +37,14 @@ int CKKeyStringFunc(CKParameter *param, char *ValueString, CKBOOL ReadFromString
     return 0;
 }
 
+static DX8InputManager *GetInputManager(CKContext *context)
+{
+    return (DX8InputManager *)context->GetManagerByGuid(INPUT_MANAGER_GUID);
+}
+
 void CK2dVectorGetMousePos(CKContext *context, CKParameterOut *res, CKParameterIn *p1, CKParameterIn *p2)
 {
-    CKInputManager *im = (CKInputManager *)context->GetManagerByGuid(INPUT_MANAGER_GUID);
+    DX8InputManager *im = GetInputManager(context);
     if (im)
     {
         Vx2DVector pos;
@@ -44,42 +57,11 @@ void CK2dVectorGetMousePos(CKContext *context, CKParameterOut *res, CKParameterI
             return;
         }
 
+        // Clamped client coordinates, from the geometry the manager caches per frame
         CKBOOL absolute = FALSE;
         param->GetValue(&absolute);
         if (absolute)
-        {
-            CKRenderContext *rc = context->GetPlayerRenderContext();
-            if (rc)
-            {
-                HWND hWnd = (HWND)rc->GetWindowHandle();
-                POINT pt;
-                pt.x = (LONG)pos.x;
-                pt.y = (LONG)pos.y;
-                ::ScreenToClient(hWnd, &pt);
-                if (pt.x >= 0)
-                {
-                    int width = rc->GetWidth();
-                    if (pt.x >= width)
-                        pt.x = width - 1;
-                }
-                else
-                {
-                    pt.x = 0;
-                }
-                if (pt.y >= 0)
-                {
-                    int height = rc->GetHeight();
-                    if (pt.y >= height)
-                        pt.y = height - 1;
-                }
-                else
-                {
-                    pt.y = 0;
-                }
-                pos.x = (float)pt.x;
-                pos.y = (float)pt.y;
-            }
-        }
+            im->GetMouseClientPosition(pos);
         *(Vx2DVector *)res->GetWriteDataPtr() = pos;
     }
 }
@@ -106,6 +88,110 @@ void CKIntGetMouseY(CKContext *context, CKParameterOut *res, CKParameterIn *p1,
     }
 }
 
+static int GetIntInput(CKParameterIn *in)
+{
+    int value = 0;
+    CKParameter *param = in ? in->GetRealSource() : NULL;
+    if (param)
+        param->GetValue(&value);
+    return value;
+}
+
+void CKVectorGetMouseMotion(CKContext *context, CKParameterOut *res, CKParameterIn *p1, CKParameterIn *p2)
+{
+    DX8InputManager *im = GetInputManager(context);
+    if (im)
+    {
+        CKInputMouseState state;
+        im->GetMouseState(&state);
+
+        // The optional input asks for the motion through the mouse filter
+        CKBOOL filtered = FALSE;
+        CKParameter *param = p1->GetRealSource();
+        if (param)
+            param->GetValue(&filtered);
+        *(VxVector *)res->GetWriteDataPtr() = filtered ? state.FilteredMotion : state.Motion;
+    }
+}
+
+// Bit i of the result is set when the key in the first column of row i is down (32 rows at most)
+void CKIntGetKeysDown(CKContext *context, CKParameterOut *res, CKParameterIn *p1, CKParameterIn *p2)
+{
+    DX8InputManager *im = GetInputManager(context);
+    if (!im)
+        return;
+
+    CKParameter *param = p1->GetRealSource();
+    CKDataArray *array = param ? (CKDataArray *)param->GetValueObject() : NULL;
+    CKDWORD keys[32];
+    int count = 0;
+    if (array)
+    {
+        int rows = array->GetRowCount();
+        for (; count < rows && count < 32; count++)
+        {
+            keys[count] = 0;
+            array->GetElementValue(count, 0, &keys[count]);
+        }
+    }
+
+    CKBYTE states[32];
+    int mask = 0;
+    if (im->GetKeysState(keys, count, states) > 0)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            if (states[i] & KS_PRESSED)
+                mask |= 1 << i;
+        }
+    }
+    *(int *)res->GetWriteDataPtr() = mask;
+}
+
+void CKVectorGetJoystickPosition(CKContext *context, CKParameterOut *res, CKParameterIn *p1, CKParameterIn *p2)
+{
+    DX8InputManager *im = GetInputManager(context);
+    if (im)
+    {
+        CKInputJoystickState state;
+        im->GetJoystickState(GetIntInput(p1), &state);
+        *(VxVector *)res->GetWriteDataPtr() = state.Position;
+    }
+}
+
+void CKVectorGetJoystickRotation(CKContext *context, CKParameterOut *res, CKParameterIn *p1, CKParameterIn *p2)
+{
+    DX8InputManager *im = GetInputManager(context);
+    if (im)
+    {
+        CKInputJoystickState state;
+        im->GetJoystickState(GetIntInput(p1), &state);
+        *(VxVector *)res->GetWriteDataPtr() = state.Rotation;
+    }
+}
+
+void CK2dVectorGetJoystickSliders(CKContext *context, CKParameterOut *res, CKParameterIn *p1, CKParameterIn *p2)
+{
+    DX8InputManager *im = GetInputManager(context);
+    if (im)
+    {
+        CKInputJoystickState state;
+        im->GetJoystickState(GetIntInput(p1), &state);
+        *(Vx2DVector *)res->GetWriteDataPtr() = state.Sliders;
+    }
+}
+
+void CKIntGetJoystickButtons(CKContext *context, CKParameterOut *res, CKParameterIn *p1, CKParameterIn *p2)
+{
+    DX8InputManager *im = GetInputManager(context);
+    if (im)
+    {
+        CKInputJoystickState state;
+        im->GetJoystickState(GetIntInput(p1), &state);
+        *(int *)res->GetWriteDataPtr() = (int)state.Buttons;
+    }
+}
+
 void CKInitializeParameterTypes(CKContext *context)
 {
     CKParameterTypeDesc desc;
@@ -133,6 +219,12 @@ void CKInitializeOperationTypes(CKContext *context)
     pm->RegisterOperationType(CKOGUID_GETMOUSEPOSITION, "Get Mouse Position");
     pm->RegisterOperationType(CKOGUID_GETMOUSEX, "Get Mouse X");
     pm->RegisterOperationType(CKOGUID_GETMOUSEY, "Get Mouse Y");
+    pm->RegisterOperationType(CKOGUID_GETMOUSEMOTION, "Get Mouse Motion");
+    pm->RegisterOperationType(CKOGUID_GETKEYSDOWN, "Get Keys Down");
+    pm->RegisterOperationType(CKOGUID_GETJOYSTICKPOSITION, "Get Joystick Position");
+    pm->RegisterOperationType(CKOGUID_GETJOYSTICKROTATION, "Get Joystick Rotation");
+    pm->RegisterOperationType(CKOGUID_GETJOYSTICKSLIDERS, "Get Joystick Sliders");
+    pm->RegisterOperationType(CKOGUID_GETJOYSTICKBUTTONS, "Get Joystick Buttons");
 }
 
 void CKInitializeOperationFunctions(CKContext *context)
@@ -142,6 +234,13 @@ void CKInitializeOperationFunctions(CKContext *context)
     pm->RegisterOperationFunction(CKOGUID_GETMOUSEY, CKPGUID_INT, CKPGUID_NONE, CKPGUID_NONE, CKIntGetMouseY);
     pm->RegisterOperationFunction(CKOGUID_GETMOUSEPOSITION, CKPGUID_2DVECTOR, CKPGUID_NONE, CKPGUID_NONE, CK2dVectorGetMousePos);
     pm->RegisterOperationFunction(CKOGUID_GETMOUSEPOSITION, CKPGUID_2DVECTOR, CKPGUID_BOOL, CKPGUID_NONE, CK2dVectorGetMousePos);
+    pm->RegisterOperationFunction(CKOGUID_GETMOUSEMOTION, CKPGUID_VECTOR, CKPGUID_NONE, CKPGUID_NONE, CKVectorGetMouseMotion);
+    pm->RegisterOperationFunction(CKOGUID_GETMOUSEMOTION, CKPGUID_VECTOR, CKPGUID_BOOL, CKPGUID_NONE, CKVectorGetMouseMotion);
+    pm->RegisterOperationFunction(CKOGUID_GETKEYSDOWN, CKPGUID_INT, CKPGUID_DATAARRAY, CKPGUID_NONE, CKIntGetKeysDown);
+    pm->RegisterOperationFunction(CKOGUID_GETJOYSTICKPOSITION, CKPGUID_VECTOR, CKPGUID_INT, CKPGUID_NONE, CKVectorGetJoystickPosition);
+    pm->RegisterOperationFunction(CKOGUID_GETJOYSTICKROTATION, CKPGUID_VECTOR, CKPGUID_INT, CKPGUID_NONE, CKVectorGetJoystickRotation);
+    pm->RegisterOperationFunction(CKOGUID_GETJOYSTICKSLIDERS, CKPGUID_2DVECTOR, CKPGUID_INT, CKPGUID_NONE, CK2dVectorGetJoystickSliders);
+    pm->RegisterOperationFunction(CKOGUID_GETJOYSTICKBUTTONS, CKPGUID_INT, CKPGUID_INT, CKPGUID_NONE, CKIntGetJoystickButtons);
 }
 
 void CKUnInitializeParameterTypes(CKContext *context)
@@ -156,4 +255,10 @@ void CKUnInitializeOperationTypes(CKContext *context)
     pm->UnRegisterOperationType(CKOGUID_GETMOUSEPOSITION);
     pm->UnRegisterOperationType(CKOGUID_GETMOUSEX);
     pm->UnRegisterOperationType(CKOGUID_GETMOUSEY);
+    pm->UnRegisterOperationType(CKOGUID_GETMOUSEMOTION);
+    pm->UnRegisterOperationType(CKOGUID_GETKEYSDOWN);
+    pm->UnRegisterOperationType(CKOGUID_GETJOYSTICKPOSITION);
+    pm->UnRegisterOperationType(CKOGUID_GETJOYSTICKROTATION);
+    pm->UnRegisterOperationType(CKOGUID_GETJOYSTICKSLIDERS);
+    pm->UnRegisterOperationType(CKOGUID_GETJOYSTICKBUTTONS);
 }
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "ResponseCurve.h"
+
+BOOL InputResponseCurveCompile(InputResponseCurve &curve, const float *x, const float *y, int count, BOOL symmetric)
+{
+    if (!x || !y || count < 2 || count > RESPONSE_CURVE_MAX_POINTS)
+        return FALSE;
+    float lowest = symmetric ? 0.0f : -1.0f;
+    for (int k = 0; k < count; k++)
+    {
+        if (!(x[k] >= lowest && x[k] <= 1.0f) || !(y[k] >= -1.0f && y[k] <= 1.0f))
+            return FALSE;
+        if (k > 0 && !(x[k] > x[k - 1]))
+            return FALSE;
+    }
+
+    // Secant slopes, then the tangents at the points: zero at a local extremum, else
+    // the weighted harmonic mean of the neighbouring slopes, which keeps each segment monotone
+    float slopes[RESPONSE_CURVE_MAX_POINTS - 1];
+    float tangents[RESPONSE_CURVE_MAX_POINTS];
+    for (int k = 0; k < count - 1; k++)
+        slopes[k] = (y[k + 1] - y[k]) / (x[k + 1] - x[k]);
+    tangents[0] = slopes[0];
+    tangents[count - 1] = slopes[count - 2];
+    for (int k = 1; k < count - 1; k++)
+    {
+        if (slopes[k - 1] * slopes[k] <= 0.0f)
+        {
+            tangents[k] = 0.0f;
+            continue;
+        }
+        float before = x[k] - x[k - 1];
+        float after = x[k + 1] - x[k];
+        float w1 = 2.0f * after + before;
+        float w2 = after + 2.0f * before;
+        tangents[k] = (w1 + w2) / (w1 / slopes[k - 1] + w2 / slopes[k]);
+    }
+
+    float span = 1.0f - lowest;
+    int k = 0;
+    for (int s = 0; s <= RESPONSE_CURVE_SIZE; s++)
+    {
+        float at = lowest + span * (float)s / (float)RESPONSE_CURVE_SIZE;
+        float value;
+        if (at <= x[0])
+            value = y[0];
+        else if (at >= x[count - 1])
+            value = y[count - 1];
+        else
+        {
+            while (at > x[k + 1])
+                ++k;
+            float h = x[k + 1] - x[k];
+            float t = (at - x[k]) / h;
+            float t2 = t * t;
+            float t3 = t2 * t;
+            value = (2.0f * t3 - 3.0f * t2 + 1.0f) * y[k] + (t3 - 2.0f * t2 + t) * h * tangents[k] +
+                    (3.0f * t2 - 2.0f * t3) * y[k + 1] + (t3 - t2) * h * tangents[k + 1];
+        }
+        curve.Table[s] = (value > 1.0f) ? 1.0f : ((value < -1.0f) ? -1.0f : value);
+    }
+
+    curve.Scale = (float)RESPONSE_CURVE_SIZE / span;
+    curve.Offset = -lowest * curve.Scale;
+    curve.Symmetric = symmetric;
+    curve.Enabled = TRUE;
+    return TRUE;
+}
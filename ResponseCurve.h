@@ -0,0 +1,48 @@
+#ifndef RESPONSECURVE_H
+#define RESPONSECURVE_H
+
+#include "InputBackend.h"
+
+#define RESPONSE_CURVE_SIZE 128       // Table intervals over the input range
+#define RESPONSE_CURVE_MAX_POINTS 16
+
+// Response of one axis, compiled into a table of RESPONSE_CURVE_SIZE + 1 samples
+// read with linear interpolation, so a lookup costs the same whatever the curve.
+// The curve passes through its control points with monotone cubic segments
+// (Fritsch-Carlson): rising points give a rising curve without overshoot, and
+// two points give a straight line. Before the first point and after the last
+// it stays at their values. A symmetric curve is given over [0, 1] and mirrored
+// so that f(-x) = -f(x); any other covers [-1, 1].
+struct InputResponseCurve
+{
+    float Table[RESPONSE_CURVE_SIZE + 1];
+    float Scale;  // Input to table position: value * Scale + Offset
+    float Offset;
+    BOOL Symmetric;
+    BOOL Enabled;
+};
+
+// Compiles the curve from count points, x increasing and y in [-1, 1]; FALSE leaves
+// it unchanged when the points are invalid
+BOOL InputResponseCurveCompile(InputResponseCurve &curve, const float *x, const float *y, int count, BOOL symmetric);
+
+// Maps a normalized value in [-1, 1] through the curve
+inline float InputResponseCurveLookup(const InputResponseCurve &curve, float value)
+{
+    float sign = 1.0f;
+    if (curve.Symmetric && value < 0.0f)
+    {
+        value = -value;
+        sign = -1.0f;
+    }
+    float position = value * curve.Scale + curve.Offset;
+    if (position <= 0.0f)
+        return sign * curve.Table[0];
+    if (position >= (float)RESPONSE_CURVE_SIZE)
+        return sign * curve.Table[RESPONSE_CURVE_SIZE];
+    int i = (int)position;
+    float t = position - (float)i;
+    return sign * (curve.Table[i] + (curve.Table[i + 1] - curve.Table[i]) * t);
+}
+
+#endif // RESPONSECURVE_H
@@ -0,0 +1,484 @@
+#include "ScriptedBackend.h"
+
+#include <stdio.h>
+
+ScriptedInputDevice::ScriptedInputDevice(const GUID &guid, const char *name, DWORD stateSize)
+    : m_GUID(guid), m_State(stateSize, 0)
+{
+    memset(m_Name, 0, sizeof(m_Name));
+    if (name)
+        strncpy(m_Name, name, MAX_PATH - 1);
+    memset(&m_Caps, 0, sizeof(m_Caps));
+    for (int i = 0; i < INPUT_AXIS_COUNT; i++)
+    {
+        m_Ranges[i].Present = FALSE;
+        m_Ranges[i].Min = -1000;
+        m_Ranges[i].Max = 1000;
+    }
+    m_BufferSize = 0;
+    m_Sequence = 0;
+    m_RelativeAxes = 0;
+    m_DataReads = 0;
+    m_StateReads = 0;
+    m_Notify = NULL;
+    m_AcquireResult = DI_OK;
+    m_Overflowed = FALSE;
+    m_Acquired = FALSE;
+    m_Open = FALSE;
+    m_Unplugged = FALSE;
+}
+
+ScriptedInputDevice::~ScriptedInputDevice() {}
+
+HRESULT ScriptedInputDevice::Acquire()
+{
+    InputMutexLock lock(m_Lock);
+    if (!m_Open)
+        return DIERR_NOTINITIALIZED;
+    if (FAILED(m_AcquireResult))
+        return m_AcquireResult;
+    if (m_Acquired)
+        return S_FALSE;
+    m_Acquired = TRUE;
+    return DI_OK;
+}
+
+HRESULT ScriptedInputDevice::Unacquire()
+{
+    InputMutexLock lock(m_Lock);
+    if (!m_Acquired)
+        return DI_NOEFFECT;
+    m_Acquired = FALSE;
+    return DI_OK;
+}
+
+HRESULT ScriptedInputDevice::Poll()
+{
+    InputMutexLock lock(m_Lock);
+    if (!m_Acquired)
+        return DIERR_NOTACQUIRED;
+    return DI_OK;
+}
+
+HRESULT ScriptedInputDevice::SetCooperativeLevel(HWND /*hWnd*/, DWORD /*flags*/)
+{
+    return m_Open ? DI_OK : DIERR_NOTINITIALIZED;
+}
+
+HRESULT ScriptedInputDevice::GetDeviceData(DIDEVICEOBJECTDATA *data, DWORD *count, DWORD flags)
+{
+    if (!count)
+        return DIERR_INVALIDPARAM;
+    InputMutexLock lock(m_Lock);
+    ++m_DataReads;
+    if (!m_Acquired)
+    {
+        *count = 0;
+        return DIERR_NOTACQUIRED;
+    }
+
+    DWORD n = 0;
+    if (data)
+    {
+        while (n < *count && n < m_Events.size())
+        {
+            data[n] = m_Events[n];
+            ++n;
+        }
+    }
+    if ((flags & DIGDD_PEEK) == 0)
+        m_Events.erase(m_Events.begin(), m_Events.begin() + n);
+    *count = n;
+
+    if (m_Overflowed)
+    {
+        if ((flags & DIGDD_PEEK) == 0)
+            m_Overflowed = FALSE;
+        return DI_BUFFEROVERFLOW;
+    }
+    return DI_OK;
+}
+
+HRESULT ScriptedInputDevice::GetDeviceState(DWORD size, void *state)
+{
+    if (!state)
+        return DIERR_INVALIDPARAM;
+    InputMutexLock lock(m_Lock);
+    ++m_StateReads;
+    if (!m_Acquired)
+        return DIERR_NOTACQUIRED;
+
+    DWORD n = size < m_State.size() ? size : (DWORD)m_State.size();
+    memset(state, 0, size);
+    if (n > 0)
+        memcpy(state, &m_State[0], n);
+
+    for (int i = 0; i < m_RelativeAxes && (DWORD)((i + 1) * sizeof(LONG)) <= m_State.size(); i++)
+        ((LONG *)&m_State[0])[i] = 0;
+
+    return DI_OK;
+}
+
+HRESULT ScriptedInputDevice::SetEventNotification(InputSignal *signal)
+{
+    InputMutexLock lock(m_Lock);
+    if (m_Acquired)
+        return DIERR_ACQUIRED;
+    m_Notify = signal;
+    return DI_OK;
+}
+
+HRESULT ScriptedInputDevice::GetCapabilities(InputDeviceCaps *caps)
+{
+    if (!caps)
+        return DIERR_INVALIDPARAM;
+    *caps = m_Caps;
+    return DI_OK;
+}
+
+HRESULT ScriptedInputDevice::GetAxisRanges(InputAxisRange ranges[INPUT_AXIS_COUNT])
+{
+    memcpy(ranges, m_Ranges, sizeof(m_Ranges));
+    return DI_OK;
+}
+
+void *ScriptedInputDevice::GetNativeInterface()
+{
+    return NULL;
+}
+
+void ScriptedInputDevice::Release()
+{
+    // Scripted devices are owned by the backend; releasing only closes them
+    InputMutexLock lock(m_Lock);
+    m_Notify = NULL;
+    m_Acquired = FALSE;
+    m_Open = FALSE;
+}
+
+void ScriptedInputDevice::QueueEvent(DWORD ofs, DWORD data, DWORD timeStamp, BOOL sameReport)
+{
+    // Like DirectInput, events arriving while the device is not acquired are lost
+    InputMutexLock lock(m_Lock);
+    if (!m_Acquired)
+        return;
+
+    if (m_BufferSize > 0 && m_Events.size() >= m_BufferSize)
+    {
+        m_Overflowed = TRUE;
+        return;
+    }
+
+    DIDEVICEOBJECTDATA event;
+    memset(&event, 0, sizeof(event));
+    event.dwOfs = ofs;
+    event.dwData = data;
+    event.dwTimeStamp = timeStamp;
+    event.dwSequence = (sameReport && m_Sequence != 0) ? m_Sequence : ++m_Sequence;
+    m_Events.push_back(event);
+    if (m_Notify)
+        m_Notify->Set();
+}
+
+void ScriptedInputDevice::SetState(const void *state, DWORD size)
+{
+    if (!state)
+        return;
+    InputMutexLock lock(m_Lock);
+    if (size > m_State.size())
+        size = (DWORD)m_State.size();
+    if (size > 0)
+        memcpy(&m_State[0], state, size);
+    if (m_Notify && m_Acquired)
+        m_Notify->Set();
+}
+
+void ScriptedInputDevice::SetAxisRange(int axis, LONG min, LONG max)
+{
+    if (axis < 0 || axis >= INPUT_AXIS_COUNT)
+        return;
+    m_Ranges[axis].Present = TRUE;
+    m_Ranges[axis].Min = min;
+    m_Ranges[axis].Max = max;
+}
+
+void ScriptedInputDevice::Lose(HRESULT acquireResult)
+{
+    InputMutexLock lock(m_Lock);
+    m_Acquired = FALSE;
+    m_AcquireResult = acquireResult;
+}
+
+int ScriptedInputDevice::GetPendingEvents() const
+{
+    InputMutexLock lock(m_Lock);
+    return (int)m_Events.size();
+}
+
+static GUID MakeScriptedGUID(DWORD index)
+{
+    GUID guid;
+    memset(&guid, 0, sizeof(GUID));
+    guid.Data1 = 0x5C1A0000 | index;
+    guid.Data2 = 0x5C1A;
+    return guid;
+}
+
+ScriptedInputBackend::ScriptedInputBackend()
+{
+    m_Keyboard = new ScriptedInputDevice(MakeScriptedGUID(0), "Scripted Keyboard", 256);
+    m_Mouse = new ScriptedInputDevice(MakeScriptedGUID(1), "Scripted Mouse", sizeof(DIMOUSESTATE));
+    m_Mouse->SetRelativeAxes(3);
+    m_Time = 0;
+    m_CursorX = 0;
+    m_CursorY = 0;
+    m_CursorQueries = 0;
+    m_JoystickOpenDelay = 0;
+    m_Initialized = FALSE;
+}
+
+ScriptedInputBackend::~ScriptedInputBackend()
+{
+    delete m_Keyboard;
+    delete m_Mouse;
+    for (size_t i = 0; i < m_Joysticks.size(); i++)
+        delete m_Joysticks[i];
+}
+
+HRESULT ScriptedInputBackend::Initialize(HWND /*hWnd*/)
+{
+    m_Initialized = TRUE;
+    return DI_OK;
+}
+
+void ScriptedInputBackend::Shutdown()
+{
+    m_Initialized = FALSE;
+}
+
+HRESULT ScriptedInputBackend::CreateKeyboard(DWORD bufferSize, InputDevice **device)
+{
+    if (!device)
+        return DIERR_INVALIDPARAM;
+    *device = NULL;
+    if (!m_Initialized)
+        return DIERR_NOTINITIALIZED;
+
+    m_Keyboard->m_BufferSize = bufferSize;
+    m_Keyboard->m_Open = TRUE;
+    *device = m_Keyboard;
+    return DI_OK;
+}
+
+HRESULT ScriptedInputBackend::CreateMouse(DWORD bufferSize, InputDevice **device)
+{
+    if (!device)
+        return DIERR_INVALIDPARAM;
+    *device = NULL;
+    if (!m_Initialized)
+        return DIERR_NOTINITIALIZED;
+
+    m_Mouse->m_BufferSize = bufferSize;
+    m_Mouse->m_Open = TRUE;
+    *device = m_Mouse;
+    return DI_OK;
+}
+
+HRESULT ScriptedInputBackend::EnumJoysticks(InputDeviceEnumCallback callback, void *context)
+{
+    if (!callback)
+        return DIERR_INVALIDPARAM;
+    if (!m_Initialized)
+        return DIERR_NOTINITIALIZED;
+
+    InputMutexLock lock(m_JoysticksLock);
+    for (size_t i = 0; i < m_Joysticks.size(); i++)
+    {
+        if (m_Joysticks[i]->m_Unplugged)
+            continue;
+        InputDeviceInfo info;
+        memset(&info, 0, sizeof(InputDeviceInfo));
+        info.InstanceGUID = m_Joysticks[i]->GetGUID();
+        size_t length = strlen(m_Joysticks[i]->GetName());
+        if (length > MAX_PATH - 1)
+            length = MAX_PATH - 1;
+        memcpy(info.ProductName, m_Joysticks[i]->GetName(), length);
+        info.ProductName[length] = '\0';
+        if (callback(&info, context) == DIENUM_STOP)
+            break;
+    }
+    return DI_OK;
+}
+
+HRESULT ScriptedInputBackend::CreateJoystick(const GUID &instance, InputDevice **device)
+{
+    if (!device)
+        return DIERR_INVALIDPARAM;
+    *device = NULL;
+    if (!m_Initialized)
+        return DIERR_NOTINITIALIZED;
+
+    ScriptedInputDevice *joystick = NULL;
+    {
+        InputMutexLock lock(m_JoysticksLock);
+        for (size_t i = 0; i < m_Joysticks.size() && !joystick; i++)
+        {
+            if (m_Joysticks[i]->GetGUID() == instance && !m_Joysticks[i]->m_Unplugged)
+                joystick = m_Joysticks[i];
+        }
+        if (!joystick)
+            return DIERR_DEVICENOTREG;
+        joystick->m_Open = TRUE;
+    }
+
+    // Stands for the data format and object enumeration of a real controller
+    if (m_JoystickOpenDelay)
+        InputSleep(m_JoystickOpenDelay);
+    *device = joystick;
+    return DI_OK;
+}
+
+DWORD ScriptedInputBackend::GetTickCount()
+{
+    return (DWORD)(m_Time / 1000);
+}
+
+InputTime ScriptedInputBackend::GetTime()
+{
+    return m_Time;
+}
+
+BOOL ScriptedInputBackend::GetCursorPos(LONG *x, LONG *y)
+{
+    ++m_CursorQueries;
+    if (x) *x = m_CursorX;
+    if (y) *y = m_CursorY;
+    return TRUE;
+}
+
+BOOL ScriptedInputBackend::SetCursorPos(LONG x, LONG y)
+{
+    m_CursorX = x;
+    m_CursorY = y;
+    return TRUE;
+}
+
+void ScriptedInputBackend::Release()
+{
+    delete this;
+}
+
+ScriptedInputDevice *ScriptedInputBackend::AddJoystick(const char *name, int buttons)
+{
+    InputMutexLock lock(m_JoysticksLock);
+    char defaultName[MAX_PATH];
+    if (!name)
+    {
+        sprintf(defaultName, "Scripted Joystick %d", (int)m_Joysticks.size());
+        name = defaultName;
+    }
+
+    ScriptedInputDevice *joystick = new ScriptedInputDevice(MakeScriptedGUID(2 + (DWORD)m_Joysticks.size()), name, sizeof(DIJOYSTATE2));
+
+    InputDeviceCaps caps;
+    caps.Axes = INPUT_AXIS_COUNT;
+    caps.Buttons = buttons;
+    caps.POVs = 1;
+    joystick->SetCapabilities(caps);
+    for (int axis = 0; axis < INPUT_AXIS_COUNT; axis++)
+        joystick->SetAxisRange(axis, -1000, 1000);
+
+    // Centered POV reads as 0xFFFF like on real hardware
+    DIJOYSTATE2 *state = (DIJOYSTATE2 *)joystick->GetStatePtr();
+    for (int i = 0; i < 4; i++)
+        state->rgdwPOV[i] = 0xFFFFFFFF;
+
+    m_Joysticks.push_back(joystick);
+    return joystick;
+}
+
+ScriptedInputDevice *ScriptedInputBackend::GetJoystick(int index)
+{
+    InputMutexLock lock(m_JoysticksLock);
+    if (index < 0 || index >= (int)m_Joysticks.size())
+        return NULL;
+    return m_Joysticks[index];
+}
+
+int ScriptedInputBackend::GetJoystickCount() const
+{
+    InputMutexLock lock(m_JoysticksLock);
+    return (int)m_Joysticks.size();
+}
+
+void ScriptedInputBackend::UnplugJoystick(int index)
+{
+    InputMutexLock lock(m_JoysticksLock);
+    ScriptedInputDevice *joystick = GetJoystick(index);
+    if (!joystick)
+        return;
+    joystick->m_Unplugged = TRUE;
+    joystick->Lose(DIERR_UNPLUGGED);
+}
+
+void ScriptedInputBackend::PlugJoystick(int index)
+{
+    InputMutexLock lock(m_JoysticksLock);
+    ScriptedInputDevice *joystick = GetJoystick(index);
+    if (!joystick)
+        return;
+    joystick->m_Unplugged = FALSE;
+    joystick->Lose(DI_OK);
+}
+
+void ScriptedInputBackend::KeyDown(DWORD key)
+{
+    if (key >= 256)
+        return;
+    InputMutexLock lock(m_Keyboard->m_Lock);
+    ((BYTE *)m_Keyboard->GetStatePtr())[key] = 0x80;
+    m_Keyboard->QueueEvent(key, 0x80, GetTickCount());
+}
+
+void ScriptedInputBackend::KeyUp(DWORD key)
+{
+    if (key >= 256)
+        return;
+    InputMutexLock lock(m_Keyboard->m_Lock);
+    ((BYTE *)m_Keyboard->GetStatePtr())[key] = 0;
+    m_Keyboard->QueueEvent(key, 0, GetTickCount());
+}
+
+void ScriptedInputBackend::MouseButton(int button, BOOL pressed)
+{
+    if (button < 0 || button >= 4)
+        return;
+    InputMutexLock lock(m_Mouse->m_Lock);
+    DIMOUSESTATE *state = (DIMOUSESTATE *)m_Mouse->GetStatePtr();
+    state->rgbButtons[button] = pressed ? 0x80 : 0;
+    m_Mouse->QueueEvent((DWORD)(DIMOFS_BUTTON0 + button), pressed ? 0x80 : 0, GetTickCount());
+}
+
+void ScriptedInputBackend::MouseMove(LONG dx, LONG dy, LONG dz)
+{
+    InputMutexLock lock(m_Mouse->m_Lock);
+    DIMOUSESTATE *state = (DIMOUSESTATE *)m_Mouse->GetStatePtr();
+    state->lX += dx;
+    state->lY += dy;
+    state->lZ += dz;
+    if (dx != 0)
+        m_Mouse->QueueEvent(DIMOFS_X, (DWORD)dx, GetTickCount());
+    if (dy != 0)
+        m_Mouse->QueueEvent(DIMOFS_Y, (DWORD)dy, GetTickCount(), dx != 0);
+    if (dz != 0)
+        m_Mouse->QueueEvent(DIMOFS_Z, (DWORD)dz, GetTickCount(), dx != 0 || dy != 0);
+    m_CursorX += dx;
+    m_CursorY += dy;
+}
+
+void ScriptedInputBackend::SetJoystickState(int index, const DIJOYSTATE2 &state)
+{
+    ScriptedInputDevice *joystick = GetJoystick(index);
+    if (joystick)
+        joystick->SetState(&state, sizeof(DIJOYSTATE2));
+}
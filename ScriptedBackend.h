@@ -0,0 +1,140 @@
+#ifndef SCRIPTEDBACKEND_H
+#define SCRIPTEDBACKEND_H
+
+#include <deque>
+#include <vector>
+
+#include "InputBackend.h"
+#include "InputThread.h"
+
+// In-memory device driven by a script instead of hardware.
+// Buffered events and immediate state behave like a DirectInput device:
+// reads fail with DIERR_NOTACQUIRED until the device is acquired, the event
+// buffer holds at most the configured number of entries and reports
+// DI_BUFFEROVERFLOW when events had to be dropped. Device calls and script
+// calls may come from different threads.
+class ScriptedInputDevice : public InputDevice
+{
+    friend class ScriptedInputBackend;
+
+public:
+    ScriptedInputDevice(const GUID &guid, const char *name, DWORD stateSize);
+    virtual ~ScriptedInputDevice();
+
+    virtual HRESULT Acquire();
+    virtual HRESULT Unacquire();
+    virtual HRESULT Poll();
+    virtual HRESULT SetCooperativeLevel(HWND hWnd, DWORD flags);
+    virtual HRESULT GetDeviceData(DIDEVICEOBJECTDATA *data, DWORD *count, DWORD flags);
+    virtual HRESULT GetDeviceState(DWORD size, void *state);
+    virtual HRESULT SetEventNotification(InputSignal *signal);
+    virtual HRESULT GetCapabilities(InputDeviceCaps *caps);
+    virtual HRESULT GetAxisRanges(InputAxisRange ranges[INPUT_AXIS_COUNT]);
+    virtual void *GetNativeInterface();
+    virtual void Release();
+
+    // Script interface
+    // sameReport gives the event the sequence number of the previous one, as DirectInput
+    // does for the axes of one mouse report
+    void QueueEvent(DWORD ofs, DWORD data, DWORD timeStamp, BOOL sameReport = FALSE);
+    void SetState(const void *state, DWORD size);
+    void *GetStatePtr() { return m_State.empty() ? NULL : &m_State[0]; }
+    // The first count LONG fields of the state are relative axes, reset after every read.
+    void SetRelativeAxes(int count) { m_RelativeAxes = count; }
+    void SetBufferSize(DWORD size) { m_BufferSize = size; }
+    void SetCapabilities(const InputDeviceCaps &caps) { m_Caps = caps; }
+    void SetAxisRange(int axis, LONG min, LONG max);
+    // Simulates focus loss: the device is unacquired and Acquire returns acquireResult until Lose(DI_OK).
+    void Lose(HRESULT acquireResult = DI_OK);
+
+    const GUID &GetGUID() const { return m_GUID; }
+    const char *GetName() const { return m_Name; }
+    BOOL IsAcquired() const { return m_Acquired; }
+    BOOL IsOpen() const { return m_Open; }
+    int GetPendingEvents() const;
+    // GetDeviceData and GetDeviceState calls made on the device, failed ones included
+    DWORD GetDataReadCount() const { return m_DataReads; }
+    DWORD GetStateReadCount() const { return m_StateReads; }
+
+private:
+    GUID m_GUID;
+    char m_Name[MAX_PATH];
+    std::deque<DIDEVICEOBJECTDATA> m_Events;
+    std::vector<BYTE> m_State;
+    InputDeviceCaps m_Caps;
+    InputAxisRange m_Ranges[INPUT_AXIS_COUNT];
+    DWORD m_BufferSize;
+    DWORD m_Sequence;
+    int m_RelativeAxes;
+    DWORD m_DataReads;
+    DWORD m_StateReads;
+    mutable InputMutex m_Lock;
+    InputSignal *m_Notify;
+    HRESULT m_AcquireResult;
+    BOOL m_Overflowed;
+    BOOL m_Acquired;
+    BOOL m_Open;
+    BOOL m_Unplugged;
+};
+
+// Backend serving one keyboard, one mouse and any number of scripted game
+// controllers. Time only advances when the script says so. Controllers may be
+// added, unplugged and plugged back while another thread enumerates them.
+class ScriptedInputBackend : public InputBackend
+{
+public:
+    ScriptedInputBackend();
+    virtual ~ScriptedInputBackend();
+
+    virtual HRESULT Initialize(HWND hWnd);
+    virtual void Shutdown();
+    virtual HRESULT CreateKeyboard(DWORD bufferSize, InputDevice **device);
+    virtual HRESULT CreateMouse(DWORD bufferSize, InputDevice **device);
+    virtual HRESULT EnumJoysticks(InputDeviceEnumCallback callback, void *context);
+    virtual HRESULT CreateJoystick(const GUID &instance, InputDevice **device);
+    virtual DWORD GetTickCount();
+    virtual InputTime GetTime();
+    virtual BOOL GetCursorPos(LONG *x, LONG *y);
+    virtual BOOL SetCursorPos(LONG x, LONG y);
+    virtual void Release();
+
+    // Script interface
+    ScriptedInputDevice *GetKeyboard() { return m_Keyboard; }
+    ScriptedInputDevice *GetMouse() { return m_Mouse; }
+    ScriptedInputDevice *AddJoystick(const char *name, int buttons = 32);
+    ScriptedInputDevice *GetJoystick(int index);
+    int GetJoystickCount() const;
+    // An unplugged controller leaves the enumeration, cannot be created, and its
+    // open device fails to acquire with DIERR_UNPLUGGED until plugged back
+    void UnplugJoystick(int index);
+    void PlugJoystick(int index);
+    // Milliseconds CreateJoystick takes, outside of any lock
+    void SetJoystickOpenDelay(DWORD ms) { m_JoystickOpenDelay = ms; }
+    DWORD GetCursorQueryCount() const { return m_CursorQueries; } // GetCursorPos calls
+
+    // Script time in milliseconds, with microsecond variants for sub-millisecond ordering
+    void SetTime(DWORD ms) { m_Time = (InputTime)ms * 1000; }
+    void AdvanceTime(DWORD ms) { m_Time += (InputTime)ms * 1000; }
+    void SetTimeMicroseconds(InputTime us) { m_Time = us; }
+    void AdvanceTimeMicroseconds(InputTime us) { m_Time += us; }
+
+    void KeyDown(DWORD key);
+    void KeyUp(DWORD key);
+    void MouseButton(int button, BOOL pressed);
+    void MouseMove(LONG dx, LONG dy, LONG dz = 0);
+    void SetJoystickState(int index, const DIJOYSTATE2 &state);
+
+private:
+    ScriptedInputDevice *m_Keyboard;
+    ScriptedInputDevice *m_Mouse;
+    std::vector<ScriptedInputDevice *> m_Joysticks;
+    mutable InputMutex m_JoysticksLock;
+    InputTime m_Time; // Microseconds
+    LONG m_CursorX;
+    LONG m_CursorY;
+    DWORD m_CursorQueries;
+    DWORD m_JoystickOpenDelay;
+    BOOL m_Initialized;
+};
+
+#endif // SCRIPTEDBACKEND_H
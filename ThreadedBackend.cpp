@@ -0,0 +1,360 @@
+#include "ThreadedBackend.h"
+
+#include <string.h>
+
+//
+// ThreadedInputDevice
+//
+
+ThreadedInputDevice::ThreadedInputDevice(ThreadedInputBackend *owner, InputDevice *device, BOOL buffered)
+    : m_Owner(owner), m_Device(device), m_Events(NULL), m_State(NULL), m_Notify(NULL),
+      m_Result(DIERR_NOTACQUIRED), m_Overflowed(0), m_Dropped(0)
+{
+    if (buffered)
+        m_Events = new InputEventQueue;
+    else
+        m_State = new InputStateBuffer(sizeof(DIJOYSTATE2));
+}
+
+ThreadedInputDevice::~ThreadedInputDevice()
+{
+    delete m_Events;
+    delete m_State;
+}
+
+HRESULT ThreadedInputDevice::Acquire()
+{
+    InputMutexLock lock(m_Lock);
+    HRESULT hr = m_Device->Acquire();
+    if (SUCCEEDED(hr))
+        InputAtomicStore(&m_Result, DI_OK);
+    return hr;
+}
+
+HRESULT ThreadedInputDevice::Unacquire()
+{
+    InputMutexLock lock(m_Lock);
+    InputAtomicStore(&m_Result, DIERR_NOTACQUIRED);
+    return m_Device->Unacquire();
+}
+
+HRESULT ThreadedInputDevice::Poll()
+{
+    if (m_Events)
+    {
+        InputMutexLock lock(m_Lock);
+        return m_Device->Poll();
+    }
+
+    // The input thread polls game controllers; only report what it ran into
+    HRESULT hr = (HRESULT)InputAtomicLoad(&m_Result);
+    return FAILED(hr) ? hr : DI_OK;
+}
+
+HRESULT ThreadedInputDevice::SetCooperativeLevel(HWND hWnd, DWORD flags)
+{
+    InputMutexLock lock(m_Lock);
+    return m_Device->SetCooperativeLevel(hWnd, flags);
+}
+
+HRESULT ThreadedInputDevice::GetDeviceData(DIDEVICEOBJECTDATA *data, DWORD *count, DWORD flags)
+{
+    if (!count)
+        return DIERR_INVALIDPARAM;
+    if (!m_Events)
+    {
+        *count = 0;
+        return DI_OK;
+    }
+
+    BOOL peek = (flags & DIGDD_PEEK) != 0;
+    DWORD n = m_Events->Pop(data, *count, peek);
+    *count = n;
+
+    // Events queued before the device was lost are delivered first
+    if (n == 0)
+    {
+        HRESULT hr = (HRESULT)InputAtomicLoad(&m_Result);
+        if (FAILED(hr))
+            return hr;
+    }
+
+    BOOL overflowed = peek ? InputAtomicLoad(&m_Overflowed) != 0 : InputAtomicExchange(&m_Overflowed, 0) != 0;
+    return overflowed ? DI_BUFFEROVERFLOW : DI_OK;
+}
+
+HRESULT ThreadedInputDevice::GetDeviceState(DWORD size, void *state)
+{
+    if (!state)
+        return DIERR_INVALIDPARAM;
+
+    if (m_State)
+    {
+        HRESULT hr = (HRESULT)InputAtomicLoad(&m_Result);
+        if (FAILED(hr))
+            return hr;
+
+        const void *latest = m_State->Acquire();
+        if (latest)
+        {
+            DWORD n = (size < m_State->GetSize()) ? size : m_State->GetSize();
+            memcpy(state, latest, n);
+            if (size > n)
+                memset((BYTE *)state + n, 0, size - n);
+            return DI_OK;
+        }
+    }
+
+    // Immediate state of buffered devices, and controllers before the first pass of the thread
+    InputMutexLock lock(m_Lock);
+    return m_Device->GetDeviceState(size, state);
+}
+
+HRESULT ThreadedInputDevice::SetEventNotification(InputSignal *signal)
+{
+    // The wrapped device notifies the input thread; this one is raised after each pass that found data
+    m_Notify = signal;
+    return DI_OK;
+}
+
+HRESULT ThreadedInputDevice::GetCapabilities(InputDeviceCaps *caps)
+{
+    InputMutexLock lock(m_Lock);
+    return m_Device->GetCapabilities(caps);
+}
+
+HRESULT ThreadedInputDevice::GetAxisRanges(InputAxisRange ranges[INPUT_AXIS_COUNT])
+{
+    InputMutexLock lock(m_Lock);
+    return m_Device->GetAxisRanges(ranges);
+}
+
+void *ThreadedInputDevice::GetNativeInterface()
+{
+    return m_Device->GetNativeInterface();
+}
+
+void ThreadedInputDevice::Release()
+{
+    // Waits for a pass of the input thread over this device to finish
+    m_Owner->Remove(this);
+    m_Device->SetEventNotification(NULL);
+    m_Device->Release();
+    delete this;
+}
+
+void ThreadedInputDevice::Pump()
+{
+    InputMutexLock lock(m_Lock);
+    if (FAILED((HRESULT)InputAtomicLoad(&m_Result)))
+        return; // Left to the main thread to acquire again
+
+    if (m_Events)
+        PumpEvents();
+    else
+        PumpState();
+}
+
+void ThreadedInputDevice::PumpEvents()
+{
+    DIDEVICEOBJECTDATA buffer[THREADED_READ_CHUNK];
+    DWORD queued = 0;
+    for (;;)
+    {
+        DWORD count = THREADED_READ_CHUNK;
+        HRESULT hr = m_Device->GetDeviceData(buffer, &count, 0);
+        if (FAILED(hr))
+        {
+            InputAtomicStore(&m_Result, hr);
+            break;
+        }
+
+        // Lost by the device or by the queue, the main thread resynchronizes either way
+        if (hr == DI_BUFFEROVERFLOW)
+            InputAtomicStore(&m_Overflowed, 1);
+        for (DWORD i = 0; i < count; i++)
+        {
+            if (m_Events->Push(buffer[i]))
+            {
+                ++queued;
+            }
+            else
+            {
+                InputAtomicStore(&m_Overflowed, 1);
+                InputAtomicAdd(&m_Dropped, 1);
+            }
+        }
+        if (count < THREADED_READ_CHUNK)
+            break;
+    }
+
+    if (queued > 0 && m_Notify)
+        m_Notify->Set();
+}
+
+void ThreadedInputDevice::PumpState()
+{
+    HRESULT hr = m_Device->Poll();
+    if (SUCCEEDED(hr))
+        hr = m_Device->GetDeviceState(m_State->GetSize(), m_State->GetBackBuffer());
+    if (FAILED(hr))
+    {
+        InputAtomicStore(&m_Result, hr);
+        return;
+    }
+
+    m_State->Publish();
+    if (m_Notify)
+        m_Notify->Set();
+}
+
+//
+// ThreadedInputBackend
+//
+
+ThreadedInputBackend::ThreadedInputBackend(InputBackend *backend)
+    : m_Backend(backend), m_DeviceCount(0), m_Stop(0), m_PollInterval(THREADED_POLL_INTERVAL), m_Wakes(0)
+{
+    memset(m_Devices, 0, sizeof(m_Devices));
+}
+
+ThreadedInputBackend::~ThreadedInputBackend()
+{
+    Shutdown();
+}
+
+void ThreadedInputBackend::Run(void *arg)
+{
+    ThreadedInputBackend *backend = (ThreadedInputBackend *)arg;
+    while (!InputAtomicLoad(&backend->m_Stop))
+    {
+        backend->m_Signal.Wait(backend->GetPollInterval());
+        if (InputAtomicLoad(&backend->m_Stop))
+            break;
+
+        InputMutexLock lock(backend->m_DevicesLock);
+        for (int i = 0; i < backend->m_DeviceCount; i++)
+            backend->m_Devices[i]->Pump();
+        InputAtomicAdd(&backend->m_Wakes, 1);
+    }
+}
+
+HRESULT ThreadedInputBackend::Initialize(HWND hWnd)
+{
+    HRESULT hr = m_Backend->Initialize(hWnd);
+    if (SUCCEEDED(hr) && !m_Thread.IsRunning())
+    {
+        InputAtomicStore(&m_Stop, 0);
+        if (!m_Thread.Start(Run, this))
+            hr = DIERR_GENERIC;
+    }
+    return hr;
+}
+
+void ThreadedInputBackend::Shutdown()
+{
+    Stop();
+    if (m_Backend)
+        m_Backend->Shutdown();
+}
+
+void ThreadedInputBackend::Stop()
+{
+    if (m_Thread.IsRunning())
+    {
+        InputAtomicStore(&m_Stop, 1);
+        m_Signal.Set();
+        m_Thread.Join();
+    }
+}
+
+HRESULT ThreadedInputBackend::CreateKeyboard(DWORD bufferSize, InputDevice **device)
+{
+    return Wrap(m_Backend->CreateKeyboard(bufferSize, device), TRUE, device);
+}
+
+HRESULT ThreadedInputBackend::CreateMouse(DWORD bufferSize, InputDevice **device)
+{
+    return Wrap(m_Backend->CreateMouse(bufferSize, device), TRUE, device);
+}
+
+HRESULT ThreadedInputBackend::EnumJoysticks(InputDeviceEnumCallback callback, void *context)
+{
+    return m_Backend->EnumJoysticks(callback, context);
+}
+
+HRESULT ThreadedInputBackend::CreateJoystick(const GUID &instance, InputDevice **device)
+{
+    return Wrap(m_Backend->CreateJoystick(instance, device), FALSE, device);
+}
+
+HRESULT ThreadedInputBackend::Wrap(HRESULT hr, BOOL buffered, InputDevice **device)
+{
+    if (FAILED(hr) || !device || !*device)
+        return hr;
+
+    // Out of slots: the device works, synchronously
+    InputMutexLock lock(m_DevicesLock);
+    if (m_DeviceCount >= THREADED_MAX_DEVICES)
+        return hr;
+
+    // Devices that cannot notify are still read every poll interval
+    (*device)->SetEventNotification(&m_Signal);
+
+    ThreadedInputDevice *threaded = new ThreadedInputDevice(this, *device, buffered);
+    m_Devices[m_DeviceCount++] = threaded;
+    *device = threaded;
+    return hr;
+}
+
+void ThreadedInputBackend::Remove(ThreadedInputDevice *device)
+{
+    InputMutexLock lock(m_DevicesLock);
+    for (int i = 0; i < m_DeviceCount; i++)
+    {
+        if (m_Devices[i] == device)
+        {
+            m_Devices[i] = m_Devices[--m_DeviceCount];
+            m_Devices[m_DeviceCount] = NULL;
+            break;
+        }
+    }
+}
+
+DWORD ThreadedInputBackend::GetTickCount()
+{
+    return m_Backend->GetTickCount();
+}
+
+InputTime ThreadedInputBackend::GetTime()
+{
+    return m_Backend->GetTime();
+}
+
+BOOL ThreadedInputBackend::GetCursorPos(LONG *x, LONG *y)
+{
+    return m_Backend->GetCursorPos(x, y);
+}
+
+BOOL ThreadedInputBackend::SetCursorPos(LONG x, LONG y)
+{
+    return m_Backend->SetCursorPos(x, y);
+}
+
+InputBackend *ThreadedInputBackend::DetachBackend()
+{
+    // The wrapped backend stays initialized: its devices may already be reopened on it
+    Stop();
+    InputBackend *backend = m_Backend;
+    m_Backend = NULL;
+    return backend;
+}
+
+void ThreadedInputBackend::Release()
+{
+    Shutdown();
+    if (m_Backend)
+        m_Backend->Release();
+    m_Backend = NULL;
+    delete this;
+}
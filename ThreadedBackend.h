@@ -0,0 +1,113 @@
+#ifndef THREADEDBACKEND_H
+#define THREADEDBACKEND_H
+
+#include "InputBackend.h"
+#include "EventQueue.h"
+#include "InputThread.h"
+
+#define THREADED_MAX_DEVICES 32
+#define THREADED_READ_CHUNK 64   // Events per GetDeviceData call on the input thread
+#define THREADED_POLL_INTERVAL 4 // Default milliseconds between passes when no device signals
+
+class ThreadedInputBackend;
+
+// Device drained by the input thread. Buffered events (keyboard and mouse) are
+// moved into a lock-free queue as they arrive; game controllers, which have no
+// buffer, have their immediate state (DIJOYSTATE2) read by the thread and
+// published in a triple buffer. The main thread reads both without waiting for the thread.
+// Other calls are forwarded to the wrapped device under the device lock.
+class ThreadedInputDevice : public InputDevice
+{
+    friend class ThreadedInputBackend;
+
+public:
+    ThreadedInputDevice(ThreadedInputBackend *owner, InputDevice *device, BOOL buffered);
+    virtual ~ThreadedInputDevice();
+
+    virtual HRESULT Acquire();
+    virtual HRESULT Unacquire();
+    virtual HRESULT Poll();
+    virtual HRESULT SetCooperativeLevel(HWND hWnd, DWORD flags);
+    virtual HRESULT GetDeviceData(DIDEVICEOBJECTDATA *data, DWORD *count, DWORD flags);
+    virtual HRESULT GetDeviceState(DWORD size, void *state);
+    virtual HRESULT SetEventNotification(InputSignal *signal);
+    virtual HRESULT GetCapabilities(InputDeviceCaps *caps);
+    virtual HRESULT GetAxisRanges(InputAxisRange ranges[INPUT_AXIS_COUNT]);
+    virtual void *GetNativeInterface();
+    virtual void Release();
+
+    // Events waiting for the main thread, and events dropped because the queue was full
+    DWORD GetQueuedCount() const { return m_Events ? m_Events->GetCount() : 0; }
+    DWORD GetDroppedCount() const { return (DWORD)InputAtomicLoad(&m_Dropped); }
+
+private:
+    // Input thread side
+    void Pump();
+    void PumpEvents();
+    void PumpState();
+
+    ThreadedInputBackend *m_Owner;
+    InputDevice *m_Device;
+    InputMutex m_Lock;         // Serializes calls to the wrapped device
+    InputEventQueue *m_Events; // Buffered devices
+    InputStateBuffer *m_State; // Game controllers
+    InputSignal *m_Notify;     // Raised after the thread queued or published something
+    volatile LONG m_Result;    // Failure seen by the thread (lost or not acquired), cleared by Acquire
+    volatile LONG m_Overflowed;
+    volatile LONG m_Dropped;
+};
+
+// Backend decorator that runs a dedicated input thread. The thread waits for
+// the devices' event notifications (or the poll interval, for devices that
+// never signal) and drains every device of the wrapped backend as data
+// arrives, so a long frame neither overflows the device buffers nor loses the
+// order of events. The state machine keeps running on the main thread and only
+// consumes what the thread handed off. The backend owns the wrapped one.
+class ThreadedInputBackend : public InputBackend
+{
+    friend class ThreadedInputDevice;
+
+public:
+    explicit ThreadedInputBackend(InputBackend *backend);
+    virtual ~ThreadedInputBackend();
+
+    virtual HRESULT Initialize(HWND hWnd);
+    virtual void Shutdown();
+    virtual HRESULT CreateKeyboard(DWORD bufferSize, InputDevice **device);
+    virtual HRESULT CreateMouse(DWORD bufferSize, InputDevice **device);
+    virtual HRESULT EnumJoysticks(InputDeviceEnumCallback callback, void *context);
+    virtual HRESULT CreateJoystick(const GUID &instance, InputDevice **device);
+    virtual DWORD GetTickCount();
+    virtual InputTime GetTime();
+    virtual BOOL GetCursorPos(LONG *x, LONG *y);
+    virtual BOOL SetCursorPos(LONG x, LONG y);
+    virtual void Release();
+
+    InputBackend *GetBackend() { return m_Backend; }
+    // Stops the thread and gives the wrapped backend back to the caller, still initialized;
+    // Release() then only destroys the decorator
+    InputBackend *DetachBackend();
+
+    void SetPollInterval(DWORD ms) { InputAtomicStore(&m_PollInterval, (LONG)(ms > 0 ? ms : 1)); }
+    DWORD GetPollInterval() const { return (DWORD)InputAtomicLoad(&m_PollInterval); }
+    BOOL IsRunning() const { return m_Thread.IsRunning(); }
+    DWORD GetWakeCount() const { return (DWORD)InputAtomicLoad(&m_Wakes); } // Passes of the input thread
+
+private:
+    static void Run(void *arg);
+    void Stop(); // Joins the input thread
+    HRESULT Wrap(HRESULT hr, BOOL buffered, InputDevice **device);
+    void Remove(ThreadedInputDevice *device);
+
+    InputBackend *m_Backend;
+    InputThread m_Thread;
+    InputSignal m_Signal; // Shared by all devices, raised by their notifications
+    InputMutex m_DevicesLock;
+    ThreadedInputDevice *m_Devices[THREADED_MAX_DEVICES];
+    int m_DeviceCount;
+    volatile LONG m_Stop;
+    volatile LONG m_PollInterval;
+    volatile LONG m_Wakes;
+};
+
+#endif // THREADEDBACKEND_H
@@ -0,0 +1,49 @@
+#ifndef BENCHUTIL_H
+#define BENCHUTIL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+// Monotonic wall clock in nanoseconds
+inline double BenchNow()
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq, counter;
+    ::QueryPerformanceFrequency(&freq);
+    ::QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart * 1e9 / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#endif
+}
+
+// Iteration count from the first command line argument, or the given default
+inline int BenchIterations(int argc, char **argv, int defaultCount)
+{
+    if (argc > 1)
+    {
+        int n = atoi(argv[1]);
+        if (n > 0)
+            return n;
+    }
+    return defaultCount;
+}
+
+inline void BenchReport(const char *name, double elapsedNs, int iterations)
+{
+    printf("%-40s %10d iters %12.1f ns/iter\n", name, iterations, elapsedNs / (double)iterations);
+}
+
+// Keeps the optimizer from discarding a computed value
+static volatile unsigned int g_BenchSink;
+inline void BenchConsume(unsigned int value) { g_BenchSink += value; }
+
+#endif // BENCHUTIL_H
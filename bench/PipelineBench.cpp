@@ -0,0 +1,2338 @@
+// Frame pipeline benchmark: runs the keyboard, mouse and joystick state machine
+// against the scripted backend the same way DX8InputManager drives it per frame.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ActionMap.h"
+#include "AxisKernel.h"
+#include "BenchUtil.h"
+#include "ComboRecognizer.h"
+#include "InputDevices.h"
+#include "InputSnapshot.h"
+#include "JoystickPoller.h"
+#include "JoystickWatcher.h"
+#include "MotionFilter.h"
+#include "ResponseCurve.h"
+#include "JournalBackend.h"
+#include "ScriptedBackend.h"
+#include "ThreadedBackend.h"
+
+#define JOYSTICK_COUNT 4
+#define PIPELINE_MAX_JOYSTICKS 8
+#define JOURNAL_PATH "PipelineBench.journal"
+#define ACTIONS_PATH "PipelineBench.actions"
+#define STARTUP_OPEN_DELAY 2 // Milliseconds a scripted joystick takes to open in the startup benchmark
+
+struct Pipeline
+{
+    InputBackend *backend;
+    InputKeyboard keyboard;
+    InputMouse mouse;
+    InputJoystick joysticks[PIPELINE_MAX_JOYSTICKS];
+    int joystickCount;
+
+    static BOOL JoystickEnum(const InputDeviceInfo *info, void *context)
+    {
+        Pipeline *p = (Pipeline *)context;
+        if (p->joystickCount >= PIPELINE_MAX_JOYSTICKS)
+            return DIENUM_STOP;
+        InputDevice *device = NULL;
+        if (SUCCEEDED(p->backend->CreateJoystick(info->InstanceGUID, &device)))
+            p->joysticks[p->joystickCount++].Attach(p->backend, device, *info);
+        return DIENUM_CONTINUE;
+    }
+
+    // Without openJoysticks, as a deferred startup, they are left to a watcher
+    explicit Pipeline(InputBackend *b, BOOL openJoysticks = TRUE) : backend(b), joystickCount(0)
+    {
+        backend->Initialize(NULL);
+        InputDevice *device = NULL;
+        backend->CreateKeyboard(KEYBOARD_BUFFER_SIZE, &device);
+        keyboard.Init(backend, device, NULL);
+        backend->CreateMouse(MOUSE_BUFFER_SIZE, &device);
+        mouse.Init(backend, device, NULL);
+        if (!openJoysticks)
+            return;
+        backend->EnumJoysticks(JoystickEnum, this);
+        for (int i = 0; i < joystickCount; i++)
+            joysticks[i].Init(NULL);
+    }
+
+    ~Pipeline()
+    {
+        keyboard.Release();
+        mouse.Release();
+        for (int i = 0; i < joystickCount; i++)
+            joysticks[i].Release();
+        backend->Shutdown();
+    }
+
+    void PreProcess()
+    {
+        keyboard.Poll(FALSE);
+        mouse.Poll(FALSE);
+        for (int i = 0; i < joystickCount; i++)
+            joysticks[i].BeginFrame();
+    }
+
+    void PostProcess()
+    {
+        keyboard.PostProcess();
+        mouse.PostProcess();
+    }
+};
+
+static int CheckStateMachine()
+{
+    ScriptedInputBackend *backend = new ScriptedInputBackend;
+    backend->AddJoystick("Bench Pad");
+    int failures = 0;
+    {
+        Pipeline p(backend);
+        p.PreProcess();
+
+        backend->KeyDown(0x1E);
+        backend->MouseButton(0, TRUE);
+        p.PreProcess();
+        if (p.keyboard.GetState()[0x1E] != INPUT_KS_PRESSED) ++failures;
+        if (!KeyMaskTest(p.keyboard.GetPressedMask(), 0x1E)) ++failures;
+        if (!KeyMaskTest(p.keyboard.GetDownMask(), 0x1E)) ++failures;
+        if (p.mouse.GetState().rgbButtons[0] != INPUT_KS_PRESSED) ++failures;
+        p.PostProcess();
+
+        backend->KeyUp(0x1E);
+        backend->MouseButton(0, FALSE);
+        p.PreProcess();
+        if (p.keyboard.GetState()[0x1E] != (INPUT_KS_PRESSED | INPUT_KS_RELEASED)) ++failures;
+        if (KeyMaskTest(p.keyboard.GetPressedMask(), 0x1E)) ++failures;
+        if (!KeyMaskTest(p.keyboard.GetReleasedMask(), 0x1E)) ++failures;
+        p.PostProcess();
+        if (p.keyboard.GetState()[0x1E] != INPUT_KS_IDLE) ++failures;
+        if (!KeyMaskIsEmpty(p.keyboard.GetDownMask()) || !KeyMaskIsEmpty(p.keyboard.GetReleasedMask())) ++failures;
+
+        BYTE states[KEYBOARD_BUFFER_SIZE];
+        memset(states, 0, sizeof(states));
+        states[0x20] = INPUT_KS_PRESSED;
+        states[0xC8] = INPUT_KS_PRESSED | INPUT_KS_RELEASED;
+        p.keyboard.SetState(states, NULL);
+        if (!KeyMaskTest(p.keyboard.GetDownMask(), 0xC8) || !KeyMaskTest(p.keyboard.GetReleasedMask(), 0xC8)) ++failures;
+        if (!KeyMaskTest(p.keyboard.GetPressedMask(), 0x20)) ++failures;
+        p.PostProcess();
+        if (p.keyboard.GetState()[0xC8] != INPUT_KS_IDLE || p.keyboard.GetState()[0x20] != INPUT_KS_PRESSED) ++failures;
+        if (p.keyboard.GetActiveKeyCount() != 1 || p.keyboard.GetActiveKeys()[0] != 0x20) ++failures;
+        p.keyboard.Clear();
+        if (p.keyboard.GetActiveKeyCount() != 0 || p.keyboard.GetState()[0x20] != INPUT_KS_IDLE || p.keyboard.GetPressTime(0x20) != 0) ++failures;
+
+        // Only held and released keys stay active, whatever the order they were touched in
+        backend->AdvanceTime(10);
+        backend->KeyDown(0x10);
+        backend->KeyDown(0x11);
+        backend->KeyDown(0x12);
+        p.PreProcess();
+        p.PostProcess();
+        backend->KeyUp(0x10);
+        backend->KeyUp(0x12);
+        p.PreProcess();
+        if (p.keyboard.GetActiveKeyCount() != 3) ++failures;
+        p.PostProcess();
+        if (p.keyboard.GetActiveKeyCount() != 1 || p.keyboard.GetActiveKeys()[0] != 0x11) ++failures;
+        if (p.keyboard.GetState()[0x10] != INPUT_KS_IDLE || p.keyboard.GetState()[0x12] != INPUT_KS_IDLE || !KeyMaskIsEmpty(p.keyboard.GetPressedMask())) ++failures;
+        backend->KeyUp(0x11);
+        p.PreProcess();
+        p.PostProcess();
+        if (p.keyboard.GetActiveKeyCount() != 0 || !KeyMaskIsEmpty(p.keyboard.GetDownMask())) ++failures;
+        if (p.keyboard.GetPressTime(0x11) == 0) ++failures;
+        p.keyboard.Clear();
+        if (p.keyboard.GetPressTime(0x11) != 0 || p.keyboard.GetReleaseTime(0x12) != 0) ++failures;
+
+        // Bytes written through the legacy state pointer are swept into the masks
+        p.PreProcess();
+        BYTE *legacy = p.keyboard.GetWritableState();
+        legacy[0x2C] = INPUT_KS_PRESSED | INPUT_KS_RELEASED;
+        legacy[0x2D] = INPUT_KS_PRESSED;
+        p.PostProcess();
+        if (p.keyboard.GetState()[0x2C] != INPUT_KS_IDLE || KeyMaskTest(p.keyboard.GetReleasedMask(), 0x2C)) ++failures;
+        if (!KeyMaskTest(p.keyboard.GetDownMask(), 0x2D) || p.keyboard.GetActiveKeyCount() != 1) ++failures;
+        p.PreProcess();
+        p.keyboard.GetWritableState()[0x2D] = INPUT_KS_RELEASED;
+        p.PostProcess();
+        if (p.keyboard.GetState()[0x2D] != INPUT_KS_IDLE || !KeyMaskIsEmpty(p.keyboard.GetDownMask())) ++failures;
+        if (p.keyboard.GetActiveKeyCount() != 0) ++failures;
+        p.keyboard.Clear();
+
+        // Repetition: a 10-interval stall past the delay yields one event carrying the count
+        p.keyboard.EnableRepetition(TRUE);
+        backend->KeyDown(0x39);
+        p.PreProcess();
+        p.PostProcess();
+        backend->AdvanceTime(p.keyboard.GetRepeatDelay() + 10 * p.keyboard.GetRepeatInterval());
+        p.PreProcess();
+        if (p.keyboard.GetEventCount() != 1 || p.keyboard.GetEvent(0)->Data.uAppData != 11) ++failures;
+        p.PostProcess();
+        backend->AdvanceTime(p.keyboard.GetRepeatInterval());
+        p.PreProcess();
+        if (p.keyboard.GetEventCount() != 1 || p.keyboard.GetEvent(0)->Data.uAppData != 1) ++failures;
+        p.PostProcess();
+        backend->KeyUp(0x39);
+        backend->AdvanceTime(10 * p.keyboard.GetRepeatInterval());
+        p.PreProcess();
+        if (p.keyboard.GetEventCount() != 1) ++failures;
+        p.PostProcess();
+        p.keyboard.EnableRepetition(FALSE);
+
+        // A key held while repetition was off repeats from its press once it is enabled
+        backend->KeyDown(0x3A);
+        p.PreProcess();
+        p.PostProcess();
+        backend->AdvanceTime(p.keyboard.GetRepeatDelay() + p.keyboard.GetRepeatInterval());
+        p.PreProcess();
+        if (p.keyboard.GetEventCount() != 0) ++failures;
+        p.PostProcess();
+        p.keyboard.EnableRepetition(TRUE);
+        p.PreProcess();
+        if (p.keyboard.GetEventCount() != 1 || p.keyboard.GetEvent(0)->Data.uAppData != 2) ++failures;
+        p.PostProcess();
+        backend->KeyUp(0x3A);
+        p.PreProcess();
+        p.PostProcess();
+        p.keyboard.EnableRepetition(FALSE);
+
+        // Microsecond timeline: injected keys keep sub-millisecond order,
+        // device events land on the clock no later than the poll
+        p.keyboard.SetKey(0x1E, TRUE, backend->GetTickCount(), backend->GetTime());
+        backend->AdvanceTimeMicroseconds(300);
+        p.keyboard.SetKey(0x1F, TRUE, backend->GetTickCount(), backend->GetTime());
+        if (p.keyboard.GetPressTime(0x1F) - p.keyboard.GetPressTime(0x1E) != 300) ++failures;
+        p.keyboard.Clear();
+        backend->KeyDown(0x20);
+        backend->AdvanceTimeMicroseconds(400);
+        p.PreProcess();
+        if (p.keyboard.GetEventCount() != 1 || p.keyboard.GetEvent(0)->Time > backend->GetTime()) ++failures;
+        if (p.keyboard.GetPressTime(0x20) != p.keyboard.GetEvent(0)->Time) ++failures;
+        p.PostProcess();
+        backend->KeyUp(0x20);
+        p.PreProcess();
+        p.PostProcess();
+
+        // A burst larger than one read is drained completely
+        backend->GetKeyboard()->SetBufferSize(1024);
+        for (int i = 0; i < 300; i++)
+        {
+            backend->KeyDown(0x10 + (i & 7));
+            backend->KeyUp(0x10 + (i & 7));
+        }
+        p.PreProcess();
+        if (p.keyboard.GetEventCount() != 600 || p.keyboard.GetOverflowCount() != 0) ++failures;
+        p.PostProcess();
+        if (!KeyMaskIsEmpty(p.keyboard.GetDownMask())) ++failures;
+
+        // Events lost by the device are counted and the stuck key is released
+        backend->GetKeyboard()->SetBufferSize(4);
+        backend->KeyDown(0x1C);
+        p.PreProcess();
+        p.PostProcess();
+        for (int i = 0; i < 4; i++)
+            backend->KeyDown(0x2C);
+        backend->KeyUp(0x1C);
+        p.PreProcess();
+        if (p.keyboard.GetOverflowCount() != 1 || (p.keyboard.GetState()[0x1C] & INPUT_KS_RELEASED) == 0) ++failures;
+        p.PostProcess();
+        if (p.keyboard.GetState()[0x1C] != INPUT_KS_IDLE) ++failures;
+        backend->GetKeyboard()->SetBufferSize(KEYBOARD_BUFFER_SIZE);
+        backend->KeyUp(0x2C);
+        p.PreProcess();
+        p.PostProcess();
+        if (p.mouse.GetState().rgbButtons[0] != INPUT_KS_IDLE) ++failures;
+
+        // Ingest latency: an event stamped 3 ms before the poll
+        LatencyHistogram ingest;
+        p.keyboard.SetIngestLatency(&ingest);
+        backend->KeyDown(0x1E);
+        backend->AdvanceTime(3);
+        p.PreProcess();
+        if (ingest.GetCount() != 1 || ingest.GetMax() != 3000) ++failures;
+        p.PostProcess();
+        backend->KeyUp(0x1E);
+        p.PreProcess();
+        p.PostProcess();
+        p.keyboard.SetIngestLatency(NULL);
+        for (DWORD us = 1; us <= 1000; us++)
+            ingest.Add(us);
+        DWORD median = ingest.GetPercentile(0.5f);
+        if (median < 500 || median > 500 + 500 / LATENCY_SUB_BUCKETS) ++failures;
+        if (ingest.GetPercentile(1.0f) != 3000 || ingest.GetPercentile(0.0f) != 0) ++failures; // The release was read at once
+
+        // Frame costs: calls, events and a reacquisition after the keyboard is lost
+        InputFrameStats stats;
+        p.keyboard.SetFrameStats(&stats);
+        p.mouse.SetFrameStats(&stats);
+        stats.BeginFrame();
+        backend->KeyDown(0x1E);
+        backend->KeyUp(0x1E);
+        backend->MouseButton(1, TRUE);
+        p.PreProcess();
+        p.PostProcess();
+        backend->GetKeyboard()->Lose();
+        stats.BeginFrame();
+        p.PreProcess();
+        p.PostProcess();
+        stats.BeginFrame();
+        const InputFrameCost *frame = stats.GetFrame(2);
+        if (!frame || frame->Stages[INPUT_STAGE_KEYBOARD_POLL].Calls != 1 || frame->Stages[INPUT_STAGE_KEYBOARD_POLL].Events != 2) ++failures;
+        if (!frame || frame->Stages[INPUT_STAGE_MOUSE_POLL].Events != 1 || frame->Stages[INPUT_STAGE_REACQUIRE].Calls != 0) ++failures;
+        frame = stats.GetFrame(1);
+        if (!frame || frame->Stages[INPUT_STAGE_REACQUIRE].Calls != 1 || frame->Stages[INPUT_STAGE_REACQUIRE].Failures != 0) ++failures;
+        InputStageCost costs[INPUT_STAGE_COUNT];
+        if (stats.Sum(costs) != 2 || costs[INPUT_STAGE_KEYBOARD_POLL].Calls != 2) ++failures;
+        char dump[1024];
+        if (stats.Format(dump, sizeof(dump)) <= 0) ++failures;
+        p.keyboard.SetFrameStats(NULL);
+        p.mouse.SetFrameStats(NULL);
+        backend->MouseButton(1, FALSE);
+        p.PreProcess();
+        p.PostProcess();
+
+        DIJOYSTATE2 state;
+        memset(&state, 0, sizeof(state));
+        state.lX = 1000;
+        state.rgdwPOV[0] = 0xFFFFFFFF;
+        state.rgbButtons[3] = 0x80;
+        backend->SetJoystickState(0, state);
+        p.PreProcess();
+        p.joysticks[0].Poll();
+        if (p.joysticks[0].GetPosition()[0] < 0.99f) ++failures;
+        if (p.joysticks[0].GetButtons() != (1u << 3)) ++failures;
+    }
+    backend->Release();
+    return failures;
+}
+
+// Scripted frame f of the journal session
+static void ScriptFrame(ScriptedInputBackend *script, int f)
+{
+    if (f % 3 == 0)
+        script->KeyDown(0x10 + (f & 7));
+    if (f % 3 == 2)
+        script->KeyUp(0x10 + ((f - 2) & 7));
+    script->MouseMove(f & 3, -(f & 1));
+    if (f % 8 == 0)
+        script->MouseButton(1, (f & 8) != 0);
+    DIJOYSTATE2 state;
+    memset(&state, 0, sizeof(state));
+    state.lX = f * 100 - 3200;
+    state.rgdwPOV[0] = 0xFFFFFFFF;
+    state.rgbButtons[f & 15] = 0x80;
+    script->SetJoystickState(0, state);
+    script->AdvanceTime(16);
+}
+
+struct JournalFrame
+{
+    BYTE Keys[KEYBOARD_BUFFER_SIZE];
+    DIMOUSESTATE Mouse;
+    float JoystickX;
+    DWORD JoystickButtons;
+    int Events;
+};
+
+static void SnapshotFrame(Pipeline &p, JournalFrame &frame)
+{
+    memcpy(frame.Keys, p.keyboard.GetState(), sizeof(frame.Keys));
+    frame.Mouse = p.mouse.GetState();
+    p.joysticks[0].Poll();
+    frame.JoystickX = p.joysticks[0].GetPosition()[0];
+    frame.JoystickButtons = p.joysticks[0].GetButtons();
+    frame.Events = p.keyboard.GetEventCount();
+}
+
+static void CountInjection(DWORD call, const void *data, DWORD size, void *context)
+{
+    int *next = (int *)context;
+    int frame;
+    if (call == 1 && size == sizeof(frame))
+    {
+        memcpy(&frame, data, sizeof(frame));
+        if (frame == *next)
+            ++*next;
+    }
+}
+
+// Records a scripted session, replays it and compares the state frame by frame
+static int CheckJournal()
+{
+    const int frameCount = 64;
+    static JournalFrame recorded[frameCount];
+    int failures = 0;
+
+    ScriptedInputBackend *script = new ScriptedInputBackend;
+    script->AddJoystick("Journal Pad");
+    RecordingInputBackend *recorder = new RecordingInputBackend(script);
+    if (!recorder->Open(JOURNAL_PATH))
+    {
+        recorder->Release();
+        return 1;
+    }
+    {
+        Pipeline p(recorder);
+        for (int f = 0; f < frameCount; f++)
+        {
+            ScriptFrame(script, f);
+            recorder->BeginFrame();
+            p.PreProcess();
+            recorder->WriteInjection(1, &f, sizeof(f));
+            SnapshotFrame(p, recorded[f]);
+            recorder->EndFrame();
+            p.PostProcess();
+        }
+    }
+    recorder->Release();
+
+    ReplayInputBackend *replay = new ReplayInputBackend;
+    int injections = 0;
+    if (!replay->Open(JOURNAL_PATH))
+    {
+        replay->Release();
+        return 1;
+    }
+    replay->SetInjectionCallback(CountInjection, &injections);
+    {
+        Pipeline p(replay);
+        for (int f = 0; f < frameCount; f++)
+        {
+            JournalFrame frame;
+            replay->BeginFrame();
+            p.PreProcess();
+            replay->DispatchInjections();
+            SnapshotFrame(p, frame);
+            replay->EndFrame();
+            p.PostProcess();
+            if (memcmp(frame.Keys, recorded[f].Keys, sizeof(frame.Keys)) != 0) ++failures;
+            if (memcmp(&frame.Mouse, &recorded[f].Mouse, sizeof(frame.Mouse)) != 0) ++failures;
+            if (frame.JoystickX != recorded[f].JoystickX || frame.JoystickButtons != recorded[f].JoystickButtons) ++failures;
+            if (frame.Events != recorded[f].Events) ++failures;
+        }
+        if (injections != frameCount) ++failures;
+        if (!replay->IsFinished() || replay->IsCorrupt()) ++failures;
+        if (replay->GetMissCount() != 0 || replay->GetSkippedCount() != 0) ++failures;
+    }
+    replay->Release();
+    remove(JOURNAL_PATH);
+    return failures;
+}
+
+// Journaling with eager poll workers: the polls stay on the main thread, in order,
+// so the replay reads the joysticks back frame by frame
+static int CheckJournalPolledEagerly()
+{
+    const int frameCount = 48;
+    static float recorded[frameCount][JOYSTICK_COUNT];
+    int failures = 0;
+
+    ScriptedInputBackend *script = new ScriptedInputBackend;
+    for (int j = 0; j < JOYSTICK_COUNT; j++)
+        script->AddJoystick(NULL);
+    RecordingInputBackend *recorder = new RecordingInputBackend(script);
+    if (!recorder->Open(JOURNAL_PATH))
+    {
+        recorder->Release();
+        return 1;
+    }
+    {
+        Pipeline p(recorder);
+        InputJoystickPoller poller;
+        if (!poller.Start(JOYSTICK_COUNT)) ++failures;
+        for (int f = 0; f < frameCount; f++)
+        {
+            DIJOYSTATE2 state;
+            memset(&state, 0, sizeof(state));
+            state.rgdwPOV[0] = 0xFFFFFFFF;
+            for (int j = 0; j < JOYSTICK_COUNT; j++)
+            {
+                state.lX = (f * 40 + j * 500) % 2000 - 1000;
+                script->SetJoystickState(j, state);
+            }
+            script->AdvanceTime(16);
+            recorder->BeginFrame();
+            p.PreProcess();
+            poller.PollAll(p.joysticks, p.joystickCount, FALSE);
+            for (int j = 0; j < JOYSTICK_COUNT; j++)
+                recorded[f][j] = p.joysticks[j].GetPosition()[0];
+            recorder->EndFrame();
+            p.PostProcess();
+        }
+    }
+    recorder->Release();
+
+    ReplayInputBackend *replay = new ReplayInputBackend;
+    if (!replay->Open(JOURNAL_PATH))
+    {
+        replay->Release();
+        return 1;
+    }
+    {
+        Pipeline p(replay);
+        InputJoystickPoller poller;
+        if (!poller.Start(JOYSTICK_COUNT)) ++failures;
+        if (p.joystickCount != JOYSTICK_COUNT) ++failures;
+        for (int f = 0; f < frameCount; f++)
+        {
+            replay->BeginFrame();
+            p.PreProcess();
+            poller.PollAll(p.joysticks, p.joystickCount, FALSE);
+            for (int j = 0; j < p.joystickCount && j < JOYSTICK_COUNT; j++)
+            {
+                if (p.joysticks[j].GetPosition()[0] != recorded[f][j]) ++failures;
+            }
+            replay->EndFrame();
+            p.PostProcess();
+        }
+        if (!replay->IsFinished() || replay->IsCorrupt()) ++failures;
+        if (replay->GetMissCount() != 0 || replay->GetSkippedCount() != 0) ++failures;
+    }
+    replay->Release();
+    remove(JOURNAL_PATH);
+    return failures;
+}
+
+static const char g_Actions[] =
+    "# Bench bindings\n"
+    "jump   key    0x39\n"
+    "fire   mouse  0\n"
+    "fire   button 0 2      # same action, second source\n"
+    "steer  axis   0 x\n"
+    "left   axis   0 x -1 0.25\n"
+    "brake  key    \"30\"   0.5\n";
+
+// Action map: parsing, evaluation of every source, edges, and a swap that keeps held actions
+static int CheckActionMap()
+{
+    int failures = 0;
+    InputActionMap map;
+    int line = 0;
+    if (map.Parse("jump key 0x39\nfire mouse 9\n", NULL, &line) || line != 2 || map.GetBindingCount() != 0) ++failures;
+    if (map.Parse("jump key Space\n", NULL, &line) || line != 1) ++failures; // No name table
+    FILE *file = fopen(ACTIONS_PATH, "wb");
+    if (file)
+    {
+        fputs(g_Actions, file);
+        fclose(file);
+    }
+    if (!map.Load(ACTIONS_PATH, NULL, &line) || map.GetActionCount() != 5 || map.GetBindingCount() != 6) ++failures;
+    remove(ACTIONS_PATH);
+
+    InputActionTable *table = map.Compile();
+    if (!table)
+        return failures + 1;
+    int jump = table->Find("JUMP");
+    int fire = table->Find("fire");
+    int steer = table->Find("steer");
+    int left = table->Find("left");
+    int brake = table->Find("brake");
+    if (jump != 0 || fire != 1 || steer != 2 || left != 3 || brake != 4 || table->Find("duck") != -1) ++failures;
+
+    ScriptedInputBackend *backend = new ScriptedInputBackend;
+    backend->AddJoystick("Action Pad");
+    {
+        Pipeline p(backend);
+        p.PreProcess();
+        table->Evaluate(p.keyboard, p.mouse, p.joysticks, p.joystickCount);
+
+        backend->KeyDown(0x39);
+        backend->KeyDown(30);
+        DIJOYSTATE2 state;
+        memset(&state, 0, sizeof(state));
+        state.lX = -700;
+        state.rgdwPOV[0] = 0xFFFFFFFF;
+        state.rgbButtons[2] = 0x80;
+        backend->SetJoystickState(0, state);
+        p.PreProcess();
+        if (table->Evaluate(p.keyboard, p.mouse, p.joysticks, p.joystickCount) != 6) ++failures;
+        if (table->GetState(jump) != (INPUT_ACTION_DOWN | INPUT_ACTION_PRESSED)) ++failures;
+        if (table->GetState(fire) != (INPUT_ACTION_DOWN | INPUT_ACTION_PRESSED) || table->GetValue(fire) != 1.0f) ++failures;
+        if (table->GetState(steer) != INPUT_ACTION_IDLE || table->GetValue(steer) > -0.6f) ++failures;
+        if (!(table->GetState(left) & INPUT_ACTION_DOWN) || table->GetValue(left) < 0.6f) ++failures;
+        if (table->GetValue(brake) != 0.5f) ++failures;
+        p.PostProcess();
+
+        // A new table with the same actions takes over without edges
+        InputActionTable *swapped = map.Compile();
+        swapped->Adopt(*table);
+        delete table;
+        table = swapped;
+        backend->KeyUp(0x39);
+        p.PreProcess();
+        table->Evaluate(p.keyboard, p.mouse, p.joysticks, p.joystickCount);
+        if (table->GetState(jump) != INPUT_ACTION_RELEASED) ++failures;
+        if (table->GetState(fire) != INPUT_ACTION_DOWN || table->GetState(brake) != INPUT_ACTION_DOWN) ++failures;
+        p.PostProcess();
+        backend->KeyUp(30);
+        backend->KeyDown(0x39);
+        backend->KeyUp(0x39);
+        p.PreProcess();
+        table->Evaluate(p.keyboard, p.mouse, p.joysticks, p.joystickCount);
+        if (table->GetState(jump) != (INPUT_ACTION_PRESSED | INPUT_ACTION_RELEASED)) ++failures; // Tap
+        if (table->GetState(brake) != INPUT_ACTION_RELEASED) ++failures;
+        p.PostProcess();
+    }
+    delete table;
+    backend->Release();
+    return failures;
+}
+
+// Combos: sequences across devices, chords in any order, windows, interruptions
+static int CheckCombos()
+{
+    int failures = 0;
+    InputComboSet set;
+    DWORD dash[] = {InputComboKey(0x1F), InputComboKey(0x20), InputComboMouseButton(0)};
+    DWORD chord[] = {InputComboKey(0x1D), InputComboKey(0x2A), InputComboKey(0x25)};
+    DWORD pad[] = {InputComboJoystickButton(0, 0), InputComboJoystickButton(0, 100)};
+    int dashPattern = set.AddSequence(dash, 3, 200);
+    int chordPattern = set.AddChordPattern(chord, 3, 50);
+    int padPattern = set.AddSequence(pad, 2, 300);
+    set.BeginPattern();
+    set.AddPress(InputComboKey(0x1F), 0);
+    if (set.AddChord(chord, COMBO_MAX_CHORD + 1, 100, 50) || set.EndPattern() != -1) ++failures;
+    if (dashPattern != 0 || chordPattern != 1 || padPattern != 2 || set.GetPatternCount() != 3) ++failures;
+
+    InputComboRecognizer *combos = set.Compile();
+    if (!combos)
+        return failures + 1;
+
+    ScriptedInputBackend *backend = new ScriptedInputBackend;
+    backend->AddJoystick("Combo Pad");
+    {
+        Pipeline p(backend);
+        p.PreProcess();
+        combos->Process(p.keyboard, p.mouse, p.joysticks, p.joystickCount);
+        p.PostProcess();
+
+        // Presses spread over frames, releases in between
+        backend->KeyDown(0x1F);
+        backend->AdvanceTime(40);
+        backend->KeyUp(0x1F);
+        p.PreProcess();
+        combos->Process(p.keyboard, p.mouse, p.joysticks, p.joystickCount);
+        p.PostProcess();
+        backend->KeyDown(0x20);
+        backend->AdvanceTime(60);
+        backend->MouseButton(0, TRUE);
+        p.PreProcess();
+        if (combos->Process(p.keyboard, p.mouse, p.joysticks, p.joystickCount) != 2) ++failures;
+        const InputComboMatch *match = combos->GetMatch(0);
+        if (combos->GetMatchCount() != 1 || !combos->IsMatched(dashPattern) || !match) ++failures;
+        if (match && match->End - match->Start != 100000) ++failures;
+        p.PostProcess();
+        backend->KeyUp(0x20);
+        backend->MouseButton(0, FALSE);
+
+        // Too slow, then interrupted
+        backend->KeyDown(0x1F);
+        backend->AdvanceTime(250);
+        backend->KeyDown(0x20);
+        backend->AdvanceTime(10);
+        backend->MouseButton(0, TRUE);
+        backend->AdvanceTime(10);
+        backend->KeyDown(0x1F);
+        backend->KeyDown(0x2D);
+        backend->KeyDown(0x20);
+        backend->MouseButton(0, FALSE);
+        backend->MouseButton(0, TRUE);
+        p.PreProcess();
+        combos->Process(p.keyboard, p.mouse, p.joysticks, p.joystickCount);
+        if (combos->GetMatchCount() != 0) ++failures;
+        p.PostProcess();
+        backend->KeyUp(0x1F);
+        backend->KeyUp(0x20);
+        backend->KeyUp(0x2D);
+        backend->MouseButton(0, FALSE);
+
+        // Chord in another order
+        backend->AdvanceTime(500);
+        backend->KeyDown(0x25);
+        backend->AdvanceTime(20);
+        backend->KeyDown(0x1D);
+        backend->AdvanceTime(20);
+        backend->KeyDown(0x2A);
+        p.PreProcess();
+        combos->Process(p.keyboard, p.mouse, p.joysticks, p.joystickCount);
+        if (!combos->IsMatched(chordPattern) || combos->IsMatched(dashPattern)) ++failures;
+        p.PostProcess();
+        backend->KeyUp(0x25);
+        backend->KeyUp(0x1D);
+        backend->KeyUp(0x2A);
+
+        // Joystick button edges
+        DIJOYSTATE2 state;
+        memset(&state, 0, sizeof(state));
+        state.rgdwPOV[0] = 0xFFFFFFFF;
+        state.rgbButtons[0] = 0x80;
+        backend->SetJoystickState(0, state);
+        backend->AdvanceTime(16);
+        p.PreProcess();
+        combos->Process(p.keyboard, p.mouse, p.joysticks, p.joystickCount);
+        p.PostProcess();
+        state.rgbButtons[100] = 0x80;
+        backend->SetJoystickState(0, state);
+        backend->AdvanceTime(16);
+        p.PreProcess();
+        combos->Process(p.keyboard, p.mouse, p.joysticks, p.joystickCount);
+        if (!combos->IsMatched(padPattern) || combos->GetMatchCount() != 1) ++failures;
+        p.PostProcess();
+    }
+    delete combos;
+    backend->Release();
+
+    // A pattern on the second joystick only polls and matches that joystick
+    {
+        InputComboSet second;
+        DWORD buttons[] = {InputComboJoystickButton(1, 5), InputComboJoystickButton(1, 101)};
+        int secondPattern = second.AddSequence(buttons, 2, 300);
+        combos = second.Compile();
+        if (!combos)
+            return failures + 1;
+        backend = new ScriptedInputBackend;
+        backend->AddJoystick("Combo Pad 0");
+        backend->AddJoystick("Combo Pad 1");
+        {
+            Pipeline p(backend);
+            DIJOYSTATE2 state;
+            memset(&state, 0, sizeof(state));
+            state.rgdwPOV[0] = 0xFFFFFFFF;
+            state.rgbButtons[5] = 0x80;
+            backend->SetJoystickState(1, state);
+            backend->AdvanceTime(16);
+            p.PreProcess();
+            if (combos->Process(p.keyboard, p.mouse, p.joysticks, p.joystickCount) != 1) ++failures;
+            p.PostProcess();
+            state.rgbButtons[101] = 0x80;
+            backend->SetJoystickState(1, state);
+            backend->AdvanceTime(16);
+            p.PreProcess();
+            if (combos->Process(p.keyboard, p.mouse, p.joysticks, p.joystickCount) != 1) ++failures;
+            if (!combos->IsMatched(secondPattern) || combos->GetMatchCount() != 1) ++failures;
+            p.PostProcess();
+        }
+        delete combos;
+        backend->Release();
+    }
+
+    // The automaton stays one lookup per press whatever the number of patterns
+    set.Clear();
+    for (DWORD i = 0; i < COMBO_MAX_PATTERNS; i++)
+    {
+        DWORD keys[4] = {0x10 + (i & 7), 0x10 + ((i >> 3) & 7), 0x20 + (i % 5), 0x2C};
+        set.AddSequence(keys, 4, 500);
+    }
+    combos = set.Compile();
+    if (!combos || combos->GetPatternCount() != COMBO_MAX_PATTERNS) ++failures;
+    if (combos)
+    {
+        DWORD keys[] = {0x10, 0x11, 0x2D, 0x23, 0x2C}; // Pattern 8 broken by a press in no pattern
+        for (int i = 0; i < 5; i++)
+            combos->Feed(InputComboKey(keys[i]), (InputTime)i * 1000);
+        if (combos->GetMatchCount() != 0) ++failures;
+        DWORD hit[] = {0x13, 0x12, 0x24, 0x2C}; // Pattern 19: 19 & 7 = 3, 19 >> 3 = 2, 19 % 5 = 4
+        for (int i = 0; i < 4; i++)
+            combos->Feed(InputComboKey(hit[i]), (InputTime)(10 + i) * 1000);
+        if (combos->GetMatchCount() != 1 || combos->GetMatch(0)->Pattern != 19) ++failures;
+        delete combos;
+    }
+    return failures;
+}
+
+// Buffered-only mouse: the events alone give motion, wheel and buttons in one device call
+static int CheckBufferedMouse()
+{
+    ScriptedInputBackend *backend = new ScriptedInputBackend;
+    ScriptedInputDevice *device = backend->GetMouse();
+    int failures = 0;
+    {
+        Pipeline p(backend);
+        p.PreProcess();
+        p.PostProcess();
+        backend->MouseMove(7, 9);
+        p.PreProcess();
+        p.PostProcess();
+
+        p.mouse.SetBufferedOnly(TRUE);
+        p.mouse.SetCursorSource(INPUT_CURSOR_MOTION);
+        DWORD dataReads = device->GetDataReadCount();
+        DWORD stateReads = device->GetStateReadCount();
+        DWORD cursorQueries = backend->GetCursorQueryCount();
+        backend->MouseMove(5, -3, 120);
+        backend->MouseButton(1, TRUE);
+        backend->MouseMove(2, 1);
+        p.PreProcess();
+        const DIMOUSESTATE &state = p.mouse.GetState();
+        if (state.lX != 7 || state.lY != -2 || state.lZ != 120 || state.rgbButtons[1] != INPUT_KS_PRESSED) ++failures;
+        if (p.mouse.GetPosition()[0] != 14.0f || p.mouse.GetPosition()[1] != 7.0f) ++failures;
+        if (device->GetDataReadCount() != dataReads + 1 || device->GetStateReadCount() != stateReads) ++failures;
+        if (backend->GetCursorQueryCount() != cursorQueries) ++failures;
+        p.PostProcess();
+
+        // A burst larger than the event buffer of a frame is drained in full
+        device->SetBufferSize(1024);
+        for (int i = 0; i < 600; i++)
+            backend->MouseMove(1, 0);
+        p.PreProcess();
+        if (p.mouse.GetState().lX != 600 || p.mouse.GetState().lY != 0 || p.mouse.GetEventCount() != MOUSE_BUFFER_SIZE) ++failures;
+        if (device->GetPendingEvents() != 0) ++failures;
+        p.PostProcess();
+        p.PreProcess();
+        if (p.mouse.GetState().lX != 0 || p.mouse.GetState().rgbButtons[1] != INPUT_KS_PRESSED) ++failures;
+        p.PostProcess();
+
+        // The cursor is queried again every second poll, or only fed
+        p.mouse.SetCursorSource(INPUT_CURSOR_MOTION, 2);
+        backend->MouseMove(1, 1);
+        p.PreProcess();
+        p.PostProcess();
+        backend->SetCursorPos(300, 400);
+        p.PreProcess();
+        if (p.mouse.GetPosition()[0] != 300.0f || p.mouse.GetPosition()[1] != 400.0f) ++failures;
+        p.PostProcess();
+        p.mouse.SetCursorSource(INPUT_CURSOR_FED);
+        p.mouse.SetCursorPosition(10.0f, 20.0f);
+        backend->MouseMove(4, 4);
+        p.PreProcess();
+        if (p.mouse.GetPosition()[0] != 10.0f || p.mouse.GetPosition()[1] != 20.0f || p.mouse.GetState().lX != 4) ++failures;
+        p.PostProcess();
+
+        // Back to the default mode, the immediate state gives the motion again
+        p.mouse.SetBufferedOnly(FALSE);
+        p.mouse.SetCursorSource(INPUT_CURSOR_QUERY);
+        stateReads = device->GetStateReadCount();
+        backend->MouseMove(-6, 2);
+        p.PreProcess();
+        if (p.mouse.GetState().lX != -6 || device->GetStateReadCount() != stateReads + 1) ++failures;
+        p.PostProcess();
+    }
+    backend->Release();
+    return failures;
+}
+
+static LONG SumMotion(const InputMotionHistory &history, int axis)
+{
+    LONG sum = 0;
+    for (int i = 0; i < history.GetCount(); i++)
+        sum += history.GetSample(i).Delta[axis];
+    return sum;
+}
+
+static int CheckMotionHistory()
+{
+    ScriptedInputBackend *backend = new ScriptedInputBackend;
+    ScriptedInputDevice *device = backend->GetMouse();
+    int failures = 0;
+    {
+        Pipeline p(backend);
+        InputMotionHistory history;
+        if (history.Configure(0) || !history.Configure(8000, 60) || history.GetCapacity() != 135) ++failures;
+        device->SetBufferSize(history.GetDeviceBufferSize());
+        p.mouse.SetMotionHistory(&history);
+        p.PreProcess();
+        p.PostProcess();
+
+        // One sample per report, X and Y of a report together
+        for (int i = 0; i < 100; i++)
+        {
+            backend->AdvanceTime(1);
+            backend->MouseMove(1, 2);
+        }
+        backend->MouseMove(0, 0, 120);
+        p.PreProcess();
+        if (history.GetCount() != 101 || history.GetCoalescedCount() != 0) ++failures;
+        if (history.GetSample(0).Delta[0] != 1 || history.GetSample(0).Delta[1] != 2 || history.GetSample(0).Reports != 1) ++failures;
+        if (history.GetSample(100).Delta[2] != 120 || history.GetSample(100).Delta[0] != 0) ++failures;
+        for (int i = 1; i < history.GetCount(); i++)
+        {
+            if (history.GetSample(i).Time < history.GetSample(i - 1).Time) ++failures;
+        }
+        if (history.GetSample(99).Time - history.GetSample(0).Time != 99000) ++failures;
+        if (SumMotion(history, 0) != p.mouse.GetState().lX || SumMotion(history, 1) != p.mouse.GetState().lY) ++failures;
+        p.PostProcess();
+
+        // More reports than the ring holds: the default mode drains them all, and they are summed into the last sample
+        device->SetBufferSize(1024);
+        for (int i = 0; i < 300; i++)
+            backend->MouseMove(1, -1);
+        p.PreProcess();
+        if (device->GetPendingEvents() != 0 || p.mouse.GetState().lX != 300) ++failures;
+        if (history.GetCount() != 135 || history.GetReportCount() != 300 || history.GetCoalescedCount() != 165) ++failures;
+        if (history.GetSample(134).Reports != 166 || SumMotion(history, 0) != 300 || SumMotion(history, 1) != -300) ++failures;
+        p.PostProcess();
+
+        // Latest: the path keeps its last samples
+        history.SetCoalescing(INPUT_MOTION_LATEST);
+        for (int i = 1; i <= 300; i++)
+            backend->MouseMove(i, 0);
+        p.PreProcess();
+        if (history.GetCount() != 135 || history.GetSample(0).Delta[0] != 166 || history.GetSample(134).Delta[0] != 300) ++failures;
+        p.PostProcess();
+
+        // Decimate: the frame ends with evenly spread samples
+        history.SetCoalescing(INPUT_MOTION_DECIMATE, 10);
+        for (int i = 0; i < 300; i++)
+            backend->MouseMove(1, 0);
+        p.PreProcess();
+        if (history.GetCount() != 10 || SumMotion(history, 0) != 300 || history.GetCoalescedCount() != 290) ++failures;
+        for (int i = 0; i < history.GetCount(); i++)
+        {
+            if (history.GetSample(i).Reports < 20 || history.GetSample(i).Reports > 40) ++failures;
+        }
+        InputMotionSample path[4];
+        if (history.GetSamples(path, 4) != 4 || path[3].Reports != history.GetSample(3).Reports) ++failures;
+        p.PostProcess();
+
+        // A paused poll reads nothing into the history
+        backend->MouseMove(5, 5);
+        p.mouse.Poll(TRUE);
+        if (history.GetCount() != 0) ++failures;
+        p.mouse.SetMotionHistory(NULL);
+    }
+    backend->Release();
+    return failures;
+}
+
+static BOOL Near(float value, float expected, float tolerance)
+{
+    return value >= expected - tolerance && value <= expected + tolerance;
+}
+
+static int CheckMotionFilter()
+{
+    int failures = 0;
+    InputMotionFilter filter;
+    float in[2] = {12.0f, -3.0f};
+    float out[2];
+    filter.Apply(in, 1000, out);
+    if (out[0] != 12.0f || out[1] != -3.0f) ++failures;
+
+    // Exponential: a step decays by exp(-1) after one time constant, whatever the frame rate
+    InputMotionFilter fast;
+    if (filter.AddExponential(10.0f) != 0 || fast.AddExponential(10.0f) != 0 || filter.AddExponential(0.0f) != -1) ++failures;
+    InputTime time = 0;
+    float step[2] = {100.0f, 0.0f};
+    float half[2] = {50.0f, 0.0f};
+    float zero[2] = {0.0f, 0.0f};
+    filter.Reset();
+    filter.Apply(zero, time, out);
+    fast.Apply(zero, time, out);
+    filter.Apply(step, time += 10000, out);
+    if (!Near(out[0], 100.0f * 0.63212f, 0.01f)) ++failures;
+    fast.Apply(half, 5000, out);
+    fast.Apply(half, 10000, out);
+    if (!Near(out[0] * 2.0f, 100.0f * 0.63212f, 0.01f)) ++failures;
+    filter.Apply(zero, time += 10000, out);
+    if (!Near(out[0], 100.0f * 0.63212f * 0.36788f, 0.01f)) ++failures;
+    fast.Apply(zero, 15000, out);
+    fast.Apply(zero, 20000, out);
+    if (!Near(out[0] * 2.0f, 100.0f * 0.63212f * 0.36788f, 0.01f)) ++failures;
+
+    // One Euro: jitter at rest is damped, a fast steady motion goes through with little lag
+    InputMotionFilter euro;
+    if (euro.AddOneEuro(1.0f, 0.01f) != 0) ++failures;
+    float jitter = 0.0f;
+    time = 0;
+    for (int i = 0; i < 120; i++)
+    {
+        float sample[2] = {(i & 1) ? 1.0f : -1.0f, 0.0f};
+        euro.Apply(sample, time += 16667, out);
+        if (i >= 60 && out[0] * out[0] > jitter * jitter)
+            jitter = out[0];
+    }
+    if (!(jitter * jitter < 0.25f)) ++failures;
+    float sum = 0.0f;
+    for (int i = 0; i < 120; i++)
+    {
+        float sample[2] = {200.0f, -100.0f};
+        euro.Apply(sample, time += 16667, out);
+        sum += out[0];
+        if (i == 119 && (!Near(out[0], 200.0f, 2.0f) || !Near(out[1], -100.0f, 1.0f))) ++failures;
+    }
+    if (!Near(sum, 120 * 200.0f, 200.0f)) ++failures;
+
+    // Curve: the gain follows the speed, linear between the points
+    InputMotionFilter curve;
+    float speeds[3] = {0.0f, 1000.0f, 5000.0f};
+    float gains[3] = {1.0f, 1.0f, 2.0f};
+    float bad[3] = {0.0f, 1000.0f, 1000.0f};
+    if (curve.AddCurve(speeds, bad, 3) != 0 || curve.AddCurve(bad, gains, 3) != -1) ++failures;
+    curve.Clear();
+    if (curve.AddCurve(speeds, gains, 3) != 0 || curve.GetStageType(0) != INPUT_FILTER_CURVE) ++failures;
+    float motion[2] = {30.0f, 0.0f};
+    curve.Apply(motion, 10000, out);
+    curve.Apply(motion, 20000, out);
+    if (!Near(out[0], 45.0f, 0.01f)) ++failures;
+    motion[0] = 5.0f;
+    curve.Apply(motion, 30000, motion);
+    if (!Near(motion[0], 5.0f, 0.001f)) ++failures;
+    motion[0] = 100.0f;
+    curve.Apply(motion, 40000, out);
+    if (!Near(out[0], 200.0f, 0.01f)) ++failures;
+
+    for (int i = curve.GetStageCount(); i < MOTION_FILTER_MAX_STAGES; i++)
+        curve.AddExponential(1.0f);
+    if (curve.AddOneEuro(1.0f, 0.0f) != -1 || curve.GetStageCount() != MOTION_FILTER_MAX_STAGES) ++failures;
+    return failures;
+}
+
+// The double precision path InputJoystick::Poll ran before the axis kernel,
+// kept as the reference the kernel must agree with
+static void LegacyNormalizeAxes(const LONG *raw, const BOOL *present, const LONG *mins, const LONG *maxs,
+                                float deadzoneRadius, float gainValue, float *out)
+{
+    double axes[AXIS_KERNEL_AXES];
+    for (int i = 0; i < AXIS_KERNEL_AXES; i++)
+    {
+        double range = (double)maxs[i] - (double)mins[i];
+        if (!present[i] || range == 0.0)
+        {
+            axes[i] = 0.0;
+            continue;
+        }
+        double normalized = ((double)raw[i] - (double)mins[i]) * 2.0 / range - 1.0;
+        axes[i] = (normalized > 1.0) ? 1.0 : ((normalized < -1.0) ? -1.0 : normalized);
+    }
+
+    const double deadzone = (double)deadzoneRadius;
+    static const int pairs[2][2] = {{0, 1}, {3, 4}};
+    for (int p = 0; p < 2; p++)
+    {
+        double &a = axes[pairs[p][0]];
+        double &b = axes[pairs[p][1]];
+        double magnitude = sqrt(a * a + b * b);
+        if (magnitude < deadzone || deadzone >= 1.0)
+        {
+            a = b = 0.0;
+        }
+        else if (magnitude > 0.0)
+        {
+            double scale = (magnitude - deadzone) / (1.0 - deadzone);
+            a = (a / magnitude) * scale;
+            b = (b / magnitude) * scale;
+        }
+    }
+    static const int singles[4] = {2, 5, 6, 7};
+    for (int s = 0; s < 4; s++)
+    {
+        if (fabs(axes[singles[s]]) < deadzone)
+            axes[singles[s]] = 0.0;
+    }
+
+    const double gain = (double)gainValue;
+    for (int i = 0; i < AXIS_KERNEL_AXES; i++)
+    {
+        float value = (float)(axes[i] * gain);
+        out[i] = (value > 1.0f) ? 1.0f : ((value < -1.0f) ? -1.0f : value);
+    }
+}
+
+static LONG NextRandom(DWORD &seed)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return (LONG)(seed >> 8);
+}
+
+static int CheckAxisKernel()
+{
+    int failures = 0;
+    // Symmetric, unsigned 16-bit, signed 16-bit and 8-bit ranges; slider 1 absent
+    const BOOL present[AXIS_KERNEL_AXES] = {TRUE, TRUE, TRUE, TRUE, TRUE, TRUE, TRUE, FALSE};
+    const LONG mins[AXIS_KERNEL_AXES] = {-1000, 0, -32768, 0, -1000, 0, -32768, 0};
+    const LONG maxs[AXIS_KERNEL_AXES] = {1000, 65535, 32767, 255, 1000, 65535, 32767, 255};
+    InputAxisScale scale;
+    for (int i = 0; i < AXIS_KERNEL_AXES; i++)
+        InputAxisScaleSet(scale, i, present[i], mins[i], maxs[i]);
+
+    const float deadzones[4] = {0.0f, 0.01f, 0.25f, 1.0f};
+    const float gains[3] = {1.0f, 0.5f, 2.0f};
+    DWORD seed = 12345;
+    for (int n = 0; n < 20000; n++)
+    {
+        LONG raw[AXIS_KERNEL_AXES];
+        for (int i = 0; i < AXIS_KERNEL_AXES; i++)
+        {
+            // A tenth of the samples sit outside the range, another tenth at rest
+            LONG span = maxs[i] - mins[i];
+            LONG r = NextRandom(seed);
+            if (n % 10 == 0)
+                raw[i] = mins[i] - span / 4 + r % (span + span / 2);
+            else if (n % 10 == 1)
+                raw[i] = mins[i] + span / 2;
+            else
+                raw[i] = mins[i] + r % (span + 1);
+        }
+        float deadzone = deadzones[n & 3];
+        float gain = gains[n % 3];
+        float expected[AXIS_KERNEL_AXES];
+        float actual[AXIS_KERNEL_AXES];
+        LegacyNormalizeAxes(raw, present, mins, maxs, deadzone, gain, expected);
+        InputNormalizeAxes(raw, scale, deadzone, gain, actual);
+        for (int i = 0; i < AXIS_KERNEL_AXES; i++)
+        {
+            if (!Near(actual[i], expected[i], 0.0001f)) ++failures;
+        }
+    }
+
+    // Through the joystick: ranges come from the device, and the scale follows a new range
+    ScriptedInputBackend *backend = new ScriptedInputBackend;
+    ScriptedInputDevice *device = backend->AddJoystick("Axis Pad");
+    device->SetAxisRange(INPUT_AXIS_X, 0, 65535);
+    {
+        Pipeline p(backend);
+        DIJOYSTATE2 state;
+        memset(&state, 0, sizeof(state));
+        state.lX = 65535;
+        state.lY = -1000;
+        state.lRz = 1000;
+        state.rglSlider[1] = 5;
+        state.rgdwPOV[0] = 0xFFFFFFFF;
+        backend->SetJoystickState(0, state);
+        p.PreProcess();
+        p.joysticks[0].Poll();
+        const float *position = p.joysticks[0].GetPosition();
+        // (1, -1) lies beyond the unit circle: the radial deadzone keeps it, the clamp bounds it
+        if (!Near(position[0], 1.0f, 0.0001f) || !Near(position[1], -1.0f, 0.0001f)) ++failures;
+        if (!Near(p.joysticks[0].GetRotation()[2], 1.0f, 0.0001f)) ++failures;
+        if (!Near(p.joysticks[0].GetSliders()[1], 0.0f, 0.0001f)) ++failures;
+
+        device->SetAxisRange(INPUT_AXIS_X, -65535, 65535);
+        p.joysticks[0].GetInfo();
+        state.lY = 0;
+        backend->SetJoystickState(0, state);
+        p.joysticks[0].Invalidate();
+        p.joysticks[0].Poll();
+        if (!Near(p.joysticks[0].GetPosition()[0], 1.0f, 0.0001f)) ++failures;
+        state.lX = 32768;
+        backend->SetJoystickState(0, state);
+        p.joysticks[0].Invalidate();
+        p.joysticks[0].Poll();
+        if (!Near(p.joysticks[0].GetPosition()[0], (32768.0f / 65535.0f - 0.01f) / 0.99f, 0.0001f)) ++failures;
+    }
+    backend->Release();
+    return failures;
+}
+
+// Sign-preserving power curve, as scripts shape the axes today
+static float PowerResponse(float value, float exponent)
+{
+    return (value < 0.0f) ? -powf(-value, exponent) : powf(value, exponent);
+}
+
+// Response curves: the table follows its points without overshoot, and a joystick maps
+// the curved axis through it in place of the gain
+static int CheckResponseCurves()
+{
+    int failures = 0;
+    InputResponseCurve curve;
+    memset(&curve, 0, sizeof(curve));
+
+    const float line[2] = {0.0f, 1.0f};
+    if (!InputResponseCurveCompile(curve, line, line, 2, TRUE)) ++failures;
+    for (int i = -100; i <= 100; i++)
+    {
+        float x = (float)i / 100.0f;
+        if (!Near(InputResponseCurveLookup(curve, x), x, 1e-5f)) ++failures;
+    }
+
+    float px[9], py[9];
+    for (int k = 0; k < 9; k++)
+    {
+        px[k] = (float)k / 8.0f;
+        py[k] = PowerResponse(px[k], 2.2f);
+    }
+    if (!InputResponseCurveCompile(curve, px, py, 9, TRUE)) ++failures;
+    for (int i = 0; i <= 1000; i++)
+    {
+        float x = (float)i / 1000.0f;
+        if (!Near(InputResponseCurveLookup(curve, x), PowerResponse(x, 2.2f), 0.01f)) ++failures;
+        if (InputResponseCurveLookup(curve, -x) != -InputResponseCurveLookup(curve, x)) ++failures;
+    }
+    for (int s = 0; s < RESPONSE_CURVE_SIZE; s++)
+    {
+        if (curve.Table[s + 1] < curve.Table[s]) ++failures;
+    }
+
+    // Flat in the middle, steep at the ends: no overshoot past the flat points
+    const float sx[5] = {-1.0f, -0.5f, 0.0f, 0.5f, 1.0f};
+    const float sy[5] = {-1.0f, -0.1f, 0.0f, 0.1f, 1.0f};
+    if (!InputResponseCurveCompile(curve, sx, sy, 5, FALSE)) ++failures;
+    for (int k = 0; k < 5; k++)
+    {
+        if (!Near(InputResponseCurveLookup(curve, sx[k]), sy[k], 1e-5f)) ++failures;
+    }
+    for (int s = 0; s < RESPONSE_CURVE_SIZE; s++)
+    {
+        if (curve.Table[s + 1] < curve.Table[s]) ++failures;
+    }
+
+    // Invalid points leave the curve as it was
+    const float backwards[3] = {0.0f, 0.6f, 0.4f};
+    const float tooHigh[2] = {0.0f, 1.5f};
+    if (InputResponseCurveCompile(curve, backwards, backwards, 3, TRUE)) ++failures;
+    if (InputResponseCurveCompile(curve, line, tooHigh, 2, TRUE)) ++failures;
+    if (InputResponseCurveCompile(curve, line, line, 1, TRUE)) ++failures;
+    if (InputResponseCurveCompile(curve, sx, sy, 5, TRUE)) ++failures;
+    if (!curve.Enabled || curve.Symmetric || !Near(InputResponseCurveLookup(curve, 0.5f), 0.1f, 1e-5f)) ++failures;
+
+    ScriptedInputBackend *backend = new ScriptedInputBackend;
+    backend->AddJoystick("Curve Pad");
+    {
+        Pipeline p(backend);
+        InputJoystick &joystick = p.joysticks[0];
+        if (!joystick.SetResponseCurve(0, px, py, 9, TRUE) || !joystick.HasResponseCurve(0)) ++failures;
+        if (joystick.SetResponseCurve(AXIS_KERNEL_AXES, px, py, 9, TRUE) || joystick.HasResponseCurve(1)) ++failures;
+        if (!InputResponseCurveCompile(curve, px, py, 9, TRUE)) ++failures;
+
+        InputAxisScale scale;
+        for (int a = 0; a < AXIS_KERNEL_AXES; a++)
+            InputAxisScaleSet(scale, a, TRUE, -1000, 1000);
+        DIJOYSTATE2 state;
+        memset(&state, 0, sizeof(state));
+        state.rgdwPOV[0] = 0xFFFFFFFF;
+        for (int frame = 0; frame < 2; frame++)
+        {
+            if (frame == 1)
+                joystick.ClearResponseCurve(0);
+            for (int i = 0; i < 50; i++)
+            {
+                state.lX = -1000 + i * 41;
+                state.lY = 900 - i * 37;
+                state.lZ = i * 20;
+                backend->SetJoystickState(0, state);
+                p.PreProcess();
+                joystick.Poll();
+                float expected[AXIS_KERNEL_AXES];
+                InputNormalizeAxes(&state.lX, scale, 0.01f, 1.0f, expected);
+                float x = (frame == 0) ? InputResponseCurveLookup(curve, expected[0]) : expected[0];
+                if (!Near(joystick.GetPosition()[0], x, 1e-5f)) ++failures;
+                if (!Near(joystick.GetPosition()[1], expected[1], 1e-5f)) ++failures;
+                if (!Near(joystick.GetPosition()[2], expected[2], 1e-5f)) ++failures;
+                p.PostProcess();
+            }
+        }
+        if (joystick.HasResponseCurve(0)) ++failures;
+    }
+    backend->Release();
+    return failures;
+}
+
+static int CheckJoystickButtons()
+{
+    int failures = 0;
+    ScriptedInputBackend *backend = new ScriptedInputBackend;
+    backend->AddJoystick("Wide Pad", JOYSTICK_BUTTON_COUNT);
+    {
+        Pipeline p(backend);
+        InputJoystick &joystick = p.joysticks[0];
+        DIJOYSTATE2 state;
+        memset(&state, 0, sizeof(state));
+        state.rgdwPOV[0] = 0xFFFFFFFF;
+        state.rgbButtons[3] = 0x80;
+        state.rgbButtons[40] = 0x80;
+        state.rgbButtons[127] = 0x80;
+        backend->SetJoystickState(0, state);
+        p.PreProcess();
+        joystick.Poll();
+        const DWORD *down = joystick.GetButtonMask();
+        if (down[0] != (1u << 3) || down[1] != (1u << 8) || down[2] != 0 || down[3] != 0x80000000u) ++failures;
+        if (joystick.GetButtons() != (1u << 3)) ++failures;
+        if (memcmp(joystick.GetPressedMask(), down, JOYSTICK_BUTTON_WORDS * sizeof(DWORD)) != 0) ++failures;
+        for (int w = 0; w < JOYSTICK_BUTTON_WORDS; w++)
+        {
+            if (joystick.GetReleasedMask()[w] != 0) ++failures;
+        }
+
+        // Held over the next frame: no edges, and the previous frame's mask matches
+        p.PreProcess();
+        joystick.Poll();
+        for (int w = 0; w < JOYSTICK_BUTTON_WORDS; w++)
+        {
+            if (joystick.GetPressedMask()[w] != 0 || joystick.GetReleasedMask()[w] != 0) ++failures;
+            if (joystick.GetLastButtonMask()[w] != joystick.GetButtonMask()[w]) ++failures;
+        }
+
+        state.rgbButtons[40] = 0;
+        state.rgbButtons[64] = 0x80;
+        backend->SetJoystickState(0, state);
+        p.PreProcess();
+        joystick.Poll();
+        if (!KeyMaskTest(joystick.GetPressedMask(), 64) || KeyMaskTest(joystick.GetPressedMask(), 40)) ++failures;
+        if (!KeyMaskTest(joystick.GetReleasedMask(), 40) || joystick.GetReleasedMask()[2] != 0) ++failures;
+        if (!KeyMaskTest(joystick.GetLastButtonMask(), 40) || KeyMaskTest(joystick.GetButtonMask(), 40)) ++failures;
+
+        // A tap between two polls of the same frame shows in both edges
+        p.PreProcess();
+        state.rgbButtons[100] = 0x80;
+        backend->SetJoystickState(0, state);
+        joystick.Poll();
+        state.rgbButtons[100] = 0;
+        backend->SetJoystickState(0, state);
+        joystick.Invalidate();
+        joystick.Poll();
+        if (KeyMaskTest(joystick.GetButtonMask(), 100)) ++failures;
+        if (!KeyMaskTest(joystick.GetPressedMask(), 100) || !KeyMaskTest(joystick.GetReleasedMask(), 100)) ++failures;
+
+        // Injected the way DX8InputManager::SetJoystickButtonDown and Up do it
+        p.PreProcess();
+        joystick.Poll();
+        DWORD buttons[JOYSTICK_BUTTON_WORDS];
+        memcpy(buttons, joystick.GetButtonMask(), sizeof(buttons));
+        KeyMaskSet(buttons, 90);
+        joystick.SetButtons(buttons);
+        KeyMaskReset(buttons, 90);
+        joystick.SetButtons(buttons);
+        if (!KeyMaskTest(joystick.GetPressedMask(), 90) || !KeyMaskTest(joystick.GetReleasedMask(), 90)) ++failures;
+
+        // Actions bind any of the 128 buttons
+        InputActionMap map;
+        int action = map.AddAction("wide");
+        if (!map.Bind(action, INPUT_BIND_JOYSTICK_BUTTON, 0, 127) || map.Bind(action, INPUT_BIND_JOYSTICK_BUTTON, 0, JOYSTICK_BUTTON_COUNT)) ++failures;
+        InputActionTable *table = map.Compile();
+        table->Evaluate(p.keyboard, p.mouse, p.joysticks, p.joystickCount);
+        if ((table->GetStates()[action] & INPUT_ACTION_DOWN) == 0) ++failures;
+        delete table;
+    }
+    backend->Release();
+    return failures;
+}
+
+static int CheckJoystickPoller()
+{
+    int failures = 0;
+    ScriptedInputBackend *backend = new ScriptedInputBackend;
+    for (int i = 0; i < PIPELINE_MAX_JOYSTICKS; i++)
+        backend->AddJoystick(NULL);
+    {
+        Pipeline p(backend);
+        if (p.joystickCount != PIPELINE_MAX_JOYSTICKS) ++failures;
+        InputFrameStats stats;
+        for (int i = 0; i < p.joystickCount; i++)
+            p.joysticks[i].SetFrameStats(&stats);
+
+        // On the calling thread, then over workers, fewer and more than the devices
+        static const int workers[4] = {0, 3, JOYSTICK_POLL_MAX_WORKERS, 1};
+        for (int w = 0; w < 4; w++)
+        {
+            InputJoystickPoller poller;
+            if (!poller.Start(workers[w]) || poller.GetWorkerCount() != workers[w]) ++failures;
+            for (int frame = 0; frame < 200; frame++)
+            {
+                DIJOYSTATE2 state;
+                memset(&state, 0, sizeof(state));
+                state.rgdwPOV[0] = 0xFFFFFFFF;
+                for (int j = 0; j < p.joystickCount; j++)
+                {
+                    state.lX = (frame * 7 + j * 100) % 2000 - 1000;
+                    memset(state.rgbButtons, 0, sizeof(state.rgbButtons));
+                    state.rgbButtons[(frame + j) & 127] = 0x80;
+                    backend->SetJoystickState(j, state);
+                }
+                DWORD reads = 0;
+                for (int j = 0; j < p.joystickCount; j++)
+                    reads += backend->GetJoystick(j)->GetStateReadCount();
+
+                stats.BeginFrame();
+                p.PreProcess();
+                poller.PollAll(p.joysticks, p.joystickCount);
+                const InputFrameCost *cost = stats.GetFrame(0);
+                if (!cost || cost->Stages[INPUT_STAGE_JOYSTICK_POLL].Calls != (DWORD)p.joystickCount) ++failures;
+
+                // The queries of the frame read what the eager polls left
+                for (int j = 0; j < p.joystickCount; j++)
+                {
+                    p.joysticks[j].Poll();
+                    float x = (float)((frame * 7 + j * 100) % 2000 - 1000) / 1000.0f;
+                    if (!Near(p.joysticks[j].GetPosition()[0], x, 0.02f)) ++failures;
+                    if (!KeyMaskTest(p.joysticks[j].GetButtonMask(), (frame + j) & 127)) ++failures;
+                    if (p.joysticks[j].GetPollTicks() <= 0) ++failures;
+                }
+                DWORD after = 0;
+                for (int j = 0; j < p.joystickCount; j++)
+                    after += backend->GetJoystick(j)->GetStateReadCount();
+                if (after - reads != (DWORD)p.joystickCount) ++failures;
+                p.PostProcess();
+            }
+        }
+        for (int i = 0; i < p.joystickCount; i++)
+            p.joysticks[i].SetFrameStats(NULL);
+
+        // A batch growing from one frame to the next, as with hot-plug: each device is
+        // read once per frame, and no read of a batch outlives its PollAll
+        InputJoystickPoller poller;
+        if (!poller.Start(3)) ++failures;
+        for (int frame = 0; frame < 4000; frame++)
+        {
+            int count = 1 + frame % p.joystickCount;
+            DWORD reads[PIPELINE_MAX_JOYSTICKS];
+            for (int j = 0; j < p.joystickCount; j++)
+                reads[j] = backend->GetJoystick(j)->GetStateReadCount();
+            p.PreProcess();
+            poller.PollAll(p.joysticks, count);
+            for (int j = 0; j < p.joystickCount; j++)
+            {
+                if (backend->GetJoystick(j)->GetStateReadCount() - reads[j] != (j < count ? 1u : 0u)) ++failures;
+            }
+            p.PostProcess();
+        }
+    }
+    backend->Release();
+    return failures;
+}
+
+// Asks for a scan and waits up to a second for it; FALSE on timeout
+static BOOL WaitScan(InputJoystickWatcher &watcher)
+{
+    DWORD target = watcher.GetScanCount() + 1;
+    watcher.Rescan();
+    for (int i = 0; i < 1000 && (LONG)(watcher.GetScanCount() - target) < 0; i++)
+        InputSleep(1);
+    return (LONG)(watcher.GetScanCount() - target) >= 0;
+}
+
+// Hot-plug: controllers arriving after start take the next free slot, unplugged ones
+// keep theirs and get it back, and the frame only applies what the watcher prepared
+static int CheckHotPlug()
+{
+    int failures = 0;
+    ScriptedInputBackend *backend = new ScriptedInputBackend;
+    backend->AddJoystick("Pad A");
+    backend->AddJoystick("Pad B");
+    {
+        Pipeline p(backend);
+        InputJoystickWatcher watcher;
+        watcher.SetInterval(0);
+        if (!watcher.Start(backend, NULL, p.joysticks, p.joystickCount, PIPELINE_MAX_JOYSTICKS)) ++failures;
+        if (!WaitScan(watcher) || watcher.HasChanges()) ++failures;
+
+        DIJOYSTATE2 state;
+        memset(&state, 0, sizeof(state));
+        state.rgdwPOV[0] = 0xFFFFFFFF;
+
+        // Opened and characterized off the frame, readable on the frame it is applied
+        backend->AddJoystick("Late Pad", 128);
+        state.lX = 500;
+        state.rgbButtons[100] = 0x80;
+        backend->SetJoystickState(2, state);
+        if (!WaitScan(watcher)) ++failures;
+        p.PreProcess();
+        if (watcher.ApplyChanges(p.joysticks, &p.joystickCount) != 1 || p.joystickCount != 3) ++failures;
+        p.joysticks[2].Poll();
+        if (!p.joysticks[2].IsAttached() || p.joysticks[2].IsDetached()) ++failures;
+        if (p.joysticks[2].GetGUID() != backend->GetJoystick(2)->GetGUID()) ++failures;
+        if (!Near(p.joysticks[2].GetPosition()[0], 0.5f, 0.02f)) ++failures;
+        if (!KeyMaskTest(p.joysticks[2].GetPressedMask(), 100)) ++failures;
+        p.PostProcess();
+
+        // Unplugged while a button is held: released this frame, the slot stays
+        memset(state.rgbButtons, 0, sizeof(state.rgbButtons));
+        state.rgbButtons[3] = 0x80;
+        backend->SetJoystickState(0, state);
+        p.PreProcess();
+        p.joysticks[0].Poll();
+        if (!KeyMaskTest(p.joysticks[0].GetButtonMask(), 3)) ++failures;
+        p.PostProcess();
+        backend->UnplugJoystick(0);
+        if (!WaitScan(watcher)) ++failures;
+        p.PreProcess();
+        if (watcher.ApplyChanges(p.joysticks, &p.joystickCount) != 1 || p.joystickCount != 3) ++failures;
+        if (p.joysticks[0].IsAttached() || !p.joysticks[0].IsDetached()) ++failures;
+        if (!KeyMaskTest(p.joysticks[0].GetReleasedMask(), 3)) ++failures;
+        p.joysticks[0].Poll();
+        if (p.joysticks[0].GetPosition()[0] != 0.0f || p.joysticks[0].GetButtons() != 0) ++failures;
+        for (int i = 1; i < 3; i++)
+        {
+            if (!p.joysticks[i].IsAttached() || p.joysticks[i].GetGUID() != backend->GetJoystick(i)->GetGUID())
+                ++failures;
+        }
+        p.PostProcess();
+
+        // Plugged back: same slot, no other change
+        backend->PlugJoystick(0);
+        state.lX = -500;
+        backend->SetJoystickState(0, state);
+        if (!WaitScan(watcher)) ++failures;
+        p.PreProcess();
+        if (watcher.ApplyChanges(p.joysticks, &p.joystickCount) != 1 || p.joystickCount != 3) ++failures;
+        p.joysticks[0].Poll();
+        if (!p.joysticks[0].IsAttached() || p.joysticks[0].IsDetached()) ++failures;
+        if (!Near(p.joysticks[0].GetPosition()[0], -0.5f, 0.02f)) ++failures;
+        p.PostProcess();
+
+        // Controllers past the last slot are left out
+        for (int i = 0; i < PIPELINE_MAX_JOYSTICKS - 2; i++)
+            backend->AddJoystick(NULL);
+        if (!WaitScan(watcher)) ++failures;
+        if (watcher.ApplyChanges(p.joysticks, &p.joystickCount) != PIPELINE_MAX_JOYSTICKS - 3) ++failures;
+        if (p.joystickCount != PIPELINE_MAX_JOYSTICKS) ++failures;
+        if (!WaitScan(watcher) || watcher.HasChanges()) ++failures;
+
+        // Arrivals not applied when the watcher stops close their device
+        backend->UnplugJoystick(1);
+        if (!WaitScan(watcher)) ++failures;
+        watcher.ApplyChanges(p.joysticks, &p.joystickCount);
+        backend->PlugJoystick(1);
+        if (!WaitScan(watcher) || !watcher.HasChanges() || !backend->GetJoystick(1)->IsOpen()) ++failures;
+        watcher.Stop();
+        if (watcher.HasChanges() || backend->GetJoystick(1)->IsOpen()) ++failures;
+    }
+    backend->Release();
+    return failures;
+}
+
+// Runs frames until the first scan of the watcher is applied; FALSE after two seconds
+static BOOL RunUntilStarted(Pipeline &p, InputJoystickWatcher &watcher)
+{
+    for (int i = 0; i < 2000; i++)
+    {
+        p.PreProcess();
+        watcher.ApplyChanges(p.joysticks, &p.joystickCount);
+        p.PostProcess();
+        // A finished scan has published all of its changes
+        if (watcher.GetScanCount() > 0 && !watcher.HasChanges())
+            return TRUE;
+        InputSleep(1);
+    }
+    return FALSE;
+}
+
+// Deferred startup: the keyboard works from the first frame while the joysticks are
+// opened in parallel, each in the slot of its enumeration order
+static int CheckDeferredStartup()
+{
+    int failures = 0;
+    ScriptedInputBackend *backend = new ScriptedInputBackend;
+    for (int i = 0; i < JOYSTICK_COUNT; i++)
+        backend->AddJoystick(NULL);
+    backend->SetJoystickOpenDelay(20);
+    {
+        Pipeline p(backend, FALSE);
+        InputJoystickWatcher watcher;
+        watcher.SetInterval(0);
+        watcher.SetOpenThreads(JOYSTICK_COUNT);
+        if (!watcher.Start(backend, NULL, p.joysticks, 0, PIPELINE_MAX_JOYSTICKS, TRUE)) ++failures;
+
+        backend->KeyDown(0x1E);
+        p.PreProcess();
+        if (!p.keyboard.IsAttached() || p.keyboard.GetState()[0x1E] != INPUT_KS_PRESSED) ++failures;
+        if (p.joystickCount != 0) ++failures;
+        p.PostProcess();
+        backend->KeyUp(0x1E);
+
+        if (!RunUntilStarted(p, watcher)) ++failures;
+        if (p.joystickCount != JOYSTICK_COUNT) ++failures;
+        for (int i = 0; i < p.joystickCount; i++)
+        {
+            if (!p.joysticks[i].IsAttached() || p.joysticks[i].GetGUID() != backend->GetJoystick(i)->GetGUID())
+                ++failures;
+        }
+
+        DIJOYSTATE2 state;
+        memset(&state, 0, sizeof(state));
+        state.rgdwPOV[0] = 0xFFFFFFFF;
+        state.lY = 250;
+        backend->SetJoystickState(JOYSTICK_COUNT - 1, state);
+        p.PreProcess();
+        p.joysticks[JOYSTICK_COUNT - 1].Poll();
+        if (!Near(p.joysticks[JOYSTICK_COUNT - 1].GetPosition()[1], 0.25f, 0.02f)) ++failures;
+        p.PostProcess();
+    }
+    backend->Release();
+    return failures;
+}
+
+struct SnapshotReader
+{
+    InputSnapshotBuffer *buffer;
+    DWORD firstFrame; // From which the joystick buttons carry the frame number
+    volatile LONG stop;
+    volatile LONG reads;
+    volatile LONG failures;
+};
+
+// Worker side: every snapshot must be self-consistent and frames must never go back
+static void ReadSnapshots(void *arg)
+{
+    SnapshotReader *reader = (SnapshotReader *)arg;
+    DWORD last = 0;
+    while (!InputAtomicLoad(&reader->stop))
+    {
+        InputSnapshotRef snapshot(reader->buffer);
+        if (!snapshot.Get())
+            continue;
+        BOOL consistent = snapshot->Frame >= last;
+        for (DWORD key = 0; key < KEYBOARD_BUFFER_SIZE; key++)
+        {
+            BOOL down = (snapshot->KeyboardState[key] & INPUT_KS_PRESSED) != 0;
+            if (down != KeyMaskTest(snapshot->KeyboardDown, key))
+                consistent = FALSE;
+        }
+        if (snapshot->Frame >= reader->firstFrame && snapshot->Joysticks[0].Buttons[0] != snapshot->Frame)
+            consistent = FALSE;
+        if (!consistent)
+            InputAtomicAdd(&reader->failures, 1);
+        last = snapshot->Frame;
+        InputAtomicAdd(&reader->reads, 1);
+    }
+}
+
+// Snapshots stay unchanged while held, and readers on other threads see whole frames
+static int CheckSnapshots()
+{
+    ScriptedInputBackend *backend = new ScriptedInputBackend;
+    backend->AddJoystick("Snapshot Pad");
+    InputSnapshotBuffer *buffer = new InputSnapshotBuffer;
+    int failures = 0;
+    if (buffer->Acquire() != NULL) ++failures;
+    {
+        Pipeline p(backend);
+        p.PreProcess();
+        p.PostProcess();
+
+        DIJOYSTATE2 state;
+        memset(&state, 0, sizeof(state));
+        state.rgdwPOV[0] = 0xFFFFFFFF;
+        state.rgbButtons[3] = 0x80;
+        state.rgbButtons[70] = 0x80;
+        backend->SetJoystickState(0, state);
+        backend->KeyDown(0x1E);
+        p.PreProcess();
+        if (!buffer->Publish(p.keyboard, p.mouse, p.joysticks, p.joystickCount, backend->GetTime())) ++failures;
+        p.PostProcess();
+        const InputSnapshot *first = buffer->Acquire();
+        if (!first || first->Frame != 1 || first->KeyboardState[0x1E] != INPUT_KS_PRESSED) ++failures;
+        if (first && (!KeyMaskTest(first->KeyboardPressed, 0x1E) || first->JoystickCount != 1 || first->Joysticks[0].Buttons[0] != (1u << 3))) ++failures;
+        if (first && (first->Joysticks[0].Buttons[2] != (1u << 6) || first->Joysticks[0].Pressed[2] != (1u << 6) || first->Joysticks[0].Released[2] != 0)) ++failures;
+
+        backend->KeyUp(0x1E);
+        p.PreProcess();
+        buffer->Publish(p.keyboard, p.mouse, p.joysticks, p.joystickCount, backend->GetTime());
+        p.PostProcess();
+        if (first && (first->KeyboardState[0x1E] != INPUT_KS_PRESSED || KeyMaskTest(first->KeyboardReleased, 0x1E))) ++failures;
+
+        // Every slot held: the publication is skipped and the last snapshot stays current
+        const InputSnapshot *held[INPUT_SNAPSHOT_SLOTS];
+        held[0] = first;
+        for (int i = 1; i < INPUT_SNAPSHOT_SLOTS; i++)
+        {
+            if (i > 1)
+                buffer->Publish(p.keyboard, p.mouse, p.joysticks, p.joystickCount, backend->GetTime());
+            held[i] = buffer->Acquire();
+            if (!held[i] || held[i]->Frame != (DWORD)(i + 1)) ++failures;
+        }
+        if (buffer->Publish(p.keyboard, p.mouse, p.joysticks, p.joystickCount, backend->GetTime()) || buffer->GetSkippedCount() != 1) ++failures;
+        {
+            InputSnapshotRef current(buffer);
+            if (current.Get() != held[INPUT_SNAPSHOT_SLOTS - 1]) ++failures;
+        }
+        for (int i = 0; i < INPUT_SNAPSHOT_SLOTS; i++)
+            buffer->Release(held[i]);
+        if (!buffer->Publish(p.keyboard, p.mouse, p.joysticks, p.joystickCount, backend->GetTime())) ++failures;
+
+        // Two workers reading while frames are published; the joystick buttons carry the frame number
+        SnapshotReader reader;
+        reader.buffer = buffer;
+        reader.firstFrame = buffer->GetPublishedCount() + 1;
+        reader.stop = 0;
+        reader.reads = 0;
+        reader.failures = 0;
+        InputThread workers[2];
+        for (int i = 0; i < 2; i++)
+            workers[i].Start(ReadSnapshots, &reader);
+        for (int frame = 0; frame < 2000; frame++)
+        {
+            DWORD key = 0x10 + (frame & 15);
+            if (frame & 16)
+                backend->KeyUp(key);
+            else
+                backend->KeyDown(key);
+            for (int i = 0; i < 32; i++)
+                state.rgbButtons[i] = ((buffer->GetPublishedCount() + 1) & (1u << i)) ? 0x80 : 0;
+            backend->SetJoystickState(0, state);
+            p.PreProcess();
+            if (!buffer->Publish(p.keyboard, p.mouse, p.joysticks, p.joystickCount, backend->GetTime())) ++failures;
+            p.PostProcess();
+        }
+        // On a single core the readers may not have run yet
+        for (int i = 0; i < 1000 && InputAtomicLoad(&reader.reads) < 2; i++)
+            InputSleep(1);
+        InputAtomicStore(&reader.stop, 1);
+        for (int i = 0; i < 2; i++)
+            workers[i].Join();
+        if (reader.failures != 0 || reader.reads == 0) ++failures;
+    }
+    delete buffer;
+    backend->Release();
+    return failures;
+}
+
+// Waits up to a second for the input thread; FALSE on timeout
+static BOOL WaitDrained(ScriptedInputDevice *device)
+{
+    for (int i = 0; i < 1000 && device->GetPendingEvents() > 0; i++)
+        InputSleep(1);
+    return device->GetPendingEvents() == 0;
+}
+
+static BOOL CountDevices(const InputDeviceInfo *, void *context)
+{
+    ++*(int *)context;
+    return DIENUM_CONTINUE;
+}
+
+static BOOL WaitPasses(ThreadedInputBackend *threaded, DWORD passes)
+{
+    DWORD target = threaded->GetWakeCount() + passes;
+    for (int i = 0; i < 1000 && (LONG)(threaded->GetWakeCount() - target) < 0; i++)
+        InputSleep(1);
+    return (LONG)(threaded->GetWakeCount() - target) >= 0;
+}
+
+// Input thread: a burst far larger than the device buffer is drained as it arrives and
+// reaches the state machine complete and in order; controllers are read by the thread
+static int CheckInputThread()
+{
+    ScriptedInputBackend *script = new ScriptedInputBackend;
+    script->AddJoystick("Threaded Pad");
+    ThreadedInputBackend *threaded = new ThreadedInputBackend(script);
+    threaded->SetPollInterval(1);
+    int failures = 0;
+    {
+        Pipeline p(threaded);
+        if (!threaded->IsRunning()) ++failures;
+        p.PreProcess();
+
+        script->GetKeyboard()->SetBufferSize(4);
+        for (int i = 0; i < 64; i++)
+        {
+            script->KeyDown(0x10 + (i & 7));
+            script->KeyUp(0x10 + (i & 7));
+            if (!WaitDrained(script->GetKeyboard())) ++failures;
+        }
+        p.PreProcess();
+        if (p.keyboard.GetEventCount() != 128 || p.keyboard.GetOverflowCount() != 0) ++failures;
+        for (int i = 0; i < p.keyboard.GetEventCount(); i++)
+        {
+            const DIDEVICEOBJECTDATA &data = p.keyboard.GetEvent(i)->Data;
+            if (data.dwOfs != (DWORD)(0x10 + ((i / 2) & 7)) || ((data.dwData & 0x80) != 0) != ((i & 1) == 0)) ++failures;
+        }
+        p.PostProcess();
+        if (!KeyMaskIsEmpty(p.keyboard.GetDownMask())) ++failures;
+        script->GetKeyboard()->SetBufferSize(KEYBOARD_BUFFER_SIZE);
+
+        // A lost keyboard is reported once the queue is empty and reacquired by the state machine
+        script->GetKeyboard()->Lose();
+        if (!WaitPasses(threaded, 2)) ++failures;
+        p.PreProcess();
+        p.PostProcess();
+        script->KeyDown(0x1E);
+        if (!WaitDrained(script->GetKeyboard())) ++failures;
+        p.PreProcess();
+        if (p.keyboard.GetState()[0x1E] != INPUT_KS_PRESSED) ++failures;
+        p.PostProcess();
+        script->KeyUp(0x1E);
+        if (!WaitDrained(script->GetKeyboard())) ++failures;
+        p.PreProcess();
+        p.PostProcess();
+
+        DIJOYSTATE2 state;
+        memset(&state, 0, sizeof(state));
+        state.lX = 1000;
+        state.rgdwPOV[0] = 0xFFFFFFFF;
+        state.rgbButtons[5] = 0x80;
+        script->SetJoystickState(0, state);
+        if (!WaitPasses(threaded, 2)) ++failures;
+        p.PreProcess();
+        p.joysticks[0].Poll();
+        if (p.joysticks[0].GetPosition()[0] < 0.99f) ++failures;
+        if (p.joysticks[0].GetButtons() != (1u << 5)) ++failures;
+    }
+    threaded->Release();
+
+    // Turning the thread off hands the wrapped backend back still usable
+    script = new ScriptedInputBackend;
+    script->AddJoystick("Detached Pad");
+    threaded = new ThreadedInputBackend(script);
+    if (FAILED(threaded->Initialize(NULL))) ++failures;
+    if (threaded->DetachBackend() != script || threaded->IsRunning()) ++failures;
+    threaded->Release();
+    int found = 0;
+    if (FAILED(script->EnumJoysticks(CountDevices, &found)) || found != 1) ++failures;
+    script->Shutdown();
+    script->Release();
+
+    // Startup with controllers that take STARTUP_OPEN_DELAY ms each to open: until the
+    // first frame, then until every joystick is attached
+    {
+        int startupIterations = 10;
+        ScriptedInputBackend *slow = new ScriptedInputBackend;
+        for (int i = 0; i < JOYSTICK_COUNT; i++)
+            slow->AddJoystick(NULL);
+        slow->SetJoystickOpenDelay(STARTUP_OPEN_DELAY);
+
+        double start = BenchNow();
+        for (int i = 0; i < startupIterations; i++)
+        {
+            Pipeline p(slow);
+            p.PreProcess();
+            BenchConsume(p.joystickCount);
+        }
+        BenchReport("startup to first frame, inline", BenchNow() - start, startupIterations);
+
+        for (int threads = 1; threads <= JOYSTICK_COUNT; threads += JOYSTICK_COUNT - 1)
+        {
+            double firstFrame = 0.0;
+            start = BenchNow();
+            for (int i = 0; i < startupIterations; i++)
+            {
+                double begin = BenchNow();
+                Pipeline p(slow, FALSE);
+                InputJoystickWatcher watcher;
+                watcher.SetInterval(0);
+                watcher.SetOpenThreads(threads);
+                watcher.Start(slow, NULL, p.joysticks, 0, PIPELINE_MAX_JOYSTICKS, TRUE);
+                p.PreProcess();
+                p.PostProcess();
+                firstFrame += BenchNow() - begin;
+                RunUntilStarted(p, watcher);
+                BenchConsume(p.joystickCount);
+            }
+            double ready = BenchNow() - start;
+            BenchReport(threads > 1 ? "startup to first frame, deferred x4" : "startup to first frame, deferred", firstFrame, startupIterations);
+            BenchReport(threads > 1 ? "startup to joysticks, deferred x4" : "startup to joysticks, deferred", ready, startupIterations);
+        }
+        slow->Release();
+    }
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = BenchIterations(argc, argv, 200000);
+
+    int failures = CheckStateMachine();
+    if (failures != 0)
+    {
+        printf("state machine check failed (%d)\n", failures);
+        return 1;
+    }
+    failures = CheckJournal();
+    if (failures != 0)
+    {
+        printf("journal check failed (%d)\n", failures);
+        return 1;
+    }
+    failures = CheckActionMap();
+    if (failures != 0)
+    {
+        printf("action map check failed (%d)\n", failures);
+        return 1;
+    }
+    failures = CheckCombos();
+    if (failures != 0)
+    {
+        printf("combo check failed (%d)\n", failures);
+        return 1;
+    }
+    failures = CheckBufferedMouse();
+    if (failures != 0)
+    {
+        printf("buffered mouse check failed (%d)\n", failures);
+        return 1;
+    }
+    failures = CheckMotionHistory();
+    if (failures != 0)
+    {
+        printf("motion history check failed (%d)\n", failures);
+        return 1;
+    }
+    failures = CheckMotionFilter();
+    if (failures != 0)
+    {
+        printf("motion filter check failed (%d)\n", failures);
+        return 1;
+    }
+    failures = CheckAxisKernel();
+    if (failures != 0)
+    {
+        printf("axis kernel check failed (%d)\n", failures);
+        return 1;
+    }
+    failures = CheckResponseCurves();
+    if (failures != 0)
+    {
+        printf("response curve check failed (%d)\n", failures);
+        return 1;
+    }
+    failures = CheckJoystickButtons();
+    if (failures != 0)
+    {
+        printf("joystick button check failed (%d)\n", failures);
+        return 1;
+    }
+    failures = CheckJoystickPoller();
+    if (failures != 0)
+    {
+        printf("joystick poller check failed (%d)\n", failures);
+        return 1;
+    }
+    failures = CheckJournalPolledEagerly();
+    if (failures != 0)
+    {
+        printf("eager poll journal check failed (%d)\n", failures);
+        return 1;
+    }
+    failures = CheckHotPlug();
+    if (failures != 0)
+    {
+        printf("hot-plug check failed (%d)\n", failures);
+        return 1;
+    }
+    failures = CheckDeferredStartup();
+    if (failures != 0)
+    {
+        printf("deferred startup check failed (%d)\n", failures);
+        return 1;
+    }
+    failures = CheckSnapshots();
+    if (failures != 0)
+    {
+        printf("snapshot check failed (%d)\n", failures);
+        return 1;
+    }
+    failures = CheckInputThread();
+    if (failures != 0)
+    {
+        printf("input thread check failed (%d)\n", failures);
+        return 1;
+    }
+
+    ScriptedInputBackend *backend = new ScriptedInputBackend;
+    for (int i = 0; i < JOYSTICK_COUNT; i++)
+        backend->AddJoystick(NULL);
+
+    {
+        Pipeline p(backend);
+        p.PreProcess();
+
+        double start = BenchNow();
+        for (int i = 0; i < iterations; i++)
+        {
+            p.PreProcess();
+            p.PostProcess();
+        }
+        BenchReport("idle frame", BenchNow() - start, iterations);
+
+        // Keyboard alone once a burst of typing is over: the active list is empty
+        for (DWORD key = 0x10; key < 0x30; key++)
+            backend->KeyDown(key);
+        p.PreProcess();
+        p.PostProcess();
+        for (DWORD key = 0x10; key < 0x30; key++)
+            backend->KeyUp(key);
+        p.PreProcess();
+        p.PostProcess();
+        start = BenchNow();
+        for (int i = 0; i < iterations; i++)
+        {
+            p.keyboard.Poll(FALSE);
+            BenchConsume(p.keyboard.GetActiveKeyCount());
+            p.keyboard.PostProcess();
+        }
+        BenchReport("idle keyboard after typing", BenchNow() - start, iterations);
+
+        start = BenchNow();
+        for (int i = 0; i < iterations; i++)
+        {
+            DWORD key = 0x10 + (i & 15);
+            p.keyboard.SetKey(key, TRUE, i, 0);
+            p.keyboard.Flush();
+            BenchConsume(p.keyboard.GetActiveKeyCount());
+        }
+        BenchReport("key down + flush", BenchNow() - start, iterations);
+
+        start = BenchNow();
+        for (int i = 0; i < iterations; i++)
+        {
+            DWORD key = 0x10 + (i & 0x1F);
+            backend->KeyDown(key);
+            backend->MouseMove(3, -2);
+            p.PreProcess();
+            p.PostProcess();
+            backend->KeyUp(key);
+            p.PreProcess();
+            p.PostProcess();
+        }
+        BenchReport("typing + mouse (2 frames)", BenchNow() - start, iterations);
+
+        p.mouse.SetBufferedOnly(TRUE);
+        p.mouse.SetCursorSource(INPUT_CURSOR_MOTION);
+        start = BenchNow();
+        for (int i = 0; i < iterations; i++)
+        {
+            DWORD key = 0x10 + (i & 0x1F);
+            backend->KeyDown(key);
+            backend->MouseMove(3, -2);
+            p.PreProcess();
+            p.PostProcess();
+            backend->KeyUp(key);
+            p.PreProcess();
+            p.PostProcess();
+        }
+        BenchReport("typing + mouse, buffered-only mouse", BenchNow() - start, iterations);
+        p.mouse.SetBufferedOnly(FALSE);
+        p.mouse.SetCursorSource(INPUT_CURSOR_QUERY);
+
+        // An 8 kHz mouse at 60 Hz: 133 reports per frame
+        InputMotionHistory history;
+        history.Configure(8000, 60);
+        backend->GetMouse()->SetBufferSize(history.GetDeviceBufferSize());
+        p.mouse.SetMotionHistory(&history);
+        p.mouse.SetBufferedOnly(TRUE);
+        start = BenchNow();
+        for (int i = 0; i < iterations / 10; i++)
+        {
+            for (int r = 0; r < 133; r++)
+                backend->MouseMove(1, -1);
+            p.PreProcess();
+            p.PostProcess();
+        }
+        BenchReport("133 mouse reports, motion history", BenchNow() - start, iterations / 10);
+        p.mouse.SetBufferedOnly(FALSE);
+        p.mouse.SetMotionHistory(NULL);
+        backend->GetMouse()->SetBufferSize(MOUSE_BUFFER_SIZE);
+
+        // The manager runs its mouse filter after the polls
+        InputMotionFilter filter;
+        float speeds[4] = {0.0f, 500.0f, 2000.0f, 8000.0f};
+        float gains[4] = {0.5f, 1.0f, 1.5f, 2.0f};
+        filter.AddExponential(8.0f);
+        filter.AddOneEuro(1.0f, 0.007f);
+        filter.AddCurve(speeds, gains, 4);
+        float filtered[2];
+        start = BenchNow();
+        for (int i = 0; i < iterations; i++)
+        {
+            backend->MouseMove(3 + (i & 7), -2);
+            backend->AdvanceTime(16);
+            p.PreProcess();
+            float motion[2] = {(float)p.mouse.GetState().lX, (float)p.mouse.GetState().lY};
+            filter.Apply(motion, p.mouse.GetTime(), filtered);
+            p.PostProcess();
+        }
+        BenchReport("mouse + filter chain", BenchNow() - start, iterations);
+
+        // Joystick axes alone: the double precision scalar path against the kernel
+        {
+            const BOOL present[AXIS_KERNEL_AXES] = {TRUE, TRUE, TRUE, TRUE, TRUE, TRUE, TRUE, TRUE};
+            const LONG mins[AXIS_KERNEL_AXES] = {0, 0, 0, 0, 0, 0, 0, 0};
+            const LONG maxs[AXIS_KERNEL_AXES] = {65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535};
+            InputAxisScale scale;
+            for (int a = 0; a < AXIS_KERNEL_AXES; a++)
+                InputAxisScaleSet(scale, a, present[a], mins[a], maxs[a]);
+            LONG raw[64][AXIS_KERNEL_AXES];
+            DWORD seed = 1;
+            for (int n = 0; n < 64; n++)
+            {
+                for (int a = 0; a < AXIS_KERNEL_AXES; a++)
+                    raw[n][a] = NextRandom(seed) & 0xFFFF;
+            }
+            float axes[AXIS_KERNEL_AXES];
+            start = BenchNow();
+            for (int i = 0; i < iterations; i++)
+            {
+                LegacyNormalizeAxes(raw[i & 63], present, mins, maxs, 0.01f, 1.0f, axes);
+                BenchConsume((unsigned int)(axes[0] * 1000.0f));
+            }
+            BenchReport("8 joystick axes, scalar", BenchNow() - start, iterations);
+            start = BenchNow();
+            for (int i = 0; i < iterations; i++)
+            {
+                InputNormalizeAxes(raw[i & 63], scale, 0.01f, 1.0f, axes);
+                BenchConsume((unsigned int)(axes[0] * 1000.0f));
+            }
+            BenchReport("8 joystick axes, kernel", BenchNow() - start, iterations);
+
+            // Shaped by a power curve: per frame in script, then through compiled tables
+            start = BenchNow();
+            for (int i = 0; i < iterations; i++)
+            {
+                InputNormalizeAxes(raw[i & 63], scale, 0.01f, 1.0f, axes);
+                for (int a = 0; a < AXIS_KERNEL_AXES; a++)
+                    axes[a] = PowerResponse(axes[a], 2.2f);
+                BenchConsume((unsigned int)(axes[0] * 1000.0f));
+            }
+            BenchReport("8 joystick axes, kernel + powf", BenchNow() - start, iterations);
+            InputResponseCurve curves[AXIS_KERNEL_AXES];
+            float px[9], py[9];
+            for (int k = 0; k < 9; k++)
+            {
+                px[k] = (float)k / 8.0f;
+                py[k] = PowerResponse(px[k], 2.2f);
+            }
+            for (int a = 0; a < AXIS_KERNEL_AXES; a++)
+                InputResponseCurveCompile(curves[a], px, py, 9, TRUE);
+            start = BenchNow();
+            for (int i = 0; i < iterations; i++)
+            {
+                InputNormalizeAxes(raw[i & 63], scale, 0.01f, 1.0f, axes);
+                for (int a = 0; a < AXIS_KERNEL_AXES; a++)
+                    axes[a] = InputResponseCurveLookup(curves[a], axes[a]);
+                BenchConsume((unsigned int)(axes[0] * 1000.0f));
+            }
+            BenchReport("8 joystick axes, kernel + curves", BenchNow() - start, iterations);
+        }
+
+        InputFrameStats stats;
+        p.keyboard.SetFrameStats(&stats);
+        p.mouse.SetFrameStats(&stats);
+        start = BenchNow();
+        for (int i = 0; i < iterations; i++)
+        {
+            DWORD key = 0x10 + (i & 0x1F);
+            backend->KeyDown(key);
+            backend->MouseMove(3, -2);
+            stats.BeginFrame();
+            p.PreProcess();
+            p.PostProcess();
+            backend->KeyUp(key);
+            stats.BeginFrame();
+            p.PreProcess();
+            p.PostProcess();
+        }
+        BenchReport("typing + mouse, frame stats", BenchNow() - start, iterations);
+        p.keyboard.SetFrameStats(NULL);
+        p.mouse.SetFrameStats(NULL);
+
+        // 64 actions: 48 keys, 4 mouse buttons, then a button and an axis on every joystick
+        InputActionMap map;
+        char name[16];
+        for (int a = 0; a < 64; a++)
+        {
+            sprintf(name, "action%d", a);
+            int action = map.AddAction(name);
+            if (a < 48)
+                map.Bind(action, INPUT_BIND_KEY, 0, 0x10 + a);
+            else if (a < 52)
+                map.Bind(action, INPUT_BIND_MOUSE_BUTTON, 0, a - 48);
+            else
+                map.Bind(action, (a & 1) ? INPUT_BIND_JOYSTICK_AXIS : INPUT_BIND_JOYSTICK_BUTTON, (a - 52) % JOYSTICK_COUNT, a & 7);
+        }
+        InputActionTable *table = map.Compile();
+        start = BenchNow();
+        for (int i = 0; i < iterations; i++)
+        {
+            DWORD key = 0x10 + (i & 0x1F);
+            backend->KeyDown(key);
+            backend->MouseMove(3, -2);
+            p.PreProcess();
+            table->Evaluate(p.keyboard, p.mouse, p.joysticks, p.joystickCount);
+            BenchConsume(table->GetStates()[i & 63]);
+            p.PostProcess();
+            backend->KeyUp(key);
+            p.PreProcess();
+            table->Evaluate(p.keyboard, p.mouse, p.joysticks, p.joystickCount);
+            BenchConsume(table->GetStates()[i & 63]);
+            p.PostProcess();
+        }
+        BenchReport("typing + mouse, 64 actions", BenchNow() - start, iterations);
+        delete table;
+
+        InputComboSet set;
+        for (DWORD c = 0; c < COMBO_MAX_PATTERNS; c++)
+        {
+            DWORD keys[4] = {0x10 + (c & 0x1F), 0x10 + ((c * 7) & 0x1F), 0x10 + ((c * 13) & 0x1F), InputComboMouseButton(c & 1)};
+            set.AddSequence(keys, 4, 250);
+        }
+        InputComboRecognizer *combos = set.Compile();
+        start = BenchNow();
+        for (int i = 0; i < iterations; i++)
+        {
+            DWORD key = 0x10 + (i & 0x1F);
+            backend->KeyDown(key);
+            backend->MouseButton(i & 1, (i & 2) != 0);
+            p.PreProcess();
+            combos->Process(p.keyboard, p.mouse, p.joysticks, p.joystickCount);
+            p.PostProcess();
+            backend->KeyUp(key);
+            backend->AdvanceTime(8);
+            p.PreProcess();
+            combos->Process(p.keyboard, p.mouse, p.joysticks, p.joystickCount);
+            BenchConsume(combos->GetMatchCount());
+            p.PostProcess();
+        }
+        BenchReport("typing + mouse, 128 combos", BenchNow() - start, iterations);
+        delete combos;
+
+        p.keyboard.EnableRepetition(TRUE);
+        for (DWORD key = 0x10; key < 0x18; key++)
+            backend->KeyDown(key);
+        start = BenchNow();
+        for (int i = 0; i < iterations; i++)
+        {
+            backend->AdvanceTime(5);
+            p.PreProcess();
+            BenchConsume(p.keyboard.GetEventCount());
+            p.PostProcess();
+        }
+        BenchReport("8 held keys with repetition", BenchNow() - start, iterations);
+        for (DWORD key = 0x10; key < 0x18; key++)
+            backend->KeyUp(key);
+        p.keyboard.EnableRepetition(FALSE);
+        p.PreProcess();
+        p.PostProcess();
+
+        start = BenchNow();
+        for (int i = 0; i < iterations; i++)
+        {
+            p.PreProcess();
+            for (int j = 0; j < p.joystickCount; j++)
+            {
+                p.joysticks[j].Poll();
+                BenchConsume(p.joysticks[j].GetButtons());
+            }
+            p.PostProcess();
+        }
+        BenchReport("frame + joystick polls", BenchNow() - start, iterations);
+
+        // Eager polls at frame start, on the main thread then shared with two workers
+        for (int workers = 0; workers <= 2; workers += 2)
+        {
+            InputJoystickPoller poller;
+            poller.Start(workers);
+            start = BenchNow();
+            for (int i = 0; i < iterations; i++)
+            {
+                p.PreProcess();
+                poller.PollAll(p.joysticks, p.joystickCount);
+                for (int j = 0; j < p.joystickCount; j++)
+                {
+                    p.joysticks[j].Poll();
+                    BenchConsume(p.joysticks[j].GetButtons());
+                }
+                p.PostProcess();
+            }
+            BenchReport(workers ? "frame + eager joystick polls, 2 workers" : "frame + eager joystick polls", BenchNow() - start, iterations);
+        }
+
+        // Enumeration runs on the watcher thread; the frame only checks for changes
+        {
+            InputJoystickWatcher watcher;
+            watcher.SetInterval(1);
+            watcher.Start(backend, NULL, p.joysticks, p.joystickCount, PIPELINE_MAX_JOYSTICKS);
+            start = BenchNow();
+            for (int i = 0; i < iterations; i++)
+            {
+                p.PreProcess();
+                watcher.ApplyChanges(p.joysticks, &p.joystickCount);
+                for (int j = 0; j < p.joystickCount; j++)
+                {
+                    p.joysticks[j].Poll();
+                    BenchConsume(p.joysticks[j].GetButtons());
+                }
+                p.PostProcess();
+            }
+            BenchReport("frame + joystick polls, hot-plug scans", BenchNow() - start, iterations);
+        }
+
+        InputSnapshotBuffer *snapshots = new InputSnapshotBuffer;
+        start = BenchNow();
+        for (int i = 0; i < iterations; i++)
+        {
+            DWORD key = 0x10 + (i & 15);
+            backend->KeyDown(key);
+            backend->MouseMove(1, -1);
+            p.PreProcess();
+            snapshots->Publish(p.keyboard, p.mouse, p.joysticks, p.joystickCount, backend->GetTime());
+            {
+                InputSnapshotRef snapshot(snapshots);
+                BenchConsume(snapshot->KeyboardState[key]);
+            }
+            p.PostProcess();
+            backend->KeyUp(key);
+        }
+        BenchReport("typing + mouse + joysticks, snapshot", BenchNow() - start, iterations);
+        delete snapshots;
+    }
+
+    backend->Release();
+
+    // Main thread cost of the typing session when the input thread drains the devices
+    ScriptedInputBackend *drained = new ScriptedInputBackend;
+    for (int i = 0; i < JOYSTICK_COUNT; i++)
+        drained->AddJoystick(NULL);
+    ThreadedInputBackend *threaded = new ThreadedInputBackend(drained);
+    {
+        Pipeline p(threaded);
+        double start = BenchNow();
+        for (int i = 0; i < iterations; i++)
+        {
+            DWORD key = 0x10 + (i & 0x1F);
+            drained->KeyDown(key);
+            drained->MouseMove(3, -2);
+            p.PreProcess();
+            p.PostProcess();
+            drained->KeyUp(key);
+            p.PreProcess();
+            for (int j = 0; j < p.joystickCount; j++)
+            {
+                p.joysticks[j].Poll();
+                BenchConsume(p.joysticks[j].GetButtons());
+            }
+            p.PostProcess();
+        }
+        BenchReport("typing + mouse + joysticks, input thread", BenchNow() - start, iterations);
+    }
+    threaded->Release();
+
+    // Journal overhead on the typing session
+    int journalIterations = iterations / 10;
+    ScriptedInputBackend *script = new ScriptedInputBackend;
+    RecordingInputBackend *recorder = new RecordingInputBackend(script);
+    if (recorder->Open(JOURNAL_PATH))
+    {
+        Pipeline p(recorder);
+        double start = BenchNow();
+        for (int i = 0; i < journalIterations; i++)
+        {
+            DWORD key = 0x10 + (i & 0x1F);
+            script->KeyDown(key);
+            script->MouseMove(3, -2);
+            recorder->BeginFrame();
+            p.PreProcess();
+            recorder->EndFrame();
+            p.PostProcess();
+            script->KeyUp(key);
+            recorder->BeginFrame();
+            p.PreProcess();
+            recorder->EndFrame();
+            p.PostProcess();
+        }
+        BenchReport("typing + mouse, recorded", BenchNow() - start, journalIterations);
+    }
+    recorder->Release();
+
+    ReplayInputBackend *replay = new ReplayInputBackend;
+    if (replay->Open(JOURNAL_PATH))
+    {
+        Pipeline p(replay);
+        double start = BenchNow();
+        for (int i = 0; i < journalIterations * 2; i++)
+        {
+            replay->BeginFrame();
+            p.PreProcess();
+            replay->EndFrame();
+            p.PostProcess();
+        }
+        BenchReport("typing + mouse, replayed", BenchNow() - start, journalIterations);
+        if (replay->GetMissCount() != 0)
+            printf("journal replay missed %u calls\n", replay->GetMissCount());
+    }
+    replay->Release();
+    remove(JOURNAL_PATH);
+    return 0;
+}